@@ -31,6 +31,7 @@
 #include "config.h"
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include "nfs_core.h"
 #include "log.h"
@@ -1336,6 +1337,7 @@ static int32_t delegrecall_completion_func(rpc_call_t *call,
 	cache_entry_t *entry = NULL;
 	char str[LOG_BUFF_LEN];
 	struct display_buffer dspbuf = {sizeof(str), str, str};
+	bool chan_dead = false;
 
 	LogDebug(COMPONENT_NFS_CB, "%p %s", call,
 		 (hook == RPC_CALL_COMPLETE) ? "Success" : "Failed");
@@ -1365,30 +1367,31 @@ static int32_t delegrecall_completion_func(rpc_call_t *call,
 	switch (hook) {
 	case RPC_CALL_COMPLETE:
 		LogMidDebug(COMPONENT_NFS_CB, "call result: %d", call->stat);
-		fh = call->cbt.v_u.v4.args.argarray.argarray_val->
-				nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val;
 		if (call->stat != RPC_SUCCESS) {
-			LogEvent(COMPONENT_NFS_CB,
-				 "Call stat: %d, marking CB channel down",
-				 call->stat);
-			set_cb_chan_down(deleg_ctx->drc_clid, true);
+			chan_dead = cb_chan_failed(deleg_ctx->drc_clid);
+			LogEvent(COMPONENT_NFS_CB, "Call stat: %d%s",
+				 call->stat,
+				 chan_dead ? ", marking CB channel down" : "");
 			resp_act = DELEG_RECALL_SCHED;
-		} else
+		} else {
+			cb_chan_succeeded(deleg_ctx->drc_clid);
 			resp_act = handle_recall_response(deleg_ctx,
 							  state,
 							  call);
+		}
 		break;
 	default:
-		LogEvent(COMPONENT_NFS_CB,
-			 "Unknown hook %d, marking CB channel down", hook);
-		set_cb_chan_down(deleg_ctx->drc_clid, true);
+		chan_dead = cb_chan_failed(deleg_ctx->drc_clid);
+		LogEvent(COMPONENT_NFS_CB, "Unknown hook %d%s", hook,
+			 chan_dead ? ", marking CB channel down" : "");
 		/* Mark the recall as failed */
 		resp_act = DELEG_RECALL_SCHED;
 		break;
 	}
 	switch (resp_act) {
 	case DELEG_RECALL_SCHED:
-		if (eval_deleg_revoke(state))
+		/* No use retrying once the back channel has kept failing */
+		if (chan_dead || eval_deleg_revoke(state))
 			goto out_revoke;
 		else {
 			if (schedule_delegrecall_task(deleg_ctx, 1))
@@ -1413,6 +1416,7 @@ out_revoke:
 
 	deleg_ctx->drc_clid->num_revokes++;
 	inc_revokes(deleg_ctx->drc_clid->gsh_client);
+	deleg_heuristics_client_failed(deleg_ctx->drc_clid);
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
@@ -1434,10 +1438,15 @@ out_free_drc:
 
 out_free:
 
-	fh = call->cbt.v_u.v4.args.argarray.argarray_val->
-				nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val;
+	/* The CB_RECALL is last, after the CB_SEQUENCE on 4.1 */
+	fh = call->cbt.v_u.v4.args.argarray.argarray_val[
+		call->cbt.v_u.v4.args.argarray.argarray_len - 1].
+			nfs_cb_argop4_u.opcbrecall.fh.nfs_fh4_val;
 	gsh_free(fh);
-	free_rpc_call(call);
+	if (call->chan->type == RPC_CHAN_V41)
+		nfs41_complete_single(call, hook, arg, flags);
+	else
+		free_rpc_call(call);
 
 	if (entry != NULL)
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
@@ -1454,6 +1463,15 @@ out_free:
  * This function sends a cb_recall for one delegation, the caller has to lock
  * cache_entry->state_lock before calling this function.
  *
+ * The call is only queued here; the workers send recalls to many
+ * clients at once, connecting a v4.0 back channel themselves if need
+ * be.  A 4.1 client gets the CB_SEQUENCE and CB_RECALL in a single
+ * compound.  A client whose callbacks have failed NFS_CB_FAILURES_MAX
+ * times in a row has its delegation revoked straight away rather than
+ * retried until the revoke deadline.  A 4.1 client with no back
+ * channel, or with all its callback slots busy, is retried: SEQUENCE
+ * tells it the callback path is down, so it can bind a new one.
+ *
  * @param[in] entry The cache entry being delegated
  * @param[in] deleg_entry Lock entry covering the delegation
  * @param[in] delegrecall_context
@@ -1464,13 +1482,15 @@ void delegrecall_one(cache_entry_t *entry,
 		     struct delegrecall_context *p_cargs)
 {
 	char *maxfh = NULL;
-	rpc_call_channel_t *chan;
+	nfs_client_id_t *clid = p_cargs->drc_clid;
 	rpc_call_t *call = NULL;
 	nfs_cb_argop4 argop[1];
 	struct cf_deleg_stats *clfl_stats;
 	char str[LOG_BUFF_LEN];
 	struct display_buffer dspbuf = {sizeof(str), str, str};
 	bool str_valid = false;
+	bool revoke_now = false;
+	int code;
 
 	clfl_stats = &state->state_data.deleg.sd_clfile_stats;
 
@@ -1486,42 +1506,18 @@ void delegrecall_one(cache_entry_t *entry,
 	if (str_valid)
 		LogFullDebug(COMPONENT_FSAL_UP, "Recalling delegation %s", str);
 
-	inc_recalls(p_cargs->drc_clid->gsh_client);
+	inc_recalls(clid->gsh_client);
 
-	/* Attempt a recall only if channel state is UP */
-	if (get_cb_chan_down(p_cargs->drc_clid)) {
+	/* Attempt a recall only if channel state is UP; a 4.1 client is
+	 * retried until it binds a back channel or the deadline passes.
+	 */
+	if (clid->cid_minorversion == 0 && get_cb_chan_down(clid)) {
 		LogCrit(COMPONENT_NFS_CB,
 			"Call back channel down, not issuing a recall");
+		revoke_now = true;
 		goto out;
 	}
 
-	chan = nfs_rpc_get_chan(p_cargs->drc_clid, NFS_RPC_FLAG_NONE);
-	if (!chan) {
-		LogCrit(COMPONENT_NFS_CB, "nfs_rpc_get_chan failed");
-		/* TODO: move this to nfs_rpc_get_chan ? */
-		set_cb_chan_down(p_cargs->drc_clid, true);
-		goto out;
-	}
-	if (!chan->clnt) {
-		LogCrit(COMPONENT_NFS_CB, "nfs_rpc_get_chan failed (no clnt)");
-		set_cb_chan_down(p_cargs->drc_clid, true);
-		goto out;
-	}
-	/* allocate a new call--freed in completion hook */
-	call = alloc_rpc_call();
-
-	if (!call) {
-		LogCrit(COMPONENT_NFS_CB, "Could not allocate rpc call");
-		goto out;
-	}
-
-	call->chan = chan;
-
-	/* setup a compound */
-	cb_compound_init_v4(&call->cbt, 1, 0,
-			    p_cargs->drc_clid->cid_cb.v40.cb_callback_ident,
-			    "brrring!!!", 10);
-
 	argop->argop = NFS4_OP_CB_RECALL;
 	COPY_STATEID(&argop->nfs_cb_argop4_u.opcbrecall.stateid, state);
 	argop->nfs_cb_argop4_u.opcbrecall.truncate = false;
@@ -1545,20 +1541,64 @@ void delegrecall_one(cache_entry_t *entry,
 		goto out;
 	}
 
+	if (clid->cid_minorversion > 0) {
+		code = nfs_rpc_v41_single(clid, argop, NULL,
+					  delegrecall_completion_func,
+					  p_cargs, NULL);
+		if (code == 0)
+			return;
+
+		if (code == EBUSY) {
+			/* All callback slots in use, try again later */
+			LogDebug(COMPONENT_NFS_CB,
+				 "No free callback slot for recall");
+			goto out;
+		}
+
+		LogCrit(COMPONENT_NFS_CB,
+			"Could not send recall, code %d", code);
+		if (code == ENOTCONN) {
+			/* No session has a back channel, which SEQUENCE
+			 * reports to the client until it binds one.
+			 */
+			set_cb_chan_down(clid, true);
+		} else if (cb_chan_failed(clid)) {
+			revoke_now = true;
+		}
+		goto out;
+	}
+
+	/* allocate a new call--freed in completion hook */
+	call = alloc_rpc_call();
+
+	if (!call) {
+		LogCrit(COMPONENT_NFS_CB, "Could not allocate rpc call");
+		goto out;
+	}
+
+	call->chan = &clid->cid_cb.v40.cb_chan;
+
+	/* setup a compound */
+	cb_compound_init_v4(&call->cbt, 1, 0,
+			    clid->cid_cb.v40.cb_callback_ident,
+			    "brrring!!!", 10);
+
 	/* add ops, till finished */
 	cb_compound_add_op(&call->cbt, argop);
 
 	/* set completion hook */
 	call->call_hook = delegrecall_completion_func;
 
-	/* call it (here, in current thread context)
-	   ret is always 0 for async calls, might change in future */
-	if (nfs_rpc_submit_call(call, p_cargs, NFS_RPC_CALL_NONE) == 0)
+	/* queue it, the worker connects the back channel if it must */
+	if (nfs_rpc_submit_call(call, p_cargs, NFS_RPC_CALL_CONNECT) == 0)
 		return;
 
+	if (cb_chan_failed(clid))
+		revoke_now = true;
+
 out:
 
-	inc_failed_recalls(p_cargs->drc_clid->gsh_client);
+	inc_failed_recalls(clid->gsh_client);
 
 	if (maxfh)
 		gsh_free(maxfh);
@@ -1566,7 +1606,7 @@ out:
 	if (call)
 		free_rpc_call(call);
 
-	if (!eval_deleg_revoke(state) &&
+	if (!revoke_now && !eval_deleg_revoke(state) &&
 	    !schedule_delegrecall_task(p_cargs, 1)) {
 		/* Keep the delegation in p_cargs */
 		if (str_valid)
@@ -1581,8 +1621,9 @@ out:
 	LogCrit(COMPONENT_STATE, "Delegation will be revoked for %s",
 		str);
 
-	p_cargs->drc_clid->num_revokes++;
-	inc_revokes(p_cargs->drc_clid->gsh_client);
+	clid->num_revokes++;
+	inc_revokes(clid->gsh_client);
+	deleg_heuristics_client_failed(clid);
 
 	if (deleg_revoke(entry, state) != NFS4_OK) {
 		LogDebug(COMPONENT_FSAL_UP,
@@ -1745,6 +1786,8 @@ state_status_t delegrecall_impl(cache_entry_t *entry)
 	struct state_t *state;
 	state_owner_t *owner;
 	struct delegrecall_context *drc_ctx;
+	struct cf_deleg_stats *clfl_stats;
+	time_t now = time(NULL);
 
 	LogDebug(COMPONENT_FSAL_UP,
 		 "FSAL_UP_DELEG: entry %p type %u",
@@ -1801,7 +1844,7 @@ state_status_t delegrecall_impl(cache_entry_t *entry)
 		inc_client_id_ref(drc_ctx->drc_clid);
 		dec_state_owner_ref(owner);
 
-		entry->object.file.fdeleg_stats.fds_last_recall = time(NULL);
+		deleg_heuristics_recall_start(entry);
 
 		/* Prevent client's lease expiring until we complete
 		 * this recall/revoke operation. If the client's lease
@@ -1819,6 +1862,13 @@ state_status_t delegrecall_impl(cache_entry_t *entry)
 		}
 		PTHREAD_MUTEX_unlock(&drc_ctx->drc_clid->cid_mutex);
 
+		/* All the holders run against the same revoke deadline,
+		 * however long queueing the recalls takes.
+		 */
+		clfl_stats = &state->state_data.deleg.sd_clfile_stats;
+		if (clfl_stats->cfd_r_time == 0)
+			clfl_stats->cfd_r_time = now;
+
 		delegrecall_one(entry, state, drc_ctx);
 	}
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
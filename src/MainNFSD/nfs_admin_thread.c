@@ -129,6 +129,76 @@ static struct gsh_dbus_method method_get_grace = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Dbus method get reclaim progress of the grace period
+ *
+ * @param[in]  args  dbus args
+ * @param[out] reply dbus reply message with grace period status and
+ *                   counts of clients
+ */
+static bool admin_dbus_get_grace_progress(DBusMessageIter *args,
+					  DBusMessage *reply,
+					  DBusError *error)
+{
+	char *errormsg = "get grace progress success";
+	bool success = true;
+	DBusMessageIter iter;
+	dbus_bool_t ingrace;
+	nfs_grace_progress_t progress;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args != NULL) {
+		errormsg = "Get grace progress takes no arguments.";
+		success = false;
+		LogWarn(COMPONENT_DBUS, "%s", errormsg);
+		goto out;
+	}
+
+	ingrace = nfs_in_grace();
+	nfs_grace_progress(&progress);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &ingrace);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &progress.known);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &progress.returned);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &progress.reclaimed);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32,
+				       &progress.expired);
+
+ out:
+	dbus_status_reply(&iter, success, errormsg);
+	return success;
+}
+
+static struct gsh_dbus_method method_get_grace_progress = {
+	.name = "get_grace_progress",
+	.method = admin_dbus_get_grace_progress,
+	.args = {
+		 {.name = "isgrace",
+		  .type = "b",
+		  .direction = "out",
+		 },
+		 {.name = "known",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 {.name = "returned",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 {.name = "reclaimed",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 {.name = "expired",
+		  .type = "u",
+		  .direction = "out",
+		 },
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
 /**
  * @brief Dbus method start grace period
  *
@@ -272,6 +342,7 @@ static struct gsh_dbus_method *admin_methods[] = {
 	&method_shutdown,
 	&method_grace_period,
 	&method_get_grace,
+	&method_get_grace_progress,
 	&method_purge_gids,
 	NULL
 };
@@ -432,6 +503,9 @@ static void do_shutdown(void)
 		LogEvent(COMPONENT_THREAD, "Reaper thread shut down.");
 	}
 
+	LogEvent(COMPONENT_MAIN, "Saving inode cache warm start snapshot.");
+	cache_inode_warm_pkgshutdown();
+
 	LogEvent(COMPONENT_MAIN, "Stopping LRU thread.");
 	rc = cache_inode_lru_pkgshutdown();
 	if (rc != 0) {
@@ -64,6 +64,8 @@
 #include "delayed_exec.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "io_buffer.h"
+#include "gsh_cksum.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
@@ -176,6 +178,43 @@ void nfs_print_param_config(void)
 	printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tNb_Worker = %u ;\n", nfs_param.core_param.nb_worker);
+	printf("\tNb_Worker_Min = %u ;\n",
+	       nfs_param.core_param.nb_worker_min);
+	printf("\tNb_Worker_Max = %u ;\n",
+	       nfs_param.core_param.nb_worker_max);
+	printf("\tWorker_Wait_Target_Msec = %u ;\n",
+	       nfs_param.core_param.worker_wait_target_ms);
+	printf("\tDispatch_Lanes = %u ;\n",
+	       nfs_param.core_param.dispatch_lanes);
+	printf("\tDispatch_Quantum = %u ;\n",
+	       nfs_param.core_param.dispatch_quantum);
+	printf("\tDispatch_Batch = %u ;\n",
+	       nfs_param.core_param.dispatch_batch);
+	printf("\tDispatch_Spin_Usec = %u ;\n",
+	       nfs_param.core_param.dispatch_spin_usec);
+	printf("\tAdmission_Control = %s ;\n",
+	       nfs_param.core_param.admission_control ? "true" : "false");
+	printf("\tAdmission_Target_Msec = %u ;\n",
+	       nfs_param.core_param.admission_target_ms);
+	printf("\tAdmission_Interval_Msec = %u ;\n",
+	       nfs_param.core_param.admission_interval_ms);
+	printf("\tIO_Buffer_Cache_MB = %u ;\n",
+	       nfs_param.core_param.io_buffer_cache_mb);
+	printf("\tDispatch_NUMA = %s ;\n",
+	       nfs_param.core_param.dispatch_numa ? "true" : "false");
+	if (nfs_param.core_param.decoder_cpus != NULL)
+		printf("\tDecoder_CPUs = %s ;\n",
+		       nfs_param.core_param.decoder_cpus);
+	if (nfs_param.core_param.worker_cpus != NULL)
+		printf("\tWorker_CPUs = %s ;\n",
+		       nfs_param.core_param.worker_cpus);
+	printf("\tDRC_Budget_MB = %u ;\n", nfs_param.core_param.drc.budget_mb);
+	printf("\tDRC_Cache_Idempotent = %s ;\n",
+	       nfs_param.core_param.drc.cache_idempotent ? "true" : "false");
+	printf("\tDRC_Checksum_Type = %u ;\n",
+	       nfs_param.core_param.drc.cksum_type);
+	printf("\tDRC_Checksum_Len = %u ;\n",
+	       nfs_param.core_param.drc.cksum_len);
 	printf("\tDRC_TCP_Npart = %u ;\n", nfs_param.core_param.drc.tcp.npart);
 	printf("\tDRC_TCP_Size = %u ;\n", nfs_param.core_param.drc.tcp.size);
 	printf("\tDRC_TCP_Cachesz = %u ;\n",
@@ -528,6 +567,14 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	 */
 	exports_pkginit();
 
+	/* start preloading the inode cache from the warm start snapshot,
+	 * in the background while the grace period runs */
+	rc = cache_inode_warm_pkginit();
+	if (rc != 0) {
+		LogCrit(COMPONENT_INIT,
+			"Unable to start inode cache warm start: %d.", rc);
+	}
+
 	nfs41_session_pool =
 	    pool_init("NFSv4.1 session pool", sizeof(nfs41_session_t),
 		      pool_basic_substrate, NULL, NULL, NULL);
@@ -535,6 +582,8 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 		LogFatal(COMPONENT_INIT,
 			 "Error while allocating NFSv4.1 session pool");
 
+	io_buf_pkginit();
+
 	request_pool =
 	    pool_init("Request pool", sizeof(request_data_t),
 		      pool_basic_substrate, NULL,
@@ -623,6 +672,9 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 		"NFSv4 clientid cache successfully initialized");
 
 	/* Init duplicate request cache */
+	gsh_cksum_pkginit();
+	LogInfo(COMPONENT_INIT, "CRC32C checksums computed in %s",
+		gsh_cksum_hw() ? "hardware" : "software");
 	dupreq2_pkginit();
 	LogInfo(COMPONENT_INIT,
 		"duplicate request hash table cache successfully initialized");
@@ -706,7 +758,7 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	/* Create stable storage directory, this needs to be done before
 	 * starting the recovery thread.
 	 */
-	nfs4_create_recov_dir();
+	nfs4_recovery_init();
 
 	/* read in the client IDs */
 	nfs4_load_recov_clids(NULL);
@@ -854,9 +906,9 @@ void nfs_start(nfs_start_info_t *p_start_info)
 	/* Regular exit */
 	LogEvent(COMPONENT_MAIN, "NFS EXIT: regular exit");
 
-	/* if not in grace period, clean up the old state directory */
+	/* if not in grace period, clean up the old client records */
 	if (!nfs_in_grace())
-		nfs4_clean_old_recov_dir(v4_old_dir);
+		nfs4_recovery_end_grace();
 
 	Cleanup();
 
@@ -41,183 +41,93 @@ unsigned int reaper_delay = REAPER_DELAY;
 
 static struct fridgethr *reaper_fridge;
 
-static int reap_expired_open_owners(hash_table_t *ht_reap)
-{
-	struct rbt_head *head_rbt;
-	struct hash_data *addr = NULL;
-	uint32_t i;
-	int rc;
-	struct rbt_node *pn;
-	int count = 0;
-	char str[LOG_BUFF_LEN];
-	struct display_buffer dspbuf = {
-			sizeof(str), str, str};
-	state_owner_t *powner;
-	time_t tnow, tclose, texpire;
-	struct gsh_buffdesc buffkey;
-	struct gsh_buffdesc old_value;
-	struct gsh_buffdesc old_key;
-
-	/* For each bucket of the requested hashtable */
-	for (i = 0; i < ht_reap->parameter.index_size; i++) {
-		head_rbt = &ht_reap->partitions[i].rbt;
-
- restart:
-		/* Use the time at the start or restart of a bucket to
-		 * check for validity (don't call time() too many times).
-		 */
-		tnow = time(NULL);
-
-		/* acquire mutex */
-		PTHREAD_RWLOCK_wrlock(&ht_reap->partitions[i].lock);
-
-		/* go through all entries in the red-black-tree */
-		RBT_LOOP(head_rbt, pn) {
-			addr = RBT_OPAQ(pn);
-
-
-			powner = addr->val.addr;
-			count++;
-
-			if (powner->so_type != STATE_OPEN_OWNER_NFSV4) {
-				RBT_INCREMENT(pn);
-				continue;
-			}
-
-			display_owner(&dspbuf, powner);
-
-			/* Cleanup the open owner only if its refcount is zero
-			 * and its last_close_time exceeds the lease_lifetime
-			 */
-			tclose = atomic_fetch_time_t(&powner->so_owner.
-						     so_nfs4_owner.
-						     last_close_time);
-			texpire = tclose + nfs_param.nfsv4_param.lease_lifetime;
-
-			if ((tclose == 0) || (texpire > tnow)) {
-				if (tclose != 0 &&
-					isFullDebug(COMPONENT_STATE)) {
-					LogFullDebug(COMPONENT_STATE,
-							"Did not release CLOSE_PENDING %s, %d seconds left",
-							str,
-							(int) (texpire - tnow));
-				}
-				RBT_INCREMENT(pn);
-				continue;
-			}
-			LogFullDebug(COMPONENT_STATE, "Free {%s}", str);
-			buffkey.addr = powner;
-			buffkey.len = sizeof(*powner);
-
-			atomic_inc_int32_t(&powner->so_refcount);
-			PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].
-					      lock);
-			rc = HashTable_Del(ht_reap, &buffkey,
-					   &old_key, &old_value);
-
-			if (rc != HASHTABLE_SUCCESS) {
-				LogCrit(COMPONENT_CLIENTID,
-					"Could not remove expired owner %s error=%s",
-					str, hash_table_err_to_str(rc));
-			}
-
-			atomic_dec_int32_t(&powner->so_refcount);
-			free_state_owner(powner);
-			goto restart;
-
-		}
-		PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].lock);
-	}
-
-	return count;
-}
-
-static int reap_hash_table(hash_table_t *ht_reap)
+/**
+ * @brief Expire the clients whose leases have run out
+ *
+ * Only the clients that come due on the lease wheel are looked at;
+ * those renewed since they were armed go back on it.
+ *
+ * @return The number of clients looked at.
+ */
+static int reap_expired_clients(void)
 {
-	struct rbt_head *head_rbt;
-	struct hash_data *addr = NULL;
-	uint32_t i;
-	struct rbt_node *pn;
+	struct glist_head expired;
+	struct glist_head *glist, *glistn;
 	nfs_client_id_t *client_id;
 	nfs_client_record_t *client_rec;
-	int count = 0;
-
-	/* For each bucket of the requested hashtable */
-	for (i = 0; i < ht_reap->parameter.index_size; i++) {
-		head_rbt = &ht_reap->partitions[i].rbt;
-
-restart:
-		/* acquire mutex */
-		PTHREAD_RWLOCK_wrlock(&ht_reap->partitions[i].lock);
-
-		/* go through all entries in the red-black-tree */
-		RBT_LOOP(head_rbt, pn) {
-			char str[LOG_BUFF_LEN];
-			struct display_buffer dspbuf = {sizeof(str), str, str};
-			bool str_valid = false;
+	int count;
 
-			addr = RBT_OPAQ(pn);
-			client_id = addr->val.addr;
+	glist_init(&expired);
+	count = lease_timers_expired(&expired);
 
-			count++;
+	glist_for_each_safe(glist, glistn, &expired) {
+		char str[LOG_BUFF_LEN];
+		struct display_buffer dspbuf = {sizeof(str), str, str};
+		bool str_valid = false;
 
-			PTHREAD_MUTEX_lock(&client_id->cid_mutex);
+		client_id = glist_entry(glist, nfs_client_id_t,
+					cid_lease_timer.link);
+		glist_del(glist);
 
-			if (valid_lease(client_id)) {
-				PTHREAD_MUTEX_unlock(&client_id->cid_mutex);
-				RBT_INCREMENT(pn);
-				continue;
-			}
+		PTHREAD_MUTEX_lock(&client_id->cid_mutex);
 
-			if (isDebug(COMPONENT_CLIENTID)) {
-				display_client_id_rec(&dspbuf, client_id);
-				LogFullDebug(COMPONENT_CLIENTID,
-					     "Expire index %d %s", i, str);
-				str_valid = true;
-			}
-
-			/* Get the client record */
-			client_rec = client_id->cid_client_record;
-
-			/* get a ref to client_id as we might drop the
-			 * last reference with expiring.
+		if (client_id->cid_confirmed == EXPIRED_CLIENT_ID) {
+			/* Unhashed while we had it, drop the wheel's
+			 * reference.
 			 */
-			inc_client_id_ref(client_id);
+			PTHREAD_MUTEX_unlock(&client_id->cid_mutex);
+			dec_client_id_ref(client_id);
+			continue;
+		}
 
-			/* if record is STALE, the linkage to client_record is
-			 * removed already. Acquire a ref on client record
-			 * before we drop the mutex on clientid
+		if (valid_lease(client_id)) {
+			/* Renewed since armed, the wheel keeps its
+			 * reference.
 			 */
-			if (client_rec != NULL)
-				inc_client_record_ref(client_rec);
+			lease_timer_rearm(client_id);
 			PTHREAD_MUTEX_unlock(&client_id->cid_mutex);
-			if (client_rec != NULL)
-				PTHREAD_MUTEX_lock(&client_rec->cr_mutex);
+			continue;
+		}
 
-			PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].lock);
-			nfs_client_id_expire(client_id, false);
+		if (isDebug(COMPONENT_CLIENTID)) {
+			display_client_id_rec(&dspbuf, client_id);
+			LogFullDebug(COMPONENT_CLIENTID, "Expire %s", str);
+			str_valid = true;
+		}
 
-			if (client_rec != NULL) {
-				PTHREAD_MUTEX_unlock(&client_rec->cr_mutex);
-				dec_client_record_ref(client_rec);
-			}
+		/* Get the client record */
+		client_rec = client_id->cid_client_record;
 
-			if (isFullDebug(COMPONENT_CLIENTID)) {
-				if (!str_valid)
-					display_printf(&dspbuf, "clientid %p",
-						       client_id);
+		/* if record is STALE, the linkage to client_record is
+		 * removed already. Acquire a ref on client record
+		 * before we drop the mutex on clientid
+		 */
+		if (client_rec != NULL)
+			inc_client_record_ref(client_rec);
+		PTHREAD_MUTEX_unlock(&client_id->cid_mutex);
+		if (client_rec != NULL)
+			PTHREAD_MUTEX_lock(&client_rec->cr_mutex);
 
-				LogFullDebug(COMPONENT_CLIENTID,
-					     "Reaper done, expired {%s}", str);
-			}
+		nfs_client_id_expire(client_id, false);
 
-			/* drop our reference to the client_id */
-			dec_client_id_ref(client_id);
+		if (client_rec != NULL) {
+			PTHREAD_MUTEX_unlock(&client_rec->cr_mutex);
+			dec_client_record_ref(client_rec);
+		}
 
-			goto restart;
+		if (isFullDebug(COMPONENT_CLIENTID)) {
+			if (!str_valid)
+				display_printf(&dspbuf, "clientid %p",
+					       client_id);
+
+			LogFullDebug(COMPONENT_CLIENTID,
+				     "Reaper done, expired {%s}", str);
 		}
-		PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].lock);
+
+		/* drop the wheel's reference to the client_id */
+		dec_client_id_ref(client_id);
 	}
+
 	return count;
 }
 
@@ -240,12 +150,15 @@ static void reaper_run(struct fridgethr_context *ctx)
 	struct reaper_state *rst = ctx->arg;
 
 	SetNameFunction("reaper");
+
+	/* Grace may end early once known clients stop coming back */
+	nfs4_reclaim_expire_absent();
 	rst->in_grace = nfs_in_grace();
 
 	if (!rst->old_state_cleaned) {
 		/* if not in grace period, clean up the old state */
 		if (!rst->in_grace) {
-			nfs4_clean_old_recov_dir(v4_old_dir);
+			nfs4_recovery_end_grace();
 			rst->old_state_cleaned = true;
 		}
 	}
@@ -264,11 +177,9 @@ static void reaper_run(struct fridgethr_context *ctx)
 #endif
 	}
 
-	rst->count =
-	    (reap_hash_table(ht_confirmed_client_id) +
-	     reap_hash_table(ht_unconfirmed_client_id));
+	rst->count = reap_expired_clients();
 
-	rst->count += reap_expired_open_owners(ht_nfs4_owner);
+	rst->count += reap_expired_open_owners();
 }
 
 int reaper_init(void)
@@ -700,6 +700,7 @@ int nfs_rpc_create_chan_v41(nfs41_session_t *session, int num_sec_parms,
 	}
 
 	session->flags |= session_bc_up;
+	set_cb_chan_down(session->clientid_record, false);
 	code = 0;
 
  out:
@@ -960,6 +961,7 @@ int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
 	assert(chan);
 
 	call->completion_arg = completion_arg;
+	call->flags |= flags & NFS_RPC_CALL_CONNECT;
 	if (flags & NFS_RPC_CALL_INLINE) {
 		code = nfs_rpc_dispatch_call(call, NFS_RPC_CALL_NONE);
 	} else {
@@ -1004,6 +1006,15 @@ int32_t nfs_rpc_dispatch_call(rpc_call_t *call, uint32_t flags)
 	/* XXX TI-RPC does the signal masking */
 	PTHREAD_MUTEX_lock(&call->chan->mtx);
 
+	/* Connect here rather than in the submitter, so that calls to
+	 * many clients do not wait on each other's connects.
+	 */
+	if (!call->chan->clnt && (call->flags & NFS_RPC_CALL_CONNECT))
+		(void)nfs_rpc_create_chan_v40(container_of(call->chan,
+							   nfs_client_id_t,
+							   cid_cb.v40.cb_chan),
+					      NFS_RPC_FLAG_NONE);
+
 	if (!call->chan->clnt) {
 		call->stat = RPC_INTR;
 		goto unlock;
@@ -1186,9 +1197,7 @@ static bool find_cb_slot(nfs41_session_t *session, bool wait, slotid4 *slot,
 
 	PTHREAD_MUTEX_lock(&session->cb_mutex);
  retry:
-	for (cur = 0;
-	     cur < MIN(session->back_channel_attrs.ca_maxrequests,
-		       NFS41_NB_SLOTS); ++cur) {
+	for (cur = 0; cur < session->nb_cb_slots; ++cur) {
 		if (!(session->cb_slots[cur].in_use) && (!found)) {
 			found = true;
 			*slot = cur;
@@ -1217,7 +1226,7 @@ static bool find_cb_slot(nfs41_session_t *session, bool wait, slotid4 *slot,
 	if (found) {
 		session->cb_slots[*slot].in_use = true;
 		++session->cb_slots[*slot].sequence;
-		assert(*slot < session->back_channel_attrs.ca_maxrequests);
+		assert(*slot < session->nb_cb_slots);
 	}
 	PTHREAD_MUTEX_unlock(&session->cb_mutex);
 
@@ -1267,7 +1276,11 @@ static void release_cb_slot(nfs41_session_t *session, slotid4 slot, bool sent)
  *                           also be called explicitly from the completion
  *                           function.
  *
- * @return POSIX error codes.
+ * @retval 0 if the call was queued.
+ * @retval ENOTCONN if no session has a back channel.
+ * @retval EBUSY if every callback slot stayed in use, so the caller
+ *         may retry later.
+ * @return Other POSIX error codes.
  */
 int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 		       struct state_refer *refer,
@@ -1278,6 +1291,7 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 {
 	int scan = 0;
 	bool sent = false;
+	bool busy = false;
 	struct glist_head *glist = NULL;
 
 	if (clientid->cid_minorversion < 1)
@@ -1300,6 +1314,7 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 			if (!
 			    (find_cb_slot
 			     (session, scan == 1, &slot, &highest_slot))) {
+				busy = true;
 				continue;
 			}
 			call =
@@ -1330,7 +1345,9 @@ int nfs_rpc_v41_single(nfs_client_id_t *clientid, nfs_cb_argop4 *op,
 	}
 
  out:
-	return (sent) ? 0 : ENOTCONN;
+	if (sent)
+		return 0;
+	return busy ? EBUSY : ENOTCONN;
 }
 
 /**
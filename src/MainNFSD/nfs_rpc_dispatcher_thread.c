@@ -37,6 +37,9 @@
 #include <sys/select.h>
 #include <poll.h>
 #include <assert.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include "hashtable.h"
 #include "log.h"
 #include "gsh_rpc.h"
@@ -56,6 +59,8 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "fridgethr.h"
+#include "client_mgr.h"
+#include "cpu_affinity.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -78,6 +83,12 @@ static struct rpc_evchan rpc_evchan[N_EVENT_CHAN];
 
 struct fridgethr *req_fridge;	/*< Decoder thread pool */
 struct nfs_req_st nfs_req_st;	/*< Shared request queues */
+struct admission_stats admission_st;	/*< Load shedding counters */
+
+static cpu_set_t decoder_cpus;	/*< CPUs for decoders, if bound */
+static bool decoder_bound;
+static cpu_set_t worker_cpus;	/*< CPUs for workers, if bound */
+static bool worker_bound;
 
 const char *req_q_s[N_REQ_QUEUES] = {
 	"REQ_Q_MOUNT",
@@ -1037,33 +1048,29 @@ static void nfs_rpc_free_user_data(SVCXPRT *xprt)
 	free_gsh_xprt_private(xprt);
 }
 
+static uint32_t enqueued_reqs;
+static uint32_t dequeued_reqs;
+
 uint32_t nfs_rpc_outstanding_reqs_est(void)
 {
-	static uint32_t ctr;
-	static uint32_t nreqs;
-	struct req_q_pair *qpair;
-	uint32_t treqs;
-	int ix;
-
-	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
-		return atomic_fetch_uint32_t(&nreqs);
-
-	treqs = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		treqs += atomic_fetch_uint32_t(&qpair->producer.size);
-		treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
-	}
-
-	atomic_store_uint32_t(&nreqs, treqs);
-	return treqs;
+	/* the class queues hold flows, not requests, so count the
+	 * difference of the totals instead */
+	return atomic_fetch_uint32_t(&enqueued_reqs)
+		- atomic_fetch_uint32_t(&dequeued_reqs);
 }
 
 static inline bool stallq_should_unstall(SVCXPRT *xprt)
 {
-	return ((xprt->xp_requests
-		 < nfs_param.core_param.dispatch_max_reqs_xprt / 2)
-		|| (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED));
+	if (xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		return true;
+
+	/* a shed transport is let go once its requests are served, or
+	 * the overload ends */
+	if (gsh_xprt_shed(xprt))
+		return xprt->xp_requests == 0 || !nfs_rpc_overloaded();
+
+	return xprt->xp_requests
+		< nfs_param.core_param.dispatch_max_reqs_xprt / 2;
 }
 
 void thr_stallq(struct fridgethr_context *thr_ctx)
@@ -1072,8 +1079,14 @@ void thr_stallq(struct fridgethr_context *thr_ctx)
 	struct glist_head *l;
 	SVCXPRT *xprt;
 
+	/* shed transports are checked at the pace of admission control */
+	uint32_t delay_ms = nfs_param.core_param.admission_interval_ms;
+
+	if (delay_ms > 1000)
+		delay_ms = 1000;
+
 	while (1) {
-		thread_delay_ms(1000);
+		thread_delay_ms(delay_ms);
 		PTHREAD_MUTEX_lock(&nfs_req_st.stallq.mtx);
  restart:
 		if (nfs_req_st.stallq.stalled == 0) {
@@ -1101,7 +1114,8 @@ void thr_stallq(struct fridgethr_context *thr_ctx)
 					glist_del(&xu->stallq);
 					--(nfs_req_st.stallq.stalled);
 					atomic_clear_uint16_t_bits(&xu->flags,
-						XPRT_PRIVATE_FLAG_STALLED);
+						XPRT_PRIVATE_FLAG_STALLED |
+						XPRT_PRIVATE_FLAG_SHED);
 					(void)svc_rqst_rearm_events(
 						xprt, SVC_RQST_FLAG_NONE);
 					/* drop stallq ref */
@@ -1123,9 +1137,18 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	gsh_xprt_private_t *xu;
 	bool activate = false;
 	uint32_t nreqs = xprt->xp_requests;
+	bool shed = gsh_xprt_shed(xprt);
+
+	/* marked for shedding, but the overload has passed */
+	if (unlikely(shed) && !nfs_rpc_overloaded()) {
+		xu = (gsh_xprt_private_t *) xprt->xp_u1;
+		atomic_clear_uint16_t_bits(&xu->flags, XPRT_PRIVATE_FLAG_SHED);
+		shed = false;
+	}
 
 	/* check per-xprt quota */
-	if (likely(nreqs < nfs_param.core_param.dispatch_max_reqs_xprt)) {
+	if (likely(nreqs < nfs_param.core_param.dispatch_max_reqs_xprt
+		   && !shed)) {
 		LogDebug(COMPONENT_DISPATCH,
 			 "xprt %p xp_refs %" PRIu32 " has %" PRIu32
 			 " reqs active (max %d)",
@@ -1147,8 +1170,10 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 		return true;
 	}
 
-	LogDebug(COMPONENT_DISPATCH, "xprt %p has %u reqs, marking stalled",
-		 xprt, nreqs);
+	LogDebug(COMPONENT_DISPATCH, "xprt %p has %u reqs, marking stalled%s",
+		 xprt, nreqs, shed ? " (shed)" : "");
+	if (shed)
+		atomic_inc_uint64_t(&admission_st.xprt_stalls);
 
 	/* ok, need to stall */
 	PTHREAD_MUTEX_lock(&nfs_req_st.stallq.mtx);
@@ -1180,10 +1205,80 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	return true;
 }
 
+/**
+ * @brief Bind a new decoder thread to the configured CPUs
+ *
+ * @param[in] ctx Thread fridge context
+ */
+
+static void decoder_thread_initializer(struct fridgethr_context *ctx)
+{
+	if (decoder_bound)
+		(void)cpu_affinity_set_self(&decoder_cpus);
+}
+
+/**
+ * @brief Bind a worker thread according to its home lane
+ *
+ * With a lane per NUMA node, a worker runs on the CPUs of its lane's
+ * node (those of Worker_CPUs, if any are on it), so that requests
+ * received on a node are executed there and the memory the worker
+ * allocates is that node's.  Otherwise only Worker_CPUs applies.
+ *
+ * @param[in] lane The worker's home lane
+ */
+
+void nfs_rpc_worker_bind(uint32_t lane)
+{
+	cpu_set_t set, node;
+
+	if (!nfs_param.core_param.dispatch_numa) {
+		if (worker_bound)
+			(void)cpu_affinity_set_self(&worker_cpus);
+		return;
+	}
+
+	cpu_topology_node_cpus(lane, &node);
+	if (worker_bound) {
+		CPU_AND(&set, &node, &worker_cpus);
+		if (CPU_COUNT(&set) == 0)
+			set = node;
+	} else {
+		set = node;
+	}
+	(void)cpu_affinity_set_self(&set);
+}
+
+/**
+ * @brief Parse one of the CPU list options
+ *
+ * @param[in]  name  Option name, for the log
+ * @param[in]  list  Its value, may be NULL
+ * @param[out] set   The CPUs
+ *
+ * @return true if threads are to be bound to set.
+ */
+
+static bool nfs_rpc_cpus_conf(const char *name, const char *list,
+			      cpu_set_t *set)
+{
+	if (list == NULL)
+		return false;
+	if (!cpu_list_parse(list, set)) {
+		LogCrit(COMPONENT_DISPATCH,
+			"Ignoring bad CPU list %s = \"%s\"", name, list);
+		return false;
+	}
+	return true;
+}
+
 void nfs_rpc_queue_init(void)
 {
 	struct fridgethr_params reqparams;
 	struct req_q_pair *qpair;
+	struct req_lane *lane;
+	uint32_t n_lanes;
+	uint32_t lx;
 	int rc = 0;
 	int ix;
 
@@ -1198,6 +1293,15 @@ void nfs_rpc_queue_init(void)
 	reqparams.deferment = fridgethr_defer_block;
 	reqparams.block_delay =
 		nfs_param.core_param.decoder_fridge_block_timeout;
+	reqparams.thread_initialize = decoder_thread_initializer;
+
+	cpu_topology_init();
+	decoder_bound = nfs_rpc_cpus_conf("Decoder_CPUs",
+					  nfs_param.core_param.decoder_cpus,
+					  &decoder_cpus);
+	worker_bound = nfs_rpc_cpus_conf("Worker_CPUs",
+					 nfs_param.core_param.worker_cpus,
+					 &worker_cpus);
 
 	/* decoder thread pool */
 	rc = fridgethr_init(&req_fridge, "decoder", &reqparams);
@@ -1205,19 +1309,48 @@ void nfs_rpc_queue_init(void)
 		LogFatal(COMPONENT_DISPATCH,
 			 "Unable to initialize decoder thread pool: %d", rc);
 
-	/* queues */
-	pthread_spin_init(&nfs_req_st.reqs.sp, PTHREAD_PROCESS_PRIVATE);
-	nfs_req_st.reqs.size = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		qpair->s = req_q_s[ix];
-		nfs_rpc_q_init(&qpair->producer);
-		nfs_rpc_q_init(&qpair->consumer);
+	/* lanes, one per CPU (or NUMA node) unless configured, but
+	 * never more than there are workers to serve them */
+	n_lanes = nfs_param.core_param.dispatch_lanes;
+	if (nfs_param.core_param.dispatch_numa) {
+		n_lanes = cpu_topology_nodes();
+	} else if (n_lanes == 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+		n_lanes = (ncpu > 0) ? ncpu : 1;
 	}
+	if (n_lanes > nfs_param.core_param.nb_worker)
+		n_lanes = nfs_param.core_param.nb_worker;
 
-	/* waitq */
-	glist_init(&nfs_req_st.reqs.wait_list);
+	nfs_req_st.reqs.lanes =
+		gsh_malloc_aligned(GSH_CACHE_LINE_SIZE,
+				   n_lanes * sizeof(struct req_lane));
+	if (nfs_req_st.reqs.lanes == NULL)
+		LogFatal(COMPONENT_DISPATCH,
+			 "Unable to allocate %" PRIu32 " dispatch lanes",
+			 n_lanes);
+
+	/* queues and waitqs */
+	nfs_req_st.reqs.n_lanes = n_lanes;
+	nfs_req_st.reqs.size = 0;
 	nfs_req_st.reqs.waiters = 0;
+	for (lx = 0; lx < n_lanes; ++lx) {
+		lane = &nfs_req_st.reqs.lanes[lx];
+		memset(lane, 0, sizeof(struct req_lane));
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			qpair = &lane->nfs_request_q.qset[ix];
+			qpair->s = req_q_s[ix];
+			qpair->lane = lane;
+			nfs_rpc_q_init(&qpair->producer);
+			nfs_rpc_q_init(&qpair->consumer);
+			nfs_rpc_flow_init(&qpair->anon, 1);
+		}
+		lane->pending = 0;
+		ec_init(&lane->ec);
+		pthread_spin_init(&lane->codel.sp, PTHREAD_PROCESS_PRIVATE);
+	}
+
+	LogInfo(COMPONENT_DISPATCH, "%" PRIu32 " dispatch lanes", n_lanes);
 
 	/* stallq */
 	gsh_mutex_init(&nfs_req_st.stallq.mtx, NULL);
@@ -1226,9 +1359,6 @@ void nfs_rpc_queue_init(void)
 	nfs_req_st.stallq.stalled = 0;
 }
 
-static uint32_t enqueued_reqs;
-static uint32_t dequeued_reqs;
-
 uint32_t get_enqueue_count(void)
 {
 	return enqueued_reqs;
@@ -1239,11 +1369,252 @@ uint32_t get_dequeue_count(void)
 	return dequeued_reqs;
 }
 
+/**
+ * @brief The CPU on which a transport's packets are received
+ *
+ * This is where the NIC interrupt (or RPS) delivers them, re-read
+ * from the socket every so often.
+ *
+ * @param[in] xprt The transport
+ *
+ * @return The CPU, or -1 if unknown.
+ */
+
+static inline int nfs_rpc_xprt_cpu(SVCXPRT *xprt)
+{
+#ifdef SO_INCOMING_CPU
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	socklen_t len = sizeof(int);
+	int cpu;
+
+	if (xu == NULL)
+		return -1;
+
+	if ((atomic_inc_uint32_t(&xu->rx_cpu_age) % 64) == 1
+	    && getsockopt(xprt->xp_fd, SOL_SOCKET, SO_INCOMING_CPU,
+			  &cpu, &len) == 0)
+		atomic_store_int32_t(&xu->rx_cpu, cpu);
+
+	return atomic_fetch_int32_t(&xu->rx_cpu);
+#else
+	return -1;
+#endif
+}
+
+/**
+ * @brief Choose the lane for a request
+ *
+ * A request goes to the lane of the CPU that received it from the
+ * network, or failing that the one decoding it; with a lane per NUMA
+ * node, to that CPU's node.
+ *
+ * @param[in] reqdata The request
+ *
+ * @return Lane index.
+ */
+
+static inline uint32_t nfs_rpc_req_lane(request_data_t *reqdata)
+{
+	int cpu = -1;
+
+	if (reqdata->rtype == NFS_REQUEST)
+		cpu = nfs_rpc_xprt_cpu(reqdata->r_u.req.xprt);
+	if (cpu < 0)
+		cpu = sched_getcpu();
+
+	if (unlikely(cpu < 0))
+		return nfs_rpc_q_next_slot() % nfs_req_st.reqs.n_lanes;
+
+	if (nfs_param.core_param.dispatch_numa)
+		return cpu_topology_node_of(cpu) % nfs_req_st.reqs.n_lanes;
+
+	return (uint32_t) cpu % nfs_req_st.reqs.n_lanes;
+}
+
+/**
+ * @brief Wake one idle worker, preferring those of a lane
+ *
+ * @param[in] lx The lane
+ */
+
+static void nfs_rpc_wake_worker(uint32_t lx)
+{
+	uint32_t n_lanes = nfs_req_st.reqs.n_lanes;
+	uint32_t ix;
+
+	/* order the queued request before the load of waiters */
+	__sync_synchronize();
+	if (atomic_fetch_uint32_t(&nfs_req_st.reqs.waiters) == 0)
+		return;
+
+	for (ix = 0; ix < n_lanes; ++ix) {
+		if (ec_signal(&nfs_req_st.reqs.lanes[(lx + ix) % n_lanes].ec,
+			      1))
+			return;
+	}
+}
+
+/**
+ * @brief Find out whether any lane has requests queued
+ *
+ * @return true if so.
+ */
+
+static bool nfs_rpc_lanes_pending(void)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < nfs_req_st.reqs.n_lanes; ++ix)
+		if (atomic_fetch_uint32_t(&nfs_req_st.reqs.lanes[ix].pending))
+			return true;
+
+	return false;
+}
+
+/**
+ * @brief Integer square root, for the CoDel control law
+ *
+ * @param[in] n The operand
+ *
+ * @return floor(sqrt(n)).
+ */
+
+static uint32_t codel_sqrt(uint32_t n)
+{
+	uint32_t r = 0;
+	uint32_t b = 1U << 30;
+
+	while (b > n)
+		b >>= 2;
+	while (b != 0) {
+		if (n >= r + b) {
+			n -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+	return r;
+}
+
+/**
+ * @brief Feed the time a request spent queued to admission control
+ *
+ * @param[in] lane     The lane it was queued on
+ * @param[in] sojourn  Time queued
+ */
+
+static void nfs_rpc_codel_sample(struct req_lane *lane, uint64_t sojourn)
+{
+	struct req_codel *cd = &lane->codel;
+	uint64_t target =
+		nfs_param.core_param.admission_target_ms * NS_PER_MSEC;
+	uint64_t interval =
+		nfs_param.core_param.admission_interval_ms * NS_PER_MSEC;
+	uint64_t now_ns;
+
+	if (!nfs_param.core_param.admission_control)
+		return;
+
+	/* a sample missed to contention does no harm */
+	if (pthread_spin_trylock(&cd->sp) != 0)
+		return;
+
+	now_ns = mono_nsecs();
+	if (sojourn < target) {
+		cd->first_above = 0;
+		if (cd->overloaded) {
+			cd->overloaded = false;
+			atomic_dec_uint32_t(&admission_st.overloaded);
+			LogDebug(COMPONENT_DISPATCH,
+				 "lane %p overload over, %" PRIu32 " shed",
+				 lane, cd->count);
+		}
+	} else if (cd->first_above == 0) {
+		cd->first_above = now_ns + interval;
+	} else if (!cd->overloaded && now_ns >= cd->first_above) {
+		cd->overloaded = true;
+		/* pick up near the last rate if it was recent */
+		if (cd->count > 2 && now_ns - cd->shed_next < 16 * interval)
+			cd->count -= 2;
+		else
+			cd->count = 0;
+		cd->shed_next = now_ns;
+		atomic_inc_uint32_t(&admission_st.overloaded);
+		atomic_inc_uint64_t(&admission_st.overloads);
+		LogDebug(COMPONENT_DISPATCH,
+			 "lane %p overloaded, requests queued %" PRIu64
+			 " ns", lane, sojourn);
+	}
+
+	pthread_spin_unlock(&cd->sp);
+}
+
+/**
+ * @brief Find out whether a sender is due to be shed
+ *
+ * Called for a sender with more than its share of the lane queued.
+ *
+ * @param[in] lane The lane
+ *
+ * @return true if the sender is to be stalled.
+ */
+
+static bool nfs_rpc_codel_shed(struct req_lane *lane)
+{
+	struct req_codel *cd = &lane->codel;
+	uint64_t interval =
+		nfs_param.core_param.admission_interval_ms * NS_PER_MSEC;
+	uint64_t now_ns = mono_nsecs();
+	bool shed = false;
+
+	pthread_spin_lock(&cd->sp);
+	if (cd->overloaded && now_ns >= cd->shed_next) {
+		shed = true;
+		cd->count++;
+		cd->shed_next = now_ns + interval / codel_sqrt(cd->count);
+	}
+	pthread_spin_unlock(&cd->sp);
+
+	return shed;
+}
+
+/**
+ * @brief Find out whether a flow holds more than its share of a lane
+ *
+ * Unlocked reads; this is a heuristic.
+ *
+ * @param[in] flow The flow
+ * @param[in] lane Its lane
+ */
+
+static bool nfs_rpc_flow_heavy(struct req_flow *flow, struct req_lane *lane)
+{
+	uint32_t active = 0;
+	uint32_t qx;
+
+	for (qx = 0; qx < N_REQ_QUEUES; ++qx) {
+		struct req_q_pair *qpair = &lane->nfs_request_q.qset[qx];
+
+		active += qpair->producer.size + qpair->consumer.size;
+	}
+	if (active == 0)
+		active = 1;
+
+	return flow->size >= 2
+		&& flow->size >= atomic_fetch_uint32_t(&lane->pending) / active;
+}
+
 void nfs_rpc_enqueue_req(request_data_t *reqdata)
 {
 	struct req_q_set *nfs_request_q;
 	struct req_q_pair *qpair;
+	struct req_flow *flow;
 	struct req_q *q;
+	uint32_t lx, qx;
+	bool activate = false;
+	bool first;
 
 #if defined(HAVE_BLKIN)
 	BLKIN_TIMESTAMP(
@@ -1252,7 +1623,9 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 		"enqueue-enter");
 #endif
 
-	nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	lx = nfs_rpc_req_lane(reqdata);
+	nfs_request_q = &nfs_req_st.reqs.lanes[lx].nfs_request_q;
+	reqdata->client = NULL;
 
 	switch (reqdata->rtype) {
 	case NFS_REQUEST:
@@ -1260,38 +1633,64 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 			     "enter rq_xid=%u lookahead.flags=%u",
 			     reqdata->r_u.req.svc.rq_xid,
 			     reqdata->r_u.req.lookahead.flags);
+		reqdata->client = get_gsh_client(
+			(sockaddr_t *)svc_getrpccaller(reqdata->r_u.req.xprt),
+			false);
 		if (reqdata->r_u.req.lookahead.flags & NFS_LOOKAHEAD_MOUNT) {
-			qpair = &(nfs_request_q->qset[REQ_Q_MOUNT]);
+			qx = REQ_Q_MOUNT;
 			break;
 		}
 		if (NFS_LOOKAHEAD_HIGH_LATENCY(reqdata->r_u.req.lookahead))
-			qpair = &(nfs_request_q->qset[REQ_Q_HIGH_LATENCY]);
+			qx = REQ_Q_HIGH_LATENCY;
 		else
-			qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+			qx = REQ_Q_LOW_LATENCY;
 		break;
 	case NFS_CALL:
-		qpair = &(nfs_request_q->qset[REQ_Q_CALL]);
+		qx = REQ_Q_CALL;
 		break;
 #ifdef _USE_9P
 	case _9P_REQUEST:
 		/* XXX identify high-latency requests and allocate
 		 * to the high-latency queue, as above */
-		qpair = &(nfs_request_q->qset[REQ_Q_LOW_LATENCY]);
+		qx = REQ_Q_LOW_LATENCY;
 		break;
 #endif
 	default:
 		goto out;
 	}
 
+	qpair = &nfs_request_q->qset[qx];
+	flow = (reqdata->client != NULL)
+		? &reqdata->client->flows[qx] : &qpair->anon;
+
 	/* this one is real, timestamp it
 	 */
 	now(&reqdata->time_queued);
-	/* always append to producer queue */
+	/* always append to the sender's flow */
+	pthread_spin_lock(&flow->sp);
+	glist_add_tail(&flow->q, &reqdata->req_q);
+	++(flow->size);
+	if (flow->qpair == NULL) {
+		flow->qpair = qpair;
+		activate = true;
+	} else {
+		/* already active, perhaps on another lane */
+		qpair = flow->qpair;
+	}
+	first = (atomic_inc_uint32_t(&qpair->lane->pending) == 1);
+	pthread_spin_unlock(&flow->sp);
+
+	/* the lane the request actually went to */
+	lx = qpair->lane - nfs_req_st.reqs.lanes;
+
+	/* a newly active flow joins the producer queue */
 	q = &qpair->producer;
-	pthread_spin_lock(&q->sp);
-	glist_add_tail(&q->q, &reqdata->req_q);
-	++(q->size);
-	pthread_spin_unlock(&q->sp);
+	if (activate) {
+		pthread_spin_lock(&q->sp);
+		glist_add_tail(&q->q, &flow->link);
+		++(q->size);
+		pthread_spin_unlock(&q->sp);
+	}
 
 	atomic_inc_uint32_t(&enqueued_reqs);
 
@@ -1310,120 +1709,159 @@ void nfs_rpc_enqueue_req(request_data_t *reqdata)
 		"enqueue-exit");
 #endif
 	LogDebug(COMPONENT_DISPATCH,
-		 "enqueued req, q %p (%s %p:%p) size is %d (enq %u deq %u)",
-		 q, qpair->s, &qpair->producer, &qpair->consumer, q->size,
-		 enqueued_reqs, dequeued_reqs);
+		 "enqueued req, lane %u flow %p (%s %p:%p) size is %d (enq %u deq %u)",
+		 lx, flow, qpair->s, &qpair->producer, &qpair->consumer,
+		 flow->size, enqueued_reqs, dequeued_reqs);
+
+	/* under overload, stop reading from senders with more than
+	 * their share queued, one at a time (not UDP, whose transport
+	 * every client shares) */
+	if (unlikely(qpair->lane->codel.overloaded)
+	    && reqdata->rtype == NFS_REQUEST
+	    && reqdata->r_u.req.xprt->xp_type != XPRT_UDP
+	    && nfs_rpc_flow_heavy(flow, qpair->lane)
+	    && nfs_rpc_codel_shed(qpair->lane)) {
+		gsh_xprt_private_t *xu =
+			(gsh_xprt_private_t *) reqdata->r_u.req.xprt->xp_u1;
+
+		LogDebug(COMPONENT_DISPATCH, "shedding xprt %p",
+			 reqdata->r_u.req.xprt);
+		atomic_set_uint16_t_bits(&xu->flags, XPRT_PRIVATE_FLAG_SHED);
+	}
 
-	/* potentially wakeup some thread */
+	/* wake a worker only when the lane was empty; otherwise the
+	 * worker that dequeues ahead of this request passes it on */
+	if (first)
+		nfs_rpc_wake_worker(lx);
 
-	/* global waitq */
-	{
-		wait_q_entry_t *wqe;
+ out:
+	return;
+}
 
-		/* SPIN LOCKED */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		if (nfs_req_st.reqs.waiters) {
-			wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
-						wait_q_entry_t, waitq);
+/**
+ * @brief Cost of a request to the fair queue, in operations
+ *
+ * @param[in] reqdata The request
+ *
+ * @return The number of operations in an NFSv4 COMPOUND, otherwise 1.
+ */
 
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
-
-			/* release 1 waiter */
-			glist_del(&wqe->waitq);
-			--(nfs_req_st.reqs.waiters);
-			--(wqe->waiters);
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-			PTHREAD_MUTEX_lock(&wqe->lwe.mtx);
-			/* XXX reliable handoff */
-			wqe->flags |= Wqe_LFlag_SyncDone;
-			if (wqe->flags & Wqe_LFlag_WaitSync)
-				pthread_cond_signal(&wqe->lwe.cv);
-			PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
-		} else
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-	}
+static inline uint32_t nfs_rpc_req_cost(request_data_t *reqdata)
+{
+	nfs_request_t *reqnfs = &reqdata->r_u.req;
+	uint32_t ops;
 
- out:
-	return;
+	if (reqdata->rtype != NFS_REQUEST
+	    || reqnfs->svc.rq_prog != nfs_param.core_param.program[P_NFS]
+	    || reqnfs->svc.rq_vers != NFS_V4
+	    || reqnfs->svc.rq_proc != NFSPROC4_COMPOUND)
+		return 1;
+
+	ops = reqnfs->arg_nfs.arg_compound4.argarray.argarray_len;
+	return (ops > 0) ? ops : 1;
 }
 
 /* static inline */
 request_data_t *nfs_rpc_consume_req(struct req_q_pair *qpair)
 {
 	request_data_t *reqdata = NULL;
+	struct req_flow *flow;
+	struct timespec ts;
+	uint64_t sojourn = 0;
+	uint32_t skipped = 0;
 
 	pthread_spin_lock(&qpair->consumer.sp);
-	if (qpair->consumer.size > 0) {
-		reqdata =
-		    glist_first_entry(&qpair->consumer.q, request_data_t,
-				      req_q);
-		glist_del(&reqdata->req_q);
-		--(qpair->consumer.size);
-		pthread_spin_unlock(&qpair->consumer.sp);
-		goto out;
-	} else {
-		char *s = NULL;
-		uint32_t csize = ~0U;
-		uint32_t psize = ~0U;
 
+	/* newly active flows join the end of the round */
+	if (atomic_fetch_uint32_t(&qpair->producer.size) > 0) {
 		pthread_spin_lock(&qpair->producer.sp);
-		if (isFullDebug(COMPONENT_DISPATCH)) {
-			s = (char *)qpair->s;
-			csize = qpair->consumer.size;
-			psize = qpair->producer.size;
+		glist_splice_tail(&qpair->consumer.q, &qpair->producer.q);
+		qpair->consumer.size += qpair->producer.size;
+		qpair->producer.size = 0;
+		pthread_spin_unlock(&qpair->producer.sp);
+	}
+
+	while (qpair->consumer.size > 0) {
+		flow = glist_first_entry(&qpair->consumer.q, struct req_flow,
+					 link);
+		pthread_spin_lock(&flow->sp);
+		if (!flow->topped) {
+			flow->deficit += (int64_t) flow->weight
+				* nfs_param.core_param.dispatch_quantum;
+			flow->topped = true;
 		}
-		if (qpair->producer.size > 0) {
-			/* splice */
-			glist_splice_tail(&qpair->consumer.q,
-					  &qpair->producer.q);
-			qpair->consumer.size = qpair->producer.size;
-			qpair->producer.size = 0;
-			/* consumer.size > 0 */
-			pthread_spin_unlock(&qpair->producer.sp);
-			reqdata =
-			    glist_first_entry(&qpair->consumer.q,
-					      request_data_t, req_q);
-			glist_del(&reqdata->req_q);
+
+		/* still in debt; pass the turn on, unless nobody
+		 * else can take it either */
+		if (flow->deficit <= 0 && skipped < qpair->consumer.size) {
+			flow->topped = false;
+			glist_del(&flow->link);
+			glist_add_tail(&qpair->consumer.q, &flow->link);
+			pthread_spin_unlock(&flow->sp);
+			++skipped;
+			continue;
+		}
+
+		reqdata = glist_first_entry(&flow->q, request_data_t, req_q);
+		glist_del(&reqdata->req_q);
+		--(flow->size);
+		atomic_dec_uint32_t(&qpair->lane->pending);
+		flow->deficit -= nfs_rpc_req_cost(reqdata);
+
+		now(&ts);
+		flow->served++;
+		sojourn = timespec_diff(&reqdata->time_queued, &ts);
+		flow->wait_ns += sojourn;
+
+		if (flow->size == 0) {
+			/* idle flows keep their debt but no credit */
+			glist_del(&flow->link);
 			--(qpair->consumer.size);
-			pthread_spin_unlock(&qpair->consumer.sp);
-			if (s)
-				LogFullDebug(COMPONENT_DISPATCH,
-					     "try splice, qpair %s consumer qsize=%u producer qsize=%u",
-					     s, csize, psize);
-			goto out;
+			flow->qpair = NULL;
+			flow->topped = false;
+			if (flow->deficit > 0)
+				flow->deficit = 0;
+		} else if (flow->deficit <= 0) {
+			/* turn used up */
+			flow->topped = false;
+			glist_del(&flow->link);
+			glist_add_tail(&qpair->consumer.q, &flow->link);
 		}
+		pthread_spin_unlock(&flow->sp);
+		break;
+	}
 
-		pthread_spin_unlock(&qpair->producer.sp);
-		pthread_spin_unlock(&qpair->consumer.sp);
+	pthread_spin_unlock(&qpair->consumer.sp);
 
-		if (s)
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "try splice, qpair %s consumer qsize=%u producer qsize=%u",
-				     s, csize, psize);
+	if (reqdata) {
+		LogFullDebug(COMPONENT_DISPATCH,
+			     "qpair %s served flow %p", qpair->s, flow);
+		nfs_rpc_codel_sample(qpair->lane, sojourn);
 	}
- out:
+
 	return reqdata;
 }
 
-request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+/**
+ * @brief Take the next request from a lane
+ *
+ * @param[in] lane  The lane
+ * @param[in] slot  Class to try first, rotated by the caller
+ *
+ * @return A request, or NULL if every class of the lane is empty.
+ */
+
+static request_data_t *nfs_rpc_consume_lane(struct req_lane *lane,
+					    uint32_t slot)
 {
-	request_data_t *reqdata = NULL;
-	struct req_q_set *nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	struct req_q_set *nfs_request_q = &lane->nfs_request_q;
 	struct req_q_pair *qpair;
-	uint32_t ix, slot;
-	struct timespec timeout;
+	request_data_t *reqdata;
+	uint32_t ix;
 
 	/* XXX: the following stands in for a more robust/flexible
 	 * weighting function */
-
-	/* slot in 1..4 */
- retry_deq:
-	slot = (nfs_rpc_q_next_slot() % 4);
-	for (ix = 0; ix < 4; ++ix) {
+	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
 		switch (slot) {
 		case 0:
 			/* MOUNT */
@@ -1453,64 +1891,105 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 
 		/* anything? */
 		reqdata = nfs_rpc_consume_req(qpair);
-		if (reqdata) {
-			atomic_inc_uint32_t(&dequeued_reqs);
-			break;
-		}
+		if (reqdata)
+			return reqdata;
 
 		++slot;
-		slot = slot % 4;
-
+		slot = slot % N_REQ_QUEUES;
 	}			/* for */
 
-	/* wait */
-	if (!reqdata) {
-		struct fridgethr_context *ctx =
-			container_of(worker, struct fridgethr_context, wd);
-		wait_q_entry_t *wqe = &worker->wqe;
-
-		assert(wqe->waiters == 0); /* wqe is not on any wait queue */
-		PTHREAD_MUTEX_lock(&wqe->lwe.mtx);
-		wqe->flags = Wqe_LFlag_WaitSync;
-		wqe->waiters = 1;
-		/* XXX functionalize */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		glist_add_tail(&nfs_req_st.reqs.wait_list, &wqe->waitq);
-		++(nfs_req_st.reqs.waiters);
-		pthread_spin_unlock(&nfs_req_st.reqs.sp);
-		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
-			timeout.tv_sec = time(NULL) + 5;
-			timeout.tv_nsec = 0;
-			pthread_cond_timedwait(&wqe->lwe.cv, &wqe->lwe.mtx,
-					       &timeout);
-			if (fridgethr_you_should_break(ctx)) {
-				/* We are returning;
-				 * so take us out of the waitq */
-				pthread_spin_lock(&nfs_req_st.reqs.sp);
-				if (wqe->waitq.next != NULL
-				    || wqe->waitq.prev != NULL) {
-					/* Element is still in wqitq,
-					 * remove it */
-					glist_del(&wqe->waitq);
-					--(nfs_req_st.reqs.waiters);
-					--(wqe->waiters);
-					wqe->flags &=
-					    ~(Wqe_LFlag_WaitSync |
-					      Wqe_LFlag_SyncDone);
-				}
-				pthread_spin_unlock(&nfs_req_st.reqs.sp);
-				PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
-				return NULL;
-			}
-		}
+	return NULL;
+}
+
+request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+{
+	request_data_t *reqdata = NULL;
+	struct req_lane *home = &nfs_req_st.reqs.lanes[worker->lane];
+	struct req_lane *lane;
+	uint32_t n_lanes = nfs_req_st.reqs.n_lanes;
+	uint32_t lx, slot, batch, key;
+	uint64_t spin_until = 0;
+
+	/* the rest of a batch handed to us earlier */
+	if (!glist_empty(&worker->batch)) {
+		reqdata = glist_first_entry(&worker->batch, request_data_t,
+					    req_q);
+		glist_del(&reqdata->req_q);
+		goto out;
+	}
+
+ retry_deq:
+	slot = (nfs_rpc_q_next_slot() % N_REQ_QUEUES);
+
+	/* own lane first */
+	lane = home;
+	reqdata = nfs_rpc_consume_lane(lane, slot);
+
+	/* with a backlog and no other worker idle, take a batch of it
+	 * rather than come back for each request */
+	for (batch = 1;
+	     reqdata != NULL
+	     && batch < nfs_param.core_param.dispatch_batch
+	     && atomic_fetch_uint32_t(&lane->pending) > 0
+	     && atomic_fetch_uint32_t(&nfs_req_st.reqs.waiters) == 0;
+	     ++batch) {
+		request_data_t *more = nfs_rpc_consume_lane(lane, slot);
+
+		if (more == NULL)
+			break;
+		glist_add_tail(&worker->batch, &more->req_q);
+	}
 
-		/* XXX wqe was removed from nfs_req_st.waitq
-		 * (by signalling thread) */
-		wqe->flags &= ~(Wqe_LFlag_WaitSync | Wqe_LFlag_SyncDone);
-		PTHREAD_MUTEX_unlock(&wqe->lwe.mtx);
-		LogFullDebug(COMPONENT_DISPATCH, "wqe wakeup %p", wqe);
+	/* then steal */
+	for (lx = 1; reqdata == NULL && lx < n_lanes; ++lx) {
+		lane = &nfs_req_st.reqs.lanes[(worker->lane + lx) % n_lanes];
+		reqdata = nfs_rpc_consume_lane(lane, slot);
+		if (reqdata)
+			LogFullDebug(COMPONENT_DISPATCH,
+				     "worker %u stole from lane %u",
+				     worker->worker_index,
+				     (worker->lane + lx) % n_lanes);
+	}
+
+	if (reqdata) {
+		/* pass what is left on to an idle worker */
+		if (atomic_fetch_uint32_t(&lane->pending) > 0)
+			nfs_rpc_wake_worker(lane - nfs_req_st.reqs.lanes);
+		goto out;
+	}
+
+	/* spin briefly, since a request is often just behind */
+	if (spin_until == 0)
+		spin_until = mono_nsecs()
+			+ nfs_param.core_param.dispatch_spin_usec * NS_PER_USEC;
+	while (mono_nsecs() < spin_until) {
+		if (nfs_rpc_lanes_pending())
+			goto retry_deq;
+		gsh_cpu_relax();
+	}
+
+	/* then sleep, unless something was queued since we looked */
+	atomic_inc_uint32_t(&nfs_req_st.reqs.waiters);
+	key = ec_prepare(&home->ec);
+	if (nfs_rpc_lanes_pending()) {
+		ec_cancel(&home->ec);
+		atomic_dec_uint32_t(&nfs_req_st.reqs.waiters);
 		goto retry_deq;
-	} /* !reqdata */
+	}
+	ec_wait(&home->ec, key, 5000);
+	atomic_dec_uint32_t(&nfs_req_st.reqs.waiters);
+
+	if (fridgethr_you_should_break(
+		    container_of(worker, struct fridgethr_context, wd)))
+		return NULL;
+
+	LogFullDebug(COMPONENT_DISPATCH, "worker %u wakeup",
+		     worker->worker_index);
+	spin_until = 0;
+	goto retry_deq;
+
+ out:
+	atomic_inc_uint32_t(&dequeued_reqs);
 
 #if defined(HAVE_BLKIN)
 	/* thread id */
@@ -1556,6 +2035,7 @@ static inline request_data_t *alloc_nfs_request(SVCXPRT *xprt)
 
 	/* set up xprt */
 	reqdata->r_u.req.xprt = xprt;
+	reqdata->client = NULL;
 
 	return reqdata;
 }
@@ -1924,6 +2404,10 @@ static inline bool thr_continue_decoding(SVCXPRT *xprt, enum xprt_stat stat)
 		     > nfs_param.core_param.dispatch_max_reqs_xprt))
 		return false;
 
+	/* stop reading from a transport marked for shedding */
+	if (unlikely(gsh_xprt_shed(xprt)))
+		return false;
+
 	return (stat == XPRT_MOREREQS);
 }
 
@@ -42,6 +42,8 @@
 #include <sys/file.h>		/* for having FNDELAY */
 #include <sys/signal.h>
 #include <poll.h>
+#include <time.h>
+#include <unistd.h>
 #include "hashtable.h"
 #include "abstract_atomic.h"
 #include "log.h"
@@ -69,6 +71,31 @@ pool_t *request_pool;
 
 static struct fridgethr *worker_fridge;
 
+/**
+ * @brief Load of the worker pool, accumulated by workers
+ */
+
+static struct {
+	uint64_t reqs;		/*< Requests started */
+	uint64_t wait_ns;	/*< Their total queue wait */
+	uint64_t busy_ns;	/*< Total time workers spent on them */
+} worker_load;
+
+/**
+ * Seconds between worker pool adjustments.
+ */
+#define WORKER_ADJUST_INTERVAL 1
+
+/**
+ * Consecutive intervals over the wait target before growing, and
+ * under a quarter of it with idle workers before shrinking.  Shrinking
+ * is made much slower than growing so that the pool settles.
+ */
+#define WORKER_GROW_STREAK 2
+#define WORKER_SHRINK_STREAK 10
+
+static struct fridgethr *worker_adjust_fridge;
+
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
 	.free_function = nfs_null_free,
@@ -278,7 +305,7 @@ const nfs_function_desc_t nfs4_func_desc[] = {
 	 .service_function = nfs4_Compound,
 	 .free_function = nfs4_Compound_Free,
 	 .xdr_decode_func = (xdrproc_t) xdr_COMPOUND4args,
-	 .xdr_encode_func = (xdrproc_t) xdr_COMPOUND4res,
+	 .xdr_encode_func = (xdrproc_t) xdr_COMPOUND4res_extended,
 	 .funcname = "nfs4_Comp",
 	 .dispatch_behaviour = CAN_BE_DUP}
 };
@@ -770,7 +797,13 @@ void nfs_rpc_execute(request_data_t *reqdata)
 	 * xprt private data. */
 
 	port = get_port(op_ctx->caller_addr);
-	op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
+	if (reqdata->client != NULL) {
+		/* looked up when queued */
+		op_ctx->client = reqdata->client;
+		inc_gsh_client_refcount(op_ctx->client);
+	} else {
+		op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
+	}
 	if (op_ctx->client == NULL) {
 		LogDebug(COMPONENT_DISPATCH,
 			 "Cannot get client block for Program %d, Version %d, Function %d",
@@ -1468,6 +1501,40 @@ static void _9p_free_reqdata(struct _9p_request_data *req9p)
 
 static uint32_t worker_indexer;
 
+/** Protects the per-lane worker counts */
+static pthread_mutex_t worker_lane_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Home a new worker on the lane with the fewest workers
+ *
+ * Worker indices only grow, so after the pool shrinks and grows
+ * again they no longer say which lanes are short of workers.
+ *
+ * @return The worker's lane.
+ */
+
+static uint32_t worker_lane_join(void)
+{
+	struct req_lane *lanes = nfs_req_st.reqs.lanes;
+	uint32_t ix, lane = 0;
+
+	PTHREAD_MUTEX_lock(&worker_lane_mtx);
+	for (ix = 1; ix < nfs_req_st.reqs.n_lanes; ++ix)
+		if (lanes[ix].workers < lanes[lane].workers)
+			lane = ix;
+	lanes[lane].workers++;
+	PTHREAD_MUTEX_unlock(&worker_lane_mtx);
+
+	return lane;
+}
+
+static void worker_lane_leave(uint32_t lane)
+{
+	PTHREAD_MUTEX_lock(&worker_lane_mtx);
+	nfs_req_st.reqs.lanes[lane].workers--;
+	PTHREAD_MUTEX_unlock(&worker_lane_mtx);
+}
+
 /**
  * @brief Initialize a worker thread
  *
@@ -1480,11 +1547,12 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 	char thr_name[32];
 
 	wd->worker_index = atomic_inc_uint32_t(&worker_indexer);
+	wd->lane = worker_lane_join();
+	nfs_rpc_worker_bind(wd->lane);
 	snprintf(thr_name, sizeof(thr_name), "work-%u", wd->worker_index);
 	SetNameFunction(thr_name);
 
-	/* Initalize thr waitq */
-	init_wait_q_entry(&wd->wqe);
+	glist_init(&wd->batch);
 }
 
 /**
@@ -1495,6 +1563,7 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 
 static void worker_thread_finalizer(struct fridgethr_context *ctx)
 {
+	worker_lane_leave(ctx->wd.lane);
 	ctx->thread_info = NULL;
 }
 
@@ -1513,14 +1582,22 @@ static void worker_run(struct fridgethr_context *ctx)
 {
 	struct nfs_worker_data *worker_data = &ctx->wd;
 	request_data_t *reqdata;
+	struct timespec timer_start, timer_end;
 
-	/* Worker's loop */
-	while (!fridgethr_you_should_break(ctx)) {
+	/* Worker's loop, which must not leave a batch behind */
+	while (!glist_empty(&worker_data->batch)
+	       || !fridgethr_you_should_break(ctx)) {
 		reqdata = nfs_rpc_dequeue_req(worker_data);
 
 		if (!reqdata)
 			continue;
 
+		now(&timer_start);
+		atomic_inc_uint64_t(&worker_load.reqs);
+		atomic_add_uint64_t(&worker_load.wait_ns,
+				    timespec_diff(&reqdata->time_queued,
+						  &timer_start));
+
 /* need to do a getpeername(2) on the socket fd before we dive into the
  * rpc_execute.  9p is messy but we do have the fd....
  */
@@ -1583,6 +1660,14 @@ static void worker_run(struct fridgethr_context *ctx)
 			break;
 		}
 
+		/* drop the queue's client ref */
+		if (reqdata->client != NULL)
+			put_gsh_client(reqdata->client);
+
+		now(&timer_end);
+		atomic_add_uint64_t(&worker_load.busy_ns,
+				    timespec_diff(&timer_start, &timer_end));
+
 		/* Free the req by releasing the entry */
 		LogFullDebug(COMPONENT_DISPATCH,
 			     "Invalidating processed entry");
@@ -1591,9 +1676,138 @@ static void worker_run(struct fridgethr_context *ctx)
 	}
 }
 
+/**
+ * @brief Effective bounds of the worker pool
+ *
+ * @param[out] min Fewest workers
+ * @param[out] max Most workers
+ */
+
+static void worker_bounds(uint32_t *min, uint32_t *max)
+{
+	uint32_t nb = nfs_param.core_param.nb_worker;
+
+	*min = nfs_param.core_param.nb_worker_min;
+	*max = nfs_param.core_param.nb_worker_max;
+	if (*min == 0 || *min > nb)
+		*min = nb;
+	/* keep a worker for every dispatch lane */
+	if (*min < nfs_req_st.reqs.n_lanes)
+		*min = nfs_req_st.reqs.n_lanes;
+	if (*max < nb)
+		*max = nb;
+}
+
+/**
+ * @brief Resize the worker pool to follow queue wait
+ *
+ * Once a second, this looks at how long requests waited in the queue
+ * since the last look, how busy the workers were, and how much CPU
+ * the whole process used.  If requests waited longer than the target
+ * while every worker was busy and the CPUs were not saturated (so the
+ * workers are mostly blocked, in the FSAL or on the network), the pool
+ * grows by a quarter.  If waits stayed well under the target while
+ * workers sat idle, it shrinks by an eighth.  Both need the condition
+ * to hold for several consecutive intervals, and shrinking far longer
+ * than growing, so the pool does not oscillate.
+ *
+ * @param[in] ctx Fridge thread context
+ */
+
+static void worker_adjust_run(struct fridgethr_context *ctx)
+{
+	static uint64_t last_reqs, last_wait, last_busy, last_cpu, last_mono;
+	static uint32_t grow_streak, shrink_streak, target;
+	static long ncpu;
+	uint64_t reqs, wait, busy, cpu, mono, interval, avg_wait, target_ns;
+	uint32_t min, max, step, i;
+	struct timespec ts;
+
+	SetNameFunction("wrk_adjust");
+
+	worker_bounds(&min, &max);
+	if (target == 0) {
+		target = nfs_param.core_param.nb_worker;
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		if (ncpu < 1)
+			ncpu = 1;
+	}
+
+	reqs = atomic_fetch_uint64_t(&worker_load.reqs);
+	wait = atomic_fetch_uint64_t(&worker_load.wait_ns);
+	busy = atomic_fetch_uint64_t(&worker_load.busy_ns);
+	mono = mono_nsecs();
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+		cpu = timespec_to_nsecs(&ts);
+	else
+		cpu = last_cpu;
+
+	if (last_mono == 0)
+		goto out;
+
+	interval = mono - last_mono;
+	avg_wait = (reqs > last_reqs)
+		? (wait - last_wait) / (reqs - last_reqs) : 0;
+	target_ns = nfs_param.core_param.worker_wait_target_ms
+		* NS_PER_MSEC;
+
+	if (avg_wait > target_ns
+	    && (busy - last_busy) * 4 > interval * target * 3
+	    && (cpu - last_cpu) * 10 < interval * ncpu * 9) {
+		/* workers saturated, but not the CPUs */
+		grow_streak++;
+		shrink_streak = 0;
+	} else if (avg_wait < target_ns / 4
+		   && (busy - last_busy) * 2 < interval * target) {
+		/* less than half the workers busy */
+		shrink_streak++;
+		grow_streak = 0;
+	} else {
+		grow_streak = 0;
+		shrink_streak = 0;
+	}
+
+	if (grow_streak >= WORKER_GROW_STREAK && target < max) {
+		step = target / 4 ? target / 4 : 1;
+		if (step > max - target)
+			step = max - target;
+		target += step;
+		fridgethr_set_limits(worker_fridge, min, target);
+		for (i = 0; i < step; i++) {
+			if (fridgethr_submit(worker_fridge, worker_run,
+					     NULL) != 0)
+				break;
+		}
+		LogEvent(COMPONENT_DISPATCH,
+			 "Queue wait %" PRIu64
+			 " usec, growing worker pool to %" PRIu32,
+			 avg_wait / NS_PER_USEC, target);
+		grow_streak = 0;
+	} else if (shrink_streak >= WORKER_SHRINK_STREAK && target > min) {
+		step = target / 8 ? target / 8 : 1;
+		if (step > target - min)
+			step = target - min;
+		target -= step;
+		fridgethr_set_limits(worker_fridge, min, target);
+		LogEvent(COMPONENT_DISPATCH,
+			 "Queue wait %" PRIu64
+			 " usec, shrinking worker pool to %" PRIu32,
+			 avg_wait / NS_PER_USEC, target);
+		shrink_streak = 0;
+	}
+
+ out:
+	last_reqs = reqs;
+	last_wait = wait;
+	last_busy = busy;
+	last_cpu = cpu;
+	last_mono = mono;
+}
+
 int worker_init(void)
 {
 	struct fridgethr_params frp;
+	uint32_t min, max;
 	int rc = 0;
 
 	memset(&frp, 0, sizeof(struct fridgethr_params));
@@ -1617,6 +1831,34 @@ int worker_init(void)
 	if (rc != 0) {
 		LogMajor(COMPONENT_DISPATCH,
 			 "Unable to populate worker fridge: %d", rc);
+		return rc;
+	}
+
+	worker_bounds(&min, &max);
+	if (min == max)
+		return 0;
+
+	/* pool is adaptive */
+	fridgethr_set_limits(worker_fridge, min,
+			     nfs_param.core_param.nb_worker);
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = WORKER_ADJUST_INTERVAL;
+	frp.flavor = fridgethr_flavor_looper;
+
+	rc = fridgethr_init(&worker_adjust_fridge, "Wrk_adjust", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to initialize worker adjust fridge: %d", rc);
+		return rc;
+	}
+
+	rc = fridgethr_submit(worker_adjust_fridge, worker_adjust_run, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to start worker adjust thread: %d", rc);
 	}
 
 	return rc;
@@ -1624,9 +1866,19 @@ int worker_init(void)
 
 int worker_shutdown(void)
 {
-	int rc = fridgethr_sync_command(worker_fridge,
-					fridgethr_comm_stop,
-					120);
+	int rc;
+
+	if (worker_adjust_fridge != NULL) {
+		rc = fridgethr_sync_command(worker_adjust_fridge,
+					    fridgethr_comm_stop,
+					    120);
+		if (rc == ETIMEDOUT)
+			fridgethr_cancel(worker_adjust_fridge);
+	}
+
+	rc = fridgethr_sync_command(worker_fridge,
+				    fridgethr_comm_stop,
+				    120);
 
 	if (rc == ETIMEDOUT) {
 		LogMajor(COMPONENT_DISPATCH,
@@ -154,6 +154,13 @@ int nfs3_setattr(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 		squash_setattr(&setattr);
 
 		if (arg->arg_setattr3.new_attributes.size.set_it) {
+			/* Only a regular file has a size to set, and
+			 * share state to check it against */
+			if (entry->type != REGULAR_FILE) {
+				res->res_setattr3.status = NFS3ERR_INVAL;
+				goto out_fail;
+			}
+
 			res->res_setattr3.status = nfs3_Errno_state(
 					state_share_anonymous_io_start(
 						entry,
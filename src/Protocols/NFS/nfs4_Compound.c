@@ -427,6 +427,88 @@ nfs_opnum4 LastOpcode[] = {
 	NFS4_OP_WRITE_SAME
 };
 
+/**
+ * @brief Keep the reply to a NFSv4.1 request in its slot
+ *
+ * The reply is encoded once, here, and only when the requester set
+ * sa_cachethis (CREATE_SESSION always caches); otherwise only its
+ * status is kept.  The encoded bytes are then what is sent, so the
+ * result structures, READ data included, are freed right away and a
+ * replay is a copy of the bytes into the reply.
+ *
+ * @param[in]     data  Compound data, with the slot to use
+ * @param[in,out] res   The reply
+ */
+
+static void nfs41_cache_reply(compound_data_t *data, nfs_res_t *res)
+{
+	nfs41_session_slot_t *slot = data->cached_slot;
+	struct nfs41_cached_reply *reply = NULL;
+	struct nfs41_cached_reply *old;
+	XDR xdrs;
+	u_int len;
+
+	if (slot->cache_used) {
+		len = xdr_sizeof((xdrproc_t) xdr_COMPOUND4res,
+				 &res->res_compound4);
+
+		if (data->session != NULL &&
+		    len > data->session->fore_channel_attrs
+					.ca_maxresponsesize_cached) {
+			LogDebug(COMPONENT_SESSIONS,
+				 "Reply of %u bytes too big to cache in slot %"
+				 PRIu32, len, data->slot);
+			goto keep;
+		}
+
+		reply = gsh_malloc(sizeof(*reply) + len);
+		if (reply == NULL)
+			goto keep;
+
+		/* One reference for the slot, one for this response */
+		reply->refcnt = 2;
+		reply->status = res->res_compound4.status;
+		reply->len = len;
+
+		xdrmem_create(&xdrs, reply->data, len, XDR_ENCODE);
+		if (!xdr_COMPOUND4res(&xdrs, &res->res_compound4)) {
+			LogCrit(COMPONENT_SESSIONS,
+				"Could not encode reply to cache in slot %"
+				PRIu32, data->slot);
+			gsh_free(reply);
+			reply = NULL;
+		}
+		xdr_destroy(&xdrs);
+	}
+
+ keep:
+	PTHREAD_MUTEX_lock(&slot->lock);
+	old = slot->cached_reply;
+	slot->cached_reply = reply;
+	slot->cached_status = res->res_compound4.status;
+	/* The slot may be freed by a shrink from here on */
+	slot->in_use = false;
+	PTHREAD_MUTEX_unlock(&slot->lock);
+
+	if (old != NULL)
+		nfs41_cached_reply_put(old);
+
+	if (reply == NULL)
+		return;
+
+	LogFullDebug(COMPONENT_SESSIONS,
+		     "Save %u byte reply in session replay cache %p",
+		     reply->len, reply);
+
+	/* Send the encoded bytes and free the structures now */
+	nfs4_Compound_Free(res);
+	res->res_compound4.resarray.resarray_len = 0;
+	res->res_compound4.resarray.resarray_val = NULL;
+	res->res_compound4.tag.utf8string_len = 0;
+	res->res_compound4.tag.utf8string_val = NULL;
+	res->res_compound4_extended.res_reply = reply;
+}
+
 /**
  * @brief The NFS PROC4 COMPOUND
  *
@@ -745,15 +827,25 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 			 * anything.
 			 */
 
-			/* Free the reply allocated above */
-			gsh_free(res->res_compound4.resarray.resarray_val);
-
-			/* Copy the reply from the cache */
-			res->res_compound4_extended = *data.cached_res;
-			status = ((COMPOUND4res *) data.cached_res)->status;
+			/* Drop the reply built so far, only the encoded
+			 * reply from the slot is sent.
+			 */
+			res->res_compound4.resarray.resarray_len = i + 1;
+			nfs4_Compound_Free(res);
+			res->res_compound4.resarray.resarray_len = 0;
+			res->res_compound4.resarray.resarray_val = NULL;
+			res->res_compound4.tag.utf8string_len = 0;
+			res->res_compound4.tag.utf8string_val = NULL;
+
+			/* Hand our reference over to the response */
+			res->res_compound4_extended.res_reply =
+							data.cached_reply;
+			status = data.cached_reply->status;
+			data.cached_reply = NULL;
 			LogFullDebug(COMPONENT_SESSIONS,
 				     "Use session replay cache %p result %s",
-				     data.cached_res, nfsstat4_to_str(status));
+				     res->res_compound4_extended.res_reply,
+				     nfsstat4_to_str(status));
 			break;	/* Exit the for loop */
 		}
 	}			/* for */
@@ -768,26 +860,8 @@ int nfs4_Compound(nfs_arg_t *arg, struct svc_req *req, nfs_res_t *res)
 	/* Manage session's DRC: keep NFS4.1 replay for later use, but don't
 	 * save a replayed result again.
 	 */
-	if (data.cached_res != NULL && !data.use_drc) {
-		/* Pointer has been set by nfs4_op_sequence and points to slot
-		 * to cache result in.
-		 */
-		LogFullDebug(COMPONENT_SESSIONS,
-			     "Save result in session replay cache %p sizeof nfs_res_t=%d",
-			     data.cached_res, (int)sizeof(nfs_res_t));
-
-		/* Indicate to nfs4_Compound_Free that this reply is cached. */
-		res->res_compound4_extended.res_cached = true;
-
-		/* If the cache is already in use, free it. */
-		if (data.cached_res->res_cached) {
-			data.cached_res->res_cached = false;
-			nfs4_Compound_Free((nfs_res_t *) data.cached_res);
-		}
-
-		/* Save the result in the cache. */
-		*data.cached_res = res->res_compound4_extended;
-	}
+	if (data.cached_slot != NULL && !data.use_drc)
+		nfs41_cache_reply(&data, res);
 
 	/* If we have reserved a lease, update it and release it */
 	if (data.preserved_clientid != NULL) {
@@ -844,11 +918,9 @@ void nfs4_Compound_Free(nfs_res_t *res)
 	if (isFullDebug(COMPONENT_SESSIONS))
 		component = COMPONENT_SESSIONS;
 
-	if (res->res_compound4_extended.res_cached) {
-		LogFullDebug(component,
-			     "Skipping free of NFS4 result %p",
-			     res);
-		return;
+	if (res->res_compound4_extended.res_reply != NULL) {
+		nfs41_cached_reply_put(res->res_compound4_extended.res_reply);
+		res->res_compound4_extended.res_reply = NULL;
 	}
 
 	LogFullDebug(component,
@@ -873,6 +945,46 @@ void nfs4_Compound_Free(nfs_res_t *res)
 		gsh_free(res->res_compound4.tag.utf8string_val);
 }
 
+/**
+ * @brief Release a reference to an encoded NFSv4.1 reply
+ *
+ * @param[in] reply  The reply
+ */
+
+void nfs41_cached_reply_put(struct nfs41_cached_reply *reply)
+{
+	if (atomic_dec_int32_t(&reply->refcnt) == 0)
+		gsh_free(reply);
+}
+
+/**
+ * @brief Encode the reply to NFS4PROC_COMPOUND
+ *
+ * A reply kept encoded in a session slot is copied as is, anything
+ * else is encoded from its structures.
+ *
+ * @param[in] xdrs  The XDR stream
+ * @param[in] res   The reply
+ *
+ * @return true on success.
+ */
+
+bool xdr_COMPOUND4res_extended(XDR *xdrs, struct COMPOUND4res_extended *res)
+{
+	if (res->res_reply == NULL)
+		return xdr_COMPOUND4res(xdrs, &res->res_compound4);
+
+	switch (xdrs->x_op) {
+	case XDR_ENCODE:
+		return XDR_PUTBYTES(xdrs, res->res_reply->data,
+				    res->res_reply->len);
+	case XDR_FREE:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /**
  * @brief Free a compound data structure
  *
@@ -900,6 +1012,11 @@ void compound_data_Free(compound_data_t *data)
 		data->saved_ds = NULL;
 	}
 
+	if (data->cached_reply) {
+		nfs41_cached_reply_put(data->cached_reply);
+		data->cached_reply = NULL;
+	}
+
 	if (data->session) {
 		dec_session_ref(data->session);
 		data->session = NULL;
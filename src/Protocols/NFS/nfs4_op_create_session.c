@@ -86,7 +86,9 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	struct display_buffer dspbuf_clientid4 = {
 		sizeof(str_clientid4), str_clientid4, str_clientid4};
 	/* Return code from clientid calls */
-	int i, rc = 0;
+	int rc = 0;
+	/* Forechannel slots granted */
+	uint32_t nb_slots;
 	/* Component for logging */
 	log_components_t component = COMPONENT_CLIENTID;
 	/* Abbreviated alias for arguments */
@@ -194,12 +196,16 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		/* Special case : the request is used without use of
 		 * OP_SEQUENCE
 		 */
+		nfs41_session_slot_t *slot = &found->cid_create_session_slot;
+
+		PTHREAD_MUTEX_lock(&slot->lock);
 		if ((arg_CREATE_SESSION4->csa_sequence + 1 ==
 		     found->cid_create_session_sequence)
-		    && (found->cid_create_session_slot.cache_used)) {
+		    && (slot->cached_reply != NULL)) {
 			data->use_drc = true;
-			data->cached_res =
-			    &found->cid_create_session_slot.cached_result;
+			data->cached_reply = slot->cached_reply;
+			atomic_inc_int32_t(&slot->cached_reply->refcnt);
+			PTHREAD_MUTEX_unlock(&slot->lock);
 
 			res_CREATE_SESSION4->csr_status = NFS4_OK;
 
@@ -207,10 +213,13 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 
 			LogDebug(component,
 				 "CREATE_SESSION replay=%p special case",
-				 data->cached_res);
+				 data->cached_reply);
 
 			goto out;
-		} else if (arg_CREATE_SESSION4->csa_sequence !=
+		}
+		PTHREAD_MUTEX_unlock(&slot->lock);
+
+		if (arg_CREATE_SESSION4->csa_sequence !=
 			   found->cid_create_session_sequence) {
 			res_CREATE_SESSION4->csr_status =
 			    NFS4ERR_SEQ_MISORDERED;
@@ -324,8 +333,29 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	nfs41_session->cb_program = 0;
 	PTHREAD_MUTEX_init(&nfs41_session->cb_mutex, NULL);
 	PTHREAD_COND_init(&nfs41_session->cb_cond, NULL);
-	for (i = 0; i < NFS41_NB_SLOTS; i++)
-		PTHREAD_MUTEX_init(&nfs41_session->slots[i].lock, NULL);
+
+	/* Agree to what the client asks for, up to Session_Max_Slots,
+	 * but start it on at most Session_Initial_Slots; the table grows
+	 * from there, up to the agreed maximum, while the client keeps
+	 * it full.
+	 */
+	nfs41_session->fore_channel_attrs.ca_maxrequests =
+		MAX(MIN(nfs41_session->fore_channel_attrs.ca_maxrequests,
+			nfs_param.nfsv4_param.session_max_slots), 1);
+	nb_slots = MIN(nfs41_session->fore_channel_attrs.ca_maxrequests,
+		       nfs_param.nfsv4_param.session_initial_slots);
+
+	if (!nfs41_Session_Slots_Init(nfs41_session, nb_slots,
+			MIN(nfs41_session->back_channel_attrs.ca_maxrequests,
+			    NFS41_NB_SLOTS))) {
+		LogCrit(component, "Could not allocate session slot tables");
+		PTHREAD_COND_destroy(&nfs41_session->cb_cond);
+		PTHREAD_MUTEX_destroy(&nfs41_session->cb_mutex);
+		pool_free(nfs41_session_pool, nfs41_session);
+		dec_client_id_ref(found);
+		res_CREATE_SESSION4->csr_status = NFS4ERR_SERVERFAULT;
+		goto out;
+	}
 
 	/* Take reference to clientid record on behalf the session. */
 	inc_client_id_ref(found);
@@ -336,8 +366,6 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		  &nfs41_session->session_link);
 	PTHREAD_MUTEX_unlock(&found->cid_mutex);
 
-	/* Set ca_maxrequests */
-	nfs41_session->fore_channel_attrs.ca_maxrequests = NFS41_NB_SLOTS;
 	nfs41_Build_sessionid(&clientid, nfs41_session->session_id);
 
 	res_CREATE_SESSION4ok->csr_sequence = arg_CREATE_SESSION4->csa_sequence;
@@ -355,11 +383,17 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	       nfs41_session->session_id,
 	       NFS4_SESSIONID_SIZE);
 
-	/* Create Session replay cache */
-	data->cached_res = &found->cid_create_session_slot.cached_result;
-	found->cid_create_session_slot.cache_used = true;
+	/* Create Session replay cache, always kept.  Within a SEQUENCE the
+	 * reply goes to the session's slot instead.
+	 */
+	if (data->oppos == 0) {
+		data->cached_slot = &found->cid_create_session_slot;
+		PTHREAD_MUTEX_lock(&data->cached_slot->lock);
+		data->cached_slot->cache_used = true;
+		PTHREAD_MUTEX_unlock(&data->cached_slot->lock);
+	}
 
-	LogDebug(component, "CREATE_SESSION replay=%p", data->cached_res);
+	LogDebug(component, "CREATE_SESSION replay=%p", data->cached_slot);
 
 	if (!nfs41_Session_Set(nfs41_session)) {
 		LogDebug(component, "Could not insert session into table");
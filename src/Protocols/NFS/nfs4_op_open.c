@@ -1034,7 +1034,7 @@ static void get_delegation(compound_data_t *data, OPEN4args *args,
 				get_deleg_perm(data->current_entry,
 					       &writeres->permissions,
 					       deleg_type);
-				data->current_entry->object.file.fdeleg_stats.
+				data->current_entry->object.file->fdeleg_stats.
 					fds_deleg_type = OPEN_DELEGATE_WRITE;
 			} else {
 				assert(deleg_type == OPEN_DELEGATE_READ);
@@ -1045,7 +1045,7 @@ static void get_delegation(compound_data_t *data, OPEN4args *args,
 				get_deleg_perm(data->current_entry,
 					       &readres->permissions,
 					       deleg_type);
-				data->current_entry->object.file.fdeleg_stats.
+				data->current_entry->object.file->fdeleg_stats.
 					fds_deleg_type = OPEN_DELEGATE_READ;
 			}
 		}
@@ -1074,12 +1074,14 @@ static void do_delegation(OPEN4args *arg_OPEN4, OPEN4res *res_OPEN4,
 {
 	OPEN4resok *resok = &res_OPEN4->OPEN4res_u.resok4;
 	bool prerecall;
-	struct file_deleg_stats *fdeleg_stats =
-				&data->current_entry->object.file.fdeleg_stats;
 
 	/* This will be updated later if we actually delegate */
 	resok->delegation.delegation_type = OPEN_DELEGATE_NONE;
 
+	/* Every open counts towards the file's access history */
+	deleg_heuristics_open(data->current_entry, clientid,
+			      arg_OPEN4->share_access);
+
 	/* Client doesn't want a delegation. */
 	if (arg_OPEN4->share_access & OPEN4_SHARE_ACCESS_WANT_NO_DELEG) {
 		resok->delegation.open_delegation4_u.
@@ -1099,11 +1101,6 @@ static void do_delegation(OPEN4args *arg_OPEN4, OPEN4res *res_OPEN4,
 	if (can_we_grant_deleg(data->current_entry, open_state) &&
 	    should_we_grant_deleg(data->current_entry, clientid, open_state,
 				  arg_OPEN4, owner, &prerecall)) {
-		/* Update delegation open stats */
-		if (fdeleg_stats->fds_num_opens == 0)
-			fdeleg_stats->fds_first_open = time(NULL);
-		fdeleg_stats->fds_num_opens++;
-
 		LogDebug(COMPONENT_STATE, "Attempting to grant delegation");
 		get_delegation(data, arg_OPEN4, open_state, owner, clientid,
 			       resok, prerecall);
@@ -34,6 +34,118 @@
 #include "sal_functions.h"
 #include "nfs_rpc_callback.h"
 #include "nfs_convert.h"
+#include "nfs_req_queue.h"
+
+/**
+ * @brief The number of slots a session's client should use
+ *
+ * The target moves at most once an admission interval:
+ *
+ * - while the session's transport is being shed by admission control,
+ *   it is halved;
+ * - while a lane is overloaded, or the targets of all sessions are
+ *   over Session_Slot_Budget, a session above its fair share of the
+ *   budget gives back a quarter;
+ * - a client using all of its target gets a quarter more, up to the
+ *   slots it negotiated at CREATE_SESSION, unless the budget is spent
+ *   and it already has its share;
+ * - a client using less than half gives back an eighth, down to the
+ *   slots granted at CREATE_SESSION.
+ *
+ * @param[in] session The session
+ * @param[in] xprt    Transport of the current request
+ * @param[in] used    Slots the client uses, sa_highest_slotid + 1
+ *
+ * @return The target, at least 1.
+ */
+
+static uint32_t sequence_target_slots(nfs41_session_t *session,
+				      SVCXPRT *xprt, uint32_t used)
+{
+	nfs_version4_parameter_t *v4 = &nfs_param.nfsv4_param;
+	uint32_t initial = session->initial_slots;
+	uint32_t max = session->fore_channel_attrs.ca_maxrequests;
+	uint32_t old = atomic_fetch_uint32_t(&session->target_slots);
+	uint32_t target = old;
+	uint64_t now_ns = mono_nsecs();
+	uint64_t interval =
+		nfs_param.core_param.admission_interval_ms * NS_PER_MSEC;
+	uint64_t sessions;
+	uint64_t fair;
+	bool spent;
+
+	if (now_ns - atomic_fetch_uint64_t(&session->target_changed)
+	    < interval)
+		return target;
+
+	sessions = atomic_fetch_uint64_t(&nfs41_slot_st.sessions);
+	fair = MAX(v4->session_slot_budget / MAX(sessions, 1), 1);
+	spent = atomic_fetch_uint64_t(&nfs41_slot_st.target) >=
+		v4->session_slot_budget;
+
+	if (gsh_xprt_shed(xprt)) {
+		if (target <= 1)
+			return target;
+		target /= 2;
+		atomic_inc_uint64_t(&admission_st.slot_cuts);
+	} else if ((spent || nfs_rpc_overloaded()) && target > fair) {
+		target = MAX(target - MAX(target / 4, 1), fair);
+		atomic_inc_uint64_t(&admission_st.slot_cuts);
+	} else if (used == target && target < max && !nfs_rpc_overloaded()
+		   && (!spent || target < fair)) {
+		target = MIN(target + MAX(target / 4, 1), max);
+	} else if (used < target / 2 && target > initial) {
+		target = MAX(target - MAX(target / 8, 1), initial);
+	} else {
+		return target;
+	}
+
+	/* a racing update wins */
+	if (!atomic_cas_uint32_t(&session->target_slots, old, target))
+		return atomic_fetch_uint32_t(&session->target_slots);
+
+	if (target > old)
+		atomic_add_uint64_t(&nfs41_slot_st.target, target - old);
+	else
+		atomic_sub_uint64_t(&nfs41_slot_st.target, old - target);
+	atomic_store_uint64_t(&session->target_changed, now_ns);
+	return target;
+}
+
+/**
+ * @brief Fit a session's slot table to its target
+ *
+ * The table grows as soon as the target does.  It shrinks once the
+ * client uses no slot above the target, at most once an admission
+ * interval since a slot with a request in progress stops it.
+ *
+ * @param[in] session The session
+ * @param[in] target  The target
+ * @param[in] used    Slots the client uses, sa_highest_slotid + 1
+ */
+
+static void sequence_fit_slots(nfs41_session_t *session, uint32_t target,
+			       uint32_t used)
+{
+	uint32_t nb = atomic_fetch_uint32_t(&session->nb_slots);
+	uint64_t now_ns;
+
+	if (target > nb) {
+		nfs41_Session_Slots_Resize(session, target);
+		return;
+	}
+
+	if (target == nb || used > target)
+		return;
+
+	now_ns = mono_nsecs();
+	if (now_ns - atomic_fetch_uint64_t(&session->slots_resized) <
+	    nfs_param.core_param.admission_interval_ms * NS_PER_MSEC)
+		return;
+
+	atomic_store_uint64_t(&session->slots_resized, now_ns);
+	nfs41_Session_Slots_Resize(session, target);
+}
 
 /**
  * @brief the NFS4_OP_SEQUENCE operation
@@ -54,6 +166,11 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 	SEQUENCE4res * const res_SEQUENCE4 = &resp->nfs_resop4_u.opsequence;
 
 	nfs41_session_t *session;
+	nfs41_session_slot_t *slot;
+	struct nfs41_cached_reply *old;
+	slotid4 highest;
+	uint32_t target;
+	uint32_t used;
 
 	resp->resop = NFS4_OP_SEQUENCE;
 	res_SEQUENCE4->sr_status = NFS4_OK;
@@ -100,9 +217,20 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 
 	PTHREAD_MUTEX_unlock(&session->clientid_record->cid_mutex);
 
-	/* Check is slot is compliant with ca_maxrequests */
-	if (arg_SEQUENCE4->sa_slotid >=
-	    session->fore_channel_attrs.ca_maxrequests) {
+	/* Size the slot table for this client before looking the slot
+	 * up, so the reply tells the table we accept from now on.
+	 */
+	used = MIN(arg_SEQUENCE4->sa_highest_slotid, UINT32_MAX - 1) + 1;
+	target = sequence_target_slots(session, data->req->rq_xprt, used);
+	sequence_fit_slots(session, target, used);
+
+	/* By default, no DRC replay */
+	data->use_drc = false;
+
+	/* Check the slot is within the table, and lock it */
+	slot = nfs41_Session_Slot(session, arg_SEQUENCE4->sa_slotid,
+				  &highest);
+	if (slot == NULL) {
 		dec_session_ref(session);
 		res_SEQUENCE4->sr_status = NFS4ERR_BADSLOT;
 		LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
@@ -111,61 +239,46 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 		return res_SEQUENCE4->sr_status;
 	}
 
-	/* By default, no DRC replay */
-	data->use_drc = false;
+	if (slot->sequence + 1 != arg_SEQUENCE4->sa_sequenceid) {
+		if (slot->sequence == arg_SEQUENCE4->sa_sequenceid &&
+		    !slot->in_use && slot->cached_reply != NULL) {
+			/* Replay operation through the DRC */
+			data->use_drc = true;
+			data->cached_reply = slot->cached_reply;
+			atomic_inc_int32_t(&slot->cached_reply->refcnt);
+
+			LogFullDebugAlt(COMPONENT_SESSIONS,
+					COMPONENT_CLIENTID,
+					"Use sesson slot %" PRIu32
+					"=%p for DRC",
+					arg_SEQUENCE4->sa_slotid,
+					data->cached_reply);
+
+			PTHREAD_MUTEX_unlock(&slot->lock);
+			dec_session_ref(session);
+			res_SEQUENCE4->sr_status = NFS4_OK;
+			return res_SEQUENCE4->sr_status;
+		}
 
-	PTHREAD_MUTEX_lock(&session->slots[arg_SEQUENCE4->sa_slotid].lock);
-	if (session->slots[arg_SEQUENCE4->sa_slotid].sequence + 1 !=
-	    arg_SEQUENCE4->sa_sequenceid) {
-		if (session->slots[arg_SEQUENCE4->sa_slotid].sequence ==
-		    arg_SEQUENCE4->sa_sequenceid) {
-#if IMPLEMENT_CACHETHIS
-			/** @todo
-			 *
-			 * Ganesha always caches result anyway so ignore
-			 * cachethis
+		if (slot->sequence == arg_SEQUENCE4->sa_sequenceid) {
+			/* The original is still in progress, or its reply
+			 * was not cached and only its status is known.
 			 */
-			if (session->slots[arg_SEQUENCE4->sa_slotid]
-			    .cache_used) {
-#endif
-				/* Replay operation through the DRC */
-				data->use_drc = true;
-				data->cached_res =
-				    &session->slots[arg_SEQUENCE4->sa_slotid].
-				    cached_result;
-
-				LogFullDebugAlt(COMPONENT_SESSIONS,
-						COMPONENT_CLIENTID,
-						"Use sesson slot %" PRIu32
-						"=%p for DRC",
-						arg_SEQUENCE4->sa_slotid,
-						data->cached_res);
-
-				PTHREAD_MUTEX_unlock(&session->
-					slots[arg_SEQUENCE4->sa_slotid].lock);
-				dec_session_ref(session);
-				res_SEQUENCE4->sr_status = NFS4_OK;
-				return res_SEQUENCE4->sr_status;
-#if IMPLEMENT_CACHETHIS
-			} else {
-				/* Illegal replay */
-				PTHREAD_MUTEX_unlock(&session->
-					slots[arg_SEQUENCE4->sa_slotid].lock);
-				dec_session_ref(session);
+			if (slot->in_use)
+				res_SEQUENCE4->sr_status = NFS4ERR_DELAY;
+			else
 				res_SEQUENCE4->sr_status =
 				    NFS4ERR_RETRY_UNCACHED_REP;
-				LogDebugAlt(COMPONENT_SESSIONS,
-					    COMPONENT_CLIENTID,
-					    "SEQUENCE returning status %s",
-					    nfsstat4_to_str(res_SEQUENCE4->
-							    sr_status));
-				return res_SEQUENCE4->sr_status;
-			}
-#endif
+			LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
+				    "SEQUENCE returning status %s, uncached reply was %s",
+				    nfsstat4_to_str(res_SEQUENCE4->sr_status),
+				    nfsstat4_to_str(slot->cached_status));
+			PTHREAD_MUTEX_unlock(&slot->lock);
+			dec_session_ref(session);
+			return res_SEQUENCE4->sr_status;
 		}
 
-		PTHREAD_MUTEX_unlock(&session->
-			slots[arg_SEQUENCE4->sa_slotid].lock);
+		PTHREAD_MUTEX_unlock(&slot->lock);
 		dec_session_ref(session);
 		res_SEQUENCE4->sr_status = NFS4ERR_SEQ_MISORDERED;
 		LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
@@ -182,49 +295,44 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 	data->slot = arg_SEQUENCE4->sa_slotid;
 
 	/* Update the sequence id within the slot */
-	session->slots[arg_SEQUENCE4->sa_slotid].sequence += 1;
+	slot->sequence += 1;
 
 	memcpy(res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_sessionid,
 	       arg_SEQUENCE4->sa_sessionid, NFS4_SESSIONID_SIZE);
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_sequenceid =
-	    session->slots[arg_SEQUENCE4->sa_slotid].sequence;
+	    slot->sequence;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_slotid =
 	    arg_SEQUENCE4->sa_slotid;
-	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_highest_slotid =
-	    NFS41_NB_SLOTS - 1;
+	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_highest_slotid = highest;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_target_highest_slotid =
-	    session->fore_channel_attrs.ca_maxrequests - 1;
+	    MIN(target - 1, highest);
 
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_status_flags = 0;
 
-	if (nfs_rpc_get_chan(session->clientid_record, 0) == NULL) {
+	if (get_cb_chan_down(session->clientid_record) ||
+	    nfs_rpc_get_chan(session->clientid_record, 0) == NULL) {
 		res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_status_flags |=
 		    SEQ4_STATUS_CB_PATH_DOWN;
 	}
 
-#if IMPLEMENT_CACHETHIS
-/* Ganesha always caches result anyway so ignore cachethis */
-	if (arg_SEQUENCE4->sa_cachethis) {
-#endif
-		data->cached_res =
-		    &session->slots[arg_SEQUENCE4->sa_slotid].cached_result;
-		session->slots[arg_SEQUENCE4->sa_slotid].cache_used = true;
-
-		LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
-				"Use sesson slot %" PRIu32 "=%p for DRC",
-				arg_SEQUENCE4->sa_slotid, data->cached_res);
-#if IMPLEMENT_CACHETHIS
-	} else {
-		data->cached_res = NULL;
-		session->slots[arg_SEQUENCE4->sa_slotid].cache_used = false;
+	/* The previous reply is acknowledged by this request; the reply
+	 * to this one is encoded and kept only if the client asks.
+	 */
+	old = slot->cached_reply;
+	slot->cached_reply = NULL;
+	slot->cache_used = arg_SEQUENCE4->sa_cachethis;
+	slot->in_use = true;
+	data->cached_slot = slot;
 
-		LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
-				"Don't use sesson slot %" PRIu32
-				"=NULL for DRC", arg_SEQUENCE4->sa_slotid);
-	}
-#endif
+	LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
+			"%s reply in sesson slot %" PRIu32,
+			slot->cache_used ? "Cache" : "Don't cache",
+			arg_SEQUENCE4->sa_slotid);
+
+	PTHREAD_MUTEX_unlock(&slot->lock);
 
-	PTHREAD_MUTEX_unlock(&session->slots[arg_SEQUENCE4->sa_slotid].lock);
+	if (old != NULL)
+		nfs41_cached_reply_put(old);
 
 	/* If we were successful, stash the clientid in the request
 	 * context.
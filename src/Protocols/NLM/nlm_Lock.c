@@ -150,7 +150,8 @@ int nlm4_Lock(nfs_arg_t *args, struct svc_req *req, nfs_res_t *res)
 		rc = NFS_REQ_DROP;
 		goto out;
 	} else {
-		atomic_inc_uint32_t(&entry->object.file.anon_ops);
+		if (entry->type == REGULAR_FILE)
+			atomic_inc_uint32_t(&entry->object.file->anon_ops);
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 	}
 
@@ -172,7 +173,8 @@ int nlm4_Lock(nfs_arg_t *args, struct svc_req *req, nfs_res_t *res)
 	 * the lock. However, when attempting to get a delegation in the
 	 * future existing locks will result in a conflict. Thus, we can
 	 * decrement the anonymous operations counter now. */
-	atomic_dec_uint32_t(&entry->object.file.anon_ops);
+	if (entry->type == REGULAR_FILE)
+		atomic_dec_uint32_t(&entry->object.file->anon_ops);
 
 	if (state_status != STATE_SUCCESS) {
 		res->res_nlm4test.test_stat.stat =
@@ -6,6 +6,7 @@
 #include "gsh_rpc.h"
 #include "nfs23.h"
 #include "nfs_fh.h"
+#include "io_buffer.h"
 
 static struct nfs_request_lookahead dummy_lookahead = {
 	.flags = 0,
@@ -1361,7 +1362,7 @@ WRITE3args *objp;
 		return (false);
 	if (!xdr_stable_how(xdrs, &objp->stable))
 		return (false);
-	if (!xdr_bytes
+	if (!xdr_io_data
 	    (xdrs, (char **)&objp->data.data_val,
 	     &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
 		return (false);
@@ -46,6 +46,7 @@
 
 #include "nfs_dupreq.h"
 #include "city.h"
+#include "gsh_cksum.h"
 #include "abstract_mem.h"
 #include "gsh_intrinsic.h"
 #include "wait_queue.h"
@@ -53,6 +54,31 @@
 #define DUPREQ_BAD_ADDR1 0x01	/* safe for marked pointers, etc */
 #define DUPREQ_NOCACHE   0x02
 
+/**
+ * Number of shards of the LRU of completed entries that enforces the
+ * byte budget across all DRCs.  An entry's shard is chosen by XID.
+ */
+#define DRC_LRU_NSHARD 16
+
+/**
+ * Entries examined by one eviction pass before it gives up.
+ */
+#define DRC_LRU_SCAN 32
+
+/**
+ * NFSv4.0 operations whose re-execution is not a faithful replay.
+ * SETATTR and SETCLIENTID share bits with REMOVE and RENAME.  A
+ * replayed DELEGRETURN, DELEGPURGE or RELEASE_LOCKOWNER would fail on
+ * the state the original released.
+ */
+#define NFS_LOOKAHEAD_MUTATING (NFS_LOOKAHEAD_WRITE |		\
+				NFS_LOOKAHEAD_REMOVE |		\
+				NFS_LOOKAHEAD_RENAME |		\
+				NFS_LOOKAHEAD_SETATTR |		\
+				NFS_LOOKAHEAD_LINK |		\
+				NFS_LOOKAHEAD_DELEGRETURN |	\
+				NFS_LOOKAHEAD_RELEASE_LOCKOWNER)
+
 pool_t *dupreq_pool;
 pool_t *nfs_res_pool;
 pool_t *tcp_drc_pool;		/* pool of per-connection DRC objects */
@@ -71,6 +97,18 @@ const char *dupreq_state_table[] = {
 	"DUPREQ_DELETED",
 };
 
+/**
+ * @brief One shard of the global LRU of completed entries
+ */
+
+struct drc_lru {
+	pthread_mutex_t mtx;
+	struct drc_tailq q;	/* least recently completed first */
+	uint64_t entries;
+	uint64_t bytes;
+	GSH_CACHE_PAD(0);
+};
+
 struct drc_st {
 	pthread_mutex_t mtx;
 	drc_t udp_drc;		/* shared DRC */
@@ -79,10 +117,17 @@ struct drc_st {
 	int32_t tcp_drc_recycle_qlen;
 	time_t last_expire_check;
 	uint32_t expire_delta;
+	uint64_t shard_budget;	/* bytes per LRU shard */
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	struct drc_lru lru[DRC_LRU_NSHARD];
 };
 
 static struct drc_st *drc_st;
 
+static void drc_drain(drc_t *drc);
+
 /**
  * @brief Comparison function for duplicate request entries.
  *
@@ -260,7 +305,7 @@ static inline void init_shared_drc(void)
  */
 void dupreq2_pkginit(void)
 {
-	int code __attribute__ ((unused)) = 0;
+	int ix, code __attribute__ ((unused)) = 0;
 
 	dupreq_pool = pool_init("Duplicate Request Pool",
 				sizeof(dupreq_entry_t),
@@ -301,6 +346,15 @@ void dupreq2_pkginit(void)
 	drc_st->last_expire_check = time(NULL);
 	drc_st->expire_delta = nfs_param.core_param.drc.tcp.recycle_expire_s;
 
+	/* byte budget LRU */
+	drc_st->shard_budget =
+	    (uint64_t)nfs_param.core_param.drc.budget_mb * 1024 * 1024 /
+	    DRC_LRU_NSHARD;
+	for (ix = 0; ix < DRC_LRU_NSHARD; ++ix) {
+		gsh_mutex_init(&drc_st->lru[ix].mtx, NULL);
+		TAILQ_INIT(&drc_st->lru[ix].q);
+	}
+
 	/* UDP DRC is global, shared */
 	init_shared_drc();
 }
@@ -410,12 +464,17 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 /**
  * @brief Deep-free a per-connection (TCP) duplicate request cache
  *
- * @param[in] drc  The DRC to dispose
+ * @param[in] drc  The DRC to dispose, unreferenced, mutex held
  *
  * Assumes that the DRC has been allocated from the tcp_drc_pool.
+ * The caller holds the DRC's mutex from its refcount check, so the LRU
+ * evictor cannot reference the DRC through one of its entries until
+ * they are all drained; after that nothing reaches it.
  */
 static inline void free_tcp_drc(drc_t *drc)
 {
+	drc_drain(drc);
+	PTHREAD_MUTEX_unlock(&drc->mtx);
 	if (drc->xt.tree[0].cache)
 		gsh_free(drc->xt.tree[0].cache);
 	PTHREAD_MUTEX_destroy(&drc->mtx);
@@ -498,7 +557,6 @@ static inline void drc_free_expired(void)
 			drc->flags &= ~DRC_FLAG_RECYCLE;
 			/* but if not, dispose it */
 			if (drc->refcnt == 0) {
-				PTHREAD_MUTEX_unlock(&drc->mtx);
 				free_tcp_drc(drc);
 				continue;
 			}
@@ -794,6 +852,7 @@ static inline dupreq_entry_t *alloc_dupreq(void)
 	memset(dv, 0, sizeof(dupreq_entry_t));	/* XXX pool_zalloc */
 	gsh_mutex_init(&dv->mtx, NULL);
 	TAILQ_INIT_ENTRY(dv, fifo_q);
+	TAILQ_INIT_ENTRY(dv, lru_q);
 out:
 	return dv;
 }
@@ -818,6 +877,164 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 	pool_free(dupreq_pool, dv);
 }
 
+/**
+ * @brief Find the LRU shard of a cache entry
+ *
+ * @param[in] dv  The entry
+ *
+ * @return The shard.
+ */
+static inline struct drc_lru *drc_lru_of(dupreq_entry_t *dv)
+{
+	return &drc_st->lru[dv->hin.tcp.rq_xid % DRC_LRU_NSHARD];
+}
+
+/**
+ * @brief Estimate the memory a completed entry holds
+ *
+ * The decoded result is charged at its encoded size, which follows
+ * the heap it pins (directory entries, names, link text) closely
+ * enough for budgeting.
+ *
+ * @param[in] dv  The completed entry
+ *
+ * @return Bytes to charge against the budget.
+ */
+static inline uint32_t drc_entry_size(dupreq_entry_t *dv)
+{
+	const nfs_function_desc_t *func = nfs_dupreq_func(dv);
+	uint32_t size = sizeof(dupreq_entry_t) + sizeof(nfs_res_t);
+
+	if (func && dv->res)
+		size += xdr_sizeof(func->xdr_encode_func, dv->res);
+
+	return size;
+}
+
+/**
+ * @brief Take an entry off its DRC's queue and off the LRU
+ *
+ * @param[in] drc  The DRC, mutex held
+ * @param[in] dv   The entry, on drc->dupreq_q
+ */
+static inline void drc_unlink_entry(drc_t *drc, dupreq_entry_t *dv)
+{
+	TAILQ_REMOVE(&drc->dupreq_q, dv, fifo_q);
+	--(drc->size);
+
+	if (TAILQ_IS_ENQUEUED(dv, lru_q)) {
+		struct drc_lru *lru = drc_lru_of(dv);
+
+		PTHREAD_MUTEX_lock(&lru->mtx);
+		TAILQ_REMOVE(&lru->q, dv, lru_q);
+		TAILQ_INIT_ENTRY(dv, lru_q);
+		--(lru->entries);
+		lru->bytes -= dv->size;
+		PTHREAD_MUTEX_unlock(&lru->mtx);
+		drc->bytes -= dv->size;
+	}
+}
+
+/**
+ * @brief Dispose of an entry already unlinked from its DRC's queue
+ *
+ * Once the entry is out of the DRC's tree no new retransmission can
+ * find it.  One that found it earlier may still be replaying it, in
+ * which case the entry is marked deleted and the final
+ * nfs_dupreq_rele frees it.
+ *
+ * @param[in] drc  The DRC, kept alive by the caller
+ * @param[in] dv   The entry
+ */
+static void drc_retire_entry(drc_t *drc, dupreq_entry_t *dv)
+{
+	struct rbtree_x_part *t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+
+	PTHREAD_MUTEX_lock(&t->mtx);	/* partition lock */
+	rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k, dv->hk);
+	PTHREAD_MUTEX_unlock(&t->mtx);
+
+	PTHREAD_MUTEX_lock(&dv->mtx);
+	if (dv->refcnt > 0) {
+		dv->state = DUPREQ_DELETED;
+		PTHREAD_MUTEX_unlock(&dv->mtx);
+		return;
+	}
+	PTHREAD_MUTEX_unlock(&dv->mtx);
+
+	nfs_dupreq_free_dupreq(dv);
+}
+
+/**
+ * @brief Free every entry of a DRC that is being disposed
+ *
+ * The DRC is unreferenced, so none of its entries is in use.
+ *
+ * @param[in] drc  The DRC, mutex held
+ */
+static void drc_drain(drc_t *drc)
+{
+	dupreq_entry_t *dv;
+
+	while ((dv = TAILQ_FIRST(&drc->dupreq_q)) != NULL) {
+		drc_unlink_entry(drc, dv);
+		nfs_dupreq_free_dupreq(dv);
+	}
+}
+
+/**
+ * @brief Bring an LRU shard back within its share of the byte budget
+ *
+ * Least recently completed entries go first, from whichever DRC holds
+ * them.  The shard lock is taken before DRC locks here, against the
+ * usual order, so a victim's DRC lock is only tried and entries whose
+ * DRC is busy, or that are being replayed, are passed over.
+ *
+ * @param[in] lru  The shard
+ */
+static void drc_lru_evict(struct drc_lru *lru)
+{
+	struct drc_tailq victims;
+	dupreq_entry_t *dv, *next;
+	drc_t *drc;
+	int scan;
+
+	TAILQ_INIT(&victims);
+
+	PTHREAD_MUTEX_lock(&lru->mtx);
+	for (dv = TAILQ_FIRST(&lru->q), scan = 0;
+	     dv && lru->bytes > drc_st->shard_budget && scan < DRC_LRU_SCAN;
+	     dv = next, ++scan) {
+		next = TAILQ_NEXT(dv, lru_q);
+		drc = dv->hin.drc;
+		if (dv->refcnt > 0 || pthread_mutex_trylock(&drc->mtx) != 0)
+			continue;
+		TAILQ_REMOVE(&lru->q, dv, lru_q);
+		TAILQ_INIT_ENTRY(dv, lru_q);
+		--(lru->entries);
+		lru->bytes -= dv->size;
+		TAILQ_REMOVE(&drc->dupreq_q, dv, fifo_q);
+		--(drc->size);
+		drc->bytes -= dv->size;
+		/* hold the DRC until the entry is out of its tree */
+		(void)nfs_dupreq_ref_drc(drc);
+		PTHREAD_MUTEX_unlock(&drc->mtx);
+		TAILQ_INSERT_TAIL(&victims, dv, fifo_q);
+	}
+	PTHREAD_MUTEX_unlock(&lru->mtx);
+
+	while ((dv = TAILQ_FIRST(&victims)) != NULL) {
+		TAILQ_REMOVE(&victims, dv, fifo_q);
+		drc = dv->hin.drc;
+		LogFullDebug(COMPONENT_DUPREQ,
+			     "evicting dv=%p xid=%u size=%u on DRC=%p",
+			     dv, dv->hin.tcp.rq_xid, dv->size, drc);
+		(void)atomic_inc_uint64_t(&drc_st->evictions);
+		drc_retire_entry(drc, dv);
+		nfs_dupreq_put_drc(NULL, drc, DRC_FLAG_NONE);
+	}
+}
+
 /**
  * @page DRC_RETIRE DRC request retire heuristic.
  *
@@ -903,9 +1120,74 @@ static inline bool nfs_dupreq_v4_cacheable(nfs_request_t *reqnfs)
 	      NFS_LOOKAHEAD_READLINK |
 	      NFS_LOOKAHEAD_READDIR)))
 		return false;
+	if (!nfs_param.core_param.drc.cache_idempotent &&
+	    !(reqnfs->lookahead.flags & NFS_LOOKAHEAD_MUTATING))
+		/* a replay would re-execute it to the same effect */
+		return false;
 	return true;
 }
 
+/**
+ * @brief Compute the checksum that, with the XID, identifies a request
+ *
+ * TI-RPC checksums the head of the call record as it receives it.
+ * The payload of a WRITE is decoded here into an I/O buffer, and its
+ * digest is folded in from a bounded prefix and its length with the
+ * configured hash, so a large WRITE costs no more than a small one.
+ *
+ * @param[in] reqnfs  The NFS request, arguments decoded
+ * @param[in] req     The request
+ * @param[in] dtype   Type of the DRC it goes to
+ *
+ * @return The checksum.
+ */
+static inline uint64_t nfs_dupreq_cksum(nfs_request_t *reqnfs,
+					struct svc_req *req,
+					enum drc_type dtype)
+{
+	enum gsh_cksum_type type = nfs_param.core_param.drc.cksum_type;
+	uint32_t max = nfs_param.core_param.drc.cksum_len;
+	uint64_t hk = req->rq_cksum;
+	COMPOUND4args *arg_c4;
+	WRITE3args *arg_w3;
+	WRITE4args *arg_w4;
+	u_int ix;
+
+	if (!(dtype == DRC_UDP_V234 ? nfs_param.core_param.drc.udp.checksum
+	      : nfs_param.core_param.drc.tcp.checksum))
+		/* match on the XID alone, which still spreads the tree */
+		return req->rq_xid;
+
+	if (type == GSH_CKSUM_TIRPC
+	    || !(reqnfs->lookahead.flags & NFS_LOOKAHEAD_WRITE)
+	    || req->rq_prog != nfs_param.core_param.program[P_NFS])
+		return hk;
+
+	switch (req->rq_vers) {
+	case NFS_V3:
+		if (req->rq_proc != NFSPROC3_WRITE)
+			break;
+		arg_w3 = &reqnfs->arg_nfs.arg_write3;
+		hk = gsh_cksum(type, arg_w3->data.data_val,
+			       arg_w3->data.data_len, max, hk);
+		break;
+	case NFS_V4:
+		arg_c4 = &reqnfs->arg_nfs.arg_compound4;
+		for (ix = 0; ix < arg_c4->argarray.argarray_len; ix++) {
+			if (arg_c4->argarray.argarray_val[ix].argop !=
+			    NFS4_OP_WRITE)
+				continue;
+			arg_w4 = &arg_c4->argarray.argarray_val[ix]
+				.nfs_argop4_u.opwrite;
+			hk = gsh_cksum(type, arg_w4->data.data_val,
+				       arg_w4->data.data_len, max, hk);
+		}
+		break;
+	}
+
+	return hk;
+}
+
 /**
  * @brief Start a duplicate request transaction
  *
@@ -1006,8 +1288,8 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs,
 		goto release_dk;
 	}
 
-	/* TI-RPC computed checksum */
-	dk->hk = req->rq_cksum;
+	/* TI-RPC computed checksum, with the payload folded in */
+	dk->hk = nfs_dupreq_cksum(reqnfs, req, dtype);
 
 	dk->state = DUPREQ_START;
 	dk->timestamp = time(NULL);
@@ -1030,7 +1312,9 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs,
 				res = dv->res;
 				PTHREAD_MUTEX_lock(&drc->mtx);
 				drc_inc_retwnd(drc);
+				++(drc->hits);
 				PTHREAD_MUTEX_unlock(&drc->mtx);
+				(void)atomic_inc_uint64_t(&drc_st->hits);
 				status = DUPREQ_EXISTS;
 				(dv->refcnt)++;
 			}
@@ -1050,7 +1334,9 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs,
 			PTHREAD_MUTEX_lock(&drc->mtx);
 			TAILQ_INSERT_TAIL(&drc->dupreq_q, dk, fifo_q);
 			++(drc->size);
+			++(drc->misses);
 			PTHREAD_MUTEX_unlock(&drc->mtx);
+			(void)atomic_inc_uint64_t(&drc_st->misses);
 			req->rq_u1 = dk;
 			release_dk = false;
 			dv = dk;
@@ -1094,6 +1380,11 @@ dupreq_status_t nfs_dupreq_start(nfs_request_t *reqnfs,
  * immediately preceding requests.  A timeout may supplement the water mark,
  * in future.
  *
+ * Completed entries are also charged, by the size of their replies,
+ * to a byte budget shared by all DRCs, and the least recently
+ * completed are evicted from whichever DRC holds them when it is
+ * exceeded.
+ *
  * req->rq_u1 has either a magic value, or points to a duplicate request
  * cache entry allocated in nfs_dupreq_start.
  *
@@ -1107,7 +1398,8 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 {
 	dupreq_entry_t *ov = NULL, *dv = (dupreq_entry_t *)req->rq_u1;
 	dupreq_status_t status = DUPREQ_SUCCESS;
-	struct rbtree_x_part *t;
+	struct drc_lru *lru = NULL;
+	bool over_budget = false;
 	drc_t *drc = NULL;
 
 	/* do nothing if req is marked no-cache */
@@ -1125,8 +1417,20 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	drc = dv->hin.drc;
 	PTHREAD_MUTEX_unlock(&dv->mtx);
 
-	/* cond. remove from q head */
+	/* charge the reply before it becomes evictable */
+	dv->size = drc_entry_size(dv);
+	lru = drc_lru_of(dv);
+
 	PTHREAD_MUTEX_lock(&drc->mtx);
+	drc->bytes += dv->size;
+	PTHREAD_MUTEX_lock(&lru->mtx);
+	TAILQ_INSERT_TAIL(&lru->q, dv, lru_q);
+	++(lru->entries);
+	lru->bytes += dv->size;
+	over_budget = lru->bytes > drc_st->shard_budget;
+	PTHREAD_MUTEX_unlock(&lru->mtx);
+
+	/* cond. remove from q head */
 
 	LogFullDebug(COMPONENT_DUPREQ,
 		     "completing dv=%p xid=%u on DRC=%p state=%s, status=%s, refcnt=%d",
@@ -1148,16 +1452,9 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 				goto unlock;
 			}
 			/* remove q entry */
-			TAILQ_REMOVE(&drc->dupreq_q, ov, fifo_q);
-			--(drc->size);
-
-			/* remove dict entry */
-			t = rbtx_partition_of_scalar(&drc->xt, ov->hk);
+			drc_unlink_entry(drc, ov);
 			/* interlock */
 			PTHREAD_MUTEX_unlock(&drc->mtx);
-			PTHREAD_MUTEX_lock(&t->mtx);	/* partition lock */
-			rbtree_x_cached_remove(&drc->xt, t, &ov->rbt_k, ov->hk);
-			PTHREAD_MUTEX_unlock(&t->mtx);
 
 			LogDebug(COMPONENT_DUPREQ,
 				 "retiring ov=%p xid=%u on DRC=%p state=%s, status=%s, refcnt=%d",
@@ -1165,8 +1462,8 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 				 ov->hin.drc, dupreq_state_table[dv->state],
 				 dupreq_status_table[status], ov->refcnt);
 
-			/* deep free ov */
-			nfs_dupreq_free_dupreq(ov);
+			/* remove dict entry, deep free ov */
+			drc_retire_entry(drc, ov);
 			goto out;
 		}
 	}
@@ -1175,6 +1472,9 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	PTHREAD_MUTEX_unlock(&drc->mtx);
 
  out:
+	if (over_budget)
+		drc_lru_evict(lru);
+
 	return status;
 }
 
@@ -1293,6 +1593,64 @@ void nfs_dupreq_rele(struct svc_req *req, const nfs_function_desc_t *func)
 	(void)free_rpc_msg(req->rq_msg);
 }
 
+/**
+ * @brief Sum the occupancy and hit counters of all DRCs
+ *
+ * @param[out] tot  The totals
+ */
+void dupreq2_totals(struct drc_totals *tot)
+{
+	int ix;
+
+	memset(tot, 0, sizeof(*tot));
+	tot->budget = drc_st->shard_budget * DRC_LRU_NSHARD;
+	for (ix = 0; ix < DRC_LRU_NSHARD; ++ix) {
+		struct drc_lru *lru = &drc_st->lru[ix];
+
+		PTHREAD_MUTEX_lock(&lru->mtx);
+		tot->entries += lru->entries;
+		tot->bytes += lru->bytes;
+		PTHREAD_MUTEX_unlock(&lru->mtx);
+	}
+	tot->hits = atomic_fetch_uint64_t(&drc_st->hits);
+	tot->misses = atomic_fetch_uint64_t(&drc_st->misses);
+	tot->evictions = atomic_fetch_uint64_t(&drc_st->evictions);
+}
+
+/**
+ * @brief Call a function on every duplicate request cache
+ *
+ * That is the shared UDP DRC and every per-connection DRC, connected
+ * or awaiting reuse.  The function is called with the DRC's mutex
+ * held and must not block.
+ *
+ * @param[in] cb     The function
+ * @param[in] state  Its argument
+ */
+void dupreq2_foreach_drc(void (*cb)(drc_t *drc, void *state), void *state)
+{
+	struct opr_rbtree_node *n;
+	drc_t *drc = &drc_st->udp_drc;
+	int ix;
+
+	PTHREAD_MUTEX_lock(&drc->mtx);
+	cb(drc, state);
+	PTHREAD_MUTEX_unlock(&drc->mtx);
+
+	DRC_ST_LOCK();
+	for (ix = 0; ix < drc_st->tcp_drc_recycle_t.npart; ++ix) {
+		struct rbtree_x_part *t = &drc_st->tcp_drc_recycle_t.tree[ix];
+
+		for (n = opr_rbtree_first(&t->t); n; n = opr_rbtree_next(n)) {
+			drc = opr_containerof(n, drc_t, d_u.tcp.recycle_k);
+			PTHREAD_MUTEX_lock(&drc->mtx);
+			cb(drc, state);
+			PTHREAD_MUTEX_unlock(&drc->mtx);
+		}
+	}
+	DRC_ST_UNLOCK();
+}
+
 /**
  * @brief Shutdown the dupreq2 package.
  */
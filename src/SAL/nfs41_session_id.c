@@ -37,6 +37,7 @@
 #include "config.h"
 #include "nfs_core.h"
 #include "sal_functions.h"
+#include "nfs_proto_functions.h"
 
 /**
  * @brief Pool for allocating session data
@@ -55,6 +56,12 @@ hash_table_t *ht_session_id;
 
 uint64_t global_sequence = 0;
 
+/**
+ * @brief Server-wide forechannel slot accounting
+ */
+
+struct nfs41_slot_totals nfs41_slot_st;
+
 /**
  * @brief Display a session ID
  *
@@ -231,6 +238,216 @@ void nfs41_Build_sessionid(clientid4 *clientid, char *sessionid)
 	memcpy(sessionid + sizeof(clientid4), &seq, sizeof(seq));
 }
 
+/**
+ * @brief Free a forechannel slot
+ *
+ * @param[in] slot  The slot, idle
+ */
+
+static void nfs41_slot_free(nfs41_session_slot_t *slot)
+{
+	if (slot->cached_reply != NULL)
+		nfs41_cached_reply_put(slot->cached_reply);
+	PTHREAD_MUTEX_destroy(&slot->lock);
+	gsh_free(slot);
+	atomic_dec_uint64_t(&nfs41_slot_st.allocated);
+}
+
+/**
+ * @brief Grow a session's forechannel slot table
+ *
+ * @param[in,out] session  The session, slots_lock held for writing
+ * @param[in]     target   Slots to accept, more than now
+ *
+ * @return false if out of memory.
+ */
+
+static bool nfs41_slots_grow(nfs41_session_t *session, uint32_t target)
+{
+	nfs41_session_slot_t **slots;
+	uint32_t nb = session->nb_slots;
+
+	slots = gsh_realloc(session->slots, target * sizeof(*slots));
+	if (slots == NULL)
+		return false;
+
+	memset(slots + nb, 0, (target - nb) * sizeof(*slots));
+	session->slots = slots;
+	session->nb_slots = target;
+	atomic_inc_uint64_t(&nfs41_slot_st.grows);
+	return true;
+}
+
+/**
+ * @brief Set up the slot tables of a new session
+ *
+ * Only the table is allocated; a forechannel slot is allocated when
+ * the client first uses it.  The table may later grow up to the
+ * negotiated fore_channel_attrs.ca_maxrequests, which must be set.
+ *
+ * @param[in,out] session      The session
+ * @param[in]     nb_slots     Forechannel slots to accept
+ * @param[in]     nb_cb_slots  Backchannel slots to use
+ *
+ * @return false if out of memory.
+ */
+
+bool nfs41_Session_Slots_Init(nfs41_session_t *session, uint32_t nb_slots,
+			      uint32_t nb_cb_slots)
+{
+	session->slots = gsh_calloc(nb_slots, sizeof(*session->slots));
+	session->cb_slots = gsh_calloc(MAX(nb_cb_slots, 1),
+				       sizeof(*session->cb_slots));
+	if (session->slots == NULL || session->cb_slots == NULL) {
+		gsh_free(session->slots);
+		gsh_free(session->cb_slots);
+		return false;
+	}
+
+	PTHREAD_RWLOCK_init(&session->slots_lock, NULL);
+	session->nb_slots = nb_slots;
+	session->nb_cb_slots = nb_cb_slots;
+	session->initial_slots = nb_slots;
+	session->target_slots = nb_slots;
+	session->target_changed = 0;
+
+	atomic_inc_uint64_t(&nfs41_slot_st.sessions);
+	atomic_add_uint64_t(&nfs41_slot_st.target, nb_slots);
+	return true;
+}
+
+/**
+ * @brief Find a forechannel slot, allocating it on first use
+ *
+ * @param[in]  session  The session
+ * @param[in]  slotid   The slot
+ * @param[out] highest  Highest slotid the session accepts
+ *
+ * @return The slot, with its lock held, or NULL if slotid is out of
+ *         the table or out of memory.
+ */
+
+nfs41_session_slot_t *nfs41_Session_Slot(nfs41_session_t *session,
+					 slotid4 slotid, slotid4 *highest)
+{
+	nfs41_session_slot_t *slot;
+
+	PTHREAD_RWLOCK_rdlock(&session->slots_lock);
+	if (slotid >= session->fore_channel_attrs.ca_maxrequests)
+		goto out;
+
+	slot = slotid < session->nb_slots ? session->slots[slotid] : NULL;
+	if (slot == NULL) {
+		PTHREAD_RWLOCK_unlock(&session->slots_lock);
+		PTHREAD_RWLOCK_wrlock(&session->slots_lock);
+
+		/* The client may use any slot it negotiated until it
+		 * has seen a highest slotid from us */
+		if (slotid >= session->nb_slots &&
+		    !nfs41_slots_grow(session, slotid + 1))
+			goto out;
+		slot = session->slots[slotid];
+		if (slot == NULL) {
+			slot = gsh_calloc(1, sizeof(*slot));
+			if (slot == NULL)
+				goto out;
+			PTHREAD_MUTEX_init(&slot->lock, NULL);
+			session->slots[slotid] = slot;
+			atomic_inc_uint64_t(&nfs41_slot_st.allocated);
+		}
+	}
+
+	*highest = session->nb_slots - 1;
+
+	/* Lock the slot before the table, a resize waits for it */
+	PTHREAD_MUTEX_lock(&slot->lock);
+	PTHREAD_RWLOCK_unlock(&session->slots_lock);
+	return slot;
+
+ out:
+	PTHREAD_RWLOCK_unlock(&session->slots_lock);
+	return NULL;
+}
+
+/**
+ * @brief Grow or shrink a session's forechannel slot table
+ *
+ * Growing stops at the slots negotiated at CREATE_SESSION.  Shrinking
+ * frees the slots above the target, but stops at a slot with a
+ * request in progress.
+ *
+ * @param[in,out] session  The session
+ * @param[in]     target   Slots to accept, at least 1
+ */
+
+void nfs41_Session_Slots_Resize(nfs41_session_t *session, uint32_t target)
+{
+	nfs41_session_slot_t **slots;
+	nfs41_session_slot_t *slot;
+	uint32_t nb;
+
+	target = MIN(target, session->fore_channel_attrs.ca_maxrequests);
+	target = MAX(target, 1);
+
+	PTHREAD_RWLOCK_wrlock(&session->slots_lock);
+	nb = session->nb_slots;
+
+	if (target > nb) {
+		(void)nfs41_slots_grow(session, target);
+		goto out;
+	}
+
+	for (; nb > target; nb--) {
+		slot = session->slots[nb - 1];
+		if (slot == NULL)
+			continue;
+
+		PTHREAD_MUTEX_lock(&slot->lock);
+		if (slot->in_use) {
+			PTHREAD_MUTEX_unlock(&slot->lock);
+			break;
+		}
+		PTHREAD_MUTEX_unlock(&slot->lock);
+
+		nfs41_slot_free(slot);
+		session->slots[nb - 1] = NULL;
+	}
+
+	if (nb == session->nb_slots)
+		goto out;
+
+	session->nb_slots = nb;
+	atomic_inc_uint64_t(&nfs41_slot_st.shrinks);
+	slots = gsh_realloc(session->slots, nb * sizeof(*slots));
+	if (slots != NULL)
+		session->slots = slots;
+
+ out:
+	PTHREAD_RWLOCK_unlock(&session->slots_lock);
+}
+
+/**
+ * @brief Free a destroyed session's forechannel slot table
+ *
+ * The session is unreferenced, so no slot can be in use.
+ *
+ * @param[in,out] session  The session
+ */
+
+void nfs41_Session_Slots_Free(nfs41_session_t *session)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < session->nb_slots; ix++) {
+		if (session->slots[ix] != NULL)
+			nfs41_slot_free(session->slots[ix]);
+	}
+
+	gsh_free(session->slots);
+	session->slots = NULL;
+	session->nb_slots = 0;
+}
+
 int32_t inc_session_ref(nfs41_session_t *session)
 {
 	int32_t refcnt = atomic_inc_int32_t(&session->refcount);
@@ -239,7 +456,6 @@ int32_t inc_session_ref(nfs41_session_t *session)
 
 int32_t dec_session_ref(nfs41_session_t *session)
 {
-	int i;
 	int32_t refcnt = atomic_dec_int32_t(&session->refcount);
 
 	if (refcnt == 0) {
@@ -254,8 +470,12 @@ int32_t dec_session_ref(nfs41_session_t *session)
 		dec_client_id_ref(session->clientid_record);
 		/* Destroy this session's mutexes and condition variable */
 
-		for (i = 0; i < NFS41_NB_SLOTS; i++)
-			PTHREAD_MUTEX_destroy(&session->slots[i].lock);
+		nfs41_Session_Slots_Free(session);
+		gsh_free(session->cb_slots);
+		PTHREAD_RWLOCK_destroy(&session->slots_lock);
+		atomic_dec_uint64_t(&nfs41_slot_st.sessions);
+		atomic_sub_uint64_t(&nfs41_slot_st.target,
+				    session->target_slots);
 
 		PTHREAD_COND_destroy(&session->cb_cond);
 		PTHREAD_MUTEX_destroy(&session->cb_mutex);
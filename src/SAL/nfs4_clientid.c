@@ -46,6 +46,7 @@
 #include "nfs4.h"
 #include "fsal.h"
 #include "sal_functions.h"
+#include "nfs_proto_functions.h"
 #include "cache_inode_lru.h"
 #include "abstract_atomic.h"
 #include "city.h"
@@ -334,6 +335,11 @@ void free_client_id(nfs_client_id_t *clientid)
 		}
 	}
 
+	if (clientid->cid_create_session_slot.cached_reply != NULL)
+		nfs41_cached_reply_put(
+			clientid->cid_create_session_slot.cached_reply);
+
+	PTHREAD_MUTEX_destroy(&clientid->cid_create_session_slot.lock);
 	PTHREAD_MUTEX_destroy(&clientid->cid_mutex);
 	PTHREAD_MUTEX_destroy(&clientid->cid_owner.so_mutex);
 	if (clientid->cid_minorversion == 0)
@@ -528,6 +534,7 @@ nfs_client_id_t *create_client_id(clientid4 clientid,
 	}
 
 	PTHREAD_MUTEX_init(&client_rec->cid_mutex, NULL);
+	PTHREAD_MUTEX_init(&client_rec->cid_create_session_slot.lock, NULL);
 
 	owner = &client_rec->cid_owner;
 
@@ -536,7 +543,7 @@ nfs_client_id_t *create_client_id(clientid4 clientid,
 	/* initialize the chan mutex for v4 */
 	if (minorversion == 0) {
 		PTHREAD_MUTEX_init(&client_rec->cid_cb.v40.cb_chan.mtx, NULL);
-		client_rec->cid_cb.v40.cb_chan_down = true;
+		client_rec->cid_cb_chan_down = true;
 		client_rec->first_path_down_resp_time = 0;
 	}
 
@@ -618,6 +625,9 @@ clientid_status_t nfs_client_id_insert(nfs_client_id_t *clientid)
 	/* Take a reference to the unconfirmed clientid for the hash table. */
 	(void)inc_client_id_ref(clientid);
 
+	/* From here on the reaper watches its lease */
+	lease_timer_start(clientid);
+
 	if (isFullDebug(COMPONENT_CLIENTID) &&
 	    isFullDebug(COMPONENT_HASHTABLE)) {
 		LogFullDebug(COMPONENT_CLIENTID,
@@ -664,6 +674,7 @@ int remove_confirmed_client_id(nfs_client_id_t *clientid)
 
 	/* Set this up so this client id record will be freed. */
 	clientid->cid_confirmed = EXPIRED_CLIENT_ID;
+	lease_timer_stop(clientid);
 
 	/* Release hash table reference to the unconfirmed record */
 	(void)dec_client_id_ref(clientid);
@@ -708,6 +719,7 @@ int remove_unconfirmed_client_id(nfs_client_id_t *clientid)
 
 	/* Set this up so this client id record will be freed. */
 	clientid->cid_confirmed = EXPIRED_CLIENT_ID;
+	lease_timer_stop(clientid);
 
 	/* Release hash table reference to the unconfirmed record */
 	(void)dec_client_id_ref(clientid);
@@ -783,6 +795,7 @@ clientid_status_t nfs_client_id_confirm(nfs_client_id_t *clientid,
 		/* Set this up so this client id record will be
 		   freed. */
 		clientid->cid_confirmed = EXPIRED_CLIENT_ID;
+		lease_timer_stop(clientid);
 
 		/* Release hash table reference to the unconfirmed
 		   record */
@@ -939,6 +952,8 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid, bool make_stale)
 				" error=%s", clientid->cid_clientid,
 				hash_table_err_to_str(rc));
 		}
+
+		lease_timer_stop(clientid);
 	}
 
 	/* Traverse the client's lock owners, and release all
@@ -1083,7 +1098,7 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid, bool make_stale)
 	}
 
 	if (clientid->cid_recov_dir != NULL && !make_stale) {
-		nfs4_rm_clid(clientid->cid_recov_dir, v4_recov_dir, 0);
+		nfs4_rm_clid(clientid);
 		gsh_free(clientid->cid_recov_dir);
 		clientid->cid_recov_dir = NULL;
 	}
@@ -1300,6 +1315,8 @@ int nfs_Init_client_id(void)
 		return -1;
 	}
 
+	lease_timer_init();
+
 	return CLIENT_ID_SUCCESS;
 }
 
@@ -40,6 +40,20 @@
 #include "nfs4.h"
 #include "sal_functions.h"
 
+/**
+ * Clients by when their lease must next be looked at.
+ *
+ * Renewals do not touch the wheel: update_lease only moves
+ * cid_last_renew.  When a client's time comes, the reaper checks the
+ * lease and, if it was renewed meanwhile, puts the client back at its
+ * new expiry.  So a busy client costs the wheel one re-arm per lease
+ * period, and the reaper looks only at clients whose last known
+ * deadline has passed.  The wheel holds a reference on each client
+ * armed on it.
+ */
+static struct timer_wheel lease_wheel;
+static pthread_mutex_t lease_wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief Return the lifetime of a valid lease
  *
@@ -157,4 +171,96 @@ void update_lease(nfs_client_id_t *clientid)
 	}
 }
 
+/**
+ * @brief When a lease will run out, as far as is known now
+ *
+ * @param[in] clientid Client record
+ */
+static time_t lease_deadline(nfs_client_id_t *clientid)
+{
+	if (clientid->cid_lease_reservations != 0)
+		return time(NULL) + nfs_param.nfsv4_param.lease_lifetime;
+
+	return clientid->cid_last_renew + nfs_param.nfsv4_param.lease_lifetime;
+}
+
+/**
+ * @brief Initialize the lease wheel
+ */
+void lease_timer_init(void)
+{
+	timer_wheel_init(&lease_wheel, time(NULL));
+}
+
+/**
+ * @brief Put a new client on the lease wheel
+ *
+ * @param[in] clientid Client record, just hashed
+ */
+void lease_timer_start(nfs_client_id_t *clientid)
+{
+	(void)inc_client_id_ref(clientid);
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	timer_wheel_arm(&lease_wheel, &clientid->cid_lease_timer,
+			lease_deadline(clientid));
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+}
+
+/**
+ * @brief Put a client taken off the wheel back on it
+ *
+ * The caller holds cid_mutex, and passes back the reference that came
+ * off the wheel with the client.
+ *
+ * @param[in] clientid Client record with a valid lease
+ */
+void lease_timer_rearm(nfs_client_id_t *clientid)
+{
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	timer_wheel_arm(&lease_wheel, &clientid->cid_lease_timer,
+			lease_deadline(clientid));
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+}
+
+/**
+ * @brief Take an unhashed client off the lease wheel
+ *
+ * If the reaper has it in hand instead, the reaper drops the
+ * reference once it sees the client expired.
+ *
+ * @param[in] clientid Client record
+ */
+void lease_timer_stop(nfs_client_id_t *clientid)
+{
+	bool armed;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	armed = timer_wheel_disarm(&lease_wheel, &clientid->cid_lease_timer);
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+
+	if (armed)
+		(void)dec_client_id_ref(clientid);
+}
+
+/**
+ * @brief Take the clients whose deadline has passed off the wheel
+ *
+ * @param[out] expired List the clients are added to, by
+ *                     cid_lease_timer.link, each with the wheel's
+ *                     reference
+ *
+ * @return The number of clients.
+ */
+uint32_t lease_timers_expired(struct glist_head *expired)
+{
+	uint32_t count;
+
+	PTHREAD_MUTEX_lock(&lease_wheel_mutex);
+	count = timer_wheel_advance(&lease_wheel, time(NULL), expired);
+	PTHREAD_MUTEX_unlock(&lease_wheel_mutex);
+
+	return count;
+}
+
 /** @} */
@@ -41,6 +41,7 @@
 #include "sal_functions.h"
 #include "nfs_proto_functions.h"
 #include "nfs_core.h"
+#include "city.h"
 
 hash_table_t *ht_nfs4_owner;
 
@@ -304,6 +305,91 @@ uint64_t nfs4_owner_rbt_hash_func(hash_parameter_t *hparam,
 	return res;
 }
 
+/** Unused open owners by when they may be reaped */
+static struct timer_wheel open_owner_wheel;
+static pthread_mutex_t open_owner_wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief The slot for an open owner in its client's owner cache
+ *
+ * @param[in] clientid Client record
+ * @param[in] owner    Owner or key, with its name
+ *
+ * @return The slot.
+ */
+
+static inline state_owner_t **owner_cache_slot(nfs_client_id_t *clientid,
+					       state_owner_t *owner)
+{
+	uint64_t hash = CityHash64(owner->so_owner_val, owner->so_owner_len);
+
+	return &clientid->cid_owner_cache[hash &
+					  (CLIENT_OWNER_CACHE_SIZE - 1)];
+}
+
+/**
+ * @brief Look an open owner up in its client's owner cache
+ *
+ * Only an owner still holding references is returned.  One whose
+ * last reference is gone may be being freed, and is only brought
+ * back through the owner table, under its latch.  Owners leave the
+ * cache in free_nfs4_owner, under the client's mutex, so those seen
+ * here are not freed while it is held.
+ *
+ * @param[in] clientid Client record
+ * @param[in] key      Key for the owner
+ *
+ * @return The owner with a new reference, or NULL.
+ */
+
+static state_owner_t *owner_cache_get(nfs_client_id_t *clientid,
+				      state_owner_t *key)
+{
+	state_owner_t **slot = owner_cache_slot(clientid, key);
+	state_owner_t *owner;
+	int32_t refcount;
+
+	PTHREAD_MUTEX_lock(&clientid->cid_mutex);
+
+	owner = *slot;
+
+	if (owner == NULL || compare_nfs4_owner(owner, key) != 0)
+		goto miss;
+
+	do {
+		refcount = atomic_fetch_int32_t(&owner->so_refcount);
+		if (refcount == 0)
+			goto miss;
+	} while (!atomic_cas_int32_t(&owner->so_refcount, refcount,
+				     refcount + 1));
+
+	PTHREAD_MUTEX_unlock(&clientid->cid_mutex);
+
+	return owner;
+
+ miss:
+
+	PTHREAD_MUTEX_unlock(&clientid->cid_mutex);
+
+	return NULL;
+}
+
+/**
+ * @brief Remember an open owner in its client's owner cache
+ *
+ * @param[in] clientid Client record
+ * @param[in] owner    The owner, on which the caller holds a reference
+ */
+
+static void owner_cache_put(nfs_client_id_t *clientid, state_owner_t *owner)
+{
+	state_owner_t **slot = owner_cache_slot(clientid, owner);
+
+	PTHREAD_MUTEX_lock(&clientid->cid_mutex);
+	*slot = owner;
+	PTHREAD_MUTEX_unlock(&clientid->cid_mutex);
+}
+
 /**
  * @brief Free an NFS4 owner object
  *
@@ -312,6 +398,19 @@ uint64_t nfs4_owner_rbt_hash_func(hash_parameter_t *hparam,
 
 void free_nfs4_owner(state_owner_t *owner)
 {
+	state_owner_t **slot;
+
+	/* If the reaper is working through the wheel, this waits for it
+	 * to be done with the owner.
+	 */
+	if (owner->so_type == STATE_OPEN_OWNER_NFSV4) {
+		PTHREAD_MUTEX_lock(&open_owner_wheel_mutex);
+		(void)timer_wheel_disarm(&open_owner_wheel,
+					 &owner->so_owner.so_nfs4_owner
+					 .so_close_timer);
+		PTHREAD_MUTEX_unlock(&open_owner_wheel_mutex);
+	}
+
 	if (owner->so_owner.so_nfs4_owner.so_related_owner != NULL)
 		dec_state_owner_ref(owner->so_owner.so_nfs4_owner.
 				    so_related_owner);
@@ -325,6 +424,15 @@ void free_nfs4_owner(state_owner_t *owner)
 
 	glist_del(&owner->so_owner.so_nfs4_owner.so_perclient);
 
+	/* An owner whose name could not be copied was never cached */
+	if (owner->so_type == STATE_OPEN_OWNER_NFSV4 &&
+	    owner->so_owner_val != NULL) {
+		slot = owner_cache_slot(owner->so_owner.so_nfs4_owner
+					.so_clientrec, owner);
+		if (*slot == owner)
+			*slot = NULL;
+	}
+
 	PTHREAD_MUTEX_unlock(&owner->so_owner.so_nfs4_owner.so_clientrec
 			     ->cid_mutex);
 
@@ -356,9 +464,123 @@ int Init_nfs4_owner(void)
 		return -1;
 	}
 
+	timer_wheel_init(&open_owner_wheel, time(NULL));
+
 	return 0;
 }				/* nfs4_Init_nfs4_owner */
 
+/**
+ * @brief Schedule an open owner left unused to be reaped
+ *
+ * @param[in] owner   The open owner, just cached with refcount 0
+ * @param[in] tclose  Its last_close_time
+ */
+void open_owner_timer_arm(state_owner_t *owner, time_t tclose)
+{
+	PTHREAD_MUTEX_lock(&open_owner_wheel_mutex);
+	timer_wheel_arm(&open_owner_wheel,
+			&owner->so_owner.so_nfs4_owner.so_close_timer,
+			tclose + nfs_param.nfsv4_param.lease_lifetime);
+	PTHREAD_MUTEX_unlock(&open_owner_wheel_mutex);
+}
+
+/**
+ * @brief Free the cached open owners that have gone a lease unused
+ *
+ * Only the owners whose time has come off the wheel are looked at.
+ * The wheel stays locked while they are, so one being freed by
+ * another thread meanwhile is not released under us.
+ *
+ * @return The number of owners looked at.
+ */
+int reap_expired_open_owners(void)
+{
+	struct glist_head expired, reaped;
+	struct glist_head *glist, *glistn;
+	state_owner_t *owner;
+	struct hash_latch latch;
+	struct gsh_buffdesc buffkey, buffval;
+	struct gsh_buffdesc old_key, old_value;
+	time_t tnow = time(NULL), tclose, texpire;
+	hash_error_t rc;
+	int count;
+
+	glist_init(&expired);
+	glist_init(&reaped);
+
+	PTHREAD_MUTEX_lock(&open_owner_wheel_mutex);
+
+	count = timer_wheel_advance(&open_owner_wheel, tnow, &expired);
+
+	glist_for_each_safe(glist, glistn, &expired) {
+		owner = glist_entry(glist, state_owner_t,
+				    so_owner.so_nfs4_owner.so_close_timer.link);
+		glist_del(glist);
+
+		buffkey.addr = owner;
+		buffkey.len = sizeof(*owner);
+
+		rc = hashtable_getlatch(ht_nfs4_owner, &buffkey, &buffval,
+					true, &latch);
+
+		if (rc != HASHTABLE_SUCCESS) {
+			/* Already on its way out */
+			if (rc == HASHTABLE_ERROR_NO_SUCH_KEY)
+				hashtable_releaselatched(ht_nfs4_owner,
+							 &latch);
+			continue;
+		}
+
+		tclose = atomic_fetch_time_t(&owner->so_owner.so_nfs4_owner.
+					     last_close_time);
+		texpire = tclose + nfs_param.nfsv4_param.lease_lifetime;
+
+		if (buffval.addr != owner || tclose == 0 ||
+		    atomic_fetch_int32_t(&owner->so_refcount) != 0) {
+			/* Replaced by a new owner of the same name, or in
+			 * use again and re-armed when next released.
+			 */
+			hashtable_releaselatched(ht_nfs4_owner, &latch);
+			continue;
+		}
+
+		if (texpire > tnow) {
+			/* Closed again since it was armed */
+			timer_wheel_arm(&open_owner_wheel,
+					&owner->so_owner.so_nfs4_owner
+					.so_close_timer, texpire);
+			hashtable_releaselatched(ht_nfs4_owner, &latch);
+			continue;
+		}
+
+		hashtable_deletelatched(ht_nfs4_owner, &buffkey, &latch,
+					&old_key, &old_value);
+		hashtable_releaselatched(ht_nfs4_owner, &latch);
+
+		glist_add_tail(&reaped, glist);
+	}
+
+	PTHREAD_MUTEX_unlock(&open_owner_wheel_mutex);
+
+	glist_for_each_safe(glist, glistn, &reaped) {
+		owner = glist_entry(glist, state_owner_t,
+				    so_owner.so_nfs4_owner.so_close_timer.link);
+		glist_del(glist);
+
+		if (isFullDebug(COMPONENT_STATE)) {
+			char str[LOG_BUFF_LEN];
+			struct display_buffer dspbuf = {sizeof(str), str, str};
+
+			display_owner(&dspbuf, owner);
+			LogFullDebug(COMPONENT_STATE, "Free {%s}", str);
+		}
+
+		free_state_owner(owner);
+	}
+
+	return count;
+}
+
 /**
  * @brief Initialize an NFS4 open owner object
  *
@@ -456,7 +678,22 @@ state_owner_t *create_nfs4_owner(state_nfs4_owner_name_t *name,
 		LogFullDebug(COMPONENT_STATE, "Key=%s", str);
 	}
 
-	owner = get_state_owner(care, &key, init_nfs4_owner, &isnew);
+	/* A process tends to open everything under one owner, so most
+	 * OPENs find it here without touching the owner table.
+	 */
+	if (type == STATE_OPEN_OWNER_NFSV4) {
+		owner = owner_cache_get(clientid, &key);
+		if (owner != NULL) {
+			isnew = false;
+		} else {
+			owner = get_state_owner(care, &key, init_nfs4_owner,
+						&isnew);
+			if (owner != NULL)
+				owner_cache_put(clientid, owner);
+		}
+	} else {
+		owner = get_state_owner(care, &key, init_nfs4_owner, &isnew);
+	}
 
 	if (owner != NULL && related_owner != NULL) {
 		PTHREAD_MUTEX_lock(&owner->so_mutex);
@@ -45,13 +45,24 @@
 #define NFS_V4_RECOV_DIR "v4recov"
 #define NFS_V4_OLD_DIR "v4old"
 
-char v4_recov_dir[PATH_MAX];
-char v4_old_dir[PATH_MAX];
+static char v4_recov_dir[PATH_MAX];
+static char v4_old_dir[PATH_MAX];
 time_t current_grace;
 pthread_mutex_t grace_mutex = PTHREAD_MUTEX_INITIALIZER;        /*< Mutex */
 struct glist_head clid_list = GLIST_HEAD_INIT(clid_list);  /*< Clients */
 
+/** How the clients in clid_list are getting on, under grace_mutex */
+static nfs_grace_progress_t reclaim_progress;
+
+static struct nfs4_recovery_backend fs_backend;
+
+/** Where client records are kept, chosen by Recovery_Backend */
+static struct nfs4_recovery_backend *recovery_backend = &fs_backend;
+
 static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp);
+static clid_entry_t *nfs4_find_clid_entry(const char *cl_name);
+static void nfs4_reclaim_start(bool loaded);
+static void nfs4_reclaim_check(void);
 static void nfs_release_nlm_state(char *release_ip);
 static void nfs_release_v4_client(char *ip);
 
@@ -66,6 +77,9 @@ static void nfs_release_v4_client(char *ip);
  */
 void nfs4_start_grace(nfs_grace_start_t *gsp)
 {
+	/* At startup the clients were loaded just before */
+	bool loaded = gsp == NULL;
+
 	if (nfs_param.nfsv4_param.graceless) {
 		LogEvent(COMPONENT_STATE,
 			 "NFS Server skipping GRACE (Graceless is true)");
@@ -106,10 +120,15 @@ void nfs4_start_grace(nfs_grace_start_t *gsp)
 			nfs_release_nlm_state(gsp->ipaddr);
 			if (gsp->event == EVENT_RELEASE_IP)
 				nfs_release_v4_client(gsp->ipaddr);
-			else
+			else {
 				nfs4_load_recov_clids_nolock(gsp);
+				loaded = true;
+			}
 		}
 	}
+
+	nfs4_reclaim_start(loaded);
+
 	PTHREAD_MUTEX_unlock(&grace_mutex);
 }
 
@@ -293,19 +312,15 @@ void nfs4_create_clid_name41(nfs_client_record_t *cl_rec,
 }
 
 /**
- * @brief Create an entry in the recovery directory
+ * @brief Record a client in stable storage
  *
- * This entry alows the client to reclaim state after a server
+ * This record alows the client to reclaim state after a server
  * reboot/restart.
  *
  * @param[in] clientid Client record
  */
 void nfs4_add_clid(nfs_client_id_t *clientid)
 {
-	int err = 0;
-	char path[PATH_MAX] = {0}, segment[NAME_MAX + 1] = {0};
-	int length, position = 0;
-
 	if (clientid->cid_minorversion > 0)
 		nfs4_create_clid_name41(clientid->cid_client_record, clientid);
 
@@ -315,6 +330,51 @@ void nfs4_add_clid(nfs_client_id_t *clientid)
 		return;
 	}
 
+	recovery_backend->add_clid(clientid);
+}
+
+/**
+ * @brief Remove a client's record from stable storage
+ *
+ * This function would be called when a client expires.
+ *
+ * @param[in] clientid Client record
+ */
+void nfs4_rm_clid(nfs_client_id_t *clientid)
+{
+	clid_entry_t *clid_ent;
+
+	if (clientid->cid_recov_dir == NULL)
+		return;
+
+	/* A client that goes away during grace has nothing left to
+	 * reclaim.
+	 */
+	PTHREAD_MUTEX_lock(&grace_mutex);
+	if (reclaim_progress.early_exit && nfs_in_grace()) {
+		clid_ent = nfs4_find_clid_entry(clientid->cid_recov_dir);
+		if (clid_ent != NULL && !clid_ent->cl_done) {
+			clid_ent->cl_done = true;
+			reclaim_progress.expired++;
+			nfs4_reclaim_check();
+		}
+	}
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+
+	recovery_backend->rm_clid(clientid);
+}
+
+/**
+ * @brief Create an entry in the recovery directory
+ *
+ * @param[in] clientid Client record, with its name
+ */
+static void fs_add_clid(nfs_client_id_t *clientid)
+{
+	int err = 0;
+	char path[PATH_MAX] = {0}, segment[NAME_MAX + 1] = {0};
+	int length, position = 0;
+
 	/* break clientid down if it is greater than max dir name */
 	/* and create a directory hierachy to represent the clientid. */
 	snprintf(path, sizeof(path), "%s", v4_recov_dir);
@@ -358,7 +418,7 @@ void nfs4_add_clid(nfs_client_id_t *clientid)
  * @param[in] path Path of the client-id on the stable storage.
  */
 
-void nfs4_rm_revoked_handles(char *path)
+static void fs_rm_revoked_handles(char *path)
 {
 	DIR *dp;
 	struct dirent *dentp;
@@ -393,11 +453,13 @@ void nfs4_rm_revoked_handles(char *path)
 /**
  * @brief Remove a client entry from the recovery directory
  *
- * This function would be called when a client expires.
- *
- * @param[in] recov_dir Recovery directory
+ * @param[in] recov_dir   Client name
+ * @param[in] parent_path Directory of the part of the name before
+ *                        position
+ * @param[in] position    Start of the rest of the name
  */
-void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
+static void fs_rm_clid_impl(const char *recov_dir, char *parent_path,
+			    int position)
 {
 	int err;
 	char *path;
@@ -413,7 +475,7 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
 		/* We are at the tail directory of the clid,
 		 * remove revoked handles, if any.
 		 */
-		nfs4_rm_revoked_handles(parent_path);
+		fs_rm_revoked_handles(parent_path);
 		return;
 	}
 	segment = gsh_malloc(NAME_MAX+1);
@@ -448,7 +510,7 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
 	/* recursively remove the directory hirerchy which represent the
 	 *clientid
 	 */
-	nfs4_rm_clid(recov_dir, path, position+segment_len);
+	fs_rm_clid_impl(recov_dir, path, position+segment_len);
 
 	err = rmdir(path);
 	if (err == -1) {
@@ -461,6 +523,195 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
 	gsh_free(path);
 }
 
+static void fs_rm_clid(nfs_client_id_t *clientid)
+{
+	fs_rm_clid_impl(clientid->cid_recov_dir, v4_recov_dir, 0);
+}
+
+/**
+ * @brief Find a client in the list of clients allowed to reclaim
+ *
+ * The caller holds grace_mutex.
+ *
+ * @param[in] cl_name Client name, its cid_recov_dir
+ *
+ * @return The entry, or NULL.
+ */
+static clid_entry_t *nfs4_find_clid_entry(const char *cl_name)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
+	glist_for_each(node, &clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		LogDebug(COMPONENT_CLIENTID, "compare %s to %s",
+			 clid_ent->cl_name, cl_name);
+		if (!strncmp(clid_ent->cl_name, cl_name, PATH_MAX))
+			return clid_ent;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Count the clients that may reclaim in a new grace period
+ *
+ * Grace may only end early when it was started with the clients of
+ * the last instance, or of a node taken over, loaded.  It never does
+ * when NLM is being served: we do not know which NLM clients will
+ * come back to reclaim their locks.
+ *
+ * The caller holds grace_mutex.
+ *
+ * @param[in] loaded Whether the clients were just loaded
+ */
+static void nfs4_reclaim_start(bool loaded)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+
+	memset(&reclaim_progress, 0, sizeof(reclaim_progress));
+
+	glist_for_each(node, &clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		clid_ent->cl_returned = false;
+		clid_ent->cl_done = false;
+		reclaim_progress.known++;
+	}
+
+	if (!loaded)
+		return;
+
+	if ((nfs_param.core_param.core_options & CORE_OPTION_NFSV3) &&
+	    nfs_param.core_param.enable_NLM) {
+		LogInfo(COMPONENT_STATE,
+			"NLM clients may reclaim, grace runs its full length");
+		return;
+	}
+
+	reclaim_progress.early_exit = true;
+
+	LogEvent(COMPONENT_STATE,
+		 "%" PRIu32 " clients may reclaim, grace ends once they all have or have expired",
+		 reclaim_progress.known);
+
+	nfs4_reclaim_check();
+}
+
+/**
+ * @brief End grace now if every client that may reclaim is done
+ *
+ * The caller holds grace_mutex.
+ */
+static void nfs4_reclaim_check(void)
+{
+	time_t now = time(NULL);
+	time_t start;
+
+	if (!reclaim_progress.early_exit ||
+	    reclaim_progress.reclaimed + reclaim_progress.expired <
+	    reclaim_progress.known)
+		return;
+
+	reclaim_progress.early_exit = false;
+
+	start = atomic_fetch_time_t(&current_grace);
+	if (start + nfs_param.nfsv4_param.grace_period <= now)
+		return;
+
+	LogEvent(COMPONENT_STATE,
+		 "All %" PRIu32 " clients done (%" PRIu32 " reclaimed, %" PRIu32 " expired), ending grace after %ld seconds",
+		 reclaim_progress.known, reclaim_progress.reclaimed,
+		 reclaim_progress.expired, (long)(now - start));
+
+	/* As though it had started a full grace period ago */
+	atomic_store_time_t(&current_grace,
+			    now - nfs_param.nfsv4_param.grace_period);
+}
+
+/**
+ * @brief Note that a client has finished reclaiming
+ *
+ * Called for RECLAIM_COMPLETE covering all file systems.  NFSv4.0
+ * has no such operation, so a 4.0 client that came back holds grace
+ * open until its record expires.
+ *
+ * @param[in] clientid Client record
+ */
+void nfs4_reclaim_complete(nfs_client_id_t *clientid)
+{
+	clid_entry_t *clid_ent;
+
+	if (clientid->cid_recov_dir == NULL)
+		return;
+
+	PTHREAD_MUTEX_lock(&grace_mutex);
+
+	if (reclaim_progress.early_exit && nfs_in_grace()) {
+		clid_ent = nfs4_find_clid_entry(clientid->cid_recov_dir);
+		if (clid_ent != NULL && !clid_ent->cl_done) {
+			clid_ent->cl_done = true;
+			reclaim_progress.reclaimed++;
+			LogInfo(COMPONENT_STATE,
+				"Reclaim %" PRIu32 " of %" PRIu32 " complete, %" PRIu32 " expired",
+				reclaim_progress.reclaimed,
+				reclaim_progress.known,
+				reclaim_progress.expired);
+			nfs4_reclaim_check();
+		}
+	}
+
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
+/**
+ * @brief Give up on the clients that have not come back
+ *
+ * A client's lease ran out at the latest one lease period after the
+ * restart, so one that has not come back by then has expired.
+ * Called periodically by the reaper.
+ */
+void nfs4_reclaim_expire_absent(void)
+{
+	struct glist_head *node;
+	clid_entry_t *clid_ent;
+	time_t start;
+
+	PTHREAD_MUTEX_lock(&grace_mutex);
+
+	start = atomic_fetch_time_t(&current_grace);
+
+	if (!reclaim_progress.early_exit || !nfs_in_grace() ||
+	    start + nfs_param.nfsv4_param.lease_lifetime > time(NULL)) {
+		PTHREAD_MUTEX_unlock(&grace_mutex);
+		return;
+	}
+
+	glist_for_each(node, &clid_list) {
+		clid_ent = glist_entry(node, clid_entry_t, cl_list);
+		if (clid_ent->cl_returned || clid_ent->cl_done)
+			continue;
+		clid_ent->cl_done = true;
+		reclaim_progress.expired++;
+	}
+
+	nfs4_reclaim_check();
+
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
+/**
+ * @brief Get the reclaim progress of the current grace period
+ *
+ * @param[out] progress Where to copy it
+ */
+void nfs_grace_progress(nfs_grace_progress_t *progress)
+{
+	PTHREAD_MUTEX_lock(&grace_mutex);
+	*progress = reclaim_progress;
+	PTHREAD_MUTEX_unlock(&grace_mutex);
+}
+
 /**
  * @brief Determine whether or not this client may reclaim state
  *
@@ -470,7 +721,6 @@ void nfs4_rm_clid(const char *recov_dir, char *parent_path, int position)
  */
 void  nfs4_chk_clid_impl(nfs_client_id_t *clientid, clid_entry_t **clid_ent_arg)
 {
-	struct glist_head *node;
 	clid_entry_t *clid_ent;
 	*clid_ent_arg = NULL;
 
@@ -478,37 +728,29 @@ void  nfs4_chk_clid_impl(nfs_client_id_t *clientid, clid_entry_t **clid_ent_arg)
 	if (clientid->cid_recov_dir == NULL)
 		return;
 
-	/* If there were no clients at time of restart, we're done */
-	if (glist_empty(&clid_list))
-		return;
-
 	/*
-	 * loop through the list and try to find this client.  if we
-	 * find it, mark it to allow reclaims.  perhaps the client should
-	 * be removed from the list at this point to make the list shorter?
+	 * look for this client in the list.  if we find it, mark it to
+	 * allow reclaims.
 	 */
-	glist_for_each(node, &clid_list) {
-		clid_ent = glist_entry(node, clid_entry_t, cl_list);
-		LogDebug(COMPONENT_CLIENTID, "compare %s to %s",
-			 clid_ent->cl_name, clientid->cid_recov_dir);
-		if (!strncmp(clid_ent->cl_name,
-			     clientid->cid_recov_dir,
-			     PATH_MAX)) {
-			if (isDebug(COMPONENT_CLIENTID)) {
-				char str[LOG_BUFF_LEN];
-				struct display_buffer dspbuf = {
-					sizeof(str), str, str};
-
-				display_client_id_rec(&dspbuf, clientid);
-
-				LogFullDebug(COMPONENT_CLIENTID,
-					     "Allowed to reclaim ClientId %s",
-					     str);
-			}
-			clientid->cid_allow_reclaim = 1;
-			*clid_ent_arg = clid_ent;
-			return;
-		}
+	clid_ent = nfs4_find_clid_entry(clientid->cid_recov_dir);
+	if (clid_ent == NULL)
+		return;
+
+	if (isDebug(COMPONENT_CLIENTID)) {
+		char str[LOG_BUFF_LEN];
+		struct display_buffer dspbuf = {sizeof(str), str, str};
+
+		display_client_id_rec(&dspbuf, clientid);
+
+		LogFullDebug(COMPONENT_CLIENTID,
+			     "Allowed to reclaim ClientId %s", str);
+	}
+	clientid->cid_allow_reclaim = 1;
+	*clid_ent_arg = clid_ent;
+
+	if (!clid_ent->cl_returned) {
+		clid_ent->cl_returned = true;
+		reclaim_progress.returned++;
 	}
 }
 
@@ -524,6 +766,88 @@ void  nfs4_chk_clid(nfs_client_id_t *clientid)
 	PTHREAD_MUTEX_unlock(&grace_mutex);
 }
 
+/**
+ * @brief Add a client to the list of clients allowed to reclaim
+ *
+ * The caller holds grace_mutex, or is starting up.
+ *
+ * @param[in] cl_name Client name
+ *
+ * @return The new entry, or NULL.
+ */
+clid_entry_t *nfs4_add_clid_entry(char *cl_name)
+{
+	clid_entry_t *new_ent = gsh_malloc(sizeof(clid_entry_t));
+
+	if (new_ent == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		return NULL;
+	}
+
+	glist_init(&new_ent->cl_rfh_list);
+	new_ent->cl_returned = false;
+	new_ent->cl_done = false;
+	strlcpy(new_ent->cl_name, cl_name, sizeof(new_ent->cl_name));
+	glist_add(&clid_list, &new_ent->cl_list);
+	LogDebug(COMPONENT_CLIENTID, "added %s to clid list",
+		 new_ent->cl_name);
+
+	return new_ent;
+}
+
+/**
+ * @brief Add a revoked handle to a client allowed to reclaim
+ *
+ * @param[in] clid_ent   Client entry
+ * @param[in] rfh_handle base64url encoded handle
+ *
+ * @return The new entry, or NULL.
+ */
+rdel_fh_t *nfs4_add_rfh_entry(clid_entry_t *clid_ent, char *rfh_handle)
+{
+	rdel_fh_t *new_ent = gsh_malloc(sizeof(rdel_fh_t));
+
+	if (new_ent == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Alloc Failed: rdel_fh_t");
+		return NULL;
+	}
+
+	new_ent->rdfh_handle_str = gsh_strdup(rfh_handle);
+	if (new_ent->rdfh_handle_str == NULL) {
+		gsh_free(new_ent);
+		LogEvent(COMPONENT_CLIENTID,
+			"Alloc Failed: rdel_fh_t->rdfh_handle_str");
+		return NULL;
+	}
+	glist_add(&clid_ent->cl_rfh_list, &new_ent->rdfh_list);
+	LogFullDebug(COMPONENT_CLIENTID, "revoked handle: %s",
+		     new_ent->rdfh_handle_str);
+
+	return new_ent;
+}
+
+/**
+ * @brief Empty the list of clients allowed to reclaim
+ */
+static void nfs4_free_clid_list(void)
+{
+	clid_entry_t *clid_ent;
+	rdel_fh_t *rfh_ent;
+
+	while ((clid_ent = glist_first_entry(&clid_list, clid_entry_t,
+					     cl_list)) != NULL) {
+		while ((rfh_ent = glist_first_entry(&clid_ent->cl_rfh_list,
+						    rdel_fh_t,
+						    rdfh_list)) != NULL) {
+			glist_del(&rfh_ent->rdfh_list);
+			gsh_free(rfh_ent->rdfh_handle_str);
+			gsh_free(rfh_ent);
+		}
+		glist_del(&clid_ent->cl_list);
+		gsh_free(clid_ent);
+	}
+}
+
 static void free_heap(char *path, char *new_path, char *build_clid)
 {
 	if (path)
@@ -550,16 +874,14 @@ static void free_heap(char *path, char *new_path, char *build_clid)
  * @param[in] del Delete after populating
  */
 
-void nfs4_cp_pop_revoked_delegs(clid_entry_t *clid_ent,
+static void fs_cp_pop_revoked_delegs(clid_entry_t *clid_ent,
 				char *path,
 				char *tgtdir,
 				bool del)
 {
 	struct dirent *dentp;
 	DIR *dp;
-	rdel_fh_t *new_ent;
 
-	glist_init(&clid_ent->cl_rfh_list);
 	/* Read the contents from recov dir of this clientid. */
 	dp = opendir(path);
 	if (dp == NULL) {
@@ -596,24 +918,9 @@ void nfs4_cp_pop_revoked_delegs(clid_entry_t *clid_ent,
 			}
 		}
 
-		new_ent = gsh_malloc(sizeof(rdel_fh_t));
-		if (new_ent == NULL) {
-			LogEvent(COMPONENT_CLIENTID, "Alloc Failed: rdel_fh_t");
-			continue;
-		}
-
 		/* Ignore the beginning \x1 and copy the rest (file handle) */
-		new_ent->rdfh_handle_str = gsh_strdup(dentp->d_name+1);
-		if (new_ent->rdfh_handle_str == NULL) {
-			gsh_free(new_ent);
-			LogEvent(COMPONENT_CLIENTID,
-				"Alloc Failed: rdel_fh_t->rdfh_handle_str");
+		if (nfs4_add_rfh_entry(clid_ent, dentp->d_name+1) == NULL)
 			continue;
-		}
-		glist_add(&clid_ent->cl_rfh_list, &new_ent->rdfh_list);
-		LogFullDebug(COMPONENT_CLIENTID,
-			"revoked handle: %s",
-			new_ent->rdfh_handle_str);
 
 		/* Since the handle is loaded into memory, go ahead and
 		 * delete it from the stable storage.
@@ -654,7 +961,7 @@ void nfs4_cp_pop_revoked_delegs(clid_entry_t *clid_ent,
  *
  * @return POSIX error codes.
  */
-static int nfs4_read_recov_clids(DIR *dp,
+static int fs_read_recov_clids_impl(DIR *dp,
 				 const char *parent_path,
 				 char *clid_str,
 				 char *tgtdir,
@@ -765,13 +1072,13 @@ static int nfs4_read_recov_clids(DIR *dp,
 		}
 
 		if (tgtdir)
-			rc = nfs4_read_recov_clids(subdp,
+			rc = fs_read_recov_clids_impl(subdp,
 						   path,
 						   build_clid,
 						   new_path,
 						   takeover);
 		else
-			rc = nfs4_read_recov_clids(subdp,
+			rc = fs_read_recov_clids_impl(subdp,
 						   path,
 						   build_clid,
 						   NULL,
@@ -833,26 +1140,17 @@ static int nfs4_read_recov_clids(DIR *dp,
 			len = strlen(ptr2);
 			if ((len == (cid_len+2)) &&
 			    (ptr2[len-1] == ')')) {
-				new_ent =
-				    gsh_malloc(sizeof(clid_entry_t));
+				new_ent = nfs4_add_clid_entry(build_clid);
 				if (new_ent == NULL) {
-					LogEvent(COMPONENT_CLIENTID,
-						 "Unable to allocate memory.");
 					free_heap(path,
 						  NULL,
 						  build_clid);
 					continue;
 				}
-				nfs4_cp_pop_revoked_delegs(new_ent,
+				fs_cp_pop_revoked_delegs(new_ent,
 							path,
 							tgtdir,
 							!takeover);
-				strcpy(new_ent->cl_name, build_clid);
-				glist_add(&clid_list,
-					  &new_ent->cl_list);
-				LogDebug(COMPONENT_CLIENTID,
-					 "added %s to clid list",
-					 new_ent->cl_name);
 			}
 		}
 		gsh_free(build_clid);
@@ -874,28 +1172,17 @@ static int nfs4_read_recov_clids(DIR *dp,
 }
 
 /**
- * @brief Load clients for recovery, with no lock
+ * @brief Read the clients in the recovery directories
  *
- * @param[in] nodeid Node, on takeover
+ * @param[in] gsp Grace period start information, NULL on startup
  */
-static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
+static void fs_read_recov_clids(nfs_grace_start_t *gsp)
 {
 	DIR *dp;
-	struct clid_entry *clid_entry;
 	int rc;
 	char path[PATH_MAX];
 
-	LogDebug(COMPONENT_STATE, "Load recovery cli %p", gsp);
-
 	if (gsp == NULL) {
-		/* when not doing a takeover, start with an empty list */
-		while ((clid_entry = glist_first_entry(&clid_list,
-						       struct clid_entry,
-						       cl_list)) != NULL) {
-			glist_del(&clid_entry->cl_list);
-			gsh_free(clid_entry);
-		}
-
 		dp = opendir(v4_old_dir);
 		if (dp == NULL) {
 			LogEvent(COMPONENT_CLIENTID,
@@ -903,7 +1190,7 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 				 v4_old_dir, errno);
 			return;
 		}
-		rc = nfs4_read_recov_clids(dp, v4_old_dir, NULL, NULL, 0);
+		rc = fs_read_recov_clids_impl(dp, v4_old_dir, NULL, NULL, 0);
 		if (rc == -1) {
 			(void)closedir(dp);
 			LogEvent(COMPONENT_CLIENTID,
@@ -921,8 +1208,8 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 			return;
 		}
 
-		rc = nfs4_read_recov_clids(dp, v4_recov_dir,
-					   NULL, v4_old_dir, 0);
+		rc = fs_read_recov_clids_impl(dp, v4_recov_dir,
+					      NULL, v4_old_dir, 0);
 		if (rc == -1) {
 			(void)closedir(dp);
 			LogEvent(COMPONENT_CLIENTID,
@@ -965,7 +1252,7 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 			return;
 		}
 
-		rc = nfs4_read_recov_clids(dp, path, NULL, v4_old_dir, 1);
+		rc = fs_read_recov_clids_impl(dp, path, NULL, v4_old_dir, 1);
 		if (rc == -1) {
 			(void)closedir(dp);
 			LogEvent(COMPONENT_CLIENTID,
@@ -981,6 +1268,22 @@ static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
 	}
 }
 
+/**
+ * @brief Load clients for recovery, with no lock
+ *
+ * @param[in] gsp Grace period start information, NULL on startup
+ */
+static void nfs4_load_recov_clids_nolock(nfs_grace_start_t *gsp)
+{
+	LogDebug(COMPONENT_STATE, "Load recovery cli %p", gsp);
+
+	/* when not doing a takeover, start with an empty list */
+	if (gsp == NULL)
+		nfs4_free_clid_list();
+
+	recovery_backend->read_clids(gsp);
+}
+
 /**
  * @brief Load clients for recovery
  *
@@ -998,7 +1301,7 @@ void nfs4_load_recov_clids(nfs_grace_start_t *gsp)
 /**
  * @brief Clean up recovery directory
  */
-void nfs4_clean_old_recov_dir(char *parent_path)
+static void fs_clean_old_recov_dir(char *parent_path)
 {
 	DIR *dp;
 	struct dirent *dentp;
@@ -1049,7 +1352,7 @@ void nfs4_clean_old_recov_dir(char *parent_path)
 
 		snprintf(path, total_len, "%s/%s", parent_path, dentp->d_name);
 
-		nfs4_clean_old_recov_dir(path);
+		fs_clean_old_recov_dir(path);
 		rc = rmdir(path);
 		if (rc == -1) {
 			LogEvent(COMPONENT_CLIENTID,
@@ -1060,6 +1363,11 @@ void nfs4_clean_old_recov_dir(char *parent_path)
 	(void)closedir(dp);
 }
 
+static void fs_end_grace(void)
+{
+	fs_clean_old_recov_dir(v4_old_dir);
+}
+
 /**
  * @brief Create the recovery directory
  *
@@ -1067,7 +1375,7 @@ void nfs4_clean_old_recov_dir(char *parent_path)
  * should only need to be done once (if at all).  Also, the location
  * of the directory could be configurable.
  */
-void nfs4_create_recov_dir(void)
+static void fs_create_recov_dir(void)
 {
 	int err;
 
@@ -1118,6 +1426,86 @@ void nfs4_create_recov_dir(void)
 	}
 }
 
+/**
+ * @brief Record a revoked filehandle in the client's directory
+ *
+ * @param[in] delr_clid Client record
+ * @param[in] rhdlstr   base64url encoded handle
+ */
+static void fs_add_revoke_fh(nfs_client_id_t *delr_clid, const char *rhdlstr)
+{
+	char path[PATH_MAX] = {0}, segment[NAME_MAX + 1] = {0};
+	int length, position = 0;
+	int fd;
+
+	/* Parse through the clientid directory structure */
+	snprintf(path, sizeof(path), "%s", v4_recov_dir);
+	length = strlen(delr_clid->cid_recov_dir);
+	while (position < length) {
+		int len = strlen(&delr_clid->cid_recov_dir[position]);
+
+		if (len <= NAME_MAX) {
+			strcat(path, "/");
+			strncat(path, &delr_clid->cid_recov_dir[position], len);
+			strcat(path, "/\x1"); /* Prefix 1 to converted fh */
+			strncat(path, rhdlstr, strlen(rhdlstr));
+			fd = creat(path, 0700);
+			if (fd < 0) {
+				LogEvent(COMPONENT_CLIENTID,
+					"Failed to record revoke errno:%d\n",
+					errno);
+			} else {
+				close(fd);
+			}
+			return;
+		}
+		strncpy(segment, &delr_clid->cid_recov_dir[position], NAME_MAX);
+		strcat(path, "/");
+		strncat(path, segment, NAME_MAX);
+		position += NAME_MAX;
+	}
+}
+
+/**
+ * @brief Client records kept in a tree of directories
+ */
+static struct nfs4_recovery_backend fs_backend = {
+	.recovery_init = fs_create_recov_dir,
+	.read_clids = fs_read_recov_clids,
+	.end_grace = fs_end_grace,
+	.add_clid = fs_add_clid,
+	.rm_clid = fs_rm_clid,
+	.add_revoke_fh = fs_add_revoke_fh,
+};
+
+/**
+ * @brief Set up stable storage for client records
+ *
+ * Picks the backend configured by Recovery_Backend and lets it create
+ * whatever it keeps its records in.
+ */
+void nfs4_recovery_init(void)
+{
+	if (nfs_param.nfsv4_param.recovery_backend == RECOVERY_BACKEND_LOG)
+		recovery_backend = &recovery_log_backend;
+	else
+		recovery_backend = &fs_backend;
+
+	recovery_backend->recovery_init();
+}
+
+/**
+ * @brief Drop the records of clients that did not come back
+ *
+ * Called once the grace period is over, when the clients that were
+ * allowed to reclaim have either done so and been recorded again, or
+ * lost their chance.
+ */
+void nfs4_recovery_end_grace(void)
+{
+	recovery_backend->end_grace();
+}
+
 /**
  * @brief Record revoked filehandle under the client.
  *
@@ -1127,9 +1515,6 @@ void nfs4_create_recov_dir(void)
 void nfs4_record_revoke(nfs_client_id_t *delr_clid, nfs_fh4 *delr_handle)
 {
 	char rhdlstr[NAME_MAX];
-	char path[PATH_MAX] = {0}, segment[NAME_MAX + 1] = {0};
-	int length, position = 0;
-	int fd;
 	int retval;
 
 	/* Convert nfs_fh4_val into base64 encoded string */
@@ -1154,34 +1539,9 @@ void nfs4_record_revoke(nfs_client_id_t *delr_clid, nfs_fh4 *delr_handle)
 	}
 	PTHREAD_MUTEX_unlock(&delr_clid->cid_mutex);
 
-	/* Parse through the clientid directory structure */
 	assert(delr_clid->cid_recov_dir != NULL);
 
-	snprintf(path, sizeof(path), "%s", v4_recov_dir);
-	length = strlen(delr_clid->cid_recov_dir);
-	while (position < length) {
-		int len = strlen(&delr_clid->cid_recov_dir[position]);
-
-		if (len <= NAME_MAX) {
-			strcat(path, "/");
-			strncat(path, &delr_clid->cid_recov_dir[position], len);
-			strcat(path, "/\x1"); /* Prefix 1 to converted fh */
-			strncat(path, rhdlstr, strlen(rhdlstr));
-			fd = creat(path, 0700);
-			if (fd < 0) {
-				LogEvent(COMPONENT_CLIENTID,
-					"Failed to record revoke errno:%d\n",
-					errno);
-			} else {
-				close(fd);
-			}
-			return;
-		}
-		strncpy(segment, &delr_clid->cid_recov_dir[position], NAME_MAX);
-		strcat(path, "/");
-		strncat(path, segment, NAME_MAX);
-		position += NAME_MAX;
-	}
+	recovery_backend->add_revoke_fh(delr_clid, rhdlstr);
 }
 
 /**
@@ -0,0 +1,919 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup SAL
+ * @{
+ */
+
+/**
+ * @file nfs4_recovery_log.c
+ * @brief NFSv4 client records in an append-only log
+ *
+ * Rather than a tree of directories, client records are kept as
+ * checksummed records appended to a single file, v4log, and made
+ * durable with one fdatasync shared by every appender waiting at the
+ * time.  Superseded records are dropped by rewriting the file from
+ * memory once they outnumber the live ones.
+ *
+ * At startup the records of the last instance, in v4log and in
+ * v4log.old (what an instance interrupted during its grace period
+ * had not yet cleaned up), are replayed, and the clients that survive
+ * are rewritten compacted into v4log.old, which is removed once the
+ * grace period is over.  v4log then starts again empty.
+ */
+
+#include "config.h"
+#include "log.h"
+#include "nfs_core.h"
+#include "nfs4.h"
+#include "sal_functions.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include "gsh_cksum.h"
+#include "city.h"
+
+#define NFS_V4_LOG "v4log"
+#define NFS_V4_LOG_MAGIC 0x4e344c47	/* "N4LG" */
+#define NFS_V4_LOG_VERSION 1
+
+/** Buckets of the maps of clients */
+#define LOG_MAP_BUCKETS 1024
+
+/** Superseded records a log may hold before it is compacted */
+#define LOG_DEAD_MAX 4096
+
+/**
+ * @brief Head of a log file
+ */
+struct log_file_hdr {
+	uint32_t lh_magic;
+	uint32_t lh_version;
+};
+
+/**
+ * @brief Types of records
+ */
+enum log_rec_type {
+	LOG_REC_ADD = 1,	/*< A client may reclaim */
+	LOG_REC_RM,		/*< A client went away */
+	LOG_REC_REVOKE,		/*< A delegation was revoked */
+};
+
+/**
+ * @brief Head of a record, followed by the name and the data
+ */
+struct log_rec_hdr {
+	uint32_t rl_cksum;	/*< CRC32C of the rest of the record */
+	uint16_t rl_type;	/*< An enum log_rec_type */
+	uint16_t rl_name_len;	/*< Length of the client name */
+	uint32_t rl_data_len;	/*< Length of the revoked handle */
+};
+
+#define LOG_REC_MAX (sizeof(struct log_rec_hdr) + PATH_MAX + NAME_MAX)
+
+/**
+ * @brief A revoked delegation of a client in a map
+ */
+struct log_revoked {
+	struct glist_head lr_link;	/*< Link in the client */
+	char lr_handle[];		/*< base64url encoded handle */
+};
+
+/**
+ * @brief A client in a map
+ */
+struct log_client {
+	struct glist_head lc_link;	/*< Link in the bucket */
+	struct glist_head lc_revoked;	/*< Revoked delegations */
+	uint32_t lc_nrevoked;		/*< Entries in lc_revoked */
+	uint64_t lc_hash;		/*< CityHash64 of the name */
+	char lc_name[];			/*< Client name */
+};
+
+/**
+ * @brief The clients a set of records describes
+ */
+struct log_map {
+	struct glist_head *lm_buckets;
+	uint32_t lm_count;		/*< Clients */
+	uint32_t lm_records;		/*< Records needed to write it */
+};
+
+static char log_path[PATH_MAX];
+static char log_old_path[PATH_MAX];
+
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_cond = PTHREAD_COND_INITIALIZER;
+static int log_fd = -1;			/*< The live log */
+static struct log_map log_live;		/*< Clients in the live log */
+static uint32_t log_dead;		/*< Superseded records in it */
+static uint64_t log_written;		/*< Records appended */
+static uint64_t log_synced;		/*< Records known durable */
+static bool log_syncing;		/*< An fdatasync is under way */
+static bool log_torn;			/*< A failed append or sync left a
+					    log that must be rewritten */
+
+static bool log_map_init(struct log_map *map)
+{
+	int i;
+
+	map->lm_buckets = gsh_malloc(LOG_MAP_BUCKETS *
+				     sizeof(struct glist_head));
+	if (map->lm_buckets == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		return false;
+	}
+
+	for (i = 0; i < LOG_MAP_BUCKETS; i++)
+		glist_init(&map->lm_buckets[i]);
+	map->lm_count = 0;
+	map->lm_records = 0;
+	return true;
+}
+
+static struct log_client *log_map_find(struct log_map *map,
+				       const char *name, size_t len)
+{
+	uint64_t hash = CityHash64(name, len);
+	struct glist_head *bucket = &map->lm_buckets[hash % LOG_MAP_BUCKETS];
+	struct glist_head *glist;
+	struct log_client *lc;
+
+	glist_for_each(glist, bucket) {
+		lc = glist_entry(glist, struct log_client, lc_link);
+		if (lc->lc_hash == hash && strlen(lc->lc_name) == len &&
+		    memcmp(lc->lc_name, name, len) == 0)
+			return lc;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Add a client to a map, unless it is there already
+ *
+ * @return The client, or NULL if out of memory.
+ */
+static struct log_client *log_map_add(struct log_map *map,
+				      const char *name, size_t len)
+{
+	struct log_client *lc = log_map_find(map, name, len);
+
+	if (lc != NULL)
+		return lc;
+
+	lc = gsh_malloc(sizeof(*lc) + len + 1);
+	if (lc == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		return NULL;
+	}
+
+	glist_init(&lc->lc_revoked);
+	lc->lc_nrevoked = 0;
+	lc->lc_hash = CityHash64(name, len);
+	memcpy(lc->lc_name, name, len);
+	lc->lc_name[len] = '\0';
+	glist_add_tail(&map->lm_buckets[lc->lc_hash % LOG_MAP_BUCKETS],
+		       &lc->lc_link);
+	map->lm_count++;
+	map->lm_records++;
+	return lc;
+}
+
+/**
+ * @brief Add a revoked delegation to a client, unless it is there
+ *
+ * @return true if added.
+ */
+static bool log_map_revoke(struct log_map *map, struct log_client *lc,
+			   const char *handle, size_t len)
+{
+	struct glist_head *glist;
+	struct log_revoked *lr;
+
+	glist_for_each(glist, &lc->lc_revoked) {
+		lr = glist_entry(glist, struct log_revoked, lr_link);
+		if (strlen(lr->lr_handle) == len &&
+		    memcmp(lr->lr_handle, handle, len) == 0)
+			return false;
+	}
+
+	lr = gsh_malloc(sizeof(*lr) + len + 1);
+	if (lr == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Alloc Failed: log_revoked");
+		return false;
+	}
+
+	memcpy(lr->lr_handle, handle, len);
+	lr->lr_handle[len] = '\0';
+	glist_add_tail(&lc->lc_revoked, &lr->lr_link);
+	lc->lc_nrevoked++;
+	map->lm_records++;
+	return true;
+}
+
+/**
+ * @brief Take a client out of a map and free it
+ */
+static void log_map_remove(struct log_map *map, struct log_client *lc)
+{
+	struct log_revoked *lr;
+
+	while ((lr = glist_first_entry(&lc->lc_revoked, struct log_revoked,
+				       lr_link)) != NULL) {
+		glist_del(&lr->lr_link);
+		gsh_free(lr);
+	}
+
+	glist_del(&lc->lc_link);
+	map->lm_count--;
+	map->lm_records -= 1 + lc->lc_nrevoked;
+	gsh_free(lc);
+}
+
+static void log_map_destroy(struct log_map *map)
+{
+	struct log_client *lc;
+	int i;
+
+	if (map->lm_buckets == NULL)
+		return;
+
+	for (i = 0; i < LOG_MAP_BUCKETS; i++)
+		while ((lc = glist_first_entry(&map->lm_buckets[i],
+					       struct log_client,
+					       lc_link)) != NULL)
+			log_map_remove(map, lc);
+
+	gsh_free(map->lm_buckets);
+	map->lm_buckets = NULL;
+}
+
+/**
+ * @brief Copy the clients of one map into another
+ */
+static void log_map_merge(struct log_map *dst, struct log_map *src)
+{
+	struct glist_head *glist, *glistr;
+	struct log_client *lc, *nlc;
+	struct log_revoked *lr;
+	int i;
+
+	for (i = 0; i < LOG_MAP_BUCKETS; i++) {
+		glist_for_each(glist, &src->lm_buckets[i]) {
+			lc = glist_entry(glist, struct log_client, lc_link);
+			nlc = log_map_add(dst, lc->lc_name,
+					  strlen(lc->lc_name));
+			if (nlc == NULL)
+				continue;
+			glist_for_each(glistr, &lc->lc_revoked) {
+				lr = glist_entry(glistr, struct log_revoked,
+						 lr_link);
+				(void)log_map_revoke(dst, nlc, lr->lr_handle,
+						     strlen(lr->lr_handle));
+			}
+		}
+	}
+}
+
+/**
+ * @brief Put the clients of a map on the list allowed to reclaim
+ */
+static void log_map_publish(struct log_map *map)
+{
+	struct glist_head *glist, *glistr;
+	struct log_client *lc;
+	struct log_revoked *lr;
+	clid_entry_t *clid_ent;
+	int i;
+
+	for (i = 0; i < LOG_MAP_BUCKETS; i++) {
+		glist_for_each(glist, &map->lm_buckets[i]) {
+			lc = glist_entry(glist, struct log_client, lc_link);
+			clid_ent = nfs4_add_clid_entry(lc->lc_name);
+			if (clid_ent == NULL)
+				continue;
+			glist_for_each(glistr, &lc->lc_revoked) {
+				lr = glist_entry(glistr, struct log_revoked,
+						 lr_link);
+				(void)nfs4_add_rfh_entry(clid_ent,
+							 lr->lr_handle);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Lay out a record in a buffer of LOG_REC_MAX bytes
+ *
+ * @return Length of the record.
+ */
+static size_t log_encode(char *buf, enum log_rec_type type,
+			 const char *name, const char *data)
+{
+	struct log_rec_hdr hdr;
+	size_t name_len = strlen(name);
+	size_t data_len = data != NULL ? strlen(data) : 0;
+	size_t len = sizeof(hdr) + name_len + data_len;
+
+	hdr.rl_cksum = 0;
+	hdr.rl_type = type;
+	hdr.rl_name_len = name_len;
+	hdr.rl_data_len = data_len;
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + sizeof(hdr), name, name_len);
+	if (data_len != 0)
+		memcpy(buf + sizeof(hdr) + name_len, data, data_len);
+	hdr.rl_cksum = gsh_crc32c(0, buf + sizeof(hdr.rl_cksum),
+				  len - sizeof(hdr.rl_cksum));
+	memcpy(buf, &hdr.rl_cksum, sizeof(hdr.rl_cksum));
+	return len;
+}
+
+/**
+ * @brief Apply a record to a map
+ *
+ * @return true if the record still describes the map afterwards.
+ */
+static bool log_apply(struct log_map *map, enum log_rec_type type,
+		      const char *name, size_t name_len,
+		      const char *data, size_t data_len)
+{
+	struct log_client *lc;
+
+	switch (type) {
+	case LOG_REC_ADD:
+		if (log_map_find(map, name, name_len) != NULL)
+			return false;
+		return log_map_add(map, name, name_len) != NULL;
+
+	case LOG_REC_RM:
+		lc = log_map_find(map, name, name_len);
+		if (lc != NULL)
+			log_map_remove(map, lc);
+		return false;
+
+	case LOG_REC_REVOKE:
+		lc = log_map_find(map, name, name_len);
+		if (lc == NULL)
+			return false;
+		return log_map_revoke(map, lc, data, data_len);
+	}
+
+	return false;
+}
+
+/**
+ * @brief Replay a log file into a map
+ *
+ * A missing file is empty.  Replay stops at the first record that is
+ * short or fails its checksum, which is where a crash interrupted an
+ * append.
+ *
+ * @param[in]     path Log file
+ * @param[in,out] map  Map the records are applied to
+ */
+static void log_replay(const char *path, struct log_map *map)
+{
+	struct log_file_hdr fhdr;
+	struct log_rec_hdr hdr;
+	struct stat st;
+	char *buf, *name;
+	size_t size, pos, len, rec_len;
+	ssize_t n;
+	int fd, records = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno != ENOENT)
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to open v4 recovery log (%s), errno=%d",
+				 path, errno);
+		return;
+	}
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(fhdr)) {
+		close(fd);
+		return;
+	}
+
+	size = st.st_size;
+	buf = gsh_malloc(size);
+	if (buf == NULL) {
+		LogEvent(COMPONENT_CLIENTID, "Unable to allocate memory.");
+		close(fd);
+		return;
+	}
+
+	for (len = 0; len < size; len += n) {
+		n = read(fd, buf + len, size - len);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n <= 0)
+			break;
+	}
+	close(fd);
+
+	if (len >= sizeof(fhdr))
+		memcpy(&fhdr, buf, sizeof(fhdr));
+	if (len < sizeof(fhdr) || fhdr.lh_magic != NFS_V4_LOG_MAGIC ||
+	    fhdr.lh_version != NFS_V4_LOG_VERSION) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Ignoring v4 recovery log (%s), bad header", path);
+		gsh_free(buf);
+		return;
+	}
+
+	pos = sizeof(fhdr);
+	while (pos + sizeof(hdr) <= len) {
+		/* Records are packed, so may not be aligned */
+		memcpy(&hdr, buf + pos, sizeof(hdr));
+		rec_len = sizeof(hdr) + hdr.rl_name_len + hdr.rl_data_len;
+		if (hdr.rl_name_len == 0 || hdr.rl_name_len >= PATH_MAX ||
+		    hdr.rl_data_len > NAME_MAX || pos + rec_len > len)
+			break;
+		if (hdr.rl_cksum !=
+		    gsh_crc32c(0, buf + pos + sizeof(hdr.rl_cksum),
+			       rec_len - sizeof(hdr.rl_cksum)))
+			break;
+
+		name = buf + pos + sizeof(hdr);
+		(void)log_apply(map, hdr.rl_type, name, hdr.rl_name_len,
+				name + hdr.rl_name_len, hdr.rl_data_len);
+		records++;
+		pos += rec_len;
+	}
+
+	if (pos != len)
+		LogEvent(COMPONENT_CLIENTID,
+			 "v4 recovery log (%s) torn after %d records, dropped %zu bytes",
+			 path, records, len - pos);
+	else
+		LogDebug(COMPONENT_CLIENTID,
+			 "Replayed %d records of v4 recovery log (%s)",
+			 records, path);
+
+	gsh_free(buf);
+}
+
+static void log_sync_dir(void)
+{
+	int fd = open(NFS_V4_RECOV_ROOT, O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0)
+		return;
+	if (fsync(fd) < 0)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to sync v4 recovery dir (%s), errno=%d",
+			 NFS_V4_RECOV_ROOT, errno);
+	close(fd);
+}
+
+/**
+ * @brief Replace a log file with the records of a map
+ *
+ * The records are written to a temporary file, made durable and
+ * renamed over path, so a crash leaves either log whole.
+ *
+ * @return true on success.
+ */
+static bool log_rewrite(const char *path, struct log_map *map)
+{
+	struct log_file_hdr fhdr = {NFS_V4_LOG_MAGIC, NFS_V4_LOG_VERSION};
+	char tmp_path[PATH_MAX];
+	char rec[LOG_REC_MAX];
+	struct glist_head *glist, *glistr;
+	struct log_client *lc;
+	struct log_revoked *lr;
+	size_t len;
+	FILE *fp;
+	int fd, i;
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0 || (fp = fdopen(fd, "w")) == NULL) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create v4 recovery log (%s), errno=%d",
+			 tmp_path, errno);
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+
+	(void)fwrite(&fhdr, sizeof(fhdr), 1, fp);
+	for (i = 0; i < LOG_MAP_BUCKETS; i++) {
+		glist_for_each(glist, &map->lm_buckets[i]) {
+			lc = glist_entry(glist, struct log_client, lc_link);
+			len = log_encode(rec, LOG_REC_ADD, lc->lc_name, NULL);
+			(void)fwrite(rec, len, 1, fp);
+			glist_for_each(glistr, &lc->lc_revoked) {
+				lr = glist_entry(glistr, struct log_revoked,
+						 lr_link);
+				len = log_encode(rec, LOG_REC_REVOKE,
+						 lc->lc_name, lr->lr_handle);
+				(void)fwrite(rec, len, 1, fp);
+			}
+		}
+	}
+
+	if (fflush(fp) != 0 || ferror(fp) || fsync(fd) < 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to write v4 recovery log (%s), errno=%d",
+			 tmp_path, errno);
+		fclose(fp);
+		(void)unlink(tmp_path);
+		return false;
+	}
+	fclose(fp);
+
+	if (rename(tmp_path, path) < 0) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to rename v4 recovery log (%s), errno=%d",
+			 tmp_path, errno);
+		(void)unlink(tmp_path);
+		return false;
+	}
+
+	log_sync_dir();
+	return true;
+}
+
+/**
+ * @brief Rewrite the live log from memory
+ *
+ * Called with log_mutex held and no fdatasync under way.  Everything
+ * appended so far is in log_live, so is durable once this returns.
+ *
+ * @return true on success.
+ */
+static bool log_compact(void)
+{
+	int fd;
+
+	if (!log_rewrite(log_path, &log_live))
+		return false;
+
+	fd = open(log_path, O_WRONLY | O_APPEND);
+	if (fd < 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to reopen v4 recovery log (%s), errno=%d",
+			log_path, errno);
+		return false;
+	}
+
+	LogDebug(COMPONENT_CLIENTID,
+		 "Compacted v4 recovery log, %u dead records, %u live",
+		 log_dead, log_live.lm_records);
+
+	close(log_fd);
+	log_fd = fd;
+	log_dead = 0;
+	log_synced = log_written;
+	log_torn = false;
+	return true;
+}
+
+/**
+ * @brief Cut a failed append off the end of the live log
+ *
+ * Replay stops at a partial record, so one left behind would hide
+ * every record appended after it.  If the log cannot be truncated
+ * back to where the append started, it is rewritten from log_live,
+ * which the failed record was never applied to.
+ *
+ * Called with log_mutex held.
+ *
+ * @param[in] start Size of the log before the append, or -1 if unknown
+ */
+static void log_untear(off_t start)
+{
+	if (start >= 0 && ftruncate(log_fd, start) == 0) {
+		log_torn = false;
+		return;
+	}
+
+	/* Don't pull the file out from under an fdatasync */
+	while (log_syncing)
+		pthread_cond_wait(&log_cond, &log_mutex);
+	if (!log_compact()) {
+		LogCrit(COMPONENT_CLIENTID,
+			"v4 recovery log must be rewritten, will retry");
+		log_torn = true;
+	}
+}
+
+/**
+ * @brief Append a record to the live log and wait until it is durable
+ *
+ * Appenders that arrive while an fdatasync is under way wait for the
+ * next one, which then covers all of them.  The record is applied to
+ * log_live only once it is written, so a failed append leaves both
+ * the file and log_live as they were.
+ */
+static void log_append(enum log_rec_type type, const char *name,
+		       const char *data)
+{
+	char rec[LOG_REC_MAX];
+	size_t len, off;
+	ssize_t n;
+	uint64_t seq, target;
+	uint32_t before;
+	off_t start;
+	int fd, rc, err;
+
+	if (strlen(name) >= PATH_MAX ||
+	    (data != NULL && strlen(data) > NAME_MAX))
+		return;
+
+	len = log_encode(rec, type, name, data);
+
+	PTHREAD_MUTEX_lock(&log_mutex);
+
+	if (log_fd < 0) {
+		PTHREAD_MUTEX_unlock(&log_mutex);
+		return;
+	}
+
+	if (log_torn) {
+		log_untear(-1);
+		if (log_torn) {
+			PTHREAD_MUTEX_unlock(&log_mutex);
+			return;
+		}
+	}
+
+	/* We are the only writer, so this is where the record goes */
+	start = lseek(log_fd, 0, SEEK_END);
+
+	for (off = 0; off < len; off += n) {
+		n = write(log_fd, rec + off, len - off);
+		if (n < 0 && errno == EINTR) {
+			n = 0;
+			continue;
+		}
+		if (n <= 0) {
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to append to v4 recovery log, errno=%d",
+				 n < 0 ? errno : ENOSPC);
+			if (off != 0)
+				log_untear(start);
+			PTHREAD_MUTEX_unlock(&log_mutex);
+			return;
+		}
+	}
+	seq = ++log_written;
+
+	before = log_live.lm_records;
+	if (!log_apply(&log_live, type, name, strlen(name),
+		       data, data != NULL ? strlen(data) : 0)) {
+		/* The record is dead on arrival, and for a removal so
+		 * is everything it superseded.
+		 */
+		log_dead += 1 + before - log_live.lm_records;
+	}
+
+	while (log_synced < seq) {
+		if (log_torn) {
+			/* The next append rewrites the log */
+			LogCrit(COMPONENT_CLIENTID,
+				"v4 recovery log record for (%s) may not be durable",
+				name);
+			break;
+		}
+
+		if (log_syncing) {
+			pthread_cond_wait(&log_cond, &log_mutex);
+			continue;
+		}
+
+		log_syncing = true;
+		target = log_written;
+		fd = log_fd;
+		PTHREAD_MUTEX_unlock(&log_mutex);
+
+		rc = fdatasync(fd);
+		err = errno;
+
+		PTHREAD_MUTEX_lock(&log_mutex);
+		log_syncing = false;
+		if (rc == 0) {
+			if (log_synced < target)
+				log_synced = target;
+		} else {
+			/* The pages that failed may now be clean, so a
+			 * second fdatasync could succeed without them.
+			 * Rewrite the log from log_live instead.
+			 */
+			LogEvent(COMPONENT_CLIENTID,
+				 "Failed to sync v4 recovery log, errno=%d",
+				 err);
+			if (!log_compact())
+				log_torn = true;
+		}
+		pthread_cond_broadcast(&log_cond);
+	}
+
+	if (log_dead > LOG_DEAD_MAX && log_dead > log_live.lm_records) {
+		/* Don't pull the file out from under an fdatasync */
+		while (log_syncing)
+			pthread_cond_wait(&log_cond, &log_mutex);
+		if (log_dead > LOG_DEAD_MAX)
+			(void)log_compact();
+	}
+
+	PTHREAD_MUTEX_unlock(&log_mutex);
+}
+
+/**
+ * @brief Open the live log
+ */
+static void log_init(void)
+{
+	struct log_file_hdr fhdr = {NFS_V4_LOG_MAGIC, NFS_V4_LOG_VERSION};
+	struct stat st;
+	int err;
+
+	err = mkdir(NFS_V4_RECOV_ROOT, 0755);
+	if (err == -1 && errno != EEXIST) {
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to create v4 recovery dir (%s), errno=%d",
+			 NFS_V4_RECOV_ROOT, errno);
+	}
+
+	if (nfs_param.core_param.clustered) {
+		snprintf(log_path, sizeof(log_path), "%s/%s.node%d",
+			 NFS_V4_RECOV_ROOT, NFS_V4_LOG, g_nodeid);
+		snprintf(log_old_path, sizeof(log_old_path), "%s/%s.node%d.old",
+			 NFS_V4_RECOV_ROOT, NFS_V4_LOG, g_nodeid);
+	} else {
+		snprintf(log_path, sizeof(log_path), "%s/%s",
+			 NFS_V4_RECOV_ROOT, NFS_V4_LOG);
+		snprintf(log_old_path, sizeof(log_old_path), "%s/%s.old",
+			 NFS_V4_RECOV_ROOT, NFS_V4_LOG);
+	}
+
+	if (!log_map_init(&log_live))
+		return;
+
+	log_fd = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+	if (log_fd < 0) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to open v4 recovery log (%s), errno=%d",
+			log_path, errno);
+		return;
+	}
+
+	/* A new log needs its header before anything is appended */
+	if (fstat(log_fd, &st) == 0 && st.st_size == 0 &&
+	    write(log_fd, &fhdr, sizeof(fhdr)) != sizeof(fhdr))
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to write v4 recovery log (%s), errno=%d",
+			log_path, errno);
+}
+
+/**
+ * @brief Start the live log over, empty
+ *
+ * Called at startup once its records are safe in the old log.  If
+ * the log can't be reset in place it is rewritten from log_live,
+ * which is still empty, and failing that on the next append.
+ */
+static void log_restart(void)
+{
+	struct log_file_hdr fhdr = {NFS_V4_LOG_MAGIC, NFS_V4_LOG_VERSION};
+
+	PTHREAD_MUTEX_lock(&log_mutex);
+
+	if (log_fd >= 0 &&
+	    (ftruncate(log_fd, 0) < 0 ||
+	     write(log_fd, &fhdr, sizeof(fhdr)) != sizeof(fhdr) ||
+	     fdatasync(log_fd) < 0)) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Failed to reset v4 recovery log (%s), errno=%d",
+			log_path, errno);
+		if (!log_compact())
+			log_torn = true;
+	}
+
+	PTHREAD_MUTEX_unlock(&log_mutex);
+}
+
+/**
+ * @brief Load clients for recovery from the logs
+ *
+ * @param[in] gsp Grace period start information, NULL on startup
+ */
+static void log_read_clids(nfs_grace_start_t *gsp)
+{
+	struct log_map old, found;
+	char path[PATH_MAX];
+
+	if (!log_map_init(&old))
+		return;
+
+	log_replay(log_old_path, &old);
+
+	if (gsp == NULL) {
+		log_replay(log_path, &old);
+		log_map_publish(&old);
+		/* Keep the live log until the old one has its clients */
+		if (log_rewrite(log_old_path, &old))
+			log_restart();
+		log_map_destroy(&old);
+		return;
+	}
+
+	if (!log_map_init(&found)) {
+		log_map_destroy(&old);
+		return;
+	}
+
+	if (gsp->event == EVENT_UPDATE_CLIENTS) {
+		PTHREAD_MUTEX_lock(&log_mutex);
+		log_map_merge(&found, &log_live);
+		PTHREAD_MUTEX_unlock(&log_mutex);
+		path[0] = '\0';
+	} else if (gsp->event == EVENT_TAKE_IP) {
+		snprintf(path, sizeof(path), "%s/%s/%s",
+			 NFS_V4_RECOV_ROOT, gsp->ipaddr, NFS_V4_LOG);
+	} else if (gsp->event == EVENT_TAKE_NODEID) {
+		snprintf(path, sizeof(path), "%s/%s.node%d",
+			 NFS_V4_RECOV_ROOT, NFS_V4_LOG, gsp->nodeid);
+	} else {
+		goto out;
+	}
+
+	if (path[0] != '\0') {
+		LogEvent(COMPONENT_CLIENTID, "Recovery for nodeid %d log (%s)",
+			 gsp->nodeid, path);
+		log_replay(path, &found);
+	}
+
+	log_map_publish(&found);
+	log_map_merge(&old, &found);
+	(void)log_rewrite(log_old_path, &old);
+
+out:
+	log_map_destroy(&found);
+	log_map_destroy(&old);
+}
+
+static void log_end_grace(void)
+{
+	if (unlink(log_old_path) < 0 && errno != ENOENT)
+		LogEvent(COMPONENT_CLIENTID,
+			 "Failed to remove old v4 recovery log (%s), errno=%d",
+			 log_old_path, errno);
+}
+
+static void log_add_clid(nfs_client_id_t *clientid)
+{
+	log_append(LOG_REC_ADD, clientid->cid_recov_dir, NULL);
+}
+
+static void log_rm_clid(nfs_client_id_t *clientid)
+{
+	log_append(LOG_REC_RM, clientid->cid_recov_dir, NULL);
+}
+
+static void log_add_revoke_fh(nfs_client_id_t *clientid, const char *rhdlstr)
+{
+	log_append(LOG_REC_REVOKE, clientid->cid_recov_dir, rhdlstr);
+}
+
+/**
+ * @brief Client records kept in an append-only log
+ */
+struct nfs4_recovery_backend recovery_log_backend = {
+	.recovery_init = log_init,
+	.read_clids = log_read_clids,
+	.end_grace = log_end_grace,
+	.add_clid = log_add_clid,
+	.rm_clid = log_rm_clid,
+	.add_revoke_fh = log_add_revoke_fh,
+};
+
+/** @} */
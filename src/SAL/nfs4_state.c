@@ -149,9 +149,15 @@ state_status_t state_add_impl(cache_entry_t *entry, enum state_type state_type,
 
 	mutex_init = true;
 
-	/* Add the stateid.other, this will increment cid_stateid_counter */
-	nfs4_BuildStateId_Other(owner_input->so_owner.so_nfs4_owner.
-				so_clientrec, pnew_state->stateid_other);
+	/* Add the stateid.other, this will allocate a stateid slot */
+	if (!nfs4_BuildStateId_Other(owner_input->so_owner.so_nfs4_owner.
+				     so_clientrec, pnew_state->stateid_other)) {
+		LogCrit(COMPONENT_STATE,
+			"Can't allocate a stateid slot for the entry %p",
+			entry);
+		status = STATE_MALLOC_ERROR;
+		goto errout;
+	}
 
 	/* Set the type and data for this state */
 	memcpy(&(pnew_state->state_data), state_data, sizeof(*state_data));
@@ -243,7 +249,7 @@ state_status_t state_add_impl(cache_entry_t *entry, enum state_type state_type,
 
 	if (pnew_state->state_type == STATE_TYPE_DELEG &&
 	    pnew_state->state_data.deleg.sd_type == OPEN_DELEGATE_WRITE)
-		entry->object.file.write_delegated = true;
+		entry->object.file->write_delegated = true;
 
 	/* Copy the result */
 	*state = pnew_state;
@@ -398,7 +404,7 @@ void state_del_locked(state_t *state)
 	/* Reset write delegated if this is a write delegation */
 	if (state->state_type == STATE_TYPE_DELEG &&
 	    state->state_data.deleg.sd_type == OPEN_DELEGATE_WRITE)
-		entry->object.file.write_delegated = false;
+		entry->object.file->write_delegated = false;
 
 	/* Remove from list of states for a particular export.
 	 * In this case, it is safe to look at state_export without yet
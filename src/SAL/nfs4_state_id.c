@@ -60,6 +60,7 @@
 #include "nfs_file_handle.h"
 #include "sal_functions.h"
 #include "nfs_proto_tools.h"
+#include "epoch_reclaim.h"
 
 /**
  * @brief Hash table for stateids.
@@ -67,6 +68,44 @@
 hash_table_t *ht_state_id;
 hash_table_t *ht_state_entry;
 
+/**
+ * @brief Slab of stateid slots
+ *
+ * The last four bytes of a stateid other, after the clientid, are a
+ * slot index in the low STATE_SLOT_BITS and the slot's generation
+ * above them.  A stateid is looked up by indexing the slab and
+ * comparing the generation and the whole other, under an epoch guard
+ * so the state cannot be freed underneath the lookup; the hash table
+ * is then only kept for enumeration and cleanup.
+ *
+ * Chunks of slots are allocated as needed and never freed, so a
+ * reader may index them without a lock.  Free slots are reused in
+ * FIFO order and bump their generation, so a stale stateid only
+ * matches again once its slot has come round STATE_GEN_MASK + 1
+ * times, and even then only if it is of the same client.
+ */
+#define STATE_SLOT_BITS 22
+#define STATE_SLOT_MASK ((1U << STATE_SLOT_BITS) - 1)
+#define STATE_GEN_MASK ((1U << (32 - STATE_SLOT_BITS)) - 1)
+#define STATE_SLOT_NONE UINT32_MAX
+
+#define STATE_SLAB_CHUNK_BITS 12
+#define STATE_SLAB_CHUNK_SIZE (1U << STATE_SLAB_CHUNK_BITS)
+#define STATE_SLAB_CHUNK_MASK (STATE_SLAB_CHUNK_SIZE - 1)
+#define STATE_SLAB_CHUNKS (1U << (STATE_SLOT_BITS - STATE_SLAB_CHUNK_BITS))
+
+struct state_slot {
+	state_t *state;		/*< Published state, NULL if none */
+	uint32_t gen;		/*< Bumped each time the slot is freed */
+	uint32_t next_free;	/*< Next slot on the free list */
+};
+
+static struct state_slot *state_slab[STATE_SLAB_CHUNKS];
+static uint32_t state_slab_nchunks;
+static uint32_t state_slab_free_head = STATE_SLOT_NONE;
+static uint32_t state_slab_free_tail = STATE_SLOT_NONE;
+static pthread_mutex_t state_slab_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * @brief All-zeroes stateid4.other
  */
@@ -89,7 +128,7 @@ char all_ones[OTHERSIZE];
 int display_stateid_other(struct display_buffer *dspbuf, char *other)
 {
 	uint64_t clientid = *((uint64_t *) other);
-	uint32_t count    = *((uint32_t *) (other + sizeof(uint64_t)));
+	uint32_t slot     = *((uint32_t *) (other + sizeof(uint64_t)));
 	int b_left = display_cat(dspbuf, "OTHER=");
 
 	if (b_left <= 0)
@@ -110,7 +149,8 @@ int display_stateid_other(struct display_buffer *dspbuf, char *other)
 	if (b_left <= 0)
 		return b_left;
 
-	return display_printf(dspbuf, "} StateIdCounter=0x%08"PRIx32"}", count);
+	return display_printf(dspbuf, "} Slot=%"PRIu32" Gen=%"PRIu32"}",
+			      slot & STATE_SLOT_MASK, slot >> STATE_SLOT_BITS);
 }
 
 /**
@@ -457,17 +497,196 @@ int nfs4_Init_state_id(void)
 	return 0;
 }
 
+/**
+ * @brief Find a slot of the slab
+ *
+ * @param[in] idx Slot index
+ *
+ * @return The slot, or NULL if its chunk was never allocated.
+ */
+static inline struct state_slot *state_slot_of(uint32_t idx)
+{
+	struct state_slot *chunk;
+
+	chunk = atomic_fetch_voidptr((void **)
+			&state_slab[(idx & STATE_SLOT_MASK) >>
+				    STATE_SLAB_CHUNK_BITS]);
+
+	if (chunk == NULL)
+		return NULL;
+
+	return &chunk[idx & STATE_SLAB_CHUNK_MASK];
+}
+
+/**
+ * @brief Take a slot off the free list
+ *
+ * @param[out] word Slot index and generation, as put in the stateid
+ *
+ * @retval true if a slot was found.
+ * @retval false if the slab is full or out of memory.
+ */
+static bool state_slot_alloc(uint32_t *word)
+{
+	struct state_slot *chunk, *slot;
+	uint32_t base, i, idx;
+
+	PTHREAD_MUTEX_lock(&state_slab_mutex);
+
+	if (state_slab_free_head == STATE_SLOT_NONE) {
+		if (state_slab_nchunks == STATE_SLAB_CHUNKS) {
+			PTHREAD_MUTEX_unlock(&state_slab_mutex);
+			LogCrit(COMPONENT_STATE,
+				"All %u stateid slots are in use",
+				STATE_SLOT_MASK + 1);
+			return false;
+		}
+
+		chunk = gsh_calloc(STATE_SLAB_CHUNK_SIZE, sizeof(*chunk));
+
+		if (chunk == NULL) {
+			PTHREAD_MUTEX_unlock(&state_slab_mutex);
+			return false;
+		}
+
+		base = state_slab_nchunks << STATE_SLAB_CHUNK_BITS;
+
+		for (i = 0; i < STATE_SLAB_CHUNK_SIZE - 1; i++)
+			chunk[i].next_free = base + i + 1;
+		chunk[i].next_free = STATE_SLOT_NONE;
+
+		atomic_store_voidptr((void **)&state_slab[state_slab_nchunks],
+				     chunk);
+		state_slab_nchunks++;
+
+		state_slab_free_head = base;
+		state_slab_free_tail = base + i;
+	}
+
+	idx = state_slab_free_head;
+	slot = state_slot_of(idx);
+
+	state_slab_free_head = slot->next_free;
+	if (state_slab_free_head == STATE_SLOT_NONE)
+		state_slab_free_tail = STATE_SLOT_NONE;
+
+	*word = (slot->gen << STATE_SLOT_BITS) | idx;
+
+	PTHREAD_MUTEX_unlock(&state_slab_mutex);
+
+	return true;
+}
+
+/**
+ * @brief Return the slot of a stateid to the free list
+ *
+ * Unpublishes the state, if it was, and retires the generation so
+ * the stateid no longer matches.
+ *
+ * @param[in] other stateid4.other
+ */
+static void state_slot_free(char *other)
+{
+	struct state_slot *slot;
+	uint32_t word, idx;
+
+	memcpy(&word, other + sizeof(clientid4), sizeof(word));
+	idx = word & STATE_SLOT_MASK;
+	slot = state_slot_of(idx);
+
+	PTHREAD_MUTEX_lock(&state_slab_mutex);
+
+	atomic_store_voidptr((void **)&slot->state, NULL);
+	atomic_store_uint32_t(&slot->gen, (slot->gen + 1) & STATE_GEN_MASK);
+
+	slot->next_free = STATE_SLOT_NONE;
+	if (state_slab_free_tail == STATE_SLOT_NONE)
+		state_slab_free_head = idx;
+	else
+		state_slot_of(state_slab_free_tail)->next_free = idx;
+	state_slab_free_tail = idx;
+
+	PTHREAD_MUTEX_unlock(&state_slab_mutex);
+}
+
+/**
+ * @brief Make a state reachable through the slot of its stateid
+ *
+ * @param[in] state The state, already in the hash table
+ */
+static void state_slot_publish(state_t *state)
+{
+	uint32_t word;
+
+	memcpy(&word, state->stateid_other + sizeof(clientid4), sizeof(word));
+	atomic_store_voidptr((void **)&state_slot_of(word)->state, state);
+}
+
+/**
+ * @brief Look a stateid up in the slab
+ *
+ * @param[in] other stateid4.other
+ *
+ * @return The state with a reference, or NULL.
+ */
+static state_t *state_slot_get(char *other)
+{
+	struct state_slot *slot;
+	state_t *state;
+	uint32_t word;
+
+	memcpy(&word, other + sizeof(clientid4), sizeof(word));
+	slot = state_slot_of(word);
+
+	if (slot == NULL)
+		return NULL;
+
+	epoch_enter();
+
+	if (atomic_fetch_uint32_t(&slot->gen) != word >> STATE_SLOT_BITS) {
+		epoch_exit();
+		return NULL;
+	}
+
+	state = atomic_fetch_voidptr((void **)&slot->state);
+
+	if (state == NULL ||
+	    memcmp(state->stateid_other, other, OTHERSIZE) != 0 ||
+	    !inc_state_t_ref_live(state)) {
+		epoch_exit();
+		return NULL;
+	}
+
+	/* Still published, so it was live when referenced */
+	if (atomic_fetch_voidptr((void **)&slot->state) != state) {
+		epoch_exit();
+		dec_nfs4_state_ref(state);
+		return NULL;
+	}
+
+	epoch_exit();
+
+	return state;
+}
+
 /**
  * @brief Build the 12 byte "other" portion of a stateid
  *
- * It is built from the ServerEpoch and a 64 bit global counter.
+ * It is built from the clientid, which carries the ServerEpoch, and
+ * a newly allocated slot of the stateid slab.
+ *
+ * @param[in]  clientid Client the state belongs to
+ * @param[out] other    stateid.other object (a char[OTHERSIZE] string)
  *
- * @param[in] other stateid.other object (a char[OTHERSIZE] string)
+ * @retval true if the stateid was built.
+ * @retval false if no slot could be allocated.
  */
-void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
+bool nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
 {
-	uint32_t my_stateid =
-	    atomic_inc_uint32_t(&clientid->cid_stateid_counter);
+	uint32_t my_stateid;
+
+	if (!state_slot_alloc(&my_stateid))
+		return false;
 
 	/* The first part of the other is the 64 bit clientid, which
 	 * consists of the epoch in the high order 32 bits followed by
@@ -477,6 +696,20 @@ void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
 
 	memcpy(other + sizeof(clientid->cid_clientid), &my_stateid,
 	       sizeof(my_stateid));
+
+	return true;
+}
+
+/**
+ * @brief Free a state after a grace period
+ *
+ * A lookup in the slab may still be looking at it.
+ *
+ * @param[in] arg The state_t
+ */
+static void nfs4_state_free(void *arg)
+{
+	pool_free(state_v4_pool, arg);
 }
 
 /**
@@ -509,7 +742,7 @@ void dec_nfs4_state_ref(struct state_t *state)
 
 	PTHREAD_MUTEX_destroy(&state->state_mutex);
 
-	pool_free(state_v4_pool, state);
+	epoch_defer(nfs4_state_free, state);
 
 	if (str_valid)
 		LogFullDebug(COMPONENT_STATE, "Deleted %s", str);
@@ -545,13 +778,16 @@ int nfs4_State_Set(state_t *state)
 		LogCrit(COMPONENT_STATE,
 			"hashtable_test_and_set failed %s for key %p",
 			hash_table_err_to_str(err), buffkey.addr);
+		state_slot_free(state->stateid_other);
 		return 0;
 	}
 
 	/* If stateid is a LOCK or SHARE state, we also index by entry/owner */
 	if (state->state_type != STATE_TYPE_LOCK &&
-	    state->state_type != STATE_TYPE_SHARE)
+	    state->state_type != STATE_TYPE_SHARE) {
+		state_slot_publish(state);
 		return 1;
+	}
 
 	buffkey.addr = state;
 	buffkey.len = sizeof(state_t);
@@ -601,46 +837,30 @@ int nfs4_State_Set(state_t *state)
 				 "Failure to delete stateid %s",
 				 hash_table_err_to_str(err));
 		}
+		state_slot_free(state->stateid_other);
 		return 0;
 	}
 
+	state_slot_publish(state);
 	return 1;
 }
 
 /**
  * @brief Get the state from the stateid
  *
+ * The stateid is looked up in the slab, without taking any lock on
+ * the stateid hash table.
+ *
  * @param[in]  other      stateid4.other
  *
  * @returns The found state_t or NULL if not found.
  */
 struct state_t *nfs4_State_Get_Pointer(char *other)
 {
-	struct gsh_buffdesc buffkey;
-	struct gsh_buffdesc buffval;
-	hash_error_t rc;
-	struct hash_latch latch;
-	struct state_t *state;
-
-	buffkey.addr = other;
-	buffkey.len = OTHERSIZE;
+	struct state_t *state = state_slot_get(other);
 
-	rc = hashtable_getlatch(ht_state_id, &buffkey, &buffval, true, &latch);
-
-	if (rc != HASHTABLE_SUCCESS) {
-		if (rc == HASHTABLE_ERROR_NO_SUCH_KEY)
-			hashtable_releaselatched(ht_state_id, &latch);
-		LogDebug(COMPONENT_STATE, "HashTable_Get returned %d", rc);
-		return NULL;
-	}
-
-	state = buffval.addr;
-
-	/* Take a reference under latch */
-	inc_state_t_ref(state);
-
-	/* Release latch */
-	hashtable_releaselatched(ht_state_id, &latch);
+	if (state == NULL)
+		LogDebug(COMPONENT_STATE, "No state in stateid slot");
 
 	return state;
 }
@@ -727,6 +947,8 @@ bool nfs4_State_Del(state_t *state)
 
 	assert(state == old_value.addr);
 
+	state_slot_free(state->stateid_other);
+
 	/* If stateid is a LOCK or SHARE state, we had also indexed by
 	 * entry/owner
 	 */
@@ -79,8 +79,8 @@ bool state_open_deleg_conflict(cache_entry_t *entry, const state_t *open_state)
 		 * the only outstanding OPEN, then we can grant
 		 * write delegation without a conflict.
 		 */
-		if (entry->object.file.share_state.share_access_read == 1 &&
-		    entry->object.file.share_state.share_access_write == 1) {
+		if (entry->object.file->share_state.share_access_read == 1 &&
+		    entry->object.file->share_state.share_access_write == 1) {
 			return false;
 		}
 		break;
@@ -89,8 +89,8 @@ bool state_open_deleg_conflict(cache_entry_t *entry, const state_t *open_state)
 		 * the only outstanding OPEN, then we can grant
 		 * write delegation without a conflict.
 		 */
-		if (entry->object.file.share_state.share_access_read == 0 &&
-		    entry->object.file.share_state.share_access_write == 1) {
+		if (entry->object.file->share_state.share_access_read == 0 &&
+		    entry->object.file->share_state.share_access_write == 1) {
 			return false;
 		}
 		break;
@@ -99,7 +99,7 @@ bool state_open_deleg_conflict(cache_entry_t *entry, const state_t *open_state)
 		 * no write OPEN, then we can grant read delegation
 		 * without a conflict.
 		 */
-		if (entry->object.file.share_state.share_access_write == 0)
+		if (entry->object.file->share_state.share_access_write == 0)
 			return false;
 		break;
 	}
@@ -267,7 +267,7 @@ void update_delegation_stats(cache_entry_t *entry,
 	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
 
 	/* Update delegation stats for file. */
-	struct file_deleg_stats *statistics = &entry->object.file.fdeleg_stats;
+	struct file_deleg_stats *statistics = &entry->object.file->fdeleg_stats;
 
 	statistics->fds_curr_delegations++;
 	statistics->fds_delegation_count++;
@@ -299,7 +299,7 @@ void deleg_heuristics_recall(cache_entry_t *entry,
 {
 	nfs_client_id_t *client = owner->so_owner.so_nfs4_owner.so_clientrec;
 	/* Update delegation stats for file. */
-	struct file_deleg_stats *statistics = &entry->object.file.fdeleg_stats;
+	struct file_deleg_stats *statistics = &entry->object.file->fdeleg_stats;
 
 	statistics->fds_curr_delegations--;
 	statistics->fds_recall_count++;
@@ -308,6 +308,10 @@ void deleg_heuristics_recall(cache_entry_t *entry,
 	dec_grants(client->gsh_client);
 	client->curr_deleg_grants--;
 
+	/* A client that answers its recalls earns back some trust */
+	if (deleg->state_data.deleg.sd_state == DELEG_RECALL_WIP)
+		client->deleg_backoff /= 2;
+
 	/* Update delegation stats for file. */
 	statistics->fds_avg_hold = advance_avg(statistics->fds_avg_hold,
 					   time(NULL)
@@ -334,7 +338,7 @@ bool init_deleg_heuristics(cache_entry_t *entry)
 		return false;
 	}
 
-	statistics = &entry->object.file.fdeleg_stats;
+	statistics = &entry->object.file->fdeleg_stats;
 	statistics->fds_curr_delegations = 0;
 	statistics->fds_deleg_type = OPEN_DELEGATE_NONE;
 	statistics->fds_delegation_count = 0;
@@ -344,6 +348,10 @@ bool init_deleg_heuristics(cache_entry_t *entry)
 	statistics->fds_avg_hold = 0;
 	statistics->fds_num_opens = 0;
 	statistics->fds_first_open = 0;
+	statistics->fds_last_client = 0;
+	statistics->fds_last_shared = 0;
+	statistics->fds_last_write = 0;
+	statistics->fds_backoff = 0;
 
 	return true;
 }
@@ -353,6 +361,104 @@ bool init_deleg_heuristics(cache_entry_t *entry)
  */
 #define RECALL2DELEG_TIME 10
 
+/* Longest a file or a client goes without delegations after recalls */
+#define DELEG_BACKOFF_MAX 600
+
+/* How long an open by a second client, or for write, counts against
+ * delegating a file
+ */
+#define DELEG_HISTORY_TIME 120
+
+/**
+ * @brief Double a backoff, or start over if it was long ago
+ *
+ * @param[in] backoff Current backoff
+ * @param[in] since   Time since the backoff last grew
+ *
+ * @return The new backoff.
+ */
+static time_t deleg_backoff_grow(time_t backoff, time_t since)
+{
+	if (backoff == 0 || since >= 4 * backoff)
+		return RECALL2DELEG_TIME;
+
+	return backoff * 2 < DELEG_BACKOFF_MAX ? backoff * 2
+					       : DELEG_BACKOFF_MAX;
+}
+
+/**
+ * @brief Record an OPEN in the file's access history
+ *
+ * Every OPEN of the file is recorded, delegated or not, so the
+ * grant policy can tell files used by one client, or only read, from
+ * contended ones.
+ *
+ * cache_entry_t state lock must be held in write mode.
+ *
+ * @param[in] entry        File being opened
+ * @param[in] client       Client opening it
+ * @param[in] share_access Access asked for
+ */
+void deleg_heuristics_open(cache_entry_t *entry, nfs_client_id_t *client,
+			   uint32_t share_access)
+{
+	struct file_deleg_stats *statistics = &entry->object.file->fdeleg_stats;
+	time_t now = time(NULL);
+
+	if (statistics->fds_num_opens == 0)
+		statistics->fds_first_open = now;
+	statistics->fds_num_opens++;
+
+	if (statistics->fds_last_client != 0 &&
+	    statistics->fds_last_client != client->cid_clientid)
+		statistics->fds_last_shared = now;
+	statistics->fds_last_client = client->cid_clientid;
+
+	if (share_access & OPEN4_SHARE_ACCESS_WRITE)
+		statistics->fds_last_write = now;
+}
+
+/**
+ * @brief Note that the delegations on a file are being recalled
+ *
+ * The file goes without delegations for a while, twice as long as
+ * the last time if that was recent.  Several delegations recalled at
+ * once count as one recall.
+ *
+ * @param[in] entry File being recalled
+ */
+void deleg_heuristics_recall_start(cache_entry_t *entry)
+{
+	struct file_deleg_stats *statistics = &entry->object.file->fdeleg_stats;
+	time_t now = time(NULL);
+
+	if (statistics->fds_last_recall == now)
+		return;
+
+	statistics->fds_backoff =
+		deleg_backoff_grow(statistics->fds_backoff,
+				   now - statistics->fds_last_recall);
+	statistics->fds_last_recall = now;
+}
+
+/**
+ * @brief Note that a client failed to return a recalled delegation
+ *
+ * The client goes without delegations for a while, growing with each
+ * failure and shrinking with each recall it answers.
+ *
+ * @param[in] client Client that failed
+ */
+void deleg_heuristics_client_failed(nfs_client_id_t *client)
+{
+	time_t now = time(NULL);
+
+	client->deleg_backoff =
+		deleg_backoff_grow(client->deleg_backoff,
+				   now - client->deleg_penalty_time);
+	client->deleg_penalty_time = now;
+}
+
 /**
  * @brief Decide if a delegation should be granted based on heuristics.
  *
@@ -368,9 +474,11 @@ bool should_we_grant_deleg(cache_entry_t *entry, nfs_client_id_t *client,
 			   state_owner_t *owner, bool *prerecall)
 {
 	/* specific file, all clients, stats */
-	struct file_deleg_stats *file_stats = &entry->object.file.fdeleg_stats;
+	struct file_deleg_stats *file_stats = &entry->object.file->fdeleg_stats;
 	/* specific client, all files stats */
 	open_claim_type4 claim = args->claim.claim;
+	time_t now;
+	bool single, readonly;
 
 	LogDebug(COMPONENT_STATE, "Checking if we should grant delegation.");
 
@@ -414,18 +522,50 @@ bool should_we_grant_deleg(cache_entry_t *entry, nfs_client_id_t *client,
 		}
 	}
 
+	now = time(NULL);
+
 	/* If there is a recent recall on this file, the client that made
 	 * the conflicting open may retry the open later. Don't give out
 	 * delegation to avoid starving the client's open that caused
-	 * the recall.
+	 * the recall.  Files recalled again and again wait longer.
 	 */
 	if (file_stats->fds_last_recall != 0 &&
-	    time(NULL) - file_stats->fds_last_recall < RECALL2DELEG_TIME)
+	    now - file_stats->fds_last_recall < file_stats->fds_backoff) {
+		LogDebug(COMPONENT_STATE,
+			 "Not delegating, file recalled %d seconds ago",
+			 (int) (now - file_stats->fds_last_recall));
+		inc_deleg_declined(client->gsh_client, DELEG_DECLINE_FILE);
 		return false;
+	}
 
-	/* Check if this is a misbehaving or unreliable client */
-	if (client->num_revokes > 2) /* more than 2 revokes */
+	/* Check if this is a misbehaving or unreliable client.  It gets
+	 * delegations again once it has gone a while without failing a
+	 * recall.
+	 */
+	if (client->deleg_penalty_time != 0 &&
+	    now - client->deleg_penalty_time < client->deleg_backoff) {
+		LogDebug(COMPONENT_STATE,
+			 "Not delegating, client failed recalls");
+		inc_deleg_declined(client->gsh_client, DELEG_DECLINE_CLIENT);
 		return false;
+	}
+
+	/* A file only this client has used lately can be delegated
+	 * either way; one that others use too only for reading, if it
+	 * has not been written lately.
+	 */
+	single = file_stats->fds_last_shared == 0 ||
+		 now - file_stats->fds_last_shared >= DELEG_HISTORY_TIME;
+	readonly = file_stats->fds_last_write == 0 ||
+		   now - file_stats->fds_last_write >= DELEG_HISTORY_TIME;
+
+	if (!single &&
+	    ((args->share_access & OPEN4_SHARE_ACCESS_WRITE) || !readonly)) {
+		LogDebug(COMPONENT_STATE,
+			 "Not delegating, file shared and written");
+		inc_deleg_declined(client->gsh_client, DELEG_DECLINE_SHARED);
+		return false;
+	}
 
 	LogDebug(COMPONENT_STATE, "Let's delegate!!");
 	return true;
@@ -583,7 +723,7 @@ bool state_deleg_conflict(cache_entry_t *entry, bool write)
 	if (entry->type != REGULAR_FILE)
 		return false;
 
-	deleg_stats = &entry->object.file.fdeleg_stats;
+	deleg_stats = &entry->object.file->fdeleg_stats;
 	if (deleg_stats->fds_curr_delegations > 0
 	    && ((deleg_stats->fds_deleg_type == OPEN_DELEGATE_READ
 		 && write)
@@ -640,7 +780,7 @@ bool can_we_grant_deleg(cache_entry_t *entry, state_t *open_state)
 	/* Can't grant delegation if there is an anonymous operation
 	 * in progress
 	 */
-	if (atomic_fetch_uint32_t(&entry->object.file.anon_ops) != 0) {
+	if (atomic_fetch_uint32_t(&entry->object.file->anon_ops) != 0) {
 		LogFullDebug(COMPONENT_STATE,
 			     "Anonymous op in progress, not granting delegation");
 		return false;
@@ -659,7 +799,7 @@ bool can_we_grant_deleg(cache_entry_t *entry, state_t *open_state)
 	 * with any kind of NLM lock, and NLM write lock would conflict
 	 * with any kind of delegation.
 	 */
-	glist_for_each(glist, &entry->object.file.lock_list) {
+	glist_for_each(glist, &entry->object.file->lock_list) {
 		lock_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 		if (lock_entry->sle_lock.lock_type == FSAL_NO_LOCK)
 			continue; /* no lock, skip */
@@ -51,6 +51,7 @@
 #include "nlm_util.h"
 #include "cache_inode_lru.h"
 #include "export_mgr.h"
+#include "slab_pool.h"
 
 /**
  * @page state_lock_entry_locking state_lock_entry_t locking rule
@@ -129,6 +130,9 @@ static hash_parameter_t cookie_param = {
 
 static hash_table_t *ht_lock_cookies;
 
+/** Pool for lock entries */
+static pool_t *state_lock_pool;
+
 /**
  * @brief Initalize locking
  *
@@ -147,20 +151,30 @@ state_status_t state_lock_init(void)
 
 	status = state_async_init();
 
+	/* Owners, states and lock entries come and go with every
+	 * OPEN/CLOSE and LOCK/LOCKU, so keep freed ones for reuse.
+	 */
 	state_owner_pool = pool_init("NFSv4 state owners",
 				     sizeof(state_owner_t),
-				     pool_basic_substrate,
+				     pool_slab_substrate,
 				     NULL,
 				     NULL,
 				     NULL);
 
 	state_v4_pool = pool_init("NFSv4 files states",
 				  sizeof(state_t),
-				  pool_basic_substrate,
+				  pool_slab_substrate,
 				  NULL,
 				  NULL,
 				  NULL);
 
+	state_lock_pool = pool_init("State lock entries",
+				    sizeof(state_lock_entry_t),
+				    pool_slab_substrate,
+				    NULL,
+				    NULL,
+				    NULL);
+
 	return status;
 }
 
@@ -554,15 +568,13 @@ static state_lock_entry_t *create_state_lock_entry(cache_entry_t *entry,
 {
 	state_lock_entry_t *new_entry;
 
-	new_entry = gsh_malloc(sizeof(*new_entry));
+	new_entry = pool_alloc(state_lock_pool, NULL);
 	if (!new_entry)
 		return NULL;
 
 	LogFullDebug(COMPONENT_STATE, "new_entry = %p owner %p", new_entry,
 		     owner);
 
-	memset(new_entry, 0, sizeof(*new_entry));
-
 	PTHREAD_MUTEX_init(&new_entry->sle_mutex, NULL);
 
 	/* sle_block_data will be filled in later if necessary */
@@ -683,8 +695,154 @@ static void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 
 		put_gsh_export(lock_entry->sle_export);
 		PTHREAD_MUTEX_destroy(&lock_entry->sle_mutex);
-		gsh_free(lock_entry);
+		pool_free(state_lock_pool, lock_entry);
+	}
+}
+
+/**
+ * @brief The lock entry holding an interval tree node
+ */
+#define lock_tree_entry(node) \
+	glist_entry(node, state_lock_entry_t, sle_range)
+
+/**
+ * @brief Add an entry to its file's lock list and indexes
+ *
+ * Every entry on the lock list is also in the file's lock_tree, and
+ * those not granted are on its blocked_locks.
+ *
+ * @param[in,out] lock_entry Entry to add
+ */
+static void lock_entry_link(state_lock_entry_t *lock_entry)
+{
+	struct cache_inode_file *file = lock_entry->sle_entry->object.file;
+
+	glist_add_tail(&file->lock_list, &lock_entry->sle_list);
+
+	lock_entry->sle_range.start = lock_entry->sle_lock.lock_start;
+	lock_entry->sle_range.last = lock_end(&lock_entry->sle_lock);
+	interval_tree_insert(&file->lock_tree, &lock_entry->sle_range);
+
+	if (lock_entry->sle_blocked != STATE_NON_BLOCKING)
+		glist_add_tail(&file->blocked_locks,
+			       &lock_entry->sle_blocked_list);
+
+	if (file->lock_export == NULL)
+		file->lock_export = lock_entry->sle_export;
+	else if (lock_entry->sle_export != file->lock_export)
+		file->lock_foreign++;
+}
+
+/**
+ * @brief Take an entry off whatever list it is on, and its indexes
+ *
+ * @param[in,out] lock_entry Entry to remove
+ */
+static void lock_entry_unlink(state_lock_entry_t *lock_entry)
+{
+	struct cache_inode_file *file = lock_entry->sle_entry->object.file;
+
+	glist_del(&lock_entry->sle_list);
+
+	/* Entries on a private list were never indexed */
+	if (!interval_node_linked(&lock_entry->sle_range))
+		return;
+
+	interval_tree_remove(&file->lock_tree, &lock_entry->sle_range);
+
+	if (lock_entry->sle_blocked != STATE_NON_BLOCKING)
+		glist_del(&lock_entry->sle_blocked_list);
+
+	if (file->lock_tree.count == 0) {
+		file->lock_export = NULL;
+		file->lock_foreign = 0;
+	} else if (lock_entry->sle_export != file->lock_export) {
+		file->lock_foreign--;
+	}
+}
+
+/**
+ * @brief Change the range of a lock entry
+ *
+ * @param[in,out] lock_entry Entry to change
+ * @param[in]     start      New start
+ * @param[in]     length     New length, 0 meaning to the end of file
+ */
+static void lock_entry_set_range(state_lock_entry_t *lock_entry,
+				 uint64_t start, uint64_t length)
+{
+	struct interval_tree *tree =
+		&lock_entry->sle_entry->object.file->lock_tree;
+	bool linked = interval_node_linked(&lock_entry->sle_range);
+
+	if (linked)
+		interval_tree_remove(tree, &lock_entry->sle_range);
+
+	lock_entry->sle_lock.lock_start = start;
+	lock_entry->sle_lock.lock_length = length;
+
+	if (linked) {
+		lock_entry->sle_range.start = start;
+		lock_entry->sle_range.last = lock_end(&lock_entry->sle_lock);
+		interval_tree_insert(tree, &lock_entry->sle_range);
+	}
+}
+
+/**
+ * @brief Change the blocking status of a lock entry
+ *
+ * @param[in,out] lock_entry Entry to change
+ * @param[in]     blocked    New status
+ */
+static void lock_entry_set_blocked(state_lock_entry_t *lock_entry,
+				   state_blocking_t blocked)
+{
+	struct cache_inode_file *file = lock_entry->sle_entry->object.file;
+	bool was_blocked = lock_entry->sle_blocked != STATE_NON_BLOCKING;
+	bool is_blocked = blocked != STATE_NON_BLOCKING;
+
+	if (interval_node_linked(&lock_entry->sle_range)
+	    && was_blocked != is_blocked) {
+		if (is_blocked)
+			glist_add_tail(&file->blocked_locks,
+				       &lock_entry->sle_blocked_list);
+		else
+			glist_del(&lock_entry->sle_blocked_list);
+	}
+
+	lock_entry->sle_blocked = blocked;
+}
+
+/**
+ * @brief Find a lock on a file held by an owner through another export
+ *
+ * @param[in] entry The file to search
+ * @param[in] owner The lock owner
+ *
+ * @return The lock or NULL.
+ */
+static state_lock_entry_t *lock_export_conflict(cache_entry_t *entry,
+						state_owner_t *owner)
+{
+	struct cache_inode_file *file = entry->object.file;
+	struct glist_head *glist;
+	state_lock_entry_t *found_entry;
+
+	/* Every lock is through the export in use */
+	if (file->lock_foreign == 0
+	    && (file->lock_export == NULL
+		|| file->lock_export == op_ctx->export))
+		return NULL;
+
+	glist_for_each(glist, &file->lock_list) {
+		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+
+		if (found_entry->sle_export != op_ctx->export
+		    && !different_owners(found_entry->sle_owner, owner))
+			return found_entry;
 	}
+
+	return NULL;
 }
 
 /**
@@ -740,7 +898,7 @@ static void remove_from_locklist(state_lock_entry_t *lock_entry)
 	}
 
 	lock_entry->sle_owner = NULL;
-	glist_del(&lock_entry->sle_list);
+	lock_entry_unlink(lock_entry);
 	lock_entry_dec_ref(lock_entry);
 }
 
@@ -757,12 +915,13 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 						 state_owner_t *owner,
 						 fsal_lock_param_t *lock)
 {
-	struct glist_head *glist;
+	struct interval_node *node;
 	state_lock_entry_t *found_entry = NULL;
-	uint64_t found_entry_end, range_end = lock_end(lock);
+	uint64_t range_end = lock_end(lock);
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	interval_tree_for_each(node, &entry->object.file->lock_tree,
+			       lock->lock_start, range_end) {
+		found_entry = lock_tree_entry(node);
 
 		LogEntry("Checking", found_entry);
 
@@ -772,21 +931,15 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 		    || found_entry->sle_blocked == STATE_CANCELED)
 			continue;
 
-		found_entry_end = lock_end(&found_entry->sle_lock);
-
-		if ((found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
-			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner, owner)
-			    ) {
-				/* found a conflicting lock, return it */
-				return found_entry;
-			}
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
+		if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
+		     || lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* found a conflicting lock, return it */
+			return found_entry;
 		}
 	}
 
@@ -810,13 +963,26 @@ static void merge_lock_entry(cache_entry_t *entry,
 	state_lock_entry_t *check_entry_right;
 	uint64_t check_entry_end;
 	uint64_t lock_entry_end;
-	struct glist_head *glist;
-	struct glist_head *glistn;
+	uint64_t lock_entry_start;
+	uint64_t lo, hi;
+	struct interval_node *node;
+	struct interval_node *next;
 
 	/* lock_entry might be STATE_NON_BLOCKING or STATE_GRANTING */
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+ again:
+
+	/* Only locks touching or overlapping lock_entry can merge */
+	lo = lock_entry->sle_lock.lock_start;
+	if (lo != 0)
+		lo--;
+	hi = lock_end(&lock_entry->sle_lock);
+	if (hi != UINT64_MAX)
+		hi++;
+
+	interval_tree_for_each_safe(node, next,
+				    &entry->object.file->lock_tree, lo, hi) {
+		check_entry = lock_tree_entry(node);
 
 		/* Skip entry being merged - it could be in the list */
 		if (check_entry == lock_entry)
@@ -833,14 +999,6 @@ static void merge_lock_entry(cache_entry_t *entry,
 		check_entry_end = lock_end(&check_entry->sle_lock);
 		lock_entry_end = lock_end(&lock_entry->sle_lock);
 
-		if ((check_entry_end + 1) < lock_entry->sle_lock.lock_start)
-			/* nothing to merge */
-			continue;
-
-		if ((lock_entry_end + 1) < check_entry->sle_lock.lock_start)
-			/* nothing to merge */
-			continue;
-
 		/* Need to handle locks of different types differently, may
 		 * split an old lock. If new lock totally overlaps old lock,
 		 * the new lock will replace the old lock so no special work
@@ -867,8 +1025,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 						 "Memory allocation failure during lock upgrade/downgrade");
 					continue;
 				}
-				glist_add_tail(&entry->object.file.lock_list,
-					       &(check_entry_right->sle_list));
+				lock_entry_link(check_entry_right);
 			} else {
 				/* No split, just shrink, make the logic below
 				 * work on original lock
@@ -881,10 +1038,10 @@ static void merge_lock_entry(cache_entry_t *entry,
 				 */
 				LogEntry("Merge shrinking right",
 					 check_entry_right);
-				check_entry_right->sle_lock.lock_start =
-				    lock_entry_end + 1;
-				check_entry_right->sle_lock.lock_length =
-				    check_entry_end - lock_entry_end;
+				lock_entry_set_range(check_entry_right,
+						     lock_entry_end + 1,
+						     check_entry_end -
+						     lock_entry_end);
 				LogEntry("Merge shrunk right",
 					 check_entry_right);
 			}
@@ -894,9 +1051,13 @@ static void merge_lock_entry(cache_entry_t *entry,
 				 * (left lock if split)
 				 */
 				LogEntry("Merge shrinking left", check_entry);
-				check_entry->sle_lock.lock_length =
-				    lock_entry->sle_lock.lock_start -
-				    check_entry->sle_lock.lock_start;
+				lock_entry_set_range(check_entry,
+						     check_entry->sle_lock
+						     .lock_start,
+						     lock_entry->sle_lock
+						     .lock_start -
+						     check_entry->sle_lock
+						     .lock_start);
 				LogEntry("Merge shrunk left", check_entry);
 			}
 			/* Done splitting/shrinking old lock */
@@ -910,20 +1071,22 @@ static void merge_lock_entry(cache_entry_t *entry,
 			/* Expand end of lock_entry */
 			lock_entry_end = check_entry_end;
 
-		if (check_entry->sle_lock.lock_start <
-		    lock_entry->sle_lock.lock_start)
+		lock_entry_start = lock_entry->sle_lock.lock_start;
+		if (check_entry->sle_lock.lock_start < lock_entry_start)
 			/* Expand start of lock_entry */
-			lock_entry->sle_lock.lock_start =
-			    check_entry->sle_lock.lock_start;
+			lock_entry_start = check_entry->sle_lock.lock_start;
 
 		/* Compute new lock length */
-		lock_entry->sle_lock.lock_length =
-		    lock_entry_end - lock_entry->sle_lock.lock_start + 1;
+		lock_entry_set_range(lock_entry, lock_entry_start,
+				     lock_entry_end - lock_entry_start + 1);
 
 		/* Remove merged entry */
 		LogEntry("Merged", lock_entry);
 		LogEntry("Merging removing", check_entry);
 		remove_from_locklist(check_entry);
+
+		/* lock_entry has grown, look again over its new range */
+		goto again;
 	}
 }
 
@@ -1038,17 +1201,53 @@ static state_status_t subtract_lock_from_entry(cache_entry_t *entry,
 	/* Remove the lock from the list it's
 	 * on and put it on the remove_list
 	 */
-	glist_del(&found_entry->sle_list);
+	lock_entry_unlink(found_entry);
 	glist_add_tail(remove_list, &(found_entry->sle_list));
 
 	*removed = true;
 	return status;
 }
 
+/**
+ * @brief Whether an unlock applies to a lock entry
+ *
+ * @param[in] found_entry   Lock entry
+ * @param[in] owner         Lock owner, NULL for any
+ * @param[in] state_applies Whether to spare the NLM state below
+ * @param[in] state         NSM state number
+ *
+ * @return true if the entry should be subtracted from.
+ */
+static bool subtract_lock_applies(state_lock_entry_t *found_entry,
+				  state_owner_t *owner,
+				  bool state_applies,
+				  int32_t state)
+{
+	if (owner != NULL
+	    && different_owners(found_entry->sle_owner, owner))
+		return false;
+
+	/* Only care about granted locks */
+	if (found_entry->sle_blocked != STATE_NON_BLOCKING)
+		return false;
+
+	/* Skip locks owned by this NLM state.
+	 * This protects NLM locks from the current iteration of an NLM
+	 * client from being released by SM_NOTIFY.
+	 */
+	if (state_applies &&
+	    found_entry->sle_state->state_seqid == state)
+		return false;
+
+	return true;
+}
+
 /**
  * @brief Subtract a lock from a list of locks
  *
- * This function possibly splits entries in the list.
+ * This function possibly splits entries in the list.  On a file's
+ * own lock list only the entries its lock_tree says overlap the lock
+ * are looked at.
  *
  * @param[in,out] entry   Cache entry on which to operate
  * @param[in]     owner   Lock owner
@@ -1070,51 +1269,62 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 	state_lock_entry_t *found_entry;
 	struct glist_head split_lock_list, remove_list;
 	struct glist_head *glist, *glistn;
+	struct interval_node *node, *next;
 	state_status_t status = STATE_SUCCESS;
 	bool removed_one = false;
+	bool file_list = list == &entry->object.file->lock_list;
 
 	*removed = false;
 
 	glist_init(&split_lock_list);
 	glist_init(&remove_list);
 
-	glist_for_each_safe(glist, glistn, list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	/* We have matched owner. Even though we are taking a reference
+	 * to found_entry, we don't inc the ref count because we want
+	 * to drop the lock entry.
+	 */
+	if (file_list) {
+		interval_tree_for_each_safe(node, next,
+					    &entry->object.file->lock_tree,
+					    lock->lock_start, lock_end(lock)) {
+			found_entry = lock_tree_entry(node);
+
+			if (!subtract_lock_applies(found_entry, owner,
+						   state_applies, state))
+				continue;
 
-		if (owner != NULL
-		    && different_owners(found_entry->sle_owner, owner))
-			continue;
+			status = subtract_lock_from_entry(entry,
+							  found_entry,
+							  lock,
+							  &split_lock_list,
+							  &remove_list,
+							  &removed_one);
 
-		/* Only care about granted locks */
-		if (found_entry->sle_blocked != STATE_NON_BLOCKING)
-			continue;
+			*removed |= removed_one;
 
-		/* Skip locks owned by this NLM state.
-		 * This protects NLM locks from the current iteration of an NLM
-		 * client from being released by SM_NOTIFY.
-		 */
-		if (state_applies &&
-		    found_entry->sle_state->state_seqid == state)
-			continue;
+			if (status != STATE_SUCCESS)
+				break;
+		}
+	} else {
+		glist_for_each_safe(glist, glistn, list) {
+			found_entry = glist_entry(glist, state_lock_entry_t,
+						  sle_list);
 
-		/* We have matched owner. Even though we are taking a reference
-		 * to found_entry, we don't inc the ref count because we want
-		 * to drop the lock entry.
-		 */
-		status = subtract_lock_from_entry(entry,
-						  found_entry,
-						  lock,
-						  &split_lock_list,
-						  &remove_list,
-						  &removed_one);
-
-		*removed |= removed_one;
-
-		if (status != STATE_SUCCESS) {
-			/* We ran out of memory while splitting,
-			 * deal with it outside loop
-			 */
-			break;
+			if (!subtract_lock_applies(found_entry, owner,
+						   state_applies, state))
+				continue;
+
+			status = subtract_lock_from_entry(entry,
+							  found_entry,
+							  lock,
+							  &split_lock_list,
+							  &remove_list,
+							  &removed_one);
+
+			*removed |= removed_one;
+
+			if (status != STATE_SUCCESS)
+				break;
 		}
 	}
 
@@ -1128,14 +1338,27 @@ static state_status_t subtract_lock_from_list(cache_entry_t *entry,
 			found_entry =
 			    glist_entry(glist, state_lock_entry_t, sle_list);
 			glist_del(&found_entry->sle_list);
-			glist_add_tail(list, &(found_entry->sle_list));
+			if (file_list)
+				lock_entry_link(found_entry);
+			else
+				glist_add_tail(list, &(found_entry->sle_list));
 		}
 	} else {
 		/* free the enttries on the remove_list */
 		free_list(&remove_list);
 
 		/* now add the split lock list */
-		glist_add_list_tail(list, &split_lock_list);
+		if (file_list) {
+			glist_for_each_safe(glist, glistn, &split_lock_list) {
+				found_entry = glist_entry(glist,
+							  state_lock_entry_t,
+							  sle_list);
+				glist_del(&found_entry->sle_list);
+				lock_entry_link(found_entry);
+			}
+		} else {
+			glist_add_list_tail(list, &split_lock_list);
+		}
 	}
 
 	LogFullDebug(COMPONENT_STATE,
@@ -1187,7 +1410,8 @@ static state_status_t subtract_list_from_list(cache_entry_t *entry,
  *
  ******************************************************************************/
 
-static void grant_blocked_locks(cache_entry_t *entry);
+static void grant_blocked_locks(cache_entry_t *entry, uint64_t lo,
+				uint64_t hi);
 
 /**
  * @brief Display lock cookie in hash table
@@ -1699,7 +1923,7 @@ void grant_blocked_lock_immediate(cache_entry_t *entry,
 	}
 
 	/* Mark lock as granted */
-	lock_entry->sle_blocked = STATE_NON_BLOCKING;
+	lock_entry_set_blocked(lock_entry, STATE_NON_BLOCKING);
 
 	/* Merge any touching or overlapping locks into this one. */
 	LogEntry("Granted immediate, merging locks for", lock_entry);
@@ -1708,7 +1932,8 @@ void grant_blocked_lock_immediate(cache_entry_t *entry,
 	LogEntry("Immediate Granted entry", lock_entry);
 
 	/* A lock downgrade could unblock blocked locks */
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, lock_entry->sle_lock.lock_start,
+			    lock_end(&lock_entry->sle_lock));
 }
 
 /**
@@ -1738,7 +1963,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 	/* We need to make sure lock is ready to be granted */
 	if (lock_entry->sle_blocked == STATE_GRANTING) {
 		/* Mark lock as granted */
-		lock_entry->sle_blocked = STATE_NON_BLOCKING;
+		lock_entry_set_blocked(lock_entry, STATE_NON_BLOCKING);
 
 		/* Merge any touching or overlapping locks into this one. */
 		LogEntry("Granted, merging locks for", lock_entry);
@@ -1747,7 +1972,8 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 		LogEntry("Granted entry", lock_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, lock_entry->sle_lock.lock_start,
+				    lock_end(&lock_entry->sle_lock));
 	}
 
 	/* Free cookie and unblock lock.
@@ -1761,7 +1987,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		cache_inode_dec_pin_ref(entry, false);
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
@@ -1799,7 +2025,7 @@ void try_to_grant_lock(state_lock_entry_t *lock_entry)
 		 * for acquiring a reference to the lock entry if needed.
 		 */
 		blocked = lock_entry->sle_blocked;
-		lock_entry->sle_blocked = STATE_GRANTING;
+		lock_entry_set_blocked(lock_entry, STATE_GRANTING);
 		if (lock_entry->sle_block_data->sbd_grant_type ==
 		    STATE_GRANT_NONE)
 			lock_entry->sle_block_data->sbd_grant_type =
@@ -1821,7 +2047,7 @@ void try_to_grant_lock(state_lock_entry_t *lock_entry)
 			/* The lock is still blocked,
 			 * restore it's type and leave it in the list
 			 */
-			lock_entry->sle_blocked = blocked;
+			lock_entry_set_blocked(lock_entry, blocked);
 			return;
 		}
 
@@ -1865,23 +2091,131 @@ void process_blocked_lock_upcall(state_block_data_t *block_data)
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		cache_inode_dec_pin_ref(entry, false);
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
 }
 
 /**
- * @brief Attempt to grant all blocked locks on a file
+ * @brief Check whether an owner holds a lock a waiter is blocked on
+ *
+ * @param[in] entry  The file
+ * @param[in] owner  The lock owner
+ * @param[in] waiter Blocked lock entry
+ *
+ * @return true if a lock granted to owner conflicts with waiter.
+ */
+static bool lock_owner_blocks(cache_entry_t *entry, state_owner_t *owner,
+			      state_lock_entry_t *waiter)
+{
+	struct interval_node *node;
+	state_lock_entry_t *held;
+
+	interval_tree_for_each(node, &entry->object.file->lock_tree,
+			       waiter->sle_range.start,
+			       waiter->sle_range.last) {
+		held = lock_tree_entry(node);
+
+		if (held->sle_blocked != STATE_NON_BLOCKING
+		    && held->sle_blocked != STATE_GRANTING)
+			continue;
+
+		if (different_owners(held->sle_owner, owner))
+			continue;
+
+		if (held->sle_lock.lock_type == FSAL_LOCK_W
+		    || waiter->sle_lock.lock_type == FSAL_LOCK_W)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Find a waiter queued ahead of a lock request
+ *
+ * Waiters are granted in the order they blocked, so a request that
+ * conflicts with a waiter queued ahead of it waits behind that one,
+ * even if nothing granted is in its way.  That keeps a stream of
+ * readers from starving a writer.
+ *
+ * A waiter blocked on a lock the requesting owner already holds is
+ * not ahead of it, though: that waiter can't be granted before the
+ * owner lets go, so making the owner wait for it would deadlock.
+ *
+ * @param[in] entry The file
+ * @param[in] owner The lock owner
+ * @param[in] lock  Lock requested
+ * @param[in] stop  Where the request is queued, or NULL if it is not
+ *
+ * @return The conflicting waiter ahead, or NULL.
+ */
+static state_lock_entry_t *lock_waiter_ahead(cache_entry_t *entry,
+					     state_owner_t *owner,
+					     fsal_lock_param_t *lock,
+					     state_lock_entry_t *stop)
+{
+	struct glist_head *glist;
+	state_lock_entry_t *ahead;
+	uint64_t range_end = lock_end(lock);
+
+	glist_for_each(glist, &entry->object.file->blocked_locks) {
+		ahead = glist_entry(glist, state_lock_entry_t,
+				    sle_blocked_list);
+
+		if (ahead == stop)
+			break;
+
+		if (ahead->sle_blocked != STATE_NLM_BLOCKING
+		    && ahead->sle_blocked != STATE_NFSV4_BLOCKING)
+			continue;
+
+		if (ahead->sle_range.start > range_end
+		    || ahead->sle_range.last < lock->lock_start)
+			continue;
+
+		if (ahead->sle_lock.lock_type != FSAL_LOCK_W
+		    && lock->lock_type != FSAL_LOCK_W)
+			continue;
+
+		if (!different_owners(ahead->sle_owner, owner)
+		    || lock_owner_blocks(entry, owner, ahead))
+			continue;
+
+		return ahead;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Hand a released range to the locks waiting for it
+ *
+ * The file's blocked_locks is its wait queue, in the order the locks
+ * blocked.  Only waiters overlapping the range that changed can have
+ * become grantable, and of those only ones that conflict neither with
+ * a granted lock nor with a waiter ahead of them are offered the lock,
+ * in queue order.  Each one granted is GRANTING, so counts as held
+ * for those behind it.  This wakes just the waiters that can proceed,
+ * makes one FSAL lock call for each, and none for waiters SAL already
+ * knows would conflict.
+ *
+ * If a waiter is dropped while being granted, its range counts as
+ * released for those behind it.
  *
  * @param[in] entry Cache entry for the file
+ * @param[in] lo    First byte released
+ * @param[in] hi    Last byte released, inclusive
  */
 
-static void grant_blocked_locks(cache_entry_t *entry)
+static void grant_blocked_locks(cache_entry_t *entry, uint64_t lo,
+				uint64_t hi)
 {
 	state_lock_entry_t *found_entry;
 	struct glist_head *glist, *glistn;
 	struct fsal_export *export = op_ctx->export->fsal_export;
+	uint64_t start, last;
 
 	/* If FSAL supports async blocking locks,
 	 * allow it to grant blocked locks.
@@ -1889,13 +2223,22 @@ static void grant_blocked_locks(cache_entry_t *entry)
 	if (export->exp_ops.fs_supports(export, fso_lock_support_async_block))
 		return;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	glist_for_each_safe(glist, glistn,
+			    &entry->object.file->blocked_locks) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_list);
 
 		if (found_entry->sle_blocked != STATE_NLM_BLOCKING
 		    && found_entry->sle_blocked != STATE_NFSV4_BLOCKING)
 			continue;
 
+		start = found_entry->sle_range.start;
+		last = found_entry->sle_range.last;
+
+		/* Nothing it was waiting for has changed */
+		if (start > hi || last < lo)
+			continue;
+
 		/* Found a blocked entry for this file,
 		 * see if we can place the lock.
 		 */
@@ -1904,8 +2247,24 @@ static void grant_blocked_locks(cache_entry_t *entry)
 		     &found_entry->sle_lock) != NULL)
 			continue;
 
+		if (lock_waiter_ahead(entry, found_entry->sle_owner,
+				      &found_entry->sle_lock,
+				      found_entry) != NULL)
+			continue;
+
 		/* Found an entry that might work, try to grant it. */
+		lock_entry_inc_ref(found_entry);
+
 		try_to_grant_lock(found_entry);
+
+		if (!interval_node_linked(&found_entry->sle_range)) {
+			if (start < lo)
+				lo = start;
+			if (last > hi)
+				hi = last;
+		}
+
+		lock_entry_dec_ref(found_entry);
 	}
 }
 
@@ -1926,7 +2285,7 @@ void cancel_blocked_lock(cache_entry_t *entry,
 
 	/* Mark lock as canceled */
 	LogEntry("Cancelling blocked", lock_entry);
-	lock_entry->sle_blocked = STATE_CANCELED;
+	lock_entry_set_blocked(lock_entry, STATE_CANCELED);
 
 	/* Unlocking the entire region will remove any FSAL locks we held,
 	 * whether from fully granted locks, or from blocking locks that were
@@ -2022,8 +2381,11 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 	state_lock_entry_t *found_entry = NULL;
 	uint64_t found_entry_end, range_end = lock_end(lock);
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	/* Granted locks are never on blocked_locks */
+	glist_for_each_safe(glist, glistn,
+			    &entry->object.file->blocked_locks) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_list);
 
 		/* Skip locks not owned by owner */
 		if (owner != NULL
@@ -2038,10 +2400,6 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 		    found_entry->sle_state->state_seqid == state)
 			continue;
 
-		/* Skip granted locks */
-		if (found_entry->sle_blocked == STATE_NON_BLOCKING)
-			continue;
-
 		LogEntry("Checking", found_entry);
 
 		found_entry_end = lock_end(&found_entry->sle_lock);
@@ -2066,9 +2424,12 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	state_lock_entry_t *lock_entry;
 	cache_entry_t *entry;
 	state_status_t status = STATE_SUCCESS;
+	uint64_t start, last;
 
 	lock_entry = cookie_entry->sce_lock_entry;
 	entry = cookie_entry->sce_entry;
+	start = lock_entry->sle_lock.lock_start;
+	last = lock_end(&lock_entry->sle_lock);
 
 	/* This routine does not call cache_inode_inc_pin_ref() because there
 	 * MUST be at least one lock present for there to be a cookie_entry
@@ -2084,7 +2445,7 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	 */
 	if (lock_entry->sle_blocked == STATE_GRANTING) {
 		/* Mark lock as canceled */
-		lock_entry->sle_blocked = STATE_CANCELED;
+		lock_entry_set_blocked(lock_entry, STATE_CANCELED);
 
 		/* We had acquired an FSAL lock, need to release it. */
 		status = do_lock_op(entry,
@@ -2117,14 +2478,14 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	free_cookie(cookie_entry, true);
 
 	/* Check to see if we can grant any blocked locks. */
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, start, last);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
 
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		cache_inode_dec_pin_ref(entry, false);
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
@@ -2215,7 +2576,7 @@ state_status_t do_unlock_no_owner(cache_entry_t *entry,
 
 	status = subtract_list_from_list(entry,
 					 &fsal_unlock_list,
-					 &entry->object.file.lock_list);
+					 &entry->object.file->lock_list);
 
 	if (status != STATE_SUCCESS) {
 		/* We ran out of memory while trying to build the unlock list.
@@ -2483,7 +2844,7 @@ state_status_t state_test(cache_entry_t *entry,
 	}
 
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS))
-		LogList("Lock List", entry, &entry->object.file.lock_list);
+		LogList("Lock List", entry, &entry->object.file->lock_list);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
 
@@ -2520,6 +2881,7 @@ state_status_t state_lock(cache_entry_t *entry,
 {
 	bool allow = true, overlap = false;
 	struct glist_head *glist;
+	struct interval_node *node;
 	state_lock_entry_t *found_entry;
 	uint64_t found_entry_end;
 	uint64_t range_end = lock_end(lock);
@@ -2579,37 +2941,39 @@ state_status_t state_lock(cache_entry_t *entry,
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
+	/* Need to reject lock request if this lock owner already has
+	 * a lock on this file via a different export.
+	 */
+	found_entry = lock_export_conflict(entry, owner);
+
+	if (found_entry != NULL) {
+		LogEvent(COMPONENT_STATE,
+			 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
+			 found_entry->sle_export->export_id,
+			 found_entry->sle_export->fullpath,
+			 op_ctx->export->export_id,
+			 op_ctx->export->fullpath);
+
+		LogEntry("Found lock entry belonging to another export",
+			 found_entry);
+
+		status = STATE_INVALID_ARGUMENT;
+		goto out_unlock;
+	}
+
 	if (blocking != STATE_NON_BLOCKING) {
 		/* First search for a blocked request. Client can ignore the
 		 * blocked request and keep sending us new lock request again
 		 * and again. So if we have a mapping blocked request return
 		 * that
 		 */
-		glist_for_each(glist, &entry->object.file.lock_list) {
-			found_entry =
-			    glist_entry(glist, state_lock_entry_t, sle_list);
+		glist_for_each(glist, &entry->object.file->blocked_locks) {
+			found_entry = glist_entry(glist, state_lock_entry_t,
+						  sle_blocked_list);
 
 			if (different_owners(found_entry->sle_owner, owner))
 				continue;
 
-			/* Need to reject lock request if this lock owner
-			 * already has a lock on this file via a different
-			 * export.
-			 */
-			if (found_entry->sle_export != op_ctx->export) {
-				LogEvent(COMPONENT_STATE,
-					 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-					 found_entry->sle_export->export_id,
-					 found_entry->sle_export->fullpath,
-					 op_ctx->export->export_id,
-					 op_ctx->export->fullpath);
-				LogEntry(
-					"Found lock entry belonging to another export",
-					found_entry);
-				status = STATE_INVALID_ARGUMENT;
-				goto out_unlock;
-			}
-
 			if (found_entry->sle_blocked != blocking)
 				continue;
 
@@ -2626,52 +2990,36 @@ state_status_t state_lock(cache_entry_t *entry,
 		}
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
-		/* Need to reject lock request if this lock owner already has
-		 * a lock on this file via a different export.
-		 */
-		if (found_entry->sle_export != op_ctx->export
-		    && !different_owners(found_entry->sle_owner, owner)) {
-			LogEvent(COMPONENT_STATE,
-				 "Lock Owner Export Conflict, Lock held for export %d (%s), request for export %d (%s)",
-				 found_entry->sle_export->export_id,
-				 found_entry->sle_export->fullpath,
-				 op_ctx->export->export_id,
-				 op_ctx->export->fullpath);
-
-			LogEntry("Found lock entry belonging to another export",
-				 found_entry);
-
-			status = STATE_INVALID_ARGUMENT;
-			goto out_unlock;
-		}
+	interval_tree_for_each(node, &entry->object.file->lock_tree,
+			       lock->lock_start, range_end) {
+		found_entry = lock_tree_entry(node);
+
+		/* Waiters are checked below, in queue order */
+		if (found_entry->sle_blocked == STATE_NLM_BLOCKING
+		    || found_entry->sle_blocked == STATE_NFSV4_BLOCKING
+		    || found_entry->sle_blocked == STATE_CANCELED)
+			continue;
 
-		/* Don't skip blocked locks for fairness */
 		found_entry_end = lock_end(&found_entry->sle_lock);
 
+		/* lock overlaps see if we can allow:
+		 * allow if neither lock is exclusive or
+		 * the owner is the same
+		 */
 		if (!(lock->lock_reclaim)
-		    && (found_entry_end >= lock->lock_start)
-		    && (found_entry->sle_lock.lock_start <= range_end)) {
-			/* lock overlaps see if we can allow:
-			 * allow if neither lock is exclusive or
-			 * the owner is the same
+		    && (found_entry->sle_lock.lock_type == FSAL_LOCK_W
+			|| lock->lock_type == FSAL_LOCK_W)
+		    && different_owners(found_entry->sle_owner, owner)) {
+			/* Found a conflicting lock, break out of loop.
+			 * Also indicate overlap hint.
 			 */
-			if ((found_entry->sle_lock.lock_type == FSAL_LOCK_W
-			     || lock->lock_type == FSAL_LOCK_W)
-			    && different_owners(found_entry->sle_owner,
-						owner)) {
-				/* Found a conflicting lock, break out of loop.
-				 * Also indicate overlap hint.
-				 */
-				LogEntry("Conflicts with", found_entry);
-				LogList("Locks", entry,
-					&entry->object.file.lock_list);
-				copy_conflict(found_entry, holder, conflict);
-				allow = false;
-				overlap = true;
-				break;
-			}
+			LogEntry("Conflicts with", found_entry);
+			LogList("Locks", entry,
+				&entry->object.file->lock_list);
+			copy_conflict(found_entry, holder, conflict);
+			allow = false;
+			overlap = true;
+			break;
 		}
 
 		if (found_entry_end >= range_end
@@ -2718,6 +3066,20 @@ state_status_t state_lock(cache_entry_t *entry,
 		}
 	}
 
+	if (allow && !lock->lock_reclaim) {
+		/* Nothing granted is in the way, but a new request still
+		 * goes behind the waiters it conflicts with, for fairness.
+		 */
+		found_entry = lock_waiter_ahead(entry, owner, lock, NULL);
+
+		if (found_entry != NULL) {
+			LogEntry("Queued behind", found_entry);
+			copy_conflict(found_entry, holder, conflict);
+			allow = false;
+			overlap = true;
+		}
+	}
+
 	/* Decide how to proceed */
 	if (fsal_export->exp_ops.
 	    fs_supports(fsal_export, fso_lock_support_async_block)
@@ -2826,17 +3188,17 @@ state_status_t state_lock(cache_entry_t *entry,
 		/* Insert entry into lock list */
 		LogEntry("New lock", found_entry);
 
-		if (glist_empty(&entry->object.file.lock_list)) {
+		if (glist_empty(&entry->object.file->lock_list)) {
 			/* List was empty so we must retain the pin reference
 			 */
 			unpin = false;
 		}
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		lock_entry_link(found_entry);
 
 		/* A lock downgrade could unblock blocked locks */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, found_entry->sle_lock.lock_start,
+				    lock_end(&found_entry->sle_lock));
 	} else if (status == STATE_LOCK_CONFLICT) {
 		LogEntry("Conflict in FSAL for", found_entry);
 
@@ -2851,14 +3213,13 @@ state_status_t state_lock(cache_entry_t *entry,
 		/* Insert entry into lock list */
 		LogEntry("FSAL block for", found_entry);
 
-		if (glist_empty(&entry->object.file.lock_list)) {
+		if (glist_empty(&entry->object.file->lock_list)) {
 			/* List was empty so we must retain the pin reference
 			 */
 			unpin = false;
 		}
 
-		glist_add_tail(&entry->object.file.lock_list,
-			       &found_entry->sle_list);
+		lock_entry_link(found_entry);
 
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 		release_state_lock = false;
@@ -2935,7 +3296,7 @@ state_status_t state_unlock(cache_entry_t *entry,
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
 	/* If lock list is empty, there really isn't any work for us to do. */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		LogDebug(COMPONENT_STATE,
 			 "Unlock success on file with no locks");
 
@@ -2966,13 +3327,13 @@ state_status_t state_unlock(cache_entry_t *entry,
 					 nsm_state,
 					 lock,
 					 &removed,
-					 &entry->object.file.lock_list);
+					 &entry->object.file->lock_list);
 
 	/* If the lock list has become zero; decrement the pin ref count pt
 	 * placed. Do this here just in case subtract_lock_from_list has made
 	 * list empty even if it failed.
 	 */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		cache_inode_dec_pin_ref(entry, false);
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
@@ -3014,9 +3375,9 @@ state_status_t state_unlock(cache_entry_t *entry,
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS)
 	    && lock->lock_start == 0 && lock->lock_length == 0)
 		empty =
-		    LogList("Lock List", entry, &entry->object.file.lock_list);
+		    LogList("Lock List", entry, &entry->object.file->lock_list);
 
-	grant_blocked_locks(entry);
+	grant_blocked_locks(entry, lock->lock_start, lock_end(lock));
 
 
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS)
@@ -3068,23 +3429,23 @@ state_status_t state_cancel(cache_entry_t *entry,
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
 	/* If lock list is empty, there really isn't any work for us to do. */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		LogDebug(COMPONENT_STATE,
 			 "Cancel success on file with no locks");
 
 		goto out_unlock;
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
-		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
+	/* Can not cancel a lock once it is granted, so only blocked
+	 * locks are candidates.
+	 */
+	glist_for_each(glist, &entry->object.file->blocked_locks) {
+		found_entry = glist_entry(glist, state_lock_entry_t,
+					  sle_blocked_list);
 
 		if (different_owners(found_entry->sle_owner, owner))
 			continue;
 
-		/* Can not cancel a lock once it is granted */
-		if (found_entry->sle_blocked == STATE_NON_BLOCKING)
-			continue;
-
 		if (different_lock(&found_entry->sle_lock, lock))
 			continue;
 
@@ -3092,7 +3453,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 		cancel_blocked_lock(entry, found_entry);
 
 		/* Check to see if we can grant any blocked locks. */
-		grant_blocked_locks(entry);
+		grant_blocked_locks(entry, lock->lock_start, lock_end(lock));
 
 		break;
 	}
@@ -3100,7 +3461,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 	/* If the lock list has become zero; decrement
 	 * the pin ref count pt placed
 	 */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->object.file->lock_list)) {
 		cache_inode_dec_pin_ref(entry, false);
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
@@ -3706,7 +4067,8 @@ void find_blocked_lock_upcall(cache_entry_t *entry, void *owner,
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS)) {
 		PTHREAD_RWLOCK_rdlock(&entry->state_lock);
 
-		LogList("File Lock List", entry, &entry->object.file.lock_list);
+		LogList("File Lock List", entry,
+			&entry->object.file->lock_list);
 
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 	}
@@ -3757,10 +4119,10 @@ void available_blocked_lock_upcall(cache_entry_t *entry, void *owner,
  */
 void state_lock_wipe(cache_entry_t *entry)
 {
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->object.file->lock_list))
 		return;
 
-	free_list(&entry->object.file.lock_list);
+	free_list(&entry->object.file->lock_list);
 
 	cache_inode_dec_pin_ref(entry, false);
 	cache_inode_lru_unref(entry, LRU_FLAG_NONE);
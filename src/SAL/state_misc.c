@@ -1014,8 +1014,11 @@ void dec_state_owner_ref(state_owner_t *owner)
 	if ((owner->so_type == STATE_OPEN_OWNER_NFSV4) &&
 	    (atomic_fetch_time_t(&owner->so_owner.so_nfs4_owner.
 				 last_close_time) == 0)) {
+		time_t tclose = time(NULL);
+
 		atomic_store_time_t(&owner->so_owner.so_nfs4_owner.
-				    last_close_time, time(NULL));
+				    last_close_time, tclose);
+		open_owner_timer_arm(owner, tclose);
 		LogFullDebug(COMPONENT_STATE,
 			     "Cached open owner {%s}",
 			     str);
@@ -1181,6 +1184,8 @@ state_owner_t *get_state_owner(care_t care, state_owner_t *key,
 	owner = pool_alloc(state_owner_pool, NULL);
 
 	if (owner == NULL) {
+		hashtable_releaselatched(ht_owner, &latch);
+
 		if (!str_valid)
 			display_owner(&dspbuf, key);
 		LogCrit(COMPONENT_STATE, "No memory for {%s}", str);
@@ -1208,6 +1213,11 @@ state_owner_t *get_state_owner(care_t care, state_owner_t *key,
 	owner->so_owner_val = gsh_malloc(key->so_owner_len);
 
 	if (owner->so_owner_val == NULL) {
+		/* Freeing an open owner takes the open owner wheel mutex,
+		 * which the reaper holds while it takes the latch.
+		 */
+		hashtable_releaselatched(ht_owner, &latch);
+
 		/* Discard the created owner */
 		if (!str_valid)
 			display_owner(&dspbuf, key);
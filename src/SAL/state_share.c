@@ -487,28 +487,28 @@ state_status_t state_share_check_conflict(cache_entry_t *entry,
 	char *cause = "";
 
 	if ((share_access & OPEN4_SHARE_ACCESS_READ) != 0
-	    && entry->object.file.share_state.share_deny_read > 0
+	    && entry->object.file->share_state.share_deny_read > 0
 	    && bypass != SHARE_BYPASS_READ) {
 		cause = "access read denied by existing deny read";
 		goto out_conflict;
 	}
 
 	if ((share_access & OPEN4_SHARE_ACCESS_WRITE) != 0
-	    && (entry->object.file.share_state.share_deny_write_v4 > 0 ||
+	    && (entry->object.file->share_state.share_deny_write_v4 > 0 ||
 		(bypass != SHARE_BYPASS_V3_WRITE &&
-		 entry->object.file.share_state.share_deny_write > 0))) {
+		 entry->object.file->share_state.share_deny_write > 0))) {
 		cause = "access write denied by existing deny write";
 		goto out_conflict;
 	}
 
 	if ((share_deny & OPEN4_SHARE_DENY_READ) != 0
-	    && entry->object.file.share_state.share_access_read > 0) {
+	    && entry->object.file->share_state.share_access_read > 0) {
 		cause = "deny read denied by existing access read";
 		goto out_conflict;
 	}
 
 	if ((share_deny & OPEN4_SHARE_DENY_WRITE) != 0
-	    && entry->object.file.share_state.share_access_write > 0) {
+	    && entry->object.file->share_state.share_access_write > 0) {
 		cause = "deny write denied by existing access write";
 		goto out_conflict;
 	}
@@ -550,22 +550,22 @@ static void state_share_update_counter(cache_entry_t *entry, int old_access,
 	    ((new_deny & OPEN4_SHARE_DENY_WRITE) !=
 	     0) - ((old_deny & OPEN4_SHARE_DENY_WRITE) != 0);
 
-	entry->object.file.share_state.share_access_read += access_read_inc;
-	entry->object.file.share_state.share_access_write += access_write_inc;
-	entry->object.file.share_state.share_deny_read += deny_read_inc;
-	entry->object.file.share_state.share_deny_write += deny_write_inc;
+	entry->object.file->share_state.share_access_read += access_read_inc;
+	entry->object.file->share_state.share_access_write += access_write_inc;
+	entry->object.file->share_state.share_deny_read += deny_read_inc;
+	entry->object.file->share_state.share_deny_write += deny_write_inc;
 	if (v4)
-		entry->object.file.share_state.share_deny_write_v4 +=
+		entry->object.file->share_state.share_deny_write_v4 +=
 		    deny_write_inc;
 
 	LogFullDebug(COMPONENT_STATE,
 		     "entry %p: share counter: access_read %u, access_write %u, deny_read %u, deny_write %u, deny_write_v4 %u",
 		     entry,
-		     entry->object.file.share_state.share_access_read,
-		     entry->object.file.share_state.share_access_write,
-		     entry->object.file.share_state.share_deny_read,
-		     entry->object.file.share_state.share_deny_write,
-		     entry->object.file.share_state.share_deny_write_v4);
+		     entry->object.file->share_state.share_access_read,
+		     entry->object.file->share_state.share_access_write,
+		     entry->object.file->share_state.share_deny_read,
+		     entry->object.file->share_state.share_deny_write,
+		     entry->object.file->share_state.share_deny_write_v4);
 }
 
 /**
@@ -579,10 +579,10 @@ static unsigned int state_share_get_share_access(cache_entry_t *entry)
 {
 	unsigned int share_access = 0;
 
-	if (entry->object.file.share_state.share_access_read > 0)
+	if (entry->object.file->share_state.share_access_read > 0)
 		share_access |= OPEN4_SHARE_ACCESS_READ;
 
-	if (entry->object.file.share_state.share_access_write > 0)
+	if (entry->object.file->share_state.share_access_write > 0)
 		share_access |= OPEN4_SHARE_ACCESS_WRITE;
 
 	LogFullDebug(COMPONENT_STATE, "entry %p: union share access = %u",
@@ -602,10 +602,10 @@ static unsigned int state_share_get_share_deny(cache_entry_t *entry)
 {
 	unsigned int share_deny = 0;
 
-	if (entry->object.file.share_state.share_deny_read > 0)
+	if (entry->object.file->share_state.share_deny_read > 0)
 		share_deny |= OPEN4_SHARE_DENY_READ;
 
-	if (entry->object.file.share_state.share_deny_write > 0)
+	if (entry->object.file->share_state.share_deny_write > 0)
 		share_deny |= OPEN4_SHARE_DENY_WRITE;
 
 	LogFullDebug(COMPONENT_STATE, "entry %p: union share deny = %u", entry,
@@ -660,7 +660,7 @@ state_status_t state_share_anonymous_io_start(cache_entry_t *entry,
 
 	/* update a counter that says we are processing an anonymous
 	 * request and can't currently grant a new delegation */
-	atomic_inc_uint32_t(&entry->object.file.anon_ops);
+	atomic_inc_uint32_t(&entry->object.file->anon_ops);
 
 	/* Temporarily bump the access counters, v4 mode doesn't matter
 	 * since there is no deny mode associated with anonymous I/O.
@@ -692,7 +692,7 @@ void state_share_anonymous_io_done(cache_entry_t *entry, int share_access)
 
 	/* If we are this far, then delegations weren't recalled and we
 	 * incremented this variable. */
-	atomic_dec_uint32_t(&entry->object.file.anon_ops);
+	atomic_dec_uint32_t(&entry->object.file->anon_ops);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
 }
@@ -717,7 +717,7 @@ void remove_nlm_share(state_t *state, bool *unpin)
 	/* Remove the share from the list for the file. */
 	glist_del(&state->state_list);
 
-	if (glist_empty(&entry->object.file.nlm_share_list)) {
+	if (glist_empty(&entry->object.file->nlm_share_list)) {
 		/* The list is now empty, remove the pin ref and
 		 * the extra LRU ref.
 		 */
@@ -867,11 +867,11 @@ state_status_t state_nlm_share(cache_entry_t *entry,
 
 	PTHREAD_MUTEX_unlock(&client->slc_nsm_client->ssc_mutex);
 
-	if (glist_empty(&entry->object.file.nlm_share_list))
+	if (glist_empty(&entry->object.file->nlm_share_list))
 		unpin = false;
 
 	/* Add share to list for file. */
-	glist_add_tail(&entry->object.file.nlm_share_list,
+	glist_add_tail(&entry->object.file->nlm_share_list,
 		       &state->state_list);
 
 	/* Add to share list for export */
@@ -992,6 +992,11 @@ state_status_t state_nlm_unshare(cache_entry_t *entry,
 	cache_inode_status_t cache_status;
 	state_status_t status = 0;
 
+	if (entry->type != REGULAR_FILE) {
+		LogDebug(COMPONENT_STATE, "Bad Unshare on non-regular file");
+		return STATE_BAD_TYPE;
+	}
+
 	cache_status = cache_inode_inc_pin_ref(entry);
 
 	if (cache_status != CACHE_INODE_SUCCESS) {
@@ -1088,7 +1093,8 @@ void state_share_wipe(cache_entry_t *entry)
 	struct glist_head *glist;
 	struct glist_head *glistn;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.nlm_share_list) {
+	glist_for_each_safe(glist, glistn,
+			    &entry->object.file->nlm_share_list) {
 		state = glist_entry(glist, state_t, state_list);
 
 		remove_nlm_share(state, NULL);
@@ -206,7 +206,6 @@ cache_inode_get(cache_inode_fsal_data_t *fsdata,
 	struct fsal_export *exp_hdl = NULL;
 	struct fsal_obj_handle *new_hdl;
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
-	cih_latch_t latch;
 	cache_inode_key_t key;
 
 	key.fsal = fsdata->export->fsal;
@@ -216,15 +215,8 @@ cache_inode_get(cache_inode_fsal_data_t *fsdata,
 
 	(void)atomic_inc_uint64_t(&cache_stp->inode_req);
 	/* Do lookup */
-	*entry =
-	    cih_get_by_key_latched(&key, &latch,
-				  CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
-				  __func__, __LINE__);
+	*entry = cih_get_by_key_ref(&key, __func__, __LINE__);
 	if (*entry) {
-		/* take an extra reference within the critical section */
-		(void) cache_inode_lru_ref(*entry, LRU_REQ_INITIAL);
-		cih_latch_rele(&latch);
-
 		if (!check_mapping(*entry, op_ctx->export)) {
 			/* Return error instead of entry */
 			cache_inode_put(*entry);
@@ -279,7 +271,6 @@ cache_inode_get_keyed(cache_inode_key_t *key,
 		      cache_inode_status_t *status)
 {
 	cache_entry_t *entry;
-	cih_latch_t latch;
 
 	if (key->kv.addr == NULL) {
 		LogDebug(COMPONENT_CACHE_INODE,
@@ -289,16 +280,9 @@ cache_inode_get_keyed(cache_inode_key_t *key,
 	}
 
 	/* Check if the entry already exists */
-	entry = cih_get_by_key_latched(key, &latch,
-				       CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
-				       __func__, __LINE__);
+	entry = cih_get_by_key_ref(key, __func__, __LINE__);
 
 	if (likely(entry != NULL)) {
-		/* Ref entry */
-		(void) cache_inode_lru_ref(entry, LRU_REQ_INITIAL);
-		/* Release the subtree hash table lock */
-		cih_latch_rele(&latch);
-
 		if (!check_mapping(entry, op_ctx->export)) {
 			/* Return error instead of entry */
 			cache_inode_put(entry);
@@ -63,6 +63,23 @@ cache_inode_init(void)
 		status = CACHE_INODE_INVALID_ARGUMENT;
 	}
 
+	cache_inode_file_pool =
+	    pool_init("File Content Pool", sizeof(struct cache_inode_file),
+		      pool_basic_substrate, NULL, NULL, NULL);
+	if (!(cache_inode_file_pool)) {
+		LogCrit(COMPONENT_CACHE_INODE, "Can't init File Content Pool");
+		status = CACHE_INODE_INVALID_ARGUMENT;
+	}
+
+	cache_inode_dir_pool =
+	    pool_init("Directory Content Pool", sizeof(struct cache_inode_dir),
+		      pool_basic_substrate, NULL, NULL, NULL);
+	if (!(cache_inode_dir_pool)) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Can't init Directory Content Pool");
+		status = CACHE_INODE_INVALID_ARGUMENT;
+	}
+
 	cih_pkginit();
 
 	return status;
@@ -79,8 +96,13 @@ cache_inode_destroyer(void)
 	/* Destroy the cache inode AVL tree */
 	cih_pkgdestroy();
 
+	/* Free entries still awaiting a grace period */
+	epoch_pkgshutdown();
+
 	/* Destroy the cache inode entry pool */
 	pool_destroy(cache_inode_entry_pool);
+	pool_destroy(cache_inode_file_pool);
+	pool_destroy(cache_inode_dir_pool);
 }
 
 /** @} */
@@ -282,7 +282,7 @@ cache_inode_lookup_impl(cache_entry_t *parent,
 
 	if ((*entry)->type == DIRECTORY) {
 		/* Insert Parent's key */
-		cache_inode_key_dup(&(*entry)->object.dir.parent,
+		cache_inode_key_dup(&(*entry)->object.dir->parent,
 				    &parent->fh_hk.key);
 	}
 
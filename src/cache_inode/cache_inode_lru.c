@@ -416,6 +416,9 @@ cache_inode_lru_clean(cache_entry_t *entry)
 	if (entry->type == DIRECTORY)
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
 
+	/* Free type-specific content and uncharge the entry */
+	cache_inode_fsobj_release(entry);
+
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
 		entry->obj_handle->obj_ops.release(entry->obj_handle);
@@ -425,13 +428,30 @@ cache_inode_lru_clean(cache_entry_t *entry)
 	/* Clean out the export mapping before deconstruction */
 	clean_mapping(entry);
 
-	/* Finalize last bits of the cache entry */
-	cache_inode_key_delete(&entry->fh_hk.key);
+	/* Finalize last bits of the cache entry.  The hash key is left
+	 * to the caller, since lockless lookups may still compare it. */
 	PTHREAD_RWLOCK_destroy(&entry->content_lock);
 	PTHREAD_RWLOCK_destroy(&entry->state_lock);
 	PTHREAD_RWLOCK_destroy(&entry->attr_lock);
 }
 
+/**
+ * @brief Free a cleaned entry after its grace period
+ *
+ * Lockless lookups may be traversing a just-unreferenced entry, so it
+ * and its hash key are released only once they have all finished.
+ *
+ * @param[in] arg  The entry to free
+ */
+static void
+lru_free_entry(void *arg)
+{
+	cache_entry_t *entry = arg;
+
+	cache_inode_key_delete(&entry->fh_hk.key);
+	pool_free(cache_inode_entry_pool, entry);
+}
+
 /**
  * @brief Try to pull an entry off the queue
  *
@@ -480,6 +500,10 @@ lru_reap_impl(enum lru_q_id qid)
 		/* entry must be unreachable from CIH when recycled */
 		if (cih_latch_entry
 		    (entry, &latch, CIH_GET_WLOCK, __func__, __LINE__)) {
+			/* Invalidate lockless lookups before sampling the
+			 * refcount: one that references the entry after
+			 * this point fails its sequence check. */
+			cih_write_begin(latch.cp);
 			QLOCK(qlane);
 			refcnt = atomic_fetch_int32_t(&entry->lru.refcnt);
 			/* there are two cases which permit reclaim,
@@ -493,13 +517,16 @@ lru_reap_impl(enum lru_q_id qid)
 				struct lru_q *q = lru_queue_of(entry);
 
 				cih_remove_latched(entry, &latch,
-						   CIH_REMOVE_QLOCKED);
+						   CIH_REMOVE_QLOCKED |
+						   CIH_REMOVE_WRITING);
+				cih_write_end(latch.cp);
 				LRU_DQ_SAFE(lru, q);
 				entry->lru.qid = LRU_ENTRY_NONE;
 				QUNLOCK(qlane);
 				cih_latch_rele(&latch);
 				goto out;
 			}
+			cih_write_end(latch.cp);
 			cih_latch_rele(&latch);
 			/* return the ref we took above--unref deals
 			 * correctly with reclaim case */
@@ -595,6 +622,8 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
 			    __func__, __LINE__)) {
 		uint32_t refcnt;
 
+		/* as in lru_reap_impl, fence off lockless lookups first */
+		cih_write_begin(latch.cp);
 		QLOCK(qlane);
 
 		refcnt = atomic_fetch_int32_t(&entry->lru.refcnt);
@@ -609,11 +638,13 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
 			struct lru_q *q = lru_queue_of(entry);
 
 			cih_remove_latched(entry, &latch,
-					   CIH_REMOVE_QLOCKED);
+					   CIH_REMOVE_QLOCKED |
+					   CIH_REMOVE_WRITING);
 			LRU_DQ_SAFE(lru, q);
 			entry->lru.qid = LRU_ENTRY_CLEANUP;
 		}
 
+		cih_write_end(latch.cp);
 		QUNLOCK(qlane);
 
 		cih_latch_rele(&latch);
@@ -914,6 +945,9 @@ lru_run(struct fridgethr_context *ctx)
 	lru_state.prev_fd_count = currentopen;
 	lru_state.prev_time = time(NULL);
 
+	/* Release entries whose grace period has elapsed */
+	epoch_reclaim();
+
 	fdnorm = (fdratepersec + fds_avg) / fds_avg;
 	fddelta = (currentopen > lru_state.fds_lowat)
 			? (currentopen - lru_state.fds_lowat) : 0;
@@ -1179,12 +1213,15 @@ alloc_cache_entry(cache_entry_t **entry)
 }
 
 /**
- * @brief Re-use or allocate an entry
+ * @brief Reclaim and allocate an entry
  *
- * This function repurposes a resident entry in the LRU system if the
- * system is above low-water mark, and allocates a new one otherwise.
- * On success, this function always returns an entry with two
- * references (one for the sentinel, one to allow the caller's use.)
+ * This function evicts a resident entry from the LRU system if the
+ * system is above the high-water mark, and allocates a new one.  The
+ * evicted entry is not reused in place: lockless lookups may still be
+ * walking through it, so it is released through the epoch like any
+ * other entry whose last reference is dropped.  On success, this
+ * function always returns an entry with two references (one for the
+ * sentinel, one to allow the caller's use.)
  *
  * @param[out] entry Returned status
  *
@@ -1200,25 +1237,21 @@ cache_inode_lru_get(cache_entry_t **entry)
 
 	lru = lru_try_reap_entry();
 	if (lru) {
-		/* we uniquely hold entry */
+		/* We hold the only counted reference, apart from any
+		 * stray one a lockless lookup is about to return;
+		 * whoever drops the last one defers the free past the
+		 * current epoch. */
 		nentry = container_of(lru, cache_entry_t, lru);
 		LogFullDebug(COMPONENT_CACHE_INODE_LRU,
-			     "Recycling entry at %p.", nentry);
-		cache_inode_lru_clean(nentry);
-		if (!init_rw_locks(nentry)) {
-			/* Recycle */
-			status = CACHE_INODE_INIT_ENTRY_FAILED;
-			pool_free(cache_inode_entry_pool, nentry);
-			nentry = NULL;
-			goto out;
-		}
-	} else {
-		/* alloc entry */
-		status = alloc_cache_entry(&nentry);
-		if (!nentry)
-			goto out;
+			     "Evicting entry at %p.", nentry);
+		cache_inode_lru_unref(nentry, LRU_FLAG_NONE);
+		nentry = NULL;
 	}
 
+	status = alloc_cache_entry(&nentry);
+	if (!nentry)
+		goto out;
+
 	/* Since the entry isn't in a queue, nobody can bump refcnt. */
 	nentry->lru.refcnt = 2;
 	nentry->lru.pin_refcnt = 0;
@@ -1369,7 +1402,6 @@ cache_inode_status_t cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags)
 {
 	cache_inode_lru_t *lru = &entry->lru;
 	struct lru_q_lane *qlane = &LRU[lru->lane];
-	struct lru_q *q;
 
 	if ((flags & (LRU_REQ_INITIAL | LRU_REQ_STALE_OK)) == 0) {
 		QLOCK(qlane);
@@ -1382,6 +1414,26 @@ cache_inode_status_t cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags)
 
 	atomic_inc_int32_t(&entry->lru.refcnt);
 
+	cache_inode_lru_touch(entry, flags);
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Adjust LRU position for a reference
+ *
+ * This function applies the LRU side effects of acquiring a reference.
+ * The caller must already hold a reference on the entry.
+ *
+ * @param[in] entry  The referenced entry
+ * @param[in] flags  One of LRU_REQ_INITIAL, LRU_REQ_SCAN, else LRU_FLAG_NONE
+ */
+void cache_inode_lru_touch(cache_entry_t *entry, uint32_t flags)
+{
+	cache_inode_lru_t *lru = &entry->lru;
+	struct lru_q_lane *qlane = &LRU[lru->lane];
+	struct lru_q *q;
+
 	/* adjust LRU on initial refs */
 	if (flags & LRU_REQ_INITIAL) {
 
@@ -1427,7 +1479,7 @@ cache_inode_status_t cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags)
 		QUNLOCK(qlane);
 	}			/* initial ref */
  out:
-	return CACHE_INODE_SUCCESS;
+	return;
 }
 
 /**
@@ -1504,7 +1556,7 @@ cache_inode_lru_unref(cache_entry_t *entry, uint32_t flags)
 			QUNLOCK(qlane);
 
 		cache_inode_lru_clean(entry);
-		pool_free(cache_inode_entry_pool, entry);
+		epoch_defer(lru_free_entry, entry);
 
 		atomic_dec_int64_t(&lru_state.entries_used);
 	}			/* refcnt == 0 */
@@ -1550,6 +1602,57 @@ cache_inode_lru_putback(cache_entry_t *entry, uint32_t flags)
 		QUNLOCK(qlane);
 }
 
+/**
+ * @brief Reference the most recently used entries
+ *
+ * Walks each lane from the MRU end of its pinned queue and then of
+ * L1, taking a reference on every live entry found, until the lane's
+ * share of @c max is reached.  Entries demoted to L2 are cold and are
+ * skipped.  The caller must drop each reference with
+ * cache_inode_lru_unref.
+ *
+ * @param[out] entries  Array to fill
+ * @param[in]  max      Size of the array
+ *
+ * @return Number of entries referenced.
+ */
+
+size_t
+cache_inode_lru_hot(cache_entry_t **entries, size_t max)
+{
+	size_t per_lane = (max + LRU_N_Q_LANES - 1) / LRU_N_Q_LANES;
+	size_t count = 0;
+	size_t lane;
+
+	for (lane = 0; lane < LRU_N_Q_LANES && count < max; ++lane) {
+		struct lru_q_lane *qlane = &LRU[lane];
+		struct lru_q *qs[2] = { &qlane->pinned, &qlane->L1 };
+		size_t taken = 0;
+		int ix;
+
+		QLOCK(qlane);
+		for (ix = 0; ix < 2; ++ix) {
+			struct glist_head *glist;
+
+			for (glist = qs[ix]->q.prev;
+			     glist != &qs[ix]->q && taken < per_lane
+				     && count < max;
+			     glist = glist->prev) {
+				cache_entry_t *entry =
+				    container_of(glist, cache_entry_t, lru.q);
+
+				if (!cache_inode_lru_ref_live(entry))
+					continue;
+				entries[count++] = entry;
+				++taken;
+			}
+		}
+		QUNLOCK(qlane);
+	}
+
+	return count;
+}
+
 /**
  *
  * @brief Wake the LRU thread to free FDs.
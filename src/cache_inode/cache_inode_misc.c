@@ -54,6 +54,97 @@
 #include <stdbool.h>
 
 pool_t *cache_inode_entry_pool;
+pool_t *cache_inode_file_pool;
+pool_t *cache_inode_dir_pool;
+
+struct cache_mem_stats cache_mem_st;
+
+/**
+ * @brief Compute the memory charged to an entry
+ *
+ * @param[in] entry  The entry, with its type and hash key set
+ *
+ * @return Bytes held by the entry, its type-specific part and its key.
+ */
+static inline size_t
+cache_inode_fsobj_size(cache_entry_t *entry)
+{
+	size_t size = sizeof(cache_entry_t) + entry->fh_hk.key.kv.len;
+
+	if (entry->type == REGULAR_FILE)
+		size += sizeof(struct cache_inode_file);
+	else if (entry->type == DIRECTORY)
+		size += sizeof(struct cache_inode_dir);
+
+	return size;
+}
+
+/**
+ * @brief Allocate the type-specific part of a new entry
+ *
+ * Allocates the file or directory part of an entry whose type and hash
+ * key have been set, and charges the entry to the memory statistics
+ * for its type.
+ *
+ * @param[in] entry  The new entry
+ *
+ * @return true on success, false if allocation failed.
+ */
+bool
+cache_inode_fsobj_init(cache_entry_t *entry)
+{
+	switch (entry->type) {
+	case REGULAR_FILE:
+		entry->object.file = pool_alloc(cache_inode_file_pool, NULL);
+		if (entry->object.file == NULL)
+			return false;
+		range_lock_init(&entry->object.file->io_range);
+		break;
+	case DIRECTORY:
+		entry->object.dir = pool_alloc(cache_inode_dir_pool, NULL);
+		if (entry->object.dir == NULL)
+			return false;
+		break;
+	default:
+		entry->object.file = NULL;
+		break;
+	}
+
+	if (entry->type <= EXTENDED_ATTR) {
+		(void)atomic_inc_uint64_t(&cache_mem_st.entries[entry->type]);
+		(void)atomic_add_uint64_t(&cache_mem_st.bytes[entry->type],
+					  cache_inode_fsobj_size(entry));
+	}
+
+	return true;
+}
+
+/**
+ * @brief Release the type-specific part of an entry
+ *
+ * Undoes cache_inode_fsobj_init.  For directories, the dirents MUST
+ * already have been released.
+ *
+ * @param[in] entry  The entry being cleaned
+ */
+void
+cache_inode_fsobj_release(cache_entry_t *entry)
+{
+	if (entry->type <= EXTENDED_ATTR) {
+		(void)atomic_dec_uint64_t(&cache_mem_st.entries[entry->type]);
+		(void)atomic_sub_uint64_t(&cache_mem_st.bytes[entry->type],
+					  cache_inode_fsobj_size(entry));
+	}
+
+	if (entry->type == REGULAR_FILE && entry->object.file != NULL) {
+		range_lock_destroy(&entry->object.file->io_range);
+		pool_free(cache_inode_file_pool, entry->object.file);
+	} else if (entry->type == DIRECTORY && entry->object.dir != NULL) {
+		pool_free(cache_inode_dir_pool, entry->object.dir);
+	}
+
+	entry->object.file = NULL;
+}
 
 const char *
 cache_inode_err_str(cache_inode_status_t err)
@@ -242,6 +333,7 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 	struct gsh_buffdesc fh_desc;
 	cih_latch_t latch;
 	bool has_hashkey = false;
+	bool has_fsobj = false;
 	int rc = 0;
 	cache_inode_key_t key;
 
@@ -290,6 +382,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 	nentry->type = new_obj->type;
 	nentry->flags = 0;
 	nentry->icreate_refcnt = 0;
+	nentry->change_time = 0;
+	nentry->attr_stable = 0;
+	nentry->object.file = NULL;
 	glist_init(&nentry->list_of_states);
 	glist_init(&nentry->export_list);
 	glist_init(&nentry->layoutrecall_list);
@@ -331,17 +426,31 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		goto out;
 	}
 
+	has_fsobj = cache_inode_fsobj_init(nentry);
+
+	if (!has_fsobj) {
+		cih_latch_rele(&latch);
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Could not allocate content of new entry");
+		status = CACHE_INODE_MALLOC_ERROR;
+		goto out;
+	}
+
 	switch (nentry->type) {
 	case REGULAR_FILE:
 		LogDebug(COMPONENT_CACHE_INODE,
 			 "Adding a REGULAR_FILE, entry=%p", nentry);
 
 		/* No shares or locks, yet. */
-		glist_init(&nentry->object.file.lock_list);
-		glist_init(&nentry->object.file.nlm_share_list);
-		memset(&nentry->object.file.share_state, 0,
+		glist_init(&nentry->object.file->lock_list);
+		interval_tree_init(&nentry->object.file->lock_tree);
+		glist_init(&nentry->object.file->blocked_locks);
+		nentry->object.file->lock_export = NULL;
+		nentry->object.file->lock_foreign = 0;
+		glist_init(&nentry->object.file->nlm_share_list);
+		memset(&nentry->object.file->share_state, 0,
 		       sizeof(cache_inode_share_t));
-		nentry->object.file.write_delegated = false;
+		nentry->object.file->write_delegated = false;
 
 		/* Init statistics used for intelligently granting delegations*/
 		init_deleg_heuristics(nentry);
@@ -364,9 +473,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 						   CACHE_INODE_DIR_POPULATED);
 		}
 
-		nentry->object.dir.avl.collisions = 0;
-		nentry->object.dir.nbactive = 0;
-		glist_init(&nentry->object.dir.export_roots);
+		nentry->object.dir->avl.collisions = 0;
+		nentry->object.dir->nbactive = 0;
+		glist_init(&nentry->object.dir->export_roots);
 		/* init avl tree */
 		cache_inode_avl_init(nentry);
 		break;
@@ -458,6 +567,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		PTHREAD_RWLOCK_destroy(&nentry->content_lock);
 		PTHREAD_RWLOCK_destroy(&nentry->state_lock);
 
+		if (has_fsobj)
+			cache_inode_fsobj_release(nentry);
+
 		if (has_hashkey)
 			cache_inode_key_delete(&nentry->fh_hk.key);
 
@@ -742,7 +854,7 @@ cache_inode_print_dir(cache_entry_t *entry)
 		return;
 	}
 
-	dirent_node = avltree_first(&entry->object.dir.avl.t);
+	dirent_node = avltree_first(&entry->object.dir->avl.t);
 	do {
 		dirent =
 		    avltree_container_of(dirent_node, cache_inode_dir_entry_t,
@@ -781,11 +893,11 @@ cache_inode_release_dirents(cache_entry_t *entry,
 
 	switch (which) {
 	case CACHE_INODE_AVL_NAMES:
-		tree = &entry->object.dir.avl.t;
+		tree = &entry->object.dir->avl.t;
 		break;
 
 	case CACHE_INODE_AVL_COOKIES:
-		tree = &entry->object.dir.avl.c;
+		tree = &entry->object.dir->avl.c;
 		break;
 
 	case CACHE_INODE_AVL_BOTH:
@@ -815,15 +927,15 @@ cache_inode_release_dirents(cache_entry_t *entry,
 			dirent_node = next_dirent_node;
 		}
 
-		if (tree == &entry->object.dir.avl.t) {
-			entry->object.dir.nbactive = 0;
+		if (tree == &entry->object.dir->avl.t) {
+			entry->object.dir->nbactive = 0;
 			atomic_clear_uint32_t_bits(&entry->flags,
 						   CACHE_INODE_DIR_POPULATED);
 		}
 
                 if (entry->type == DIRECTORY &&
-                    entry->object.dir.parent.kv.len) {
-                        cache_inode_key_delete(&entry->object.dir.parent);
+                    entry->object.dir->parent.kv.len) {
+                        cache_inode_key_delete(&entry->object.dir->parent);
                 }
         }
 }
@@ -367,8 +367,8 @@ void cache_inode_adjust_openflags(cache_entry_t *entry)
 	 * Also, if we have an outstanding write delegation, we shouldn't
 	 * downgrade!
 	 */
-	if (entry->object.file.share_state.share_access_write > 0 ||
-	    entry->object.file.write_delegated ||
+	if (entry->object.file->share_state.share_access_write > 0 ||
+	    entry->object.file->write_delegated ||
 	    !fsal_export->exp_ops.fs_supports(fsal_export, fso_reopen_method))
 		return;
 
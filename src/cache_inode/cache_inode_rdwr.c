@@ -53,6 +53,29 @@
 #include <pthread.h>
 #include <assert.h>
 
+/**
+ * @brief Check whether the open file descriptor can serve an I/O
+ *
+ * A descriptor opened for reading and writing serves either, and a
+ * stable write through a descriptor opened without FSAL_O_SYNC is
+ * followed by a commit, so only the access mode matters.
+ *
+ * @param[in] entry      File, content lock held
+ * @param[in] openflags  Flags the I/O would open with
+ *
+ * @return true if no (re)open is needed.
+ */
+
+static inline bool rdwr_fd_usable(cache_entry_t *entry,
+				  fsal_openflags_t openflags)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	fsal_openflags_t need = openflags & FSAL_O_RDWR;
+
+	return is_open(entry) &&
+	       (obj_hdl->obj_ops.status(obj_hdl) & need) == need;
+}
+
 /**
  * @brief Reads/Writes through the cache layer
  *
@@ -60,6 +83,12 @@
  * disk cache or through the FSAL directly.  The caller MUST NOT hold
  * either the content or attribute locks when calling this function.
  *
+ * The byte range being transferred is locked in the file's io_range,
+ * shared for reads and exclusive for writes, so overlapping I/O is
+ * ordered while I/O to disjoint ranges runs in parallel.  The content
+ * lock is held shared across the transfer only to keep the file
+ * descriptor open; it is taken exclusive just to open or reopen it.
+ *
  * @param[in]     entry        File to be read or written
  * @param[in]     io_direction Whether this is a read or a write
  * @param[in]     offset       Absolute file position for I/O
@@ -90,6 +119,10 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 	/* Required open mode to successfully read or write */
 	fsal_openflags_t openflags = FSAL_O_CLOSED;
 	fsal_openflags_t loflags;
+	/* Byte range of the transfer */
+	struct range_lock_entry range;
+	/* True if we have locked 'range' */
+	bool range_locked = false;
 	/* True if we have taken the content lock on 'entry' */
 	bool content_locked = false;
 	/* True if we have taken the attribute lock on 'entry' */
@@ -131,21 +164,26 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		goto out;
 	}
 
+	range_lock_acquire(&entry->object.file->io_range, &range, offset,
+			   io_size, openflags & FSAL_O_WRITE);
+	range_locked = true;
+
 	/* Write through the FSAL.  We need a write lock only if we need
 	   to open or close a file descriptor. */
 	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
 	content_locked = true;
-	loflags = obj_hdl->obj_ops.status(obj_hdl);
-	while ((!is_open(entry))
-	       || (loflags && loflags != FSAL_O_RDWR && loflags != openflags)) {
+	while (!rdwr_fd_usable(entry, openflags)) {
 		PTHREAD_RWLOCK_unlock(&entry->content_lock);
 		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-		loflags = obj_hdl->obj_ops.status(obj_hdl);
-		if ((!is_open(entry))
-		    || (loflags && loflags != FSAL_O_RDWR
-			&& loflags != openflags)) {
+		if (!rdwr_fd_usable(entry, openflags)) {
+			/* Keep the access the descriptor already has, so
+			   interleaved reads and writes settle on a single
+			   read/write descriptor rather than reopening it
+			   back and forth. */
+			loflags = obj_hdl->obj_ops.status(obj_hdl);
 			status =
-			    cache_inode_open(entry, openflags,
+			    cache_inode_open(entry,
+					     openflags | (loflags & FSAL_O_RDWR),
 					     (CACHE_INODE_FLAG_CONTENT_HAVE |
 					      CACHE_INODE_FLAG_CONTENT_HOLD));
 			if (status != CACHE_INODE_SUCCESS)
@@ -154,7 +192,6 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		}
 		PTHREAD_RWLOCK_unlock(&entry->content_lock);
 		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
-		loflags = obj_hdl->obj_ops.status(obj_hdl);
 	}
 
 	/* Call FSAL_read or FSAL_write */
@@ -266,6 +303,9 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		content_locked = false;
 	}
 
+	range_lock_release(&entry->object.file->io_range, &range);
+	range_locked = false;
+
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 	attributes_locked = true;
 	if (io_direction == CACHE_INODE_WRITE ||
@@ -287,6 +327,11 @@ cache_inode_status_t cache_inode_rdwr(cache_entry_t *entry,
 		content_locked = false;
 	}
 
+	if (range_locked) {
+		range_lock_release(&entry->object.file->io_range, &range);
+		range_locked = false;
+	}
+
 	if (attributes_locked) {
 		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
 		attributes_locked = false;
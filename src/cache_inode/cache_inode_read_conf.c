@@ -61,6 +61,18 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, expire_time_attr),
 	CONF_ITEM_BOOL("Use_Getattr_Directory_Invalidation", false,
 			cache_inode_parameter, getattr_dir_invalidation),
+	CONF_ITEM_UI32("Attr_Expiration_Msec_File", 0, UINT32_MAX, 0,
+		       cache_inode_parameter, expire.file_ms),
+	CONF_ITEM_UI32("Attr_Expiration_Msec_Dir", 0, UINT32_MAX, 0,
+		       cache_inode_parameter, expire.dir_ms),
+	CONF_ITEM_UI32("Attr_Expiration_Msec_Symlink", 0, UINT32_MAX, 0,
+		       cache_inode_parameter, expire.symlink_ms),
+	CONF_ITEM_BOOL("Attr_Expiration_Adaptive", false,
+		       cache_inode_parameter, expire.adaptive),
+	CONF_ITEM_UI32("Attr_Adaptive_Stable_Refreshes", 0, 1000, 3,
+		       cache_inode_parameter, expire.stable_refreshes),
+	CONF_ITEM_UI32("Attr_Adaptive_Max_Msec", 1, UINT32_MAX, 600000,
+		       cache_inode_parameter, expire.adaptive_max_ms),
 	CONF_ITEM_UI32("Dir_Max_Deleted", 1, UINT32_MAX, 65536,
 		       cache_inode_parameter, dir.avl_max_deleted),
 	CONF_ITEM_UI32("Entries_HWMark", 1, UINT32_MAX, 100000,
@@ -85,6 +97,14 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_PATH("Warm_Start_File", 1, MAXPATHLEN, NULL,
+		       cache_inode_parameter, warm_start_file),
+	CONF_ITEM_UI32("Warm_Start_Interval", 1, 24 * 3600, 300,
+		       cache_inode_parameter, warm_start_interval),
+	CONF_ITEM_UI32("Warm_Start_Entries", 1, UINT32_MAX, 10000,
+		       cache_inode_parameter, warm_start_entries),
+	CONF_ITEM_UI32("Warm_Start_Threads", 1, 64, 4,
+		       cache_inode_parameter, warm_start_threads),
 	CONFIG_EOL
 };
 
@@ -106,7 +106,7 @@ cache_inode_remove(cache_entry_t *entry, const char *name)
 		/* Get attr_lock for looking at junction_export */
 		PTHREAD_RWLOCK_rdlock(&to_remove_entry->attr_lock);
 
-		if (to_remove_entry->object.dir.junction_export != NULL ||
+		if (to_remove_entry->object.dir->junction_export != NULL ||
 		    atomic_fetch_int32_t(&to_remove_entry->exp_root_refcount)
 		    != 0) {
 			/* Trying to remove an export mount point */
@@ -0,0 +1,712 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @addtogroup cache_inode
+ * @{
+ */
+
+/**
+ * @file cache_inode_warm.c
+ * @brief Warm-start snapshot of the inode cache
+ *
+ * A looper thread periodically writes the wire handles of the most
+ * recently used entries, together with the handle of each cached
+ * directory's parent, to a local file.  At startup the file is read
+ * back and the handles are resolved through cache_inode_get by a
+ * small pool of worker threads, in the background and concurrently
+ * with the grace period, so that clients reclaiming state after a
+ * restart or failover find their objects already cached.
+ *
+ * Only handles are saved.  Names are not: a dirent saved before the
+ * restart cannot be revalidated without a lookup, so directory
+ * contents are rebuilt on demand as before.
+ */
+
+#include "config.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "log.h"
+#include "fsal.h"
+#include "nfs_core.h"
+#include "nfs_fh.h"
+#include "export_mgr.h"
+#include "cache_inode.h"
+#include "cache_inode_lru.h"
+#include "abstract_atomic.h"
+#include "fridgethr.h"
+
+/** Snapshot file magic, "GWRM" */
+#define WARM_MAGIC 0x4757524d
+#define WARM_VERSION 1
+
+/**
+ * @brief Snapshot file header
+ *
+ * The snapshot is only ever read back by the host that wrote it, so
+ * it is kept in host byte order.
+ */
+
+struct warm_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;		/*< Number of records that follow */
+	uint32_t reserved;
+};
+
+/**
+ * @brief On-disk record, followed by the handle and parent bytes
+ */
+
+struct warm_record {
+	uint16_t export_id;
+	uint16_t handle_len;
+	uint16_t parent_len;	/*< 0 unless a directory with a known parent */
+	uint16_t type;
+};
+
+/**
+ * @brief A record read back at startup
+ */
+
+struct warm_entry {
+	uint16_t export_id;
+	uint16_t handle_len;
+	uint16_t parent_len;
+	char handle[NFS4_FHSIZE];
+	char parent[NFS4_FHSIZE];
+};
+
+/**
+ * @brief Shared state of one preload
+ *
+ * Every preload job claims records from @c next until none remain,
+ * so the work balances itself across however many threads the
+ * fridge runs.  The last job to finish frees the load.
+ */
+
+struct warm_load {
+	struct warm_entry *entries;
+	uint32_t count;
+	uint32_t next;		/*< Next record to claim */
+	uint32_t jobs;		/*< Jobs still running */
+	uint32_t loaded;
+	uint32_t failed;
+	struct timespec start;
+};
+
+/** Looper writing periodic snapshots */
+static struct fridgethr *warm_fridge;
+/** Workers preloading the snapshot at startup */
+static struct fridgethr *warm_load_fridge;
+/** True while a preload is in progress */
+static uint32_t warm_loading;
+/** The preload in progress, for shutdown to reclaim */
+static struct warm_load *warm_load_cur;
+/** Time of the last snapshot (or of startup) */
+static time_t warm_last;
+
+/**
+ * @brief Free a finished or abandoned preload
+ *
+ * @param[in] wl  The load
+ */
+
+static void warm_load_free(struct warm_load *wl)
+{
+	atomic_store_voidptr((void **)&warm_load_cur, NULL);
+	gsh_free(wl->entries);
+	gsh_free(wl);
+	atomic_store_uint32_t(&warm_loading, false);
+}
+
+/**
+ * @brief Resolve a saved handle to a referenced cache entry
+ *
+ * op_ctx must be set up for the handle's export.
+ *
+ * @param[in]  handle  Saved wire handle
+ * @param[in]  len     Length of the handle
+ * @param[out] entry   Referenced entry on success
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t warm_get(const char *handle, uint16_t len,
+				     cache_entry_t **entry)
+{
+	char buf[NFS4_FHSIZE];
+	cache_inode_fsal_data_t fsal_data;
+	fsal_status_t fsal_status;
+	int flags = 0;
+
+#if (BYTE_ORDER == BIG_ENDIAN)
+	flags = FH_FSAL_BIG_ENDIAN;
+#endif
+
+	/* extract_handle may adjust the buffer, so work on a copy */
+	memcpy(buf, handle, len);
+	fsal_data.export = op_ctx->fsal_export;
+	fsal_data.fh_desc.addr = buf;
+	fsal_data.fh_desc.len = len;
+
+	fsal_status =
+	    fsal_data.export->exp_ops.extract_handle(fsal_data.export,
+						     FSAL_DIGEST_NFSV4,
+						     &fsal_data.fh_desc,
+						     flags);
+	if (FSAL_IS_ERROR(fsal_status))
+		return cache_inode_error_convert(fsal_status);
+
+	return cache_inode_get(&fsal_data, entry);
+}
+
+/**
+ * @brief Bring one saved entry, and its parent link, into the cache
+ *
+ * @param[in] we  The saved entry
+ *
+ * @return true if the entry is now cached.
+ */
+
+static bool warm_load_one(struct warm_entry *we)
+{
+	struct gsh_export *export = get_gsh_export(we->export_id);
+	struct root_op_context root_op_context;
+	cache_entry_t *entry = NULL;
+	cache_entry_t *parent = NULL;
+	cache_inode_status_t status;
+
+	if (export == NULL) {
+		/* export has gone away since the snapshot */
+		return false;
+	}
+
+	init_root_op_context(&root_op_context, export, export->fsal_export,
+			     0, 0, UNKNOWN_REQUEST);
+
+	status = warm_get(we->handle, we->handle_len, &entry);
+	if (status != CACHE_INODE_SUCCESS) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "Could not preload handle for export %u: %s",
+			     we->export_id, cache_inode_err_str(status));
+		goto out;
+	}
+
+	if (entry->type == DIRECTORY && we->parent_len != 0 &&
+	    warm_get(we->parent, we->parent_len, &parent) ==
+	    CACHE_INODE_SUCCESS) {
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		if (entry->object.dir->parent.kv.len == 0)
+			cache_inode_key_dup(&entry->object.dir->parent,
+					    &parent->fh_hk.key);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		cache_inode_put(parent);
+	}
+
+	cache_inode_put(entry);
+
+ out:
+	release_root_op_context();
+	put_gsh_export(export);
+
+	return status == CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Preload worker
+ *
+ * Stops early if the fridge is shutting down or the cache reaches
+ * its high water mark, since loading further would only evict what
+ * was just loaded.
+ *
+ * @param[in] ctx  Thread context, arg is the shared load
+ */
+
+static void warm_load_run(struct fridgethr_context *ctx)
+{
+	struct warm_load *wl = ctx->arg;
+	struct timespec end;
+	uint32_t ix;
+
+	SetNameFunction("cache_warm");
+
+	while (!fridgethr_you_should_break(ctx) &&
+	       atomic_fetch_uint64_t(&lru_state.entries_used) <
+	       lru_state.entries_hiwat) {
+		ix = atomic_postinc_uint32_t(&wl->next);
+		if (ix >= wl->count)
+			break;
+		if (warm_load_one(&wl->entries[ix]))
+			atomic_inc_uint32_t(&wl->loaded);
+		else
+			atomic_inc_uint32_t(&wl->failed);
+	}
+
+	if (atomic_dec_uint32_t(&wl->jobs) != 0)
+		return;
+
+	now(&end);
+	LogEvent(COMPONENT_CACHE_INODE,
+		 "Warm start preloaded %" PRIu32 " of %" PRIu32
+		 " entries (%" PRIu32 " failed) in %" PRIu64 " ms",
+		 wl->loaded, wl->count, wl->failed,
+		 timespec_diff(&wl->start, &end) / NS_PER_MSEC);
+
+	warm_load_free(wl);
+}
+
+/**
+ * @brief Read a snapshot file
+ *
+ * @param[out] count  Number of entries read
+ *
+ * @return The entries, or NULL if there is no usable snapshot.
+ */
+
+static struct warm_entry *warm_read(uint32_t *count)
+{
+	struct warm_header hdr;
+	struct warm_record rec;
+	struct warm_entry *entries = NULL;
+	uint32_t n = 0;
+	FILE *fp;
+
+	fp = fopen(cache_param.warm_start_file, "r");
+	if (fp == NULL) {
+		LogInfo(COMPONENT_CACHE_INODE,
+			"No warm start snapshot at %s: %s",
+			cache_param.warm_start_file, strerror(errno));
+		return NULL;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    hdr.magic != WARM_MAGIC || hdr.version != WARM_VERSION) {
+		LogWarn(COMPONENT_CACHE_INODE,
+			"Ignoring invalid warm start snapshot %s",
+			cache_param.warm_start_file);
+		goto out;
+	}
+
+	if (hdr.count > cache_param.warm_start_entries)
+		hdr.count = cache_param.warm_start_entries;
+	if (hdr.count == 0)
+		goto out;
+
+	entries = gsh_calloc(hdr.count, sizeof(*entries));
+	if (entries == NULL) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Unable to allocate warm start entries");
+		goto out;
+	}
+
+	for (n = 0; n < hdr.count; n++) {
+		struct warm_entry *we = &entries[n];
+
+		if (fread(&rec, sizeof(rec), 1, fp) != 1 ||
+		    rec.handle_len == 0 || rec.handle_len > NFS4_FHSIZE ||
+		    rec.parent_len > NFS4_FHSIZE ||
+		    fread(we->handle, rec.handle_len, 1, fp) != 1 ||
+		    (rec.parent_len != 0 &&
+		     fread(we->parent, rec.parent_len, 1, fp) != 1)) {
+			LogWarn(COMPONENT_CACHE_INODE,
+				"Warm start snapshot %s truncated after %"
+				PRIu32 " entries",
+				cache_param.warm_start_file, n);
+			break;
+		}
+		we->export_id = rec.export_id;
+		we->handle_len = rec.handle_len;
+		we->parent_len = rec.parent_len;
+	}
+
+	if (n == 0) {
+		gsh_free(entries);
+		entries = NULL;
+	}
+
+ out:
+	fclose(fp);
+	*count = n;
+	return entries;
+}
+
+/**
+ * @brief Start preloading the saved snapshot
+ *
+ * @return 0 on success or if there is nothing to load, else errors.
+ */
+
+static int warm_load_start(void)
+{
+	struct warm_load *wl;
+	uint32_t count;
+	uint32_t jobs;
+	struct warm_entry *entries = warm_read(&count);
+	int rc = 0;
+
+	if (entries == NULL)
+		return 0;
+
+	wl = gsh_calloc(1, sizeof(*wl));
+	if (wl == NULL) {
+		gsh_free(entries);
+		return ENOMEM;
+	}
+
+	wl->entries = entries;
+	wl->count = count;
+	now(&wl->start);
+
+	jobs = MIN(cache_param.warm_start_threads, count);
+	wl->jobs = jobs;
+	atomic_store_voidptr((void **)&warm_load_cur, wl);
+	atomic_store_uint32_t(&warm_loading, true);
+
+	LogEvent(COMPONENT_CACHE_INODE,
+		 "Preloading %" PRIu32 " entries from %s with %" PRIu32
+		 " threads", count, cache_param.warm_start_file, jobs);
+
+	while (jobs > 0) {
+		rc = fridgethr_submit(warm_load_fridge, warm_load_run, wl);
+		if (rc != 0) {
+			LogMajor(COMPONENT_CACHE_INODE,
+				 "Unable to start warm start thread: %d", rc);
+			break;
+		}
+		--jobs;
+	}
+
+	/* Account for jobs that never started; the last one running
+	 * frees the load. */
+	if (jobs > 0 && atomic_sub_uint32_t(&wl->jobs, jobs) == 0)
+		warm_load_free(wl);
+
+	return rc;
+}
+
+/**
+ * @brief Write one entry to the snapshot
+ *
+ * @param[in] fp     Snapshot file
+ * @param[in] entry  Referenced entry
+ *
+ * @return true if a record was written.
+ */
+
+static bool warm_save_one(FILE *fp, cache_entry_t *entry)
+{
+	struct warm_record rec;
+	struct gsh_export *export = NULL;
+	struct root_op_context root_op_context;
+	struct gsh_buffdesc fh_desc;
+	char handle[NFS4_FHSIZE];
+	char parent[NFS4_FHSIZE];
+	cache_inode_key_t pkey = { .kv = { NULL, 0 } };
+	cache_entry_t *pentry;
+	cache_inode_status_t status;
+	fsal_status_t fsal_status;
+	struct gsh_export *first;
+	bool written = false;
+
+	PTHREAD_RWLOCK_rdlock(&entry->attr_lock);
+	first = atomic_fetch_voidptr(&entry->first_export);
+	if (first != NULL) {
+		rec.export_id = first->export_id;
+		export = get_gsh_export(rec.export_id);
+	}
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	if (export == NULL)
+		return false;
+
+	init_root_op_context(&root_op_context, export, export->fsal_export,
+			     0, 0, UNKNOWN_REQUEST);
+
+	fh_desc.addr = handle;
+	fh_desc.len = sizeof(handle);
+	fsal_status = entry->obj_handle->obj_ops.handle_digest(
+				entry->obj_handle, FSAL_DIGEST_NFSV4, &fh_desc);
+	if (FSAL_IS_ERROR(fsal_status))
+		goto out;
+
+	rec.handle_len = fh_desc.len;
+	rec.parent_len = 0;
+	rec.type = entry->type;
+
+	if (entry->type == DIRECTORY) {
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		if (entry->object.dir->parent.kv.len != 0)
+			cache_inode_key_dup(&pkey, &entry->object.dir->parent);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
+
+	if (pkey.kv.len != 0) {
+		pentry = cache_inode_get_keyed(&pkey,
+					       CIG_KEYED_FLAG_CACHED_ONLY,
+					       &status);
+		if (pentry != NULL) {
+			fh_desc.addr = parent;
+			fh_desc.len = sizeof(parent);
+			fsal_status = pentry->obj_handle->obj_ops.handle_digest(
+				pentry->obj_handle, FSAL_DIGEST_NFSV4,
+				&fh_desc);
+			if (!FSAL_IS_ERROR(fsal_status))
+				rec.parent_len = fh_desc.len;
+			cache_inode_put(pentry);
+		}
+		cache_inode_key_delete(&pkey);
+	}
+
+	written = fwrite(&rec, sizeof(rec), 1, fp) == 1 &&
+		  fwrite(handle, rec.handle_len, 1, fp) == 1 &&
+		  (rec.parent_len == 0 ||
+		   fwrite(parent, rec.parent_len, 1, fp) == 1);
+
+ out:
+	release_root_op_context();
+	put_gsh_export(export);
+
+	return written;
+}
+
+/**
+ * @brief Write a snapshot of the hottest entries
+ *
+ * The snapshot is written to a temporary file and renamed into
+ * place, so a crash part way through leaves the previous one intact.
+ */
+
+static void warm_snapshot(void)
+{
+	char tmp[MAXPATHLEN];
+	struct warm_header hdr = {
+		.magic = WARM_MAGIC,
+		.version = WARM_VERSION,
+	};
+	cache_entry_t **entries;
+	size_t count, ix;
+	FILE *fp;
+	bool ok = true;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp",
+		     cache_param.warm_start_file) >= (int)sizeof(tmp)) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Warm start file name %s too long",
+			cache_param.warm_start_file);
+		return;
+	}
+
+	entries = gsh_malloc(cache_param.warm_start_entries *
+			     sizeof(*entries));
+	if (entries == NULL) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Unable to allocate warm start snapshot");
+		return;
+	}
+
+	count = cache_inode_lru_hot(entries, cache_param.warm_start_entries);
+
+	fp = fopen(tmp, "w");
+	if (fp == NULL) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Unable to create warm start snapshot %s: %s",
+			tmp, strerror(errno));
+		ok = false;
+	} else if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+		ok = false;
+	}
+
+	for (ix = 0; ix < count; ix++) {
+		if (ok && warm_save_one(fp, entries[ix]))
+			hdr.count++;
+		cache_inode_lru_unref(entries[ix], LRU_FLAG_NONE);
+	}
+	gsh_free(entries);
+
+	if (fp == NULL)
+		return;
+
+	/* now that we know the count, rewrite the header */
+	if (ok)
+		ok = fseek(fp, 0, SEEK_SET) == 0 &&
+		     fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+		     fflush(fp) == 0 &&
+		     fsync(fileno(fp)) == 0;
+
+	if (fclose(fp) != 0)
+		ok = false;
+
+	if (!ok || rename(tmp, cache_param.warm_start_file) != 0) {
+		LogCrit(COMPONENT_CACHE_INODE,
+			"Unable to write warm start snapshot %s: %s",
+			cache_param.warm_start_file, strerror(errno));
+		unlink(tmp);
+		return;
+	}
+
+	warm_last = time(NULL);
+	LogDebug(COMPONENT_CACHE_INODE,
+		 "Wrote %" PRIu32 " entries to warm start snapshot %s",
+		 hdr.count, cache_param.warm_start_file);
+}
+
+/**
+ * @brief Snapshot looper
+ *
+ * Skips its turn while a preload is running, since the cache does
+ * not yet reflect the workload.
+ *
+ * @param[in] ctx  Thread context
+ */
+
+static void warm_run(struct fridgethr_context *ctx)
+{
+	SetNameFunction("cache_snap");
+
+	if (atomic_fetch_uint32_t(&warm_loading))
+		return;
+
+	/* The looper runs once as soon as it starts; don't overwrite
+	 * the snapshot with an almost empty cache. */
+	if (time(NULL) - warm_last <
+	    (time_t) cache_param.warm_start_interval / 2)
+		return;
+
+	warm_snapshot();
+}
+
+/**
+ * @brief Start warm-start preloading and snapshots
+ *
+ * Must be called after the exports have been loaded.  Does nothing
+ * if no Warm_Start_File is configured.
+ *
+ * @return 0 on success, POSIX errors on failure.
+ */
+
+int cache_inode_warm_pkginit(void)
+{
+	struct fridgethr_params frp;
+	int rc;
+
+	if (cache_param.warm_start_file == NULL)
+		return 0;
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = cache_param.warm_start_threads;
+	frp.thr_min = 0;
+	frp.flavor = fridgethr_flavor_worker;
+	frp.deferment = fridgethr_defer_queue;
+
+	rc = fridgethr_init(&warm_load_fridge, "Warm_load_fridge", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize warm start fridge, error code %d.",
+			 rc);
+		return rc;
+	}
+
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = cache_param.warm_start_interval;
+	frp.flavor = fridgethr_flavor_looper;
+
+	rc = fridgethr_init(&warm_fridge, "Warm_fridge", &frp);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to initialize snapshot fridge, error code %d.",
+			 rc);
+		return rc;
+	}
+
+	warm_last = time(NULL);
+
+	rc = warm_load_start();
+	if (rc != 0)
+		return rc;
+
+	rc = fridgethr_submit(warm_fridge, warm_run, NULL);
+	if (rc != 0) {
+		LogMajor(COMPONENT_CACHE_INODE,
+			 "Unable to start snapshot thread, error code %d.", rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Stop preloading and write a final snapshot
+ *
+ * Must be called before the exports are removed.  If a preload was
+ * interrupted, the existing snapshot is kept, as it describes the
+ * workload better than the partially warmed cache does.  Preload jobs
+ * still queued when the fridge stopped never run, so the load they
+ * share is freed here.
+ */
+
+void cache_inode_warm_pkgshutdown(void)
+{
+	struct fridgethr *frs[] = { warm_load_fridge, warm_fridge };
+	struct warm_load *wl;
+	int ix, rc;
+
+	if (cache_param.warm_start_file == NULL)
+		return;
+
+	for (ix = 0; ix < 2; ix++) {
+		if (frs[ix] == NULL)
+			continue;
+		rc = fridgethr_sync_command(frs[ix], fridgethr_comm_stop, 120);
+		if (rc == ETIMEDOUT) {
+			LogMajor(COMPONENT_CACHE_INODE,
+				 "Shutdown timed out, cancelling threads.");
+			fridgethr_cancel(frs[ix]);
+		} else if (rc != 0) {
+			LogMajor(COMPONENT_CACHE_INODE,
+				 "Failed shutting down warm start thread: %d",
+				 rc);
+		}
+	}
+
+	if (!atomic_fetch_uint32_t(&warm_loading)) {
+		warm_snapshot();
+		return;
+	}
+
+	wl = atomic_fetch_voidptr((void **)&warm_load_cur);
+	if (wl != NULL) {
+		LogEvent(COMPONENT_CACHE_INODE,
+			 "Warm start preload interrupted after %" PRIu32
+			 " of %" PRIu32 " entries", wl->loaded, wl->count);
+		warm_load_free(wl);
+	}
+}
+
+/** @} */
@@ -67,6 +67,8 @@ typedef struct cache_entry_t cache_entry_t;
 #include "nlm4.h"
 #include "gsh_list.h"
 #include "gsh_types.h"
+#include "range_lock.h"
+#include "interval_tree.h"
 #include "nfs4_acls.h"
 
 /**
@@ -102,6 +104,31 @@ struct cache_inode_parameter {
 	/** Use getattr for directory invalidation.  Defaults to
 	    false.  Settable with Use_Getattr_Directory_Invalidation. */
 	bool getattr_dir_invalidation;
+	struct {
+		/** Attribute expiration in milliseconds for regular
+		    files, directories and symbolic links.  0 (the
+		    default) uses the export's Attr_Expiration_Time.
+		    These only replace a positive expiration; they
+		    never enable caching where it was disabled.
+		    Settable with Attr_Expiration_Msec_File,
+		    Attr_Expiration_Msec_Dir and
+		    Attr_Expiration_Msec_Symlink. */
+		uint32_t file_ms;
+		uint32_t dir_ms;
+		uint32_t symlink_ms;
+		/** Lengthen the expiration of objects whose change
+		    time stays put.  Defaults to false, settable with
+		    Attr_Expiration_Adaptive. */
+		bool adaptive;
+		/** Unchanged refreshes before the expiration starts
+		    doubling.  Defaults to 3, settable with
+		    Attr_Adaptive_Stable_Refreshes. */
+		uint32_t stable_refreshes;
+		/** Cap on the adaptive expiration in milliseconds.
+		    Defaults to 600000, settable with
+		    Attr_Adaptive_Max_Msec. */
+		uint32_t adaptive_max_ms;
+	} expire;
 	struct {
 		/** Max size of per-directory cache of removed
 		    entries */
@@ -152,6 +179,20 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Local file holding the warm-start snapshot of hot cache
+	    entries.  Unset (the default) disables warm start.
+	    Settable with Warm_Start_File. */
+	char *warm_start_file;
+	/** Interval in seconds between snapshots.  Defaults to 300,
+	    settable with Warm_Start_Interval. */
+	uint32_t warm_start_interval;
+	/** Maximum number of entries saved in a snapshot and
+	    preloaded at startup.  Defaults to 10000, settable with
+	    Warm_Start_Entries. */
+	uint32_t warm_start_entries;
+	/** Number of threads preloading the snapshot at startup.
+	    Defaults to 4, settable with Warm_Start_Threads. */
+	uint32_t warm_start_threads;
 };
 
 /** @} */
@@ -211,6 +252,19 @@ struct cache_stats {
 
 extern struct cache_stats *cache_stp;
 
+/**
+ * @brief Memory held by cache entries, indexed by object type
+ *
+ * Bytes count the entry itself, its type-specific part and its hash
+ * key, but not the FSAL handle, whose size only the FSAL knows.
+ */
+struct cache_mem_stats {
+	uint64_t entries[EXTENDED_ATTR + 1];
+	uint64_t bytes[EXTENDED_ATTR + 1];
+};
+
+extern struct cache_mem_stats cache_mem_st;
+
 /**
  * Indicate whether this is a read or write operation, for
  * cache_inode_rdwr.
@@ -378,6 +432,75 @@ struct file_deleg_stats {
 	uint32_t fds_num_opens;         /* total num of opens so far. */
 	time_t fds_first_open;          /* time that we started recording
 					   num_opens */
+	clientid4 fds_last_client;      /* client of the last open */
+	time_t fds_last_shared;         /* last open by another client than
+					   the one before */
+	time_t fds_last_write;          /* last open for write */
+	time_t fds_backoff;             /* no delegation for this long after
+					   fds_last_recall */
+};
+
+/**
+ * @brief Regular file specific part of a cached inode
+ *
+ * Allocated from cache_inode_file_pool when a REGULAR_FILE entry is
+ * created, and referenced by cache_entry_t::object.file.
+ */
+
+struct cache_inode_file {
+	/** Pointers for lock list */
+	struct glist_head lock_list;
+	/** Everything on lock_list, by byte range */
+	struct interval_tree lock_tree;
+	/** Locks on lock_list not yet granted, oldest first */
+	struct glist_head blocked_locks;
+	/** Export of the locks on lock_list, and how many are through
+	    some other export.  The latter rarely leaves 0, so a LOCK
+	    need not look at every lock to rule out an export conflict. */
+	struct gsh_export *lock_export;
+	uint32_t lock_foreign;
+	/** Pointers for NLM share list */
+	struct glist_head nlm_share_list;
+	/** Share reservation state for this file. */
+	cache_inode_share_t share_state;
+	bool write_delegated; /* true iff write delegated */
+	uint32_t anon_ops;   /* number of anonymous operations
+			      * happening at the moment which
+			      * prevents delegations from being
+			      * granted */
+	/** Delegation statistics */
+	struct file_deleg_stats fdeleg_stats;
+	/** Byte ranges under READ or WRITE.  Orders overlapping I/O
+	    so the content lock need only be held shared across it. */
+	struct range_lock io_range;
+};
+
+/**
+ * @brief Directory specific part of a cached inode
+ *
+ * Allocated from cache_inode_dir_pool when a DIRECTORY entry is
+ * created, and referenced by cache_entry_t::object.dir.
+ */
+
+struct cache_inode_dir {
+	/** Number of known active children */
+	uint32_t nbactive;
+	/** The parent of this directory ('..') */
+	cache_inode_key_t parent;
+	struct {
+		/** Children */
+		struct avltree t;
+		/** Persist cookies */
+		struct avltree c;
+		/** Heuristic. Expect 0. */
+		uint32_t collisions;
+	} avl;
+	/** If this is a junction, the export this node points
+	    to. Protected by the attr_lock. */
+	struct gsh_export *junction_export;
+	/** List of exports that have this cache inode
+	    as their root. Protected by the attr_lock. */
+	struct glist_head export_roots;
 };
 
 /**
@@ -428,6 +551,14 @@ struct file_deleg_stats {
  * The attributes and symlink contents are stored in the handle for
  * api simplicity but these locks apply around their access methods.
  *
+ * Fields are ordered hottest first.  The first cache line holds the
+ * hash linkage compared on every lookup by handle; the second holds
+ * the LRU state touched by every reference, together with the handle,
+ * type and flags most requests examine next.  Locks and lists follow.
+ * Type-specific content (file state lists, directory AVL trees) is
+ * allocated separately, so that symlinks and special files pay for
+ * neither.
+ *
  * @note As part of the transition to the new api, the handle was
  * moved out of the union and made a pointer to a separately allocated
  * object.  However, locking applies everywhere except handle object
@@ -439,35 +570,53 @@ struct file_deleg_stats {
  */
 
 struct cache_entry_t {
-	/** Reader-writer lock for attributes */
-	pthread_rwlock_t attr_lock;
-	/** The FSAL Handle */
-	struct fsal_obj_handle *obj_handle;
 	/** FH hash linkage */
 	struct {
 		struct avltree_node node_k;	/*< AVL node in tree */
 		cache_inode_key_t key;	/*< Key of this entry */
 		bool inavl;
 	} fh_hk;
+	/** New style LRU link */
+	cache_inode_lru_t lru;
+	/** The FSAL Handle */
+	struct fsal_obj_handle *obj_handle;
+	/** Atomic pointer to the first mapped export for fast path */
+	void *first_export;
 	/** The type of the entry */
 	object_file_type_t type;
 	/** Flags for this entry */
 	uint32_t flags;
-	/** refcount for number of active icreate */
-	int32_t icreate_refcnt;
+	/** Monotonic time in nsecs at which we last refreshed
+	    attributes. */
+	uint64_t attr_time;
+	/** How long the attributes stay valid after attr_time, in
+	    nsecs.  0 means never, UINT64_MAX means forever. */
+	uint64_t attr_ttl;
+	/** Refreshes in a row that found change_time unchanged */
+	uint32_t attr_stable;
 	/** The time of the last operation ganesha knows about.  We
 	    can ue this for change_info4, but atomic MUST be set to
 	    false.  Don't use it for anything else (servicing getattr,
 	    etc.) */
 	time_t change_time;
-	/** Time at which we last refreshed attributes. */
-	time_t attr_time;
-	/** New style LRU link */
-	cache_inode_lru_t lru;
+	/** Filetype specific data, discriminated by the type field.
+	    NULL for types with no cached content.  Note that data for
+	    special files is in attributes.rawdev */
+	union cache_inode_fsobj {
+		struct cache_inode_file *file;	/*< REGULAR_FILE data */
+		struct cache_inode_dir *dir;	/*< DIRECTORY data */
+	} object;
+	/** refcount for number of active icreate */
+	int32_t icreate_refcnt;
 	/** There is one export root reference counted for each export
 	    for which this entry is a root for. This field is used
 	    with the atomic inc/dec/fetch routines. */
 	int32_t exp_root_refcount;
+	/** Reader-writer lock for attributes */
+	pthread_rwlock_t attr_lock;
+	/** Lock on type-specific cached content.  See locking
+	    discipline for details. */
+	pthread_rwlock_t content_lock;
 	/** This is separated out from the content lock, since there
 	    are state oerations that don't affect anything guarded by
 	    content (for example, a layout return or request has no
@@ -479,54 +628,8 @@ struct cache_entry_t {
 	struct glist_head list_of_states;
 	/** Exports per entry (protected by attr_lock) */
 	struct glist_head export_list;
-	/** Atomic pointer to the first mapped export for fast path */
-	void *first_export;
 	/** Layout recalls on this entry */
 	struct glist_head layoutrecall_list;
-	/** Lock on type-specific cached content.  See locking
-	    discipline for details. */
-	pthread_rwlock_t content_lock;
-	/** Filetype specific data, discriminated by the type field.
-	    Note that data for special files is in
-	    attributes.rawdev */
-	union cache_inode_fsobj {
-		struct cache_inode_file {
-			/** Pointers for lock list */
-			struct glist_head lock_list;
-			/** Pointers for NLM share list */
-			struct glist_head nlm_share_list;
-			/** Share reservation state for this file. */
-			cache_inode_share_t share_state;
-			bool write_delegated; /* true iff write delegated */
-			/** Delegation statistics */
-			struct file_deleg_stats fdeleg_stats;
-			uint32_t anon_ops;   /* number of anonymous operations
-					      * happening at the moment which
-					      * prevents delegations from being
-					      * granted */
-		} file;		/*< REGULAR_FILE data */
-
-		struct {
-			/** Number of known active children */
-			uint32_t nbactive;
-			/** The parent of this directory ('..') */
-			cache_inode_key_t parent;
-			struct {
-				/** Children */
-				struct avltree t;
-				/** Persist cookies */
-				struct avltree c;
-				/** Heuristic. Expect 0. */
-				uint32_t collisions;
-			} avl;
-			/** If this is a junction, the export this node points
-			    to. Protected by the attr_lock. */
-			struct gsh_export *junction_export;
-			/** List of exports that have this cache inode
-			    as their root. Protected by the attr_lock. */
-			struct glist_head export_roots;
-		} dir;		/*< DIRECTORY data */
-	} object;
 };
 
 /**
@@ -560,6 +663,8 @@ typedef struct cache_inode_fsal_data {
 
 /** Cache entries pool */
 extern pool_t *cache_inode_entry_pool;
+extern pool_t *cache_inode_file_pool;
+extern pool_t *cache_inode_dir_pool;
 
 /**
  * Type-specific data passed to cache_inode_new_entry
@@ -815,6 +920,8 @@ cache_inode_status_t cache_inode_setattr(cache_entry_t *entry,
 
 cache_inode_status_t cache_inode_error_convert(fsal_status_t fsal_status);
 
+bool cache_inode_fsobj_init(cache_entry_t *entry);
+void cache_inode_fsobj_release(cache_entry_t *entry);
 cache_inode_status_t cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 					   uint32_t flags,
 					   cache_entry_t **entry);
@@ -872,6 +979,9 @@ int cache_inode_set_time_current(struct timespec *time);
 
 void cache_inode_destroyer(void);
 
+int cache_inode_warm_pkginit(void);
+void cache_inode_warm_pkgshutdown(void);
+
 /**
 ** Resolve forward declarations
 */
@@ -891,19 +1001,62 @@ void cache_inode_destroyer(void);
 static inline void
 cache_inode_fixup_md(cache_entry_t *entry)
 {
-	/* Set the refresh time for the cache entry */
-	if (entry->obj_handle->attrs->expire_time_attr > 0)
-		entry->attr_time = time(NULL);
-	else
-		entry->attr_time = 0;
+	int32_t expire = entry->obj_handle->attrs->expire_time_attr;
+	uint64_t ttl, max;
+	time_t change_time;
+	uint32_t ms = 0;
+	uint32_t shift;
 
 	/* I don't like using nsecs as a counter, it will be annoying in
 	 * 500 years.  I'll fix to match MS nano-intervals later.
 	 *
 	 * Also, fsal attrs has a changetime.
 	 * (Matt). */
-	entry->change_time =
-	    timespec_to_nsecs(&entry->obj_handle->attrs->chgtime);
+	change_time = timespec_to_nsecs(&entry->obj_handle->attrs->chgtime);
+
+	if (entry->change_time != 0 && change_time == entry->change_time)
+		entry->attr_stable++;
+	else
+		entry->attr_stable = 0;
+	entry->change_time = change_time;
+
+	/* Work out how long these attributes may be trusted */
+	if (expire == 0) {
+		ttl = 0;
+	} else if (expire < 0) {
+		ttl = UINT64_MAX;
+	} else {
+		switch (entry->type) {
+		case REGULAR_FILE:
+			ms = cache_param.expire.file_ms;
+			break;
+		case DIRECTORY:
+			ms = cache_param.expire.dir_ms;
+			break;
+		case SYMBOLIC_LINK:
+			ms = cache_param.expire.symlink_ms;
+			break;
+		default:
+			break;
+		}
+		ttl = ms != 0 ? ms * NS_PER_MSEC : expire * NS_PER_SEC;
+
+		/* Back off on objects that are not changing, doubling
+		 * for each unchanged refresh past the threshold, up to
+		 * the cap. */
+		max = cache_param.expire.adaptive_max_ms * NS_PER_MSEC;
+		if (cache_param.expire.adaptive && ttl < max &&
+		    entry->attr_stable > cache_param.expire.stable_refreshes) {
+			shift = entry->attr_stable -
+				cache_param.expire.stable_refreshes;
+			while (shift-- > 0 && ttl < max)
+				ttl <<= 1;
+			ttl = MIN(ttl, max);
+		}
+	}
+
+	entry->attr_ttl = ttl;
+	entry->attr_time = mono_nsecs();
 
 	/* We have just loaded the attributes from the FSAL. */
 	entry->flags |= CACHE_INODE_TRUST_ATTRS;
@@ -930,16 +1083,12 @@ cache_inode_is_attrs_valid(const cache_entry_t *entry)
 	    && cache_param.getattr_dir_invalidation)
 		return false;
 
-	if (entry->obj_handle->attrs->expire_time_attr == 0)
+	if (entry->attr_ttl == 0)
 		return false;
 
-	if (entry->obj_handle->attrs->expire_time_attr > 0) {
-		time_t current_time = time(NULL);
-
-		if (current_time - entry->attr_time >
-		    entry->obj_handle->attrs->expire_time_attr)
-			return false;
-	}
+	if (entry->attr_ttl != UINT64_MAX &&
+	    mono_nsecs() - entry->attr_time > entry->attr_ttl)
+		return false;
 
 	return true;
 }
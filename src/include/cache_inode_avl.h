@@ -93,7 +93,7 @@ cache_inode_dir_entry_t *cache_inode_avl_qp_lookup_s(cache_entry_t *entry,
 static inline void cache_inode_avl_remove(cache_entry_t *entry,
 					  cache_inode_dir_entry_t *v)
 {
-	avltree_remove(&v->node_hk, &entry->object.dir.avl.t);
+	avltree_remove(&v->node_hk, &entry->object.dir->avl.t);
 }
 
 #endif				/* CACHE_INODE_AVL_H */
@@ -39,6 +39,12 @@
  * This module exports an interface for efficient lookup of cache entries
  * by file handle, (etc?).  Refactored from the prior abstract HashTable
  * implementation.
+ *
+ * Writers are serialized by the partition lock as before.  Readers
+ * that only want a referenced entry (PUTFH and friends) may instead
+ * use cih_get_by_key_ref, which walks the partition under an epoch
+ * guard and validates the walk against the partition's sequence
+ * count, falling back to the shared lock only when it races a writer.
  */
 
 #ifndef CACHE_INODE_HASH_H
@@ -51,6 +57,7 @@
 #include "gsh_intrinsic.h"
 #include "cache_inode_lru.h"
 #include "city.h"
+#include "epoch_reclaim.h"
 #include <libgen.h>
 
 /**
@@ -61,6 +68,7 @@
  */
 typedef struct cih_partition {
 	uint32_t part_ix;
+	uint32_t seq;		/*< Odd while a writer is modifying t */
 	pthread_rwlock_t lock;
 	struct avltree t;
 	struct avltree_node **cache;
@@ -205,6 +213,71 @@ cih_fhcache_inline_lookup(const struct avltree *tree,
 	return NULL;
 }
 
+/**
+ * @brief Bound on a lockless tree walk
+ *
+ * A consistent AVL tree is far shallower than this; a walk exceeding
+ * it has raced a rotation and must be retried.
+ */
+#define CIH_MAX_DEPTH 64
+
+/**
+ * @brief Lockless avltree lookup
+ *
+ * Search for an entry matching key in avltree tree without holding the
+ * partition lock.  The caller MUST be in an epoch critical section and
+ * MUST validate the result against the partition sequence count.
+ *
+ * @param tree [in] The avltree to search
+ * @param key [in] Entry being searched for, as an avltree node
+ * @param node [out] Pointer to node if found, else NULL
+ *
+ * @return false if the walk was abandoned, else true.
+ */
+static inline bool
+cih_fhcache_lockless_lookup(const struct avltree *tree,
+			    const struct avltree_node *key,
+			    struct avltree_node **node)
+{
+	struct avltree_node *n =
+		atomic_fetch_voidptr((void **)&tree->root);
+	int depth, res;
+
+	for (depth = 0; n && depth < CIH_MAX_DEPTH; ++depth) {
+		res = cih_fh_cmpf(n, key);
+		if (res == 0)
+			break;
+		n = (res > 0) ? n->left : n->right;
+	}
+	*node = n;
+	return depth < CIH_MAX_DEPTH;
+}
+
+/**
+ * @brief Begin modifying a write-locked partition
+ *
+ * Makes the partition sequence count odd, so that concurrent lockless
+ * readers will discard whatever they observe until cih_write_end.
+ *
+ * @param cp [in] The partition, held with the write lock
+ */
+static inline void
+cih_write_begin(cih_partition_t *cp)
+{
+	(void)atomic_inc_uint32_t(&cp->seq);
+}
+
+/**
+ * @brief Finish modifying a write-locked partition
+ *
+ * @param cp [in] The partition, held with the write lock
+ */
+static inline void
+cih_write_end(cih_partition_t *cp)
+{
+	(void)atomic_inc_uint32_t(&cp->seq);
+}
+
 #define CIH_HASH_NONE           0x0000
 #define CIH_HASH_KEY_PROTOTYPE  0x0001
 
@@ -339,6 +412,112 @@ cih_get_by_key_latched(cache_inode_key_t *key, cih_latch_t *latch,
 	return entry;
 }
 
+/**
+ * @brief Number of lockless attempts before taking the partition lock
+ */
+#define CIH_LOCKLESS_RETRIES 3
+
+/**
+ * @brief Lookup cache entry by key and return it referenced.
+ *
+ * Lookup cache entry by key, without taking the partition lock in the
+ * common case.  The walk is performed under an epoch guard, so entries
+ * it touches cannot be freed underneath it, and a reference is taken
+ * only if the entry is still live.  The reference is kept only if the
+ * partition sequence count is unchanged (and even) across the whole
+ * operation, proving that the entry was hashed when referenced.  After
+ * repeated races with writers, falls back to the shared lock.
+ *
+ * Lockless walks do not refill the partition cache, since a stale
+ * store could resurrect a removed node.
+ *
+ * @param key [in] Key being searched
+ *
+ * @return Pointer to cache entry, with an initial reference, if found,
+ *         else NULL
+ */
+static inline cache_entry_t *
+cih_get_by_key_ref(cache_inode_key_t *key, const char *func, int line)
+{
+	cache_entry_t k_entry, *entry;
+	struct avltree_node *node;
+	cih_partition_t *cp;
+	cih_latch_t latch;
+	uint32_t seq;
+	int retry;
+
+	k_entry.fh_hk.key = *key;
+	cp = cih_partition_of_scalar(&cih_fhcache, key->hk);
+
+	for (retry = 0; retry < CIH_LOCKLESS_RETRIES; ++retry) {
+		epoch_enter();
+
+		seq = atomic_fetch_uint32_t(&cp->seq);
+		if (seq & 1) {
+			epoch_exit();
+			continue;
+		}
+
+		node = atomic_fetch_voidptr((void **)
+		    &(cp->cache[cih_cache_offsetof(&cih_fhcache, key->hk)]));
+		if (!node ||
+		    cih_fh_cmpf(&k_entry.fh_hk.node_k, node) != 0) {
+			if (!cih_fhcache_lockless_lookup(
+					&cp->t, &k_entry.fh_hk.node_k, &node)) {
+				epoch_exit();
+				continue;
+			}
+		}
+
+		if (!node) {
+			if (atomic_fetch_uint32_t(&cp->seq) == seq) {
+				/* the tree was stable: a true miss */
+				epoch_exit();
+				LogDebug(COMPONENT_HASHTABLE_CACHE,
+					 "fdcache MISS (lockless)");
+				return NULL;
+			}
+			epoch_exit();
+			continue;
+		}
+
+		entry = avltree_container_of(node, cache_entry_t,
+					     fh_hk.node_k);
+		if (!cache_inode_lru_ref_live(entry)) {
+			/* being freed, so certainly no longer hashed */
+			epoch_exit();
+			continue;
+		}
+
+		if (atomic_fetch_uint32_t(&cp->seq) == seq) {
+			epoch_exit();
+			cache_inode_lru_touch(entry, LRU_REQ_INITIAL);
+			LogDebug(COMPONENT_HASHTABLE_CACHE,
+				 "cih lockless hit slot %d",
+				 cih_cache_offsetof(&cih_fhcache, key->hk));
+			return entry;
+		}
+
+		/* Raced a writer.  Our reference keeps the entry alive, so
+		 * leave the critical section before returning it: the last
+		 * unref may call into the FSAL, and must not hold back the
+		 * grace period.  A recycler seeing the reference skips. */
+		epoch_exit();
+		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
+	}
+
+	/* contended; take the latch */
+	entry = cih_get_by_key_latched(key, &latch,
+				       CIH_GET_RLOCK | CIH_GET_UNLOCK_ON_MISS,
+				       func, line);
+	if (entry) {
+		(void) cache_inode_lru_ref(entry, LRU_REQ_INITIAL);
+		cih_latch_rele(&latch);
+	}
+
+	return entry;
+}
+
 /**
  * @brief Latch the partition of entry.
  *
@@ -402,8 +581,10 @@ cih_set_latched(cache_entry_t *entry, cih_latch_t *latch,
 				  fh_desc, CIH_HASH_NONE))
 			return 1;
 
+	cih_write_begin(cp);
 	(void)avltree_insert(&entry->fh_hk.node_k, &cp->t);
 	entry->fh_hk.inavl = true;
+	cih_write_end(cp);
 
 	if (likely(flags & CIH_SET_UNLOCK))
 		PTHREAD_RWLOCK_unlock(&cp->lock);
@@ -431,10 +612,12 @@ cih_remove_checked(cache_entry_t *entry)
 	PTHREAD_RWLOCK_wrlock(&cp->lock);
 	node = cih_fhcache_inline_lookup(&cp->t, &entry->fh_hk.node_k);
 	if (entry->fh_hk.inavl && node) {
+		cih_write_begin(cp);
 		avltree_remove(node, &cp->t);
 		cp->cache[cih_cache_offsetof(&cih_fhcache,
 					     entry->fh_hk.key.hk)] = NULL;
 		entry->fh_hk.inavl = false;
+		cih_write_end(cp);
 		/* return sentinel ref */
 		cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 	}
@@ -444,7 +627,11 @@ cih_remove_checked(cache_entry_t *entry)
 /**
  * @brief Remove cache entry protected by latch
  *
- * Remove cache entry.
+ * Remove cache entry.  With CIH_REMOVE_WRITING, the caller has already
+ * called cih_write_begin (typically before testing the refcount that
+ * justifies the removal, so that a lockless lookup cannot take a
+ * reference in between and still validate) and will call
+ * cih_write_end itself.
  *
  * @param entry [in] Entry to be removed.0
  *
@@ -453,6 +640,7 @@ cih_remove_checked(cache_entry_t *entry)
 #define CIH_REMOVE_NONE    0x0000
 #define CIH_REMOVE_UNLOCK  0x0001
 #define CIH_REMOVE_QLOCKED 0x0002
+#define CIH_REMOVE_WRITING 0x0004
 
 static inline bool
 cih_remove_latched(cache_entry_t *entry, cih_latch_t *latch, uint32_t flags)
@@ -462,10 +650,14 @@ cih_remove_latched(cache_entry_t *entry, cih_latch_t *latch, uint32_t flags)
 	uint32_t lflags = LRU_FLAG_NONE;
 
 	if (entry->fh_hk.inavl) {
+		if (!(flags & CIH_REMOVE_WRITING))
+			cih_write_begin(cp);
 		avltree_remove(&entry->fh_hk.node_k, &cp->t);
 		cp->cache[cih_cache_offsetof(&cih_fhcache,
 					     entry->fh_hk.key.hk)] = NULL;
 		entry->fh_hk.inavl = false;
+		if (!(flags & CIH_REMOVE_WRITING))
+			cih_write_end(cp);
 		if (flags & CIH_REMOVE_QLOCKED)
 			lflags |= LRU_UNREF_QLOCKED;
 		cache_inode_lru_unref(entry, lflags);
@@ -142,6 +142,7 @@ extern size_t open_fd_count;
 
 cache_inode_status_t cache_inode_lru_get(struct cache_entry_t **entry);
 cache_inode_status_t cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags);
+void cache_inode_lru_touch(cache_entry_t *entry, uint32_t flags);
 
 /* XXX */
 void cache_inode_lru_kill(cache_entry_t *entry);
@@ -151,6 +152,7 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry);
 void cache_inode_lru_unref(cache_entry_t *entry, uint32_t flags);
 void cache_inode_lru_putback(cache_entry_t *entry, uint32_t flags);
 void lru_wake_thread(void);
+size_t cache_inode_lru_hot(cache_entry_t **entries, size_t max);
 cache_inode_status_t cache_inode_inc_pin_ref(cache_entry_t *entry);
 void cache_inode_unpinnable(cache_entry_t *entry);
 void cache_inode_dec_pin_ref(cache_entry_t *entry, bool closefile);
@@ -178,6 +180,33 @@ static inline void cache_inode_put(cache_entry_t *entry)
 	cache_inode_lru_unref(entry, LRU_FLAG_NONE);
 }
 
+/**
+ * @brief Get a reference on an entry reached without the hash latch
+ *
+ * Takes a reference only if the entry still holds one, i.e. it is not
+ * already being freed.  Intended for lockless lookups inside an epoch
+ * critical section; the caller MUST then verify that the entry was
+ * still hashed, and return the reference if it was not.  No LRU
+ * adjustment is made (see cache_inode_lru_touch).
+ *
+ * @param[in] entry The entry on which to get a reference
+ *
+ * @return true if the reference was acquired.
+ */
+static inline bool cache_inode_lru_ref_live(cache_entry_t *entry)
+{
+	int32_t refcnt = atomic_fetch_int32_t(&entry->lru.refcnt);
+
+	while (refcnt > 0) {
+		if (atomic_cas_int32_t(&entry->lru.refcnt, refcnt,
+				       refcnt + 1))
+			return true;
+		refcnt = atomic_fetch_int32_t(&entry->lru.refcnt);
+	}
+
+	return false;
+}
+
 /**
  * Return true if there are FDs available to serve open requests,
  * false otherwise.  This function also wakes the LRU thread if the
@@ -44,6 +44,7 @@
 
 #include "avltree.h"
 #include "gsh_types.h"
+#include "nfs_req_queue.h"
 
 struct gsh_client {
 	struct avltree_node node_k;
@@ -52,6 +53,7 @@ struct gsh_client {
 	int64_t refcnt;
 	nsecs_elapsed_t last_update;
 	char *hostaddr_str;
+	struct req_flow flows[N_REQ_QUEUES];	/*< Dispatch queues by class */
 	unsigned char addrbuf[];
 };
 
@@ -509,6 +509,26 @@ static inline void now(struct timespec *ts)
 	}
 }
 
+/**
+ * @brief Get a monotonic timestamp in nanoseconds
+ *
+ * Suitable only for measuring intervals within this process.
+ *
+ * @return Nanoseconds since an arbitrary fixed point.
+ */
+
+static inline nsecs_elapsed_t mono_nsecs(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		LogCrit(COMPONENT_MAIN, "Failed to get monotonic timestamp");
+		assert(0);
+	}
+
+	return timespec_to_nsecs(&ts);
+}
+
 /**
  * @brief Copy a string into a buffer safely
  *
@@ -0,0 +1,53 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup cpu_affinity CPU topology and thread placement
+ *
+ * The NUMA layout is read once from sysfs, so there is no dependency
+ * on libnuma.  Without sysfs node information every CPU is taken to
+ * be on node 0.
+ *
+ * @{
+ */
+
+/**
+ * @file cpu_affinity.h
+ * @brief CPU topology and thread placement
+ */
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sched.h>
+
+void cpu_topology_init(void);
+uint32_t cpu_topology_nodes(void);
+uint32_t cpu_topology_node_of(int cpu);
+void cpu_topology_node_cpus(uint32_t node, cpu_set_t *set);
+bool cpu_list_parse(const char *list, cpu_set_t *set);
+int cpu_affinity_set_self(const cpu_set_t *set);
+
+#endif				/* CPU_AFFINITY_H */
+
+/** @} */
@@ -0,0 +1,115 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup epoch Epoch-based reclamation
+ *
+ * This provides a minimal RCU-like facility for read-mostly
+ * structures.  Readers bracket lockless traversals with
+ * epoch_enter() and epoch_exit(); writers, which remain serialized by
+ * whatever lock already protects the structure, unlink objects and
+ * hand them to epoch_defer() rather than freeing them in place.  A
+ * deferred object is released only after every reader that could
+ * have observed it has left its critical section (a grace period).
+ *
+ * Read-side critical sections MUST be short and MUST NOT block.
+ *
+ * @{
+ */
+
+/**
+ * @file epoch_reclaim.h
+ * @brief Header for the epoch-based reclamation package
+ */
+
+#ifndef EPOCH_RECLAIM_H
+#define EPOCH_RECLAIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "abstract_atomic.h"
+#include "gsh_list.h"
+#include "gsh_intrinsic.h"
+
+/**
+ * @brief Per-thread epoch record
+ *
+ * Each thread that enters a read-side critical section owns one of
+ * these.  Records are never freed; they are recycled when their
+ * thread exits.
+ */
+
+struct epoch_record {
+	uint64_t epoch;		/*< Epoch observed on entry, 0 if quiescent */
+	uint32_t nesting;	/*< Critical section nesting depth */
+	bool in_use;		/*< Owned by a live thread */
+	void *reserve;		/*< Spare deferral for when allocation fails */
+	struct glist_head rec_link;	/*< Link in the record list */
+	GSH_CACHE_PAD(0);
+};
+
+extern uint64_t epoch_global;
+extern __thread struct epoch_record *epoch_self;
+
+struct epoch_record *epoch_register(void);
+
+/**
+ * @brief Enter a read-side critical section
+ *
+ * Objects reachable from an epoch-protected structure will not be
+ * reclaimed until the matching epoch_exit().  Sections nest.
+ */
+
+static inline void epoch_enter(void)
+{
+	struct epoch_record *rec = epoch_self;
+
+	if (unlikely(rec == NULL))
+		rec = epoch_register();
+
+	if (rec->nesting++ == 0) {
+		atomic_store_uint64_t(&rec->epoch,
+				      atomic_fetch_uint64_t(&epoch_global));
+		/* order the epoch publication before any data loads */
+		__sync_synchronize();
+	}
+}
+
+/**
+ * @brief Leave a read-side critical section
+ */
+
+static inline void epoch_exit(void)
+{
+	struct epoch_record *rec = epoch_self;
+
+	if (--rec->nesting == 0)
+		atomic_store_uint64_t(&rec->epoch, 0);
+}
+
+void epoch_defer(void (*func)(void *), void *arg);
+void epoch_synchronize(void);
+void epoch_reclaim(void);
+void epoch_pkgshutdown(void);
+
+#endif				/* EPOCH_RECLAIM_H */
+
+/** @} */
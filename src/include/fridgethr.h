@@ -57,8 +57,9 @@ extern struct fridgethr *req_fridge;
  */
 
 typedef struct nfs_worker_data {
-	wait_q_entry_t wqe;	/*< Queue for coordinating with decoder */
 	unsigned int worker_index;	/*< Index for log messages */
+	uint32_t lane;		/*< Home dispatch lane */
+	struct glist_head batch;	/*< Requests dequeued, not yet run */
 } nfs_worker_data_t;
 
 /**
@@ -91,6 +92,7 @@ struct fridgethr_entry {
 	} ctx;
 	uint32_t flags; /*< Thread-fridge flags (for handoff) */
 	bool frozen; /*< Thread is frozen */
+	bool exiting; /*< Claimed an exit token, under the fridge mutex */
 	struct timespec timeout; /*< Wait timeout */
 	struct glist_head thread_link; /*< Link in the list of all
 					   threads */
@@ -212,6 +214,7 @@ struct fridgethr {
 	pthread_attr_t attr;	/*< Creation attributes */
 	struct glist_head thread_list;	/*< List of threads */
 	uint32_t nthreads;	/*< Number of threads in fridge */
+	uint32_t nexiting;	/*< Threads leaving after a shrink */
 	struct glist_head idle_q;	/*< Idle threads */
 	uint32_t nidle;		/*< Number of idle threads */
 	uint32_t flags;		/*< Fridge-wide flags */
@@ -261,6 +264,8 @@ int fridgethr_populate(struct fridgethr *, void (*)(struct fridgethr_context *),
 
 void fridgethr_setwait(struct fridgethr_context *ctx, time_t thread_delay);
 time_t fridgethr_getwait(struct fridgethr_context *ctx);
+void fridgethr_set_limits(struct fridgethr *fr, uint32_t thr_min,
+			  uint32_t thr_max);
 
 void fridgethr_cancel(struct fridgethr *fr);
 
@@ -0,0 +1,67 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup cksum Request checksums
+ *
+ * Non-cryptographic digests of request bodies, used to tell a
+ * retransmission from a new call that reuses its XID.  Only a bounded
+ * prefix of the data is hashed and its full length is folded in, so
+ * the cost of a digest does not grow with the size of the request.
+ *
+ * CRC32C uses the CPU's instruction where there is one (SSE4.2 on
+ * x86_64, the CRC extension on ARMv8) and a table otherwise.
+ *
+ * @{
+ */
+
+/**
+ * @file gsh_cksum.h
+ * @brief Request checksums
+ */
+
+#ifndef GSH_CKSUM_H
+#define GSH_CKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Hash functions a digest may use
+ */
+
+enum gsh_cksum_type {
+	GSH_CKSUM_TIRPC,	/*< Only TI-RPC's checksum of the record head */
+	GSH_CKSUM_CRC32C,	/*< CRC32C, in hardware if available */
+	GSH_CKSUM_XXHASH,	/*< xxHash64 */
+	GSH_CKSUM_CITY,		/*< CityHash64 */
+};
+
+void gsh_cksum_pkginit(void);
+bool gsh_cksum_hw(void);
+uint32_t gsh_crc32c(uint32_t crc, const void *buf, size_t len);
+uint64_t gsh_cksum(enum gsh_cksum_type type, const void *buf, size_t len,
+		   size_t max, uint64_t seed);
+
+#endif				/* GSH_CKSUM_H */
+
+/** @} */
@@ -82,6 +82,16 @@ typedef enum protos {
  */
 #define NB_WORKER_THREAD_DEFAULT 16
 
+/**
+ * @brief Default value for core_param.drc.budget_mb
+ */
+#define DRC_BUDGET_MB 64
+
+/**
+ * @brief Default value for core_param.drc.cksum_len
+ */
+#define DRC_CKSUM_LEN 256
+
 /**
  * @brief Default value for core_param.drc.tcp.npart
  */
@@ -200,6 +210,16 @@ typedef struct nfs_core_param {
 	/** Number of worker threads.  Set to NB_WORKER_DEFAULT by
 	    default and changed with the Nb_Worker option. */
 	uint32_t nb_worker;
+	/** Bounds within which the worker pool is resized to keep
+	    queue wait near worker_wait_target_ms.  Each defaults to
+	    0, meaning nb_worker, so that the pool is fixed unless
+	    they are set (Nb_Worker_Min and Nb_Worker_Max). */
+	uint32_t nb_worker_min;
+	uint32_t nb_worker_max;
+	/** Target time for requests to wait in the queue before a
+	    worker picks them up.  Defaults to 10 and settable by
+	    Worker_Wait_Target_Msec. */
+	uint32_t worker_wait_target_ms;
 	/** For NFSv3, whether to drop rather than reply to requests
 	    yielding I/O errors.  True by default and settable with
 	    Drop_IO_Errors.  As this generally results in client
@@ -224,11 +244,70 @@ typedef struct nfs_core_param {
 	    specific transport.  Defaults to 512 and settable by
 	    Dispatch_Max_Reqs_Xprt. */
 	uint32_t dispatch_max_reqs_xprt;
+	/** Number of dispatch lanes (per-CPU request queue sets).  0,
+	    the default, means one per online CPU.  Never more than
+	    the number of workers.  Settable by Dispatch_Lanes. */
+	uint32_t dispatch_lanes;
+	/** Operations a client with weight 1 may have dispatched per
+	    turn of the fair queue.  Defaults to 64 and settable by
+	    Dispatch_Quantum. */
+	uint32_t dispatch_quantum;
+	/** Most requests a worker takes from its lane at once, when
+	    no other worker is idle.  Defaults to 4 and settable by
+	    Dispatch_Batch. */
+	uint32_t dispatch_batch;
+	/** Microseconds an idle worker polls the lanes before going to
+	    sleep.  Defaults to 20 and settable by Dispatch_Spin_Usec. */
+	uint32_t dispatch_spin_usec;
+	/** Whether to shed load when requests queue too long.  Defaults
+	    to true and settable by Admission_Control. */
+	bool admission_control;
+	/** Queueing delay, in milliseconds, above which a lane counts
+	    as overloaded if it persists for an interval.  Defaults to
+	    20 and settable by Admission_Target_Msec. */
+	uint32_t admission_target_ms;
+	/** Admission control interval in milliseconds.  Defaults to
+	    100 and settable by Admission_Interval_Msec. */
+	uint32_t admission_interval_ms;
+	/** Megabytes of aligned I/O buffers (for WRITE payloads) kept
+	    for reuse.  Defaults to 64 and settable by
+	    IO_Buffer_Cache_MB. */
+	uint32_t io_buffer_cache_mb;
+	/** Whether to have one dispatch lane per NUMA node, with each
+	    worker bound to the CPUs of its lane's node.  Overrides
+	    dispatch_lanes.  Defaults to false and settable by
+	    Dispatch_NUMA. */
+	bool dispatch_numa;
+	/** CPUs (as a list like "0-7,16") to which decoder threads are
+	    bound.  Unbound by default, settable by Decoder_CPUs. */
+	char *decoder_cpus;
+	/** CPUs to which worker threads are bound.  Unbound by
+	    default, settable by Worker_CPUs. */
+	char *worker_cpus;
 	/** Parameters controlling the Duplicate Request Cache.  */
 	struct {
 		/** Whether to disable the DRC entirely.  Defaults to
 		    false, settable by DRC_Disabled. */
 		bool disabled;
+		/** Megabytes of completed replies all DRCs together
+		    may hold before the least recently completed are
+		    evicted.  Defaults to DRC_BUDGET_MB, settable by
+		    DRC_Budget_MB. */
+		uint32_t budget_mb;
+		/** Whether NFSv4.0 compounds that change nothing are
+		    cached as well.  NFSv3 and the side protocols only
+		    ever cache procedures marked CAN_BE_DUP.  Defaults
+		    to false, settable by DRC_Cache_Idempotent. */
+		bool cache_idempotent;
+		/** Hash (an enum gsh_cksum_type) folded into the
+		    checksum of a request to detect retransmissions.
+		    Defaults to crc32c, settable by
+		    DRC_Checksum_Type. */
+		uint32_t cksum_type;
+		/** Bytes of a request's payload hashed at most, its
+		    length being hashed as well.  Defaults to
+		    DRC_CKSUM_LEN, settable by DRC_Checksum_Len. */
+		uint32_t cksum_len;
 		/* Parameters controlling TCP specific DRC behavior. */
 		struct {
 			/** Number of partitions in the tree for the
@@ -395,6 +474,29 @@ typedef struct nfs_core_param {
  */
 #define DELEG_RECALL_RETRY_DELAY_DEFAULT 1
 
+/**
+ * @brief Default value of session_initial_slots.
+ */
+#define SESSION_INITIAL_SLOTS_DEFAULT 64
+
+/**
+ * @brief Default value of session_max_slots.
+ */
+#define SESSION_MAX_SLOTS_DEFAULT 1024
+
+/**
+ * @brief Default value of session_slot_budget.
+ */
+#define SESSION_SLOT_BUDGET_DEFAULT 65536
+
+/**
+ * @brief Where client records for reclaim are kept
+ */
+enum recovery_backend {
+	RECOVERY_BACKEND_FS,	/*< A directory per client */
+	RECOVERY_BACKEND_LOG,	/*< An append-only log */
+};
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -431,6 +533,24 @@ typedef struct nfs_version4_parameter {
 	bool allow_delegations;
 	/** Delay after which server will retry a recall in case of failures */
 	uint32_t deleg_recall_retry_delay;
+	/** Forechannel slots a session starts with, at most what the
+	    client asks for.  Defaults to SESSION_INITIAL_SLOTS_DEFAULT
+	    and is settable with Session_Initial_Slots. */
+	uint32_t session_initial_slots;
+	/** Forechannel slots a busy session may grow to, at most what
+	    the client asks for.  Defaults to
+	    SESSION_MAX_SLOTS_DEFAULT and is settable with
+	    Session_Max_Slots. */
+	uint32_t session_max_slots;
+	/** Slot targets of all sessions beyond which sessions above
+	    their fair share shrink.  Defaults to
+	    SESSION_SLOT_BUDGET_DEFAULT and is settable with
+	    Session_Slot_Budget. */
+	uint32_t session_slot_budget;
+	/** Where client records are kept across restarts, an enum
+	    recovery_backend.  Defaults to RECOVERY_BACKEND_FS and is
+	    settable with Recovery_Backend. */
+	uint32_t recovery_backend;
 	/** Whether this a pNFS MDS server. Defaults to false */
 	bool pnfs_mds;
 	/** Whether this a pNFS DS server. Defaults to false */
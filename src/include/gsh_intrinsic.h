@@ -55,5 +55,14 @@
 #endif
 #define GSH_CACHE_PAD(_n) char __pad ## _n[GSH_CACHE_LINE_SIZE]
 
+/* politeness to a sibling hyperthread while spinning */
+#if defined(__x86_64__) || defined(__i386__)
+#define gsh_cpu_relax() __builtin_ia32_pause()
+#elif defined(__PPC64__)
+#define gsh_cpu_relax() __asm__ __volatile__("or 27,27,27" ::: "memory")
+#else
+#define gsh_cpu_relax() __sync_synchronize()
+#endif
+
 
 #endif				/* _GSH_INTRINSIC_H */
@@ -51,6 +51,9 @@
 #define NFS_LOOKAHEAD_SETCLIENTID_CONFIRM  0x0200
 #define NFS_LOOKAHEAD_LOOKUP 0x0400
 #define NFS_LOOKAHEAD_READLINK 0x0800
+#define NFS_LOOKAHEAD_LINK 0x1000
+#define NFS_LOOKAHEAD_DELEGRETURN 0x2000 /* and DELEGPURGE */
+#define NFS_LOOKAHEAD_RELEASE_LOCKOWNER 0x4000
 /* ... */
 
 struct nfs_request_lookahead {
@@ -144,6 +147,7 @@ const char *str_gc_proc(rpc_gss_proc_t);
 /* uint16_t actually used */
 #define XPRT_PRIVATE_FLAG_DECODING 0x0008
 #define XPRT_PRIVATE_FLAG_STALLED 0x0010	/* ie, -on stallq- */
+#define XPRT_PRIVATE_FLAG_SHED 0x0020	/* stall, for admission control */
 
 /* uint32_t instructions */
 #define XPRT_PRIVATE_FLAG_LOCKED	SVC_XPRT_FLAG_LOCKED
@@ -155,6 +159,8 @@ typedef struct gsh_xprt_private {
 	SVCXPRT *xprt;
 	struct glist_head stallq;
 	uint16_t flags;
+	int32_t rx_cpu;		/* CPU receiving its packets, or -1 */
+	uint32_t rx_cpu_age;	/* requests since rx_cpu was read */
 } gsh_xprt_private_t;
 
 static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
@@ -164,6 +170,8 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 
 	xu->xprt = xprt;
 	xu->flags = flags;
+	xu->rx_cpu = -1;
+	xu->rx_cpu_age = 0;
 
 	return xu;
 }
@@ -182,6 +190,21 @@ static inline void free_gsh_xprt_private(SVCXPRT *xprt)
 	}
 }
 
+/**
+ * @brief Whether a transport is being shed for overload
+ *
+ * @param[in] xprt The transport
+ */
+
+static inline bool gsh_xprt_shed(SVCXPRT *xprt)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *)xprt->xp_u1;
+
+	return xu != NULL
+		&& (atomic_fetch_uint16_t(&xu->flags)
+		    & XPRT_PRIVATE_FLAG_SHED);
+}
+
 static inline void gsh_xprt_ref(SVCXPRT *xprt, uint32_t flags,
 				const char *tag,
 				const int line)
@@ -0,0 +1,129 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup interval_tree Interval trees
+ *
+ * An AVL tree of closed intervals [start, last] ordered by start,
+ * where each node also carries the greatest last of its subtree.
+ * That lets a search skip every subtree that ends before the range
+ * asked about, so finding the k intervals that overlap a range costs
+ * O(k log n) rather than a walk over all n.
+ *
+ * Nodes are embedded in the caller's structures; the tree does no
+ * allocation and no locking.  Intervals with equal starts are told
+ * apart by the address of their node.
+ *
+ * @{
+ */
+
+/**
+ * @file interval_tree.h
+ * @brief Augmented AVL trees of intervals
+ */
+
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief An interval, embedded in the structure it describes
+ *
+ * The caller sets start and last before inserting, and must not
+ * change them while the node is in a tree.
+ */
+
+struct interval_node {
+	struct interval_node *left;
+	struct interval_node *right;
+	uint64_t start;			/*< First point */
+	uint64_t last;			/*< Last point, inclusive */
+	uint64_t max_last;		/*< Greatest last in this subtree */
+	int height;			/*< 0 when not in a tree */
+};
+
+/**
+ * @brief A tree of intervals
+ */
+
+struct interval_tree {
+	struct interval_node *root;
+	uint32_t count;			/*< Nodes in the tree */
+};
+
+static inline void interval_tree_init(struct interval_tree *tree)
+{
+	tree->root = NULL;
+	tree->count = 0;
+}
+
+/**
+ * @brief Whether a node is in a tree
+ */
+
+static inline bool interval_node_linked(const struct interval_node *node)
+{
+	return node->height != 0;
+}
+
+void interval_tree_insert(struct interval_tree *tree,
+			  struct interval_node *node);
+void interval_tree_remove(struct interval_tree *tree,
+			  struct interval_node *node);
+struct interval_node *interval_tree_next(struct interval_tree *tree,
+					 const struct interval_node *after,
+					 uint64_t lo, uint64_t hi);
+
+/**
+ * @brief Find the interval with the lowest start overlapping [lo, hi]
+ */
+
+static inline struct interval_node *
+interval_tree_first(struct interval_tree *tree, uint64_t lo, uint64_t hi)
+{
+	return interval_tree_next(tree, NULL, lo, hi);
+}
+
+/**
+ * @brief Visit, in order of start, the intervals overlapping [lo, hi]
+ */
+
+#define interval_tree_for_each(node, tree, lo, hi)			\
+	for (node = interval_tree_first(tree, lo, hi);			\
+	     node != NULL;						\
+	     node = interval_tree_next(tree, node, lo, hi))
+
+/**
+ * @brief As interval_tree_for_each, allowing node to be removed
+ */
+
+#define interval_tree_for_each_safe(node, n, tree, lo, hi)		\
+	for (node = interval_tree_first(tree, lo, hi);			\
+	     node != NULL &&						\
+	     ((n = interval_tree_next(tree, node, lo, hi)), true);	\
+	     node = n)
+
+#endif				/* INTERVAL_TREE_H */
+
+/** @} */
@@ -0,0 +1,54 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+
+/**
+ * @defgroup io_buffer Aligned I/O buffers
+ *
+ * Page-aligned buffers for bulk data, kept on per-size free lists so
+ * that large WRITE payloads neither go through malloc nor fault in
+ * fresh pages on every request.  The WRITE argument decoders land the
+ * payload in one of these, and the same buffer is handed down to the
+ * FSAL; its alignment makes it fit for O_DIRECT.
+ *
+ * @{
+ */
+
+/**
+ * @file io_buffer.h
+ * @brief Aligned I/O buffers
+ */
+
+#ifndef IO_BUFFER_H
+#define IO_BUFFER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "gsh_rpc.h"
+
+void io_buf_pkginit(void);
+void *io_buf_get(size_t len);
+void io_buf_put(void *buf, size_t len);
+bool xdr_io_data(XDR *xdrs, char **data, u_int *len, u_int maxlen);
+
+#endif				/* IO_BUFFER_H */
+
+/** @} */
@@ -111,6 +111,7 @@ typedef struct request_data {
 					 *  added to the worker thread queue.
 					 */
 	request_type_t rtype;
+	struct gsh_client *client;	/*< Sender, referenced while queued */
 
 	union request_content {
 		rpc_call_t call;
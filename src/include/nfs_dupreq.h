@@ -70,6 +70,9 @@ typedef struct drc {
 	uint32_t flags;
 	uint32_t refcnt; /* call path refs */
 	uint32_t retwnd;
+	uint64_t bytes; /* held by completed entries */
+	uint64_t hits;
+	uint64_t misses;
 	union {
 		struct {
 			sockaddr_t addr;
@@ -92,6 +95,8 @@ struct dupreq_entry {
 	struct opr_rbtree_node rbt_k;
 	/* Define the tail queue */
 	TAILQ_ENTRY(dupreq_entry) fifo_q;
+	/* Global byte budget LRU, completed entries only */
+	TAILQ_ENTRY(dupreq_entry) lru_q;
 	pthread_mutex_t mtx;
 	struct {
 		drc_t *drc;
@@ -108,6 +113,7 @@ struct dupreq_entry {
 	dupreq_state_t state;
 	uint32_t refcnt;
 	nfs_res_t *res;
+	uint32_t size;		/* bytes charged to the budget */
 	time_t timestamp;
 };
 
@@ -137,8 +143,23 @@ typedef enum dupreq_status {
 	DUPREQ_ERROR,
 } dupreq_status_t;
 
+/**
+ * @brief Totals over all duplicate request caches
+ */
+
+struct drc_totals {
+	uint64_t budget;	/*< Byte budget */
+	uint64_t entries;	/*< Completed entries held */
+	uint64_t bytes;		/*< Bytes they are charged */
+	uint64_t hits;		/*< Retransmissions answered */
+	uint64_t misses;	/*< Requests inserted */
+	uint64_t evictions;	/*< Entries evicted for the budget */
+};
+
 void dupreq2_pkginit(void);
 void dupreq2_pkgshutdown(void);
+void dupreq2_totals(struct drc_totals *tot);
+void dupreq2_foreach_drc(void (*cb)(drc_t *drc, void *state), void *state);
 
 drc_t *drc_get_tcp_drc(struct svc_req *);
 void drc_release_tcp_drc(drc_t *);
@@ -101,9 +101,24 @@ typedef union nfs_arg__ {
 	ext_setquota_args arg_ext_rquota_setactivequota;
 } nfs_arg_t;
 
+/**
+ * @brief An NFSv4.1 reply kept encoded in a session slot
+ *
+ * Shared by the slot and by every response replaying it; the last
+ * reference frees it.
+ */
+
+struct nfs41_cached_reply {
+	int32_t refcnt;		/*< References from slot and responses */
+	nfsstat4 status;	/*< Status of the COMPOUND */
+	u_int len;		/*< Length of the encoded COMPOUND4res */
+	char data[];		/*< The encoded COMPOUND4res */
+};
+
 struct COMPOUND4res_extended {
 	COMPOUND4res res_compound4;
-	bool res_cached;
+	struct nfs41_cached_reply *res_reply;	/*< If set, sent in place of
+						    res_compound4 */
 };
 
 typedef union nfs_res__ {
@@ -323,9 +338,10 @@ typedef struct compound_data {
 	nfs_client_cred_t credential;	/*< Raw RPC credentials */
 	nfs_client_id_t *preserved_clientid;	/*< clientid that has lease
 						   reserved, if any */
-	struct COMPOUND4res_extended *cached_res;	/*< NFv41: pointer to
-							   cached RPC result in
-							   a session's slot */
+	struct nfs41_session_slot__ *cached_slot;	/*< NFSv41: slot to
+							   keep the reply in */
+	struct nfs41_cached_reply *cached_reply;	/*< NFSv41: reply to
+							   replay, referenced */
 	bool use_drc;		/*< Set to true if session DRC is to be used */
 	uint32_t oppos;		/*< Position of the operation within the
 				    request processed  */
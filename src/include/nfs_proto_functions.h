@@ -411,6 +411,8 @@ void nfs3_read_free(nfs_res_t *);
 
 void nfs4_Compound_FreeOne(nfs_resop4 *);
 void nfs4_Compound_Free(nfs_res_t *);
+bool xdr_COMPOUND4res_extended(XDR *, struct COMPOUND4res_extended *);
+void nfs41_cached_reply_put(struct nfs41_cached_reply *);
 void nfs4_Compound_CopyResOne(nfs_resop4 *, nfs_resop4 *);
 void nfs4_Compound_CopyRes(nfs_res_t *, nfs_res_t *);
 
@@ -36,6 +36,8 @@
 #define NFS_REQ_QUEUE_H
 
 #include "gsh_list.h"
+#include "gsh_intrinsic.h"
+#include "abstract_atomic.h"
 #include "wait_queue.h"
 
 struct req_q {
@@ -46,13 +48,44 @@ struct req_q {
 	uint32_t waiters;
 };
 
+struct req_q_pair;
+
+/**
+ * @brief The queued requests of one client in one class
+ *
+ * While it has requests queued, a flow is active on exactly one class
+ * queue (of the lane its first pending request was decoded on), where
+ * it is served by deficit round-robin against the other active flows:
+ * each turn it is credited weight quanta of operations, and it keeps
+ * the head of the queue until the operations it has been served use
+ * the credit up.  A flow that overdraws (one huge compound) carries
+ * the debt into later turns.
+ */
+
+struct req_flow {
+	pthread_spinlock_t sp;
+	struct glist_head q;		/* queued requests, FIFO */
+	struct glist_head link;		/* in req_q_pair producer/consumer */
+	struct req_q_pair *qpair;	/* where active, NULL if idle */
+	uint32_t size;			/* queued requests */
+	uint32_t weight;		/* quanta per turn */
+	int64_t deficit;		/* operations left this turn */
+	bool topped;			/* credited for this turn */
+	uint64_t served;		/* requests dequeued */
+	uint64_t wait_ns;		/* total time those were queued */
+};
+
+struct req_lane;
+
 struct req_q_pair {
 	const char *s;
+	struct req_lane *lane;	/* the lane this belongs to */
 	GSH_CACHE_PAD(0);
-	struct req_q producer;	/* from decoder */
+	struct req_q producer;	/* flows newly active, from decoder */
 	GSH_CACHE_PAD(1);
-	struct req_q consumer;	/* to executor */
+	struct req_q consumer;	/* flows in DRR order, to executor */
 	GSH_CACHE_PAD(2);
+	struct req_flow anon;	/* requests with no client */
 };
 
 #define REQ_Q_MOUNT 0
@@ -67,14 +100,68 @@ struct req_q_set {
 	struct req_q_pair qset[N_REQ_QUEUES];
 };
 
+/**
+ * @brief Admission control state of a lane
+ *
+ * This is CoDel applied to the request queue: when the time requests
+ * spend queued stays above the target for a whole interval the lane
+ * is overloaded, and its busiest senders are shed (their transports
+ * stalled) at a rate rising with the square root of the number shed,
+ * until a request again gets through within the target.
+ */
+
+struct req_codel {
+	pthread_spinlock_t sp;
+	uint64_t first_above;	/* end of the interval over target, or 0 */
+	uint64_t shed_next;	/* when the next sender may be shed */
+	uint32_t count;		/* senders shed this episode */
+	bool overloaded;
+};
+
+/**
+ * @brief Load shedding statistics
+ */
+
+struct admission_stats {
+	uint64_t overloads;	/* episodes of lane overload */
+	uint64_t xprt_stalls;	/* transports stalled to shed load */
+	uint64_t slot_cuts;	/* NFSv4.1 slot targets reduced */
+	uint32_t overloaded;	/* lanes overloaded now */
+};
+
+extern struct admission_stats admission_st;
+
+/**
+ * @brief One dispatch lane
+ *
+ * Requests are queued to the lane of the CPU that decoded them.  Each
+ * worker has a home lane which it serves first, and waits on, and
+ * steals from the other lanes only when its own is empty.
+ *
+ * A sleeping worker is woken when its lane goes from empty to
+ * non-empty, or by a worker that dequeued from the lane and left
+ * requests behind, so that wakeups follow idle workers rather than
+ * requests.
+ */
+
+struct req_lane {
+	struct req_q_set nfs_request_q;
+	GSH_CACHE_PAD(0);
+	uint32_t pending;		/* requests queued on the lane */
+	eventcount_t ec;		/* idle workers of the lane */
+	uint32_t workers;		/* live workers homed on the lane */
+	GSH_CACHE_PAD(1);
+	struct req_codel codel;
+	GSH_CACHE_PAD(2);
+};
+
 struct nfs_req_st {
 	struct {
 		uint32_t ctr;
-		struct req_q_set nfs_request_q;
+		uint32_t n_lanes;
+		struct req_lane *lanes;
 		uint64_t size;
-		pthread_spinlock_t sp;
-		struct glist_head wait_list;
-		uint32_t waiters;
+		uint32_t waiters;	/* idle workers, all lanes */
 	} reqs;
 	GSH_CACHE_PAD(1);
 	struct {
@@ -88,6 +175,16 @@ struct nfs_req_st {
 extern struct nfs_req_st nfs_req_st;
 
 void nfs_rpc_queue_init(void);
+void nfs_rpc_worker_bind(uint32_t lane);
+
+/**
+ * @brief Whether any lane is overloaded
+ */
+
+static inline bool nfs_rpc_overloaded(void)
+{
+	return atomic_fetch_uint32_t(&admission_st.overloaded) != 0;
+}
 
 static inline void nfs_rpc_q_init(struct req_q *q)
 {
@@ -97,6 +194,19 @@ static inline void nfs_rpc_q_init(struct req_q *q)
 	q->waiters = 0;
 }
 
+static inline void nfs_rpc_flow_init(struct req_flow *flow, uint32_t weight)
+{
+	pthread_spin_init(&flow->sp, PTHREAD_PROCESS_PRIVATE);
+	glist_init(&flow->q);
+	flow->qpair = NULL;
+	flow->size = 0;
+	flow->weight = weight;
+	flow->deficit = 0;
+	flow->topped = false;
+	flow->served = 0;
+	flow->wait_ns = 0;
+}
+
 static inline uint32_t nfs_rpc_q_next_slot(void)
 {
 	uint32_t ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
@@ -109,17 +219,10 @@ static inline uint32_t nfs_rpc_q_next_slot(void)
 static inline void nfs_rpc_queue_awaken(void *arg)
 {
 	struct nfs_req_st *st = arg;
-	struct glist_head *g = NULL;
-	struct glist_head *n = NULL;
-
-	pthread_spin_lock(&st->reqs.sp);
-	glist_for_each_safe(g, n, &st->reqs.wait_list) {
-		wait_q_entry_t *wqe = glist_entry(g, wait_q_entry_t, waitq);
+	uint32_t ix;
 
-		pthread_cond_signal(&wqe->lwe.cv);
-		pthread_cond_signal(&wqe->rwe.cv);
-	}
-	pthread_spin_unlock(&st->reqs.sp);
+	for (ix = 0; ix < st->reqs.n_lanes; ++ix)
+		(void)ec_signal(&st->reqs.lanes[ix].ec, INT32_MAX);
 }
 
 #endif				/* NFS_REQ_QUEUE_H */
@@ -35,6 +35,7 @@
 #include "cache_inode.h"
 #include "wait_queue.h"
 #include "nfs_core.h"
+#include "abstract_atomic.h"
 
 /**
  * @file nfs_rpc_callback.h
@@ -104,12 +105,48 @@ static inline void free_cb_resop(nfs_cb_resop4 *ptr)
 
 static inline bool get_cb_chan_down(struct nfs_client_id_t *clid)
 {
-	return clid->cid_cb.v40.cb_chan_down;
+	return clid->cid_cb_chan_down;
 }
 
 static inline void set_cb_chan_down(struct nfs_client_id_t *clid, bool down)
 {
-	clid->cid_cb.v40.cb_chan_down = down;
+	clid->cid_cb_chan_down = down;
+	if (!down)
+		atomic_store_uint32_t(&clid->cid_cb_failures, 0);
+}
+
+/**
+ * @brief Callbacks that must fail in a row before the channel is down
+ *
+ * One lost reply or dropped connection is not enough to give up on a
+ * client and revoke its delegations.
+ */
+#define NFS_CB_FAILURES_MAX 3
+
+/**
+ * @brief Count a failed callback against a client
+ *
+ * @param[in,out] clid The client record
+ *
+ * @return true if the back channel is now taken to be down.
+ */
+static inline bool cb_chan_failed(struct nfs_client_id_t *clid)
+{
+	if (atomic_inc_uint32_t(&clid->cid_cb_failures) < NFS_CB_FAILURES_MAX)
+		return false;
+
+	clid->cid_cb_chan_down = true;
+	return true;
+}
+
+/**
+ * @brief Note that a callback to a client got a reply
+ *
+ * @param[in,out] clid The client record
+ */
+static inline void cb_chan_succeeded(struct nfs_client_id_t *clid)
+{
+	atomic_store_uint32_t(&clid->cid_cb_failures, 0);
 }
 
 rpc_call_channel_t *nfs_rpc_get_chan(nfs_client_id_t *pclientid,
@@ -141,6 +178,8 @@ int nfs_rpc_call_init(rpc_call_t call, uint32_t flags);
 #define NFS_RPC_CALL_NONE 0x0000
 #define NFS_RPC_CALL_INLINE 0x0001	/*< execute in current thread ctxt */
 #define NFS_RPC_CALL_BROADCAST 0x0002
+#define NFS_RPC_CALL_CONNECT 0x0004	/*< connect a v4.0 back channel in
+					    the worker if there is none */
 
 /* Submit rpc to be called on chan, optionally waiting for completion. */
 int32_t nfs_rpc_submit_call(rpc_call_t *call, void *completion_arg,
@@ -21,6 +21,7 @@ extern "C" {
 
 #include "gsh_rpc.h"
 #include "nfs_fh.h"
+#include "io_buffer.h"
 
 	typedef struct authsys_parms authsys_parms;
 #endif				/* _AUTH_SYS_DEFINE_FOR_NFSv41 */
@@ -6528,7 +6529,7 @@ extern "C" {
 			return false;
 		if (!xdr_stable_how4(xdrs, &objp->stable))
 			return false;
-		if (!inline_xdr_bytes
+		if (!xdr_io_data
 		    (xdrs, (char **)&objp->data.data_val,
 		     &objp->data.data_len, XDR_BYTES_MAXLEN_IO))
 			return false;
@@ -8090,11 +8091,13 @@ extern "C" {
 			if (!xdr_DELEGPURGE4args
 			    (xdrs, &objp->nfs_argop4_u.opdelegpurge))
 				return false;
+			lkhd->flags |= NFS_LOOKAHEAD_DELEGRETURN;
 			break;
 		case NFS4_OP_DELEGRETURN:
 			if (!xdr_DELEGRETURN4args
 			    (xdrs, &objp->nfs_argop4_u.opdelegreturn))
 				return false;
+			lkhd->flags |= NFS_LOOKAHEAD_DELEGRETURN;
 			break;
 		case NFS4_OP_GETATTR:
 			if (!xdr_GETATTR4args
@@ -8106,6 +8109,7 @@ extern "C" {
 		case NFS4_OP_LINK:
 			if (!xdr_LINK4args(xdrs, &objp->nfs_argop4_u.oplink))
 				return false;
+			lkhd->flags |= NFS_LOOKAHEAD_LINK;
 			break;
 		case NFS4_OP_LOCK:
 			if (!xdr_LOCK4args(xdrs, &objp->nfs_argop4_u.oplock))
@@ -8241,6 +8245,7 @@ extern "C" {
 			if (!xdr_RELEASE_LOCKOWNER4args
 			    (xdrs, &objp->nfs_argop4_u.oprelease_lockowner))
 				return false;
+			lkhd->flags |= NFS_LOOKAHEAD_RELEASE_LOCKOWNER;
 			break;
 		case NFS4_OP_BACKCHANNEL_CTL:
 			if (!xdr_BACKCHANNEL_CTL4args
@@ -0,0 +1,85 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup range_lock Byte-range locks
+ *
+ * Reader/writer locks over byte ranges of an object.  Shared holders
+ * of any range coexist; an exclusive holder excludes every other
+ * holder of an overlapping range, so I/O to disjoint ranges of one
+ * file proceeds in parallel.  These serialize the server's own data
+ * path only and have nothing to do with client (NLM/NFSv4) locks.
+ *
+ * Holders are expected to be few and short-lived, so the granted
+ * ranges are kept in a list.  A request waits behind any earlier
+ * waiter it conflicts with, as well as behind conflicting holders, so
+ * waiters are granted in arrival order and a stream of readers cannot
+ * starve a writer.  Each waiter sleeps on its own condition variable
+ * and is woken only once its range has been granted.
+ *
+ * @{
+ */
+
+/**
+ * @file range_lock.h
+ * @brief Byte-range reader/writer locks
+ */
+
+#ifndef RANGE_LOCK_H
+#define RANGE_LOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "gsh_list.h"
+
+/**
+ * @brief A set of locked ranges on one object
+ */
+
+struct range_lock {
+	pthread_mutex_t mtx;		/*< Protects the fields below */
+	struct glist_head held;		/*< Granted ranges */
+	struct glist_head waiting;	/*< Waiting ranges, oldest first */
+};
+
+/**
+ * @brief One granted range, owned by the caller (usually on its stack)
+ */
+
+struct range_lock_entry {
+	struct glist_head link;		/*< Link in held or waiting */
+	uint64_t start;			/*< First byte */
+	uint64_t end;			/*< One past the last byte */
+	bool exclusive;			/*< Writer */
+	bool granted;			/*< Moved to held */
+	pthread_cond_t cv;		/*< Signalled on grant, while waiting */
+};
+
+void range_lock_init(struct range_lock *rl);
+void range_lock_destroy(struct range_lock *rl);
+void range_lock_acquire(struct range_lock *rl, struct range_lock_entry *re,
+			uint64_t offset, uint64_t length, bool exclusive);
+void range_lock_release(struct range_lock *rl, struct range_lock_entry *re);
+
+#endif				/* RANGE_LOCK_H */
+
+/** @} */
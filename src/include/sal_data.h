@@ -49,6 +49,8 @@
 #include "hashtable.h"
 #include "fsal_pnfs.h"
 #include "config_parsing.h"
+#include "interval_tree.h"
+#include "timer_wheel.h"
 
 #ifdef _USE_9P
 /* define u32 and related types independent of SAL and 9P */
@@ -116,10 +118,10 @@ extern pool_t *nfs41_session_pool;
 extern hash_table_t *ht_session_id;
 
 /**
- * @brief Number of forechannel slots in a session
+ * @brief Maximum number of backchannel slots we'll use
  *
- * This is also the maximum number of backchannel slots we'll use,
- * even if the client offers more.
+ * Even if the client offers more.  The forechannel slot table is sized
+ * per session, see Session_Initial_Slots and Session_Max_Slots.
  */
 #define NFS41_NB_SLOTS 128
 
@@ -130,12 +132,32 @@ extern hash_table_t *ht_session_id;
 typedef struct nfs41_session_slot__ {
 	sequenceid4 sequence;	/*< Sequence number of this operation */
 	pthread_mutex_t lock;	/*< Lock on the slot */
-	struct COMPOUND4res_extended cached_result;	/*< NFv41: pointer to
-							   cached RPC result in
-							   a session's slot */
-	unsigned int cache_used;	/*< If we cached the result */
+	struct nfs41_cached_reply *cached_reply;	/*< Encoded reply of
+							   the last request,
+							   if cached */
+	nfsstat4 cached_status;	/*< Status of the last reply */
+	unsigned int cache_used;	/*< If the reply of the current sequence
+					    is to be cached (sa_cachethis) */
+	bool in_use;		/*< A request on the slot is in progress */
 } nfs41_session_slot_t;
 
+/**
+ * @brief Server-wide accounting of forechannel slots
+ *
+ * The slot budget is shared out between sessions: a session whose
+ * target is above budget / sessions gives slots back first.
+ */
+
+struct nfs41_slot_totals {
+	uint64_t sessions;	/*< Sessions with a slot table */
+	uint64_t target;	/*< Sum of the sessions' slot targets */
+	uint64_t allocated;	/*< Slots allocated, all sessions */
+	uint64_t grows;		/*< Slot tables grown */
+	uint64_t shrinks;	/*< Slot tables shrunk */
+};
+
+extern struct nfs41_slot_totals nfs41_slot_st;
+
 /**
  * @brief Bookkeeping for callback slots on the client
  */
@@ -172,11 +194,19 @@ struct nfs41_session {
 	SVCXPRT *xprt;		/*< Referenced pointer to transport */
 
 	channel_attrs4 fore_channel_attrs;	/*< Fore-channel attributes */
-	nfs41_session_slot_t slots[NFS41_NB_SLOTS];	/*< Slot table */
+	pthread_rwlock_t slots_lock;	/*< Protects slots and nb_slots */
+	nfs41_session_slot_t **slots;	/*< Slot table, each slot allocated
+					    on first use */
+	uint32_t nb_slots;	/*< Size of the slot table, the highest
+				    slotid we accept plus one */
+	uint32_t initial_slots;	/*< Slots granted at CREATE_SESSION */
+	uint32_t target_slots;	/*< Slots we would have the client use */
+	uint64_t target_changed;	/*< When target_slots last moved */
+	uint64_t slots_resized;	/*< When the slot table last shrank */
 
 	channel_attrs4 back_channel_attrs;	/*< Back-channel attributes */
-	nfs41_cb_session_slot_t cb_slots[NFS41_NB_SLOTS];	/*< Callback
-								   Slot table */
+	nfs41_cb_session_slot_t *cb_slots;	/*< Callback slot table */
+	uint32_t nb_cb_slots;	/*< Size of the callback slot table */
 	uint32_t cb_program;	/*< Callback program ID */
 	struct rpc_call_channel cb_chan;	/*< Back channel */
 	pthread_mutex_t cb_mutex;	/*< Protects the cb slot table,
@@ -218,12 +248,11 @@ typedef struct rdel_fh {
 typedef struct clid_entry {
 	struct glist_head cl_list;	/*< Link in the list */
 	struct glist_head cl_rfh_list;
+	bool cl_returned;	/*< Came back in this grace period */
+	bool cl_done;		/*< Reclaimed, or expired */
 	char cl_name[PATH_MAX];	/*< Client name */
 } clid_entry_t;
 
-extern char v4_old_dir[PATH_MAX];
-extern char v4_recov_dir[PATH_MAX];
-
 /******************************************************************************
  *
  * NFSv4 State data
@@ -574,6 +603,8 @@ struct state_nfs4_owner_t {
 	struct glist_head so_perclient;  /*< open owner entry to be
 					   linked to client */
 	time_t last_close_time; /* time last CLOSE op performed */
+	struct timer_wheel_entry so_close_timer; /*< When an unused open
+						     owner may be reaped */
 };
 
 /**
@@ -641,6 +672,12 @@ typedef enum clientid_status {
 	CLIENT_ID_STALE		/*< requested client id stale */
 } clientid_status_t;
 
+/**
+ * @brief Open owners remembered per client for OPEN, a power of 2
+ */
+
+#define CLIENT_OWNER_CACHE_SIZE 16
+
 /**
  * @brief Record associated with a clientid
  *
@@ -652,6 +689,8 @@ struct nfs_client_id_t {
 	verifier4 cid_verifier;	/*< Known verifier */
 	verifier4 cid_incoming_verifier; /*< Most recently supplied verifier */
 	time_t cid_last_renew;	/*< Time of last renewal */
+	struct timer_wheel_entry cid_lease_timer; /*< When the lease must
+						      next be checked */
 	nfs_clientid_confirm_state_t cid_confirmed; /*< Confirm/expire state */
 	nfs_client_cred_t cid_credential;	/*< Client credential */
 	int cid_allow_reclaim;	/*< Whether this client can still
@@ -662,6 +701,9 @@ struct nfs_client_id_t {
 						   replacement */
 	struct glist_head cid_openowners;	/*< All open owners */
 	struct glist_head cid_lockowners;	/*< All lock owners */
+	/** Recently used open owners, by hash of their names, so OPEN
+	    can find them without the owner table.  Under cid_mutex. */
+	state_owner_t *cid_owner_cache[CLIENT_OWNER_CACHE_SIZE];
 	pthread_mutex_t cid_mutex;	/*< Mutex for this client */
 	union {
 		struct {
@@ -675,7 +717,6 @@ struct nfs_client_id_t {
 			char cb_client_r_addr[SOCK_NAME_MAX + 1];
 			/** Callback program */
 			uint32_t cb_program;
-			bool cb_chan_down;    /* Callback channel state */
 		} v40;		/*< v4.0 callback information */
 		struct {
 			bool cid_reclaim_complete; /*< reclaim complete
@@ -684,6 +725,10 @@ struct nfs_client_id_t {
 			struct glist_head cb_session_list;
 		} v41;		/*< v4.1 callback information */
 	} cid_cb;		/*< Version specific callback information */
+	bool cid_cb_chan_down;	/*< Callbacks have kept failing, or
+				    there is no back channel, and none
+				    has been set up since */
+	uint32_t cid_cb_failures;	/*< Callbacks failed in a row */
 	time_t first_path_down_resp_time;  /* Time when the server first sent
 					       NFS4ERR_CB_PATH_DOWN */
 	char cid_server_owner[MAXNAMLEN + 1];	/*< Server owner.
@@ -700,11 +745,13 @@ struct nfs_client_id_t {
 	int cid_lease_reservations;	/*< Counted lease reservations, to spare
 					   this clientid from the reaper */
 	uint32_t cid_minorversion;
-	uint32_t cid_stateid_counter;
 
 	uint32_t curr_deleg_grants; /* current num of delegations owned by
 				       this client */
 	uint32_t num_revokes;       /* Num revokes for the client */
+	time_t deleg_backoff;       /* no delegations for this long after
+				       deleg_penalty_time */
+	time_t deleg_penalty_time;  /* last failed or revoked recall */
 	struct gsh_client *gsh_client; /* for client specific statistics. */
 };
 
@@ -808,6 +855,9 @@ struct state_block_data_t {
 
 struct state_lock_entry_t {
 	struct glist_head sle_list;	/*< Locks on this file */
+	struct interval_node sle_range;	/*< Node in the file's lock_tree */
+	struct glist_head sle_blocked_list; /*< Link in the file's
+						blocked_locks */
 	struct glist_head sle_owner_locks; /*< Link on the owner lock list */
 	struct glist_head sle_client_locks;	/*< Locks on this client */
 	struct glist_head sle_state_locks;	/*< Locks on this state */
@@ -982,6 +1032,18 @@ typedef struct nfs_grace_start {
 	char *ipaddr;		/*< IP of failed node */
 } nfs_grace_start_t;
 
+/**
+ * @brief Reclaim progress of the clients loaded for a grace period
+ */
+
+typedef struct nfs_grace_progress {
+	uint32_t known;		/*< Clients loaded that may reclaim */
+	uint32_t returned;	/*< Of those, the ones that came back */
+	uint32_t reclaimed;	/*< Sent RECLAIM_COMPLETE */
+	uint32_t expired;	/*< Gone, or not back within a lease */
+	bool early_exit;	/*< Grace ends once all are done */
+} nfs_grace_progress_t;
+
 /* Memory pools */
 
 extern pool_t *state_owner_pool;	/*< Pool for NFSv4 files's open owner */
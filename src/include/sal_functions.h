@@ -343,6 +343,12 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 			      nfs41_session_t **session_data);
 
 int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE]);
+bool nfs41_Session_Slots_Init(nfs41_session_t *session, uint32_t nb_slots,
+			      uint32_t nb_cb_slots);
+nfs41_session_slot_t *nfs41_Session_Slot(nfs41_session_t *session,
+					 slotid4 slotid, slotid4 *highest);
+void nfs41_Session_Slots_Resize(nfs41_session_t *session, uint32_t target);
+void nfs41_Session_Slots_Free(nfs41_session_t *session);
 void nfs41_Build_sessionid(clientid4 *clientid, char *sessionid);
 void nfs41_Session_PrintAll(void);
 
@@ -361,7 +367,7 @@ int display_stateid(struct display_buffer *dspbuf, state_t *state);
 #define DISPLAY_STATEID4_SIZE (DISPLAY_STATEID_OTHER_SIZE + 17)
 
 int display_stateid4(struct display_buffer *dspbuf, stateid4 *stateid);
-void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other);
+bool nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other);
 
 #define STATEID_NO_SPECIAL 0	/*< No special stateids */
 #define STATEID_SPECIAL_ALL_0 2	/*< Allow anonymous */
@@ -403,6 +409,31 @@ static inline void inc_state_t_ref(struct state_t *state)
 	atomic_inc_int32_t(&state->state_refcount);
 }
 
+/**
+ * @brief Take a reference on a state reached without a lock
+ *
+ * Takes a reference only if the state still holds one, i.e. it is
+ * not already being freed.  Intended for lookups inside an epoch
+ * critical section.
+ *
+ * @param[in] state The state
+ *
+ * @return true if the reference was acquired.
+ */
+static inline bool inc_state_t_ref_live(struct state_t *state)
+{
+	int32_t refcount = atomic_fetch_int32_t(&state->state_refcount);
+
+	while (refcount > 0) {
+		if (atomic_cas_int32_t(&state->state_refcount, refcount,
+				       refcount + 1))
+			return true;
+		refcount = atomic_fetch_int32_t(&state->state_refcount);
+	}
+
+	return false;
+}
+
 void dec_nfs4_state_ref(struct state_t *state);
 
 /**
@@ -445,6 +476,11 @@ uint64_t state_id_rbt_hash_func(hash_parameter_t *hparam,
 int reserve_lease(nfs_client_id_t *clientid);
 void update_lease(nfs_client_id_t *clientid);
 bool valid_lease(nfs_client_id_t *clientid);
+void lease_timer_init(void);
+void lease_timer_start(nfs_client_id_t *clientid);
+void lease_timer_rearm(nfs_client_id_t *clientid);
+void lease_timer_stop(nfs_client_id_t *clientid);
+uint32_t lease_timers_expired(struct glist_head *expired);
 
 /******************************************************************************
  *
@@ -453,6 +489,8 @@ bool valid_lease(nfs_client_id_t *clientid);
  ******************************************************************************/
 
 void free_nfs4_owner(state_owner_t *owner);
+void open_owner_timer_arm(state_owner_t *owner, time_t tclose);
+int reap_expired_open_owners(void);
 int display_nfs4_owner(struct display_buffer *dspbuf, state_owner_t *owner);
 int display_nfs4_owner_val(struct gsh_buffdesc *buff, char *str);
 int display_nfs4_owner_key(struct gsh_buffdesc *buff, char *str);
@@ -824,6 +862,10 @@ void init_new_deleg_state(union state_data *deleg_state,
 void deleg_heuristics_recall(cache_entry_t *entry,
 			     state_owner_t *owner,
 			     struct state_t *deleg);
+void deleg_heuristics_open(cache_entry_t *entry, nfs_client_id_t *client,
+			   uint32_t share_access);
+void deleg_heuristics_recall_start(cache_entry_t *entry);
+void deleg_heuristics_client_failed(nfs_client_id_t *client);
 void get_deleg_perm(cache_entry_t *entry, nfsace4 *permissions,
 		    open_delegation_type4 type);
 void update_delegation_stats(cache_entry_t *entry,
@@ -952,16 +994,48 @@ void process_blocked_lock_upcall(state_block_data_t *block_data);
  *
  ******************************************************************************/
 
+/**
+ * @brief Where client records are kept across restarts
+ *
+ * Records are named by the client's cid_recov_dir.  read_clids is
+ * called with grace_mutex held and adds what it finds to the list of
+ * clients allowed to reclaim with nfs4_add_clid_entry and
+ * nfs4_add_rfh_entry.
+ */
+struct nfs4_recovery_backend {
+	/** Create or open the backing store, at startup */
+	void (*recovery_init)(void);
+	/** Load the clients of the last instance, or of another node
+	    on takeover when gsp is not NULL */
+	void (*read_clids)(nfs_grace_start_t *gsp);
+	/** Forget the clients loaded at startup, once grace is over */
+	void (*end_grace)(void);
+	/** Record a client that may reclaim after a restart */
+	void (*add_clid)(nfs_client_id_t *clientid);
+	/** Forget a client */
+	void (*rm_clid)(nfs_client_id_t *clientid);
+	/** Record a delegation revoked from a client */
+	void (*add_revoke_fh)(nfs_client_id_t *clientid,
+			      const char *rhdlstr);
+};
+
+extern struct nfs4_recovery_backend recovery_log_backend;
+
 void nfs4_start_grace(nfs_grace_start_t *gsp);
 int nfs_in_grace(void);
 void nfs4_create_clid_name(nfs_client_record_t *, nfs_client_id_t *,
 			   struct svc_req *);
 void nfs4_add_clid(nfs_client_id_t *);
-void nfs4_rm_clid(const char *, char *, int);
+void nfs4_rm_clid(nfs_client_id_t *);
 void nfs4_chk_clid(nfs_client_id_t *);
+void nfs4_reclaim_complete(nfs_client_id_t *);
+void nfs4_reclaim_expire_absent(void);
+void nfs_grace_progress(nfs_grace_progress_t *);
 void nfs4_load_recov_clids(nfs_grace_start_t *gsp);
-void nfs4_clean_old_recov_dir(char *);
-void nfs4_create_recov_dir(void);
+void nfs4_recovery_init(void);
+void nfs4_recovery_end_grace(void);
+clid_entry_t *nfs4_add_clid_entry(char *);
+rdel_fh_t *nfs4_add_rfh_entry(clid_entry_t *, char *);
 void nfs4_record_revoke(nfs_client_id_t *, nfs_fh4 *);
 bool nfs4_check_deleg_reclaim(nfs_client_id_t *, nfs_fh4 *);
 
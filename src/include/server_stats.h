@@ -58,11 +58,21 @@ void server_stats_transport_done(struct gsh_client *client,
 				uint64_t tx_pkt, uint64_t tx_err);
 
 /* For delegations */
+
+/* Why a delegation was not granted */
+enum deleg_decline {
+	DELEG_DECLINE_FILE,	/* file recalled lately */
+	DELEG_DECLINE_CLIENT,	/* client failed recalls lately */
+	DELEG_DECLINE_SHARED,	/* file shared with writers lately */
+	DELEG_DECLINE_COUNT
+};
+
 void inc_grants(struct gsh_client *client);
 void dec_grants(struct gsh_client *client);
 void inc_revokes(struct gsh_client *client);
 void inc_recalls(struct gsh_client *client);
 void inc_failed_recalls(struct gsh_client *client);
+void inc_deleg_declined(struct gsh_client *client, enum deleg_decline why);
 
 #endif				/* !SERVER_STATS_H */
 /** @} */
@@ -174,6 +174,37 @@ struct export_stats {
 	.direction = "out"   \
 }
 
+#define CACHE_MEM_REPLY      \
+{                            \
+	.name = "mem",       \
+	.type = "a(stt)",    \
+	.direction = "out"   \
+}
+
+#define DRC_REPLY            \
+{                            \
+	.name = "totals",    \
+	.type = "(stststststst)", \
+	.direction = "out"   \
+},                           \
+{                            \
+	.name = "drcs",      \
+	.type = "a(sstttt)", \
+	.direction = "out"   \
+}
+
+#define DISPATCH_REPLY       \
+{                            \
+	.name = "weight",    \
+	.type = "u",         \
+	.direction = "out"   \
+},                           \
+{                            \
+	.name = "queues",    \
+	.type = "a(sutt)",   \
+	.direction = "out"   \
+}
+
 #define LAYOUTS_REPLY		\
 {				\
 	.name = "getdevinfo",	\
@@ -202,11 +233,13 @@ struct export_stats {
 }
 
 /* number of delegations, number of sent recalls,
- * number of failed recalls, number of revokes */
+ * number of failed recalls, number of revokes, delegations not
+ * granted as the file was recalled lately, as the client failed
+ * recalls lately, and as the file is shared with writers */
 #define DELEG_REPLY		       \
 {				       \
 	.name = "delegation_stats",    \
-	.type = "(tttt)",	       \
+	.type = "(uuuuuuu)",	       \
 	.direction = "out"	       \
 }
 
@@ -251,6 +284,9 @@ void server_dbus_total_ops(struct export_stats *export_st,
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void cache_inode_dbus_show_mem(DBusMessageIter *iter);
+void admission_dbus_show(DBusMessageIter *iter);
+void dupreq_dbus_show(DBusMessageIter *iter);
 
 #ifdef _USE_9P
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
@@ -0,0 +1,231 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file slab_pool.h
+ * @brief A pool substrate that recycles freed objects
+ *
+ * Objects returned to the pool are kept on free lists and handed out
+ * again instead of going back to the allocator, so a workload that
+ * creates and drops many objects of one kind in quick succession does
+ * not keep calling malloc and free.  The free lists are sharded by
+ * CPU, each with its own lock, and each keeps at most a bounded
+ * number of objects; beyond that, objects are freed.
+ *
+ * As with the basic substrate, an object from a pool without a
+ * constructor comes back zeroed.
+ */
+
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+/* sched_getcpu() is declared only for GNU sources */
+#ifndef _GNU_SOURCE
+#error "slab_pool.h requires _GNU_SOURCE"
+#endif
+
+#include <sched.h>
+#include <pthread.h>
+#include "abstract_mem.h"
+#include "common_utils.h"
+
+#define POOL_SLAB_SHARDS 16
+
+/** Default for the objects kept on each shard's free list */
+#define POOL_SLAB_MAX_FREE 1024
+
+/**
+ * @brief Parameters to a slab pool
+ */
+
+struct pool_slab_params {
+	uint32_t max_free;	/*< Objects kept on each shard */
+};
+
+/**
+ * @brief One free list
+ */
+
+struct pool_slab_shard {
+	pthread_mutex_t mtx;
+	void *free;		/*< Objects, linked through their first word */
+	uint32_t nfree;		/*< Length of free */
+} __attribute__ ((aligned(64)));
+
+/**
+ * @brief The slab substrate's part of a pool
+ */
+
+struct pool_slab {
+	uint32_t max_free;
+	struct pool_slab_shard shards[POOL_SLAB_SHARDS];
+};
+
+/**
+ * @brief The slab part of a pool, cache line aligned within it
+ */
+
+static inline struct pool_slab *pool_slab_of(pool_t *pool)
+{
+	return (struct pool_slab *)(((uintptr_t)pool->substrate_data + 63)
+				    & ~(uintptr_t)63);
+}
+
+static inline struct pool_slab_shard *pool_slab_shard(pool_t *pool)
+{
+	int cpu = sched_getcpu();
+
+	if (cpu < 0)
+		cpu = 0;
+
+	return &pool_slab_of(pool)->shards[cpu % POOL_SLAB_SHARDS];
+}
+
+/**
+ * @brief Initialize a slab pool
+ *
+ * @param[in] size  Size of the object, at least a pointer
+ * @param[in] param A struct pool_slab_params, or NULL for defaults
+ *
+ * @return the allocated pool_t structure.
+ */
+
+static inline pool_t *
+pool_slab_initializer(size_t size, void *param)
+{
+	struct pool_slab_params *params = param;
+	pool_t *pool;
+	struct pool_slab *slab;
+	int i;
+
+	assert(size >= sizeof(void *));
+
+	pool = gsh_malloc(sizeof(pool_t) + sizeof(struct pool_slab) + 64);
+	if (pool == NULL)
+		return NULL;
+
+	slab = pool_slab_of(pool);
+	slab->max_free = params != NULL ? params->max_free
+					: POOL_SLAB_MAX_FREE;
+
+	for (i = 0; i < POOL_SLAB_SHARDS; i++) {
+		PTHREAD_MUTEX_init(&slab->shards[i].mtx, NULL);
+		slab->shards[i].free = NULL;
+		slab->shards[i].nfree = 0;
+	}
+
+	return pool;
+}
+
+/**
+ * @brief Destroy a slab pool, freeing the objects it kept
+ *
+ * @param[in] pool The pool to destroy
+ */
+
+static inline void
+pool_slab_destroy(pool_t *pool)
+{
+	struct pool_slab *slab = pool_slab_of(pool);
+	void *object;
+	int i;
+
+	for (i = 0; i < POOL_SLAB_SHARDS; i++) {
+		while (slab->shards[i].free != NULL) {
+			object = slab->shards[i].free;
+			slab->shards[i].free = *(void **)object;
+			gsh_free(object);
+		}
+		PTHREAD_MUTEX_destroy(&slab->shards[i].mtx);
+	}
+
+	if (pool->name)
+		gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Allocate an object from a slab pool
+ *
+ * @param[in] pool The pool from which to allocate.
+ *
+ * @return the allocated object or NULL.
+ */
+
+static inline void *
+pool_slab_alloc(pool_t *pool)
+{
+	struct pool_slab_shard *shard = pool_slab_shard(pool);
+	void *object;
+
+	PTHREAD_MUTEX_lock(&shard->mtx);
+	object = shard->free;
+	if (object != NULL) {
+		shard->free = *(void **)object;
+		shard->nfree--;
+	}
+	PTHREAD_MUTEX_unlock(&shard->mtx);
+
+	if (object == NULL)
+		return pool->constructor ? gsh_malloc(pool->object_size)
+					 : gsh_calloc(1, pool->object_size);
+
+	if (pool->constructor == NULL)
+		memset(object, 0, pool->object_size);
+
+	return object;
+}
+
+/**
+ * @brief Return an object to a slab pool
+ *
+ * @param[in] pool   The pool to which the object belongs
+ * @param[in] object The object to return
+ */
+
+static inline void
+pool_slab_free(pool_t *pool, void *object)
+{
+	struct pool_slab_shard *shard = pool_slab_shard(pool);
+
+	PTHREAD_MUTEX_lock(&shard->mtx);
+	if (shard->nfree < pool_slab_of(pool)->max_free) {
+		*(void **)object = shard->free;
+		shard->free = object;
+		shard->nfree++;
+		object = NULL;
+	}
+	PTHREAD_MUTEX_unlock(&shard->mtx);
+
+	if (object != NULL)
+		gsh_free(object);
+}
+
+static const struct pool_substrate_vector pool_slab_substrate[] = {
+	{
+		.initializer = pool_slab_initializer,
+		.destroyer = pool_slab_destroy,
+		.allocator = pool_slab_alloc,
+		.freer = pool_slab_free
+	}
+};
+
+#endif				/* SLAB_POOL_H */
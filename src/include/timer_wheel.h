@@ -0,0 +1,90 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @defgroup timer_wheel Timer wheels
+ *
+ * Hierarchical timing wheels with a resolution of one second.  Level
+ * 0 has a slot for each of the next 64 seconds, level 1 a slot for
+ * each of the next 64 spans of 64 seconds, and so on over four
+ * levels; a deadline further out than that waits in the last slot.
+ * As the wheel turns, each slot of a higher level is spread over the
+ * level below it when that one wraps.
+ *
+ * Arming and disarming an entry are O(1), and advancing the wheel
+ * touches only the entries that fall due and those cascading down,
+ * so whoever drives it never looks at entries that are not close to
+ * expiring.
+ *
+ * Entries are embedded in the caller's structures.  The wheel does no
+ * allocation and no locking.
+ *
+ * @{
+ */
+
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheels
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "gsh_list.h"
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+/**
+ * @brief A deadline, embedded in the structure it belongs to
+ */
+
+struct timer_wheel_entry {
+	struct glist_head link;		/*< Link in a slot, or the list
+					    of expired entries */
+	time_t expires;			/*< Deadline */
+	bool armed;			/*< In a slot */
+};
+
+/**
+ * @brief A wheel of deadlines
+ */
+
+struct timer_wheel {
+	time_t now;			/*< The next second to expire */
+	uint32_t armed;			/*< Entries in slots */
+	struct glist_head slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+void timer_wheel_init(struct timer_wheel *tw, time_t now);
+void timer_wheel_arm(struct timer_wheel *tw, struct timer_wheel_entry *te,
+		     time_t expires);
+bool timer_wheel_disarm(struct timer_wheel *tw, struct timer_wheel_entry *te);
+uint32_t timer_wheel_advance(struct timer_wheel *tw, time_t now,
+			     struct glist_head *expired);
+
+#endif				/* TIMER_WHEEL_H */
+
+/** @} */
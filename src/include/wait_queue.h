@@ -38,7 +38,14 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <time.h>
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #include "gsh_list.h"
+#include "abstract_atomic.h"
 
 typedef struct wait_entry {
 	pthread_mutex_t mtx;
@@ -97,4 +104,170 @@ static inline void thread_delay_ms(unsigned long ms)
 	nanosleep(&then, NULL);
 }
 
+/**
+ * @brief An eventcount
+ *
+ * Lets threads sleep until some condition they poll for may have
+ * become true, without a lock shared with the threads that make it
+ * true.  A waiter takes a key with ec_prepare(), re-checks its
+ * condition, and then either ec_cancel()s or ec_wait()s; a signal
+ * between ec_prepare() and ec_wait() makes the wait return at once.
+ * Signalling with nobody waiting costs a fence and a load.
+ *
+ * The waiter count covers only threads nobody has signalled yet: a
+ * signal moves the waiters it wakes from @c waiters to @c woken in
+ * the same atomic update that bumps the sequence, and each returning
+ * waiter consumes a @c woken token if there is one, or else removes
+ * itself from @c waiters.  So a second signal is not spent on a
+ * waiter that is already awake.
+ *
+ * On Linux the sequence word is a futex; elsewhere a mutex and
+ * condition variable stand in.
+ */
+
+typedef struct eventcount {
+	union {
+		uint64_t word;	/*< All three, for atomic update */
+		struct {
+			uint32_t seq;	/*< Bumped by every signal that wakes */
+			uint16_t waiters; /*< Prepared and not yet signalled */
+			uint16_t woken;	/*< Signalled and not yet returned */
+		} c;
+	} u;
+#if !defined(__linux__)
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+#endif
+} eventcount_t;
+
+static inline void ec_init(eventcount_t *ec)
+{
+	ec->u.word = 0;
+#if !defined(__linux__)
+	pthread_mutex_init(&ec->mtx, NULL);
+	pthread_cond_init(&ec->cv, NULL);
+#endif
+}
+
+/**
+ * @brief Announce an intent to wait
+ *
+ * @return The key to pass to ec_wait().
+ */
+
+static inline uint32_t ec_prepare(eventcount_t *ec)
+{
+	eventcount_t old, new;
+
+	do {
+		old.u.word = atomic_fetch_uint64_t(&ec->u.word);
+		new.u.word = old.u.word;
+		new.u.c.waiters++;
+	} while (!atomic_cas_uint64_t(&ec->u.word, old.u.word, new.u.word));
+
+	return new.u.c.seq;
+}
+
+/**
+ * @brief Leave the eventcount after ec_prepare()
+ *
+ * Consumes a wakeup meant for some waiter if there is one, since a
+ * signal already removed that waiter from the count; otherwise
+ * removes the caller from it.
+ */
+
+static inline void ec_cancel(eventcount_t *ec)
+{
+	eventcount_t old, new;
+
+	do {
+		old.u.word = atomic_fetch_uint64_t(&ec->u.word);
+		new.u.word = old.u.word;
+		if (new.u.c.woken > 0)
+			new.u.c.woken--;
+		else
+			new.u.c.waiters--;
+	} while (!atomic_cas_uint64_t(&ec->u.word, old.u.word, new.u.word));
+}
+
+/**
+ * @brief Sleep until signalled since ec_prepare() or timed out
+ *
+ * @param[in] ec   The eventcount
+ * @param[in] key  From ec_prepare()
+ * @param[in] ms   Timeout
+ */
+
+static inline void ec_wait(eventcount_t *ec, uint32_t key, uint32_t ms)
+{
+	struct timespec ts = {
+		.tv_sec = ms / 1000,
+		.tv_nsec = (ms % 1000) * 1000000UL
+	};
+
+#if defined(__linux__)
+	(void)syscall(SYS_futex, &ec->u.c.seq, FUTEX_WAIT_PRIVATE, key, &ts,
+		      NULL, 0);
+#else
+	struct timespec abstime;
+
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += ts.tv_sec;
+	abstime.tv_nsec += ts.tv_nsec;
+	if (abstime.tv_nsec >= 1000000000L) {
+		abstime.tv_sec++;
+		abstime.tv_nsec -= 1000000000L;
+	}
+	pthread_mutex_lock(&ec->mtx);
+	if (atomic_fetch_uint32_t(&ec->u.c.seq) == key)
+		(void)pthread_cond_timedwait(&ec->cv, &ec->mtx, &abstime);
+	pthread_mutex_unlock(&ec->mtx);
+#endif
+	ec_cancel(ec);
+}
+
+/**
+ * @brief Wake waiters, if there are any
+ *
+ * The caller must already have made its condition true.
+ *
+ * @param[in] ec  The eventcount
+ * @param[in] n   Number of waiters to wake, INT32_MAX for all
+ *
+ * @return true if anybody not yet signalled was waiting.
+ */
+
+static inline bool ec_signal(eventcount_t *ec, int n)
+{
+	eventcount_t old, new;
+	uint16_t wake;
+
+	/* order the caller's stores before the load of waiters */
+	__sync_synchronize();
+	do {
+		old.u.word = atomic_fetch_uint64_t(&ec->u.word);
+		if (old.u.c.waiters == 0)
+			return false;
+
+		wake = (n < old.u.c.waiters) ? n : old.u.c.waiters;
+		new.u.word = old.u.word;
+		new.u.c.seq++;
+		new.u.c.waiters -= wake;
+		new.u.c.woken += wake;
+	} while (!atomic_cas_uint64_t(&ec->u.word, old.u.word, new.u.word));
+
+#if defined(__linux__)
+	(void)syscall(SYS_futex, &ec->u.c.seq, FUTEX_WAKE_PRIVATE, n, NULL,
+		      NULL, 0);
+#else
+	pthread_mutex_lock(&ec->mtx);
+	if (n == 1)
+		pthread_cond_signal(&ec->cv);
+	else
+		pthread_cond_broadcast(&ec->cv);
+	pthread_mutex_unlock(&ec->mtx);
+#endif
+	return true;
+}
+
 #endif /* WAIT_QUEUE_H */
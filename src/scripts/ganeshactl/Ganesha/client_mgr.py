@@ -58,6 +58,13 @@ class ClientMgr(QtDBus.QDBusAbstractInterface):
         status = QtDBus.QDBusPendingCallWatcher(async, self)
         status.finished.connect(self.clientmgr_done)
 
+    def SetDispatchWeight(self, ipaddr, weight):
+        arg = QtDBus.QDBusArgument()
+        arg.add(weight, QtCore.QMetaType.UInt)
+        async = self.asyncCall("SetDispatchWeight", ipaddr, arg)
+        status = QtDBus.QDBusPendingCallWatcher(async, self)
+        status.finished.connect(self.clientmgr_done)
+
     def ShowClients(self):
         async = self.asyncCall("ShowClients")
         status = QtDBus.QDBusPendingCallWatcher(async, self)
@@ -44,6 +44,21 @@ class RetrieveExportStats():
         stats_op = self.exportmgrobj.get_dbus_method("ShowCacheInode",
                                  self.dbus_exportstats_name)
         return InodeStats(stats_op())
+    # cache inode memory use by object type
+    def inode_mem_stats(self):
+        stats_op = self.exportmgrobj.get_dbus_method("ShowCacheInodeMemory",
+                                 self.dbus_exportstats_name)
+        return InodeMemStats(stats_op())
+    # load shed by admission control
+    def admission_stats(self):
+        stats_op = self.exportmgrobj.get_dbus_method("ShowAdmission",
+                                 self.dbus_exportstats_name)
+        return AdmissionStats(stats_op())
+    # duplicate request cache occupancy and hits
+    def drc_stats(self):
+        stats_op = self.exportmgrobj.get_dbus_method("ShowDRC",
+                                 self.dbus_exportstats_name)
+        return DRCStats(stats_op())
     # list of all exports
     def export_stats(self):
         stats_op = self.exportmgrobj.get_dbus_method("ShowExports",
@@ -114,6 +129,11 @@ class RetrieveClientStats():
         stats_op = self.clientmgrobj.get_dbus_method("GetDelegations",
                           self.dbus_clientstats_name)
         return DelegStats(stats_op(ip))
+    # dispatch queue stats of a single client ip
+    def dispatch_stats(self, ip):
+        stats_op = self.clientmgrobj.get_dbus_method("GetDispatchQueues",
+                          self.dbus_clientstats_name)
+        return DispatchStats(stats_op(ip))
     def list_clients(self):
         stats_op = self.clientmgrobj.get_dbus_method("ShowClients",
                           self.dbus_clientmgr_name)
@@ -146,6 +166,9 @@ class DelegStats():
             self.curr_recall = stats[3][1]
             self.fail_recall = stats[3][2]
             self.num_revokes = stats[3][3]
+            self.declined_file = stats[3][4]
+            self.declined_client = stats[3][5]
+            self.declined_shared = stats[3][6]
     def __str__(self):
         if self.status != "OK":
             return ("GANESHA RESPONSE STATUS: " + self.status)
@@ -155,7 +178,30 @@ class DelegStats():
                      "\nCurrent Delegations: " + str(self.curr_deleg) +
                      "\nCurrent Recalls: " + str(self.curr_recall) +
                      "\nCurrent Failed Recalls: " + str(self.fail_recall) +
-                     "\nCurrent Number of Revokes: " + str(self.num_revokes) )
+                     "\nCurrent Number of Revokes: " + str(self.num_revokes) +
+                     "\nNot Granted, File Recalled: " + str(self.declined_file) +
+                     "\nNot Granted, Client Failed Recalls: " + str(self.declined_client) +
+                     "\nNot Granted, File Shared and Written: " + str(self.declined_shared) )
+
+class DispatchStats():
+    def __init__(self, stats):
+        self.status = stats[1]
+        if stats[1] == "OK":
+            self.timestamp = (stats[2][0], stats[2][1])
+            self.weight = stats[3]
+            self.queues = stats[4]
+    def __str__(self):
+        if self.status != "OK":
+            return ("GANESHA RESPONSE STATUS: " + self.status)
+        output = ( "GANESHA RESPONSE STATUS: " + self.status +
+                   "\nTimestamp: " + time.ctime(self.timestamp[0]) + str(self.timestamp[1]) + " nsecs" +
+                   "\nWeight: " + str(self.weight) )
+        for (qname, depth, served, wait_ns) in self.queues:
+            output += ("\n" + str(qname) + ": " + str(depth) + " queued, " +
+                       str(served) + " dispatched")
+            if served > 0:
+                output += (", avg wait " + str(wait_ns / served) + " nsecs")
+        return output
 
 class Export():
     def __init__(self, export):
@@ -236,6 +282,89 @@ class InodeStats():
                  "\nInode Cache Adds: " + str(self.cache_add) +
                  "\nInode Cache Mapping: " + str(self.cache_mapping) )
 
+class InodeMemStats():
+    def __init__(self, stats):
+        self.status = stats[1]
+        if stats[1] != "OK":
+            return
+        self.timestamp = (stats[2][0], stats[2][1])
+        self.types = stats[3]
+    def __str__(self):
+        if self.status != "OK":
+            return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
+        output = ("Timestamp: " + time.ctime(self.timestamp[0]) + str(self.timestamp[1]) + " nsecs" +
+                  "\nInode Cache Memory:" )
+        total_entries = 0
+        total_bytes = 0
+        for (objtype, entries, nbytes) in self.types:
+            total_entries += entries
+            total_bytes += nbytes
+            output += ("\n " + str(objtype) + ": " + str(entries) +
+                       " entries, " + str(nbytes) + " bytes (" +
+                       str(nbytes / entries) + " bytes/entry)")
+        output += ("\nTotal: " + str(total_entries) + " entries, " +
+                   str(total_bytes) + " bytes")
+        return output
+
+class AdmissionStats():
+    def __init__(self, stats):
+        self.status = stats[1]
+        if stats[1] != "OK":
+            return
+        self.timestamp = (stats[2][0], stats[2][1])
+        self.overloaded = stats[3][1]
+        self.overloads = stats[3][3]
+        self.xprt_stalls = stats[3][5]
+        self.slot_cuts = stats[3][7]
+        self.sessions = stats[3][9]
+        self.slot_targets = stats[3][11]
+        self.slots_allocated = stats[3][13]
+        self.slot_grows = stats[3][15]
+        self.slot_shrinks = stats[3][17]
+    def __str__(self):
+        if self.status != "OK":
+            return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
+        return ( "Timestamp: " + time.ctime(self.timestamp[0]) + str(self.timestamp[1]) + " nsecs" +
+                 "\nLanes Overloaded: " + str(self.overloaded) +
+                 "\nOverload Episodes: " + str(self.overloads) +
+                 "\nTransports Stalled: " + str(self.xprt_stalls) +
+                 "\nSlot Targets Cut: " + str(self.slot_cuts) +
+                 "\nSessions: " + str(self.sessions) +
+                 "\nSlot Targets: " + str(self.slot_targets) +
+                 "\nSlots Allocated: " + str(self.slots_allocated) +
+                 "\nSlot Tables Grown: " + str(self.slot_grows) +
+                 "\nSlot Tables Shrunk: " + str(self.slot_shrinks) )
+
+class DRCStats():
+    def __init__(self, stats):
+        self.status = stats[1]
+        if stats[1] != "OK":
+            return
+        self.timestamp = (stats[2][0], stats[2][1])
+        self.budget = stats[3][1]
+        self.entries = stats[3][3]
+        self.bytes = stats[3][5]
+        self.hits = stats[3][7]
+        self.misses = stats[3][9]
+        self.evictions = stats[3][11]
+        self.drcs = stats[4]
+    def __str__(self):
+        if self.status != "OK":
+            return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
+        output = ("Timestamp: " + time.ctime(self.timestamp[0]) + str(self.timestamp[1]) + " nsecs" +
+                  "\nBudget: " + str(self.budget) + " bytes" +
+                  "\nHeld: " + str(self.entries) + " entries, " +
+                  str(self.bytes) + " bytes" +
+                  "\nHits: " + str(self.hits) +
+                  "\nMisses: " + str(self.misses) +
+                  "\nEvictions: " + str(self.evictions) )
+        for (addr, drctype, entries, nbytes, hits, misses) in self.drcs:
+            output += ("\n " + str(addr) + " " + str(drctype) + ": " +
+                       str(entries) + " entries, " + str(nbytes) +
+                       " bytes, " + str(hits) + " hits, " +
+                       str(misses) + " misses")
+        return output
+
 class FastStats():
     def __init__(self, stats):
         self.stats = stats
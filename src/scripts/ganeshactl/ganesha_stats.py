@@ -15,7 +15,8 @@ import Ganesha.glib_dbus_stats
 def usage():
     message = "Command gives global stats by default.\n"
     message += "%s [list_clients | deleg <ip address> | " % (sys.argv[0])
-    message += "inode | iov3 [export id] | iov4 [export id] | export |"
+    message += "dispatch <ip address> | "
+    message += "inode | inode_mem | admission | drc | iov3 [export id] | iov4 [export id] | export |"
     message += " total [export id] | fast | pnfs [export id] ]"
     sys.exit(message)
 
@@ -25,13 +26,13 @@ else:
     command = sys.argv[1]
 
 # check arguments
-commands = ('help', 'list_clients', 'deleg', 'global', 'inode', 'iov3', 'iov4',
-           'export', 'total', 'fast', 'pnfs')
+commands = ('help', 'list_clients', 'deleg', 'dispatch', 'global', 'inode',
+           'inode_mem', 'admission', 'drc', 'iov3', 'iov4', 'export', 'total', 'fast', 'pnfs')
 if command not in commands:
     print "Option \"%s\" is not correct." % (command)
     usage()
 # requires an IP address
-elif command in ('deleg'):
+elif command in ('deleg', 'dispatch'):
     if not len(sys.argv) == 3:
         print "Option \"%s\" must be followed by an ip address." % (command)
         usage()
@@ -56,12 +57,20 @@ elif command == "export":
     print exp_interface.export_stats()
 elif command == "inode":
     print exp_interface.inode_stats()
+elif command == "inode_mem":
+    print exp_interface.inode_mem_stats()
+elif command == "admission":
+    print exp_interface.admission_stats()
+elif command == "drc":
+    print exp_interface.drc_stats()
 elif command == "fast":
     print exp_interface.fast_stats()
 elif command == "list_clients":
     print cl_interface.list_clients()
 elif command == "deleg":
     print cl_interface.deleg_stats(command_arg)
+elif command == "dispatch":
+    print cl_interface.dispatch_stats(command_arg)
 elif command == "iov3":
     print exp_interface.v3io_stats(command_arg)
 elif command == "iov4":
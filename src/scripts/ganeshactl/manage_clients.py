@@ -49,6 +49,10 @@ class ManageClients(QtCore.QObject):
         self.clientmgr.RemoveClient(ipaddr)
         print "Remove a client %s" % (ipaddr)
 
+    def setweight(self, ipaddr, weight):
+        self.clientmgr.SetDispatchWeight(ipaddr, weight)
+        print "Set dispatch weight of client %s to %d" % (ipaddr, weight)
+
     def showclients(self):
         self.clientmgr.ShowClients()
         print "Show clients"
@@ -87,6 +91,8 @@ if __name__ == '__main__':
         clientmgr.addclient(sys.argv[2])
     elif sys.argv[1] == "remove":
         clientmgr.removeclient(sys.argv[2])
+    elif sys.argv[1] == "weight":
+        clientmgr.setweight(sys.argv[2], int(sys.argv[3]))
     elif sys.argv[1] == "show":
         clientmgr.showclients()
     else:
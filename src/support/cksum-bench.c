@@ -0,0 +1,117 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file cksum-bench.c
+ * @brief Per-request cost of DRC checksums
+ *
+ * Times a digest of WRITE payloads of several sizes: a full pass of
+ * CityHash64 over the payload, as a checksum of the whole request
+ * costs, against gsh_cksum() of a bounded prefix and the length with
+ * each hash.  Like city-test.c this is not part of the build:
+ *
+ *   cc -O2 -D_GNU_SOURCE -Iinclude -I<build>/include \
+ *      support/cksum-bench.c support/gsh_cksum.c support/city.c \
+ *      support/xxhash.c -o cksum-bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "city.h"
+#include "gsh_cksum.h"
+
+#define PREFIX 256
+#define ROUNDS (64 << 20)	/* bytes digested per measurement */
+
+static const size_t sizes[] = { 1024, 4096, 65536, 1048576 };
+
+static const struct {
+	const char *name;
+	enum gsh_cksum_type type;
+} hashes[] = {
+	{ "crc32c", GSH_CKSUM_CRC32C },
+	{ "xxhash", GSH_CKSUM_XXHASH },
+	{ "city", GSH_CKSUM_CITY },
+};
+
+static volatile uint64_t sink;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Average ns per digest of a payload of len bytes
+ */
+
+static double bench(const char *buf, size_t len, int full,
+		    enum gsh_cksum_type type)
+{
+	long n = ROUNDS / len + 1000;
+	long i;
+	double start = now_ns();
+
+	for (i = 0; i < n; i++) {
+		if (full)
+			sink += CityHash64WithSeed(buf, len, i);
+		else
+			sink += gsh_cksum(type, buf, len, PREFIX, i);
+	}
+
+	return (now_ns() - start) / n;
+}
+
+int main(void)
+{
+	size_t max = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+	char *buf = malloc(max);
+	size_t i, j;
+
+	if (buf == NULL)
+		return 1;
+	for (i = 0; i < max; i++)
+		buf[i] = rand();
+
+	gsh_cksum_pkginit();
+	printf("CRC32C in %s, prefix %d bytes\n",
+	       gsh_cksum_hw() ? "hardware" : "software", PREFIX);
+	printf("%10s %12s", "payload", "full city");
+	for (j = 0; j < sizeof(hashes) / sizeof(hashes[0]); j++)
+		printf(" %12s", hashes[j].name);
+	printf("   (ns/request)\n");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		printf("%10zu %12.1f", sizes[i], bench(buf, sizes[i], 1, 0));
+		for (j = 0; j < sizeof(hashes) / sizeof(hashes[0]); j++)
+			printf(" %12.1f",
+			       bench(buf, sizes[i], 0, hashes[j].type));
+		printf("\n");
+	}
+
+	free(buf);
+	return 0;
+}
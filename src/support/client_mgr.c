@@ -136,6 +136,7 @@ struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only)
 	uint32_t ipaddr;
 	int addr_len = 0;
 	void **cache_slot;
+	int ix;
 
 	switch (client_ipaddr->ss_family) {
 	case AF_INET:
@@ -205,6 +206,8 @@ struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only)
 	cl->refcnt = 0;		/* we will hold a ref starting out... */
 	sprint_sockip(client_ipaddr, hoststr, SOCK_NAME_MAX);
 	cl->hostaddr_str = gsh_strdup(hoststr);
+	for (ix = 0; ix < N_REQ_QUEUES; ix++)
+		nfs_rpc_flow_init(&cl->flows[ix], 1);
 
 	PTHREAD_RWLOCK_wrlock(&client_by_ip.lock);
 	node = avltree_insert(&cl->node_k, &client_by_ip.t);
@@ -464,6 +467,69 @@ static struct gsh_dbus_method cltmgr_remove_client = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Set a client's weight in the dispatch fair queue via DBUS
+ *
+ * @param args [IN] dbus argument stream from the message
+ * @param reply [OUT] dbus reply stream for method to fill
+ */
+
+static bool gsh_client_setweight(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	sockaddr_t sockaddr;
+	uint32_t weight = 0;
+	bool success;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+	int ix;
+
+	dbus_message_iter_init_append(reply, &iter);
+	success = arg_ipaddr(args, &sockaddr, &errormsg);
+	if (success) {
+		dbus_message_iter_next(args);
+		if (DBUS_TYPE_UINT32 != dbus_message_iter_get_arg_type(args)) {
+			success = false;
+			errormsg = "arg not a 32 bit integer";
+		} else {
+			dbus_message_iter_get_basic(args, &weight);
+			if (weight < 1 || weight > 1024) {
+				success = false;
+				errormsg = "weight must be 1 to 1024";
+			}
+		}
+	}
+	if (success) {
+		client = get_gsh_client(&sockaddr, false);
+		if (client == NULL) {
+			success = false;
+			errormsg = "No memory to insert client";
+		}
+	}
+	if (success) {
+		for (ix = 0; ix < N_REQ_QUEUES; ix++)
+			atomic_store_uint32_t(&client->flows[ix].weight,
+					      weight);
+		put_gsh_client(client);
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_set_weight = {
+	.name = "SetDispatchWeight",
+	.method = gsh_client_setweight,
+	.args = {IPADDR_ARG,
+		 {
+		  .name = "weight",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
 struct showclients_state {
 	DBusMessageIter client_iter;
 };
@@ -531,6 +597,7 @@ static struct gsh_dbus_method *cltmgr_client_methods[] = {
 	&cltmgr_add_client,
 	&cltmgr_remove_client,
 	&cltmgr_show_clients,
+	&cltmgr_set_weight,
 	NULL
 };
 
@@ -799,6 +866,80 @@ static struct gsh_dbus_method cltmgr_show_delegations = {
 		 END_ARG_LIST}
 };
 
+/**
+ * DBUS method to report a client's dispatch queues
+ *
+ * For each request class: requests queued now, requests dispatched,
+ * and the total nanoseconds those waited in the queue.
+ */
+static bool get_stats_dispatch(DBusMessageIter *args,
+			       DBusMessage *reply,
+			       DBusError *error)
+{
+	char *errormsg = "OK";
+	struct gsh_client *client = NULL;
+	bool success = true;
+	DBusMessageIter iter, array_iter, struct_iter;
+	struct timespec timestamp;
+	uint32_t weight;
+	int ix;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		errormsg = "Client IP address not found";
+	}
+
+	dbus_status_reply(&iter, success, errormsg);
+	if (!success)
+		return true;
+
+	now(&timestamp);
+	dbus_append_timestamp(&iter, &timestamp);
+	weight = atomic_fetch_uint32_t(&client->flows[0].weight);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &weight);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sutt)",
+					 &array_iter);
+	for (ix = 0; ix < N_REQ_QUEUES; ix++) {
+		struct req_flow *flow = &client->flows[ix];
+		uint32_t size;
+		uint64_t served, wait_ns;
+
+		pthread_spin_lock(&flow->sp);
+		size = flow->size;
+		served = flow->served;
+		wait_ns = flow->wait_ns;
+		pthread_spin_unlock(&flow->sp);
+
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+					       &req_q_s[ix]);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+					       &size);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &served);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &wait_ns);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(&iter, &array_iter);
+
+	put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_dispatch = {
+	.name = "GetDispatchQueues",
+	.method = get_stats_dispatch,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 DISPATCH_REPLY,
+		 END_ARG_LIST}
+};
+
 #ifdef _USE_9P
 /**
  * DBUS method to report 9p I/O statistics
@@ -952,6 +1093,7 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v41_io,
 	&cltmgr_show_v41_layouts,
 	&cltmgr_show_delegations,
+	&cltmgr_show_dispatch,
 #ifdef _USE_9P
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
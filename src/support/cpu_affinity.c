@@ -0,0 +1,212 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cpu_affinity
+ * @{
+ */
+
+/**
+ * @file cpu_affinity.c
+ * @brief Implementation of CPU topology and thread placement
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include "log.h"
+#include "cpu_affinity.h"
+
+/** Most NUMA nodes we keep track of */
+#define CPU_MAX_NODES 64
+
+/** Number of nodes found, at least 1 */
+static uint32_t cpu_nodes = 1;
+/** Node of each CPU */
+static uint8_t cpu_node[CPU_SETSIZE];
+/** CPUs of each node */
+static cpu_set_t node_cpus[CPU_MAX_NODES];
+
+/**
+ * @brief Parse a CPU list such as "0-3,8,10-11"
+ *
+ * This is the format of the kernel's cpulist files and of taskset -c.
+ *
+ * @param[in]  list  The list
+ * @param[out] set   The CPUs in it
+ *
+ * @return true if the list was well formed and not empty.
+ */
+
+bool cpu_list_parse(const char *list, cpu_set_t *set)
+{
+	const char *p = list;
+	char *end;
+	long lo, hi;
+
+	CPU_ZERO(set);
+
+	while (*p != '\0') {
+		while (isspace((unsigned char)*p) || *p == ',')
+			p++;
+		if (*p == '\0')
+			break;
+
+		lo = strtol(p, &end, 10);
+		if (end == p || lo < 0)
+			return false;
+		hi = lo;
+		p = end;
+		if (*p == '-') {
+			p++;
+			hi = strtol(p, &end, 10);
+			if (end == p || hi < lo)
+				return false;
+			p = end;
+		}
+		if (hi >= CPU_SETSIZE)
+			return false;
+
+		for (; lo <= hi; lo++)
+			CPU_SET(lo, set);
+
+		while (isspace((unsigned char)*p))
+			p++;
+		if (*p != '\0' && *p != ',')
+			return false;
+	}
+
+	return CPU_COUNT(set) > 0;
+}
+
+/**
+ * @brief Learn which CPUs are on which NUMA node
+ */
+
+void cpu_topology_init(void)
+{
+	char path[64];
+	char buf[1024];
+	uint32_t node, found = 0;
+	int cpu;
+	FILE *f;
+
+	memset(cpu_node, 0, sizeof(cpu_node));
+
+	for (node = 0; node < CPU_MAX_NODES; node++) {
+		CPU_ZERO(&node_cpus[node]);
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%u/cpulist", node);
+		f = fopen(path, "r");
+		if (f == NULL)
+			continue;
+		if (fgets(buf, sizeof(buf), f) != NULL) {
+			buf[strcspn(buf, "\n")] = '\0';
+			if (!cpu_list_parse(buf, &node_cpus[found]))
+				CPU_ZERO(&node_cpus[found]);
+		}
+		fclose(f);
+
+		/* memoryless or CPU-less nodes are of no use here */
+		if (CPU_COUNT(&node_cpus[found]) == 0)
+			continue;
+
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &node_cpus[found]))
+				cpu_node[cpu] = found;
+		found++;
+	}
+
+	if (found == 0) {
+		/* no sysfs node information: one node with everything */
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &node_cpus[0]);
+		found = 1;
+	}
+
+	cpu_nodes = found;
+	LogInfo(COMPONENT_INIT, "%" PRIu32 " NUMA nodes with CPUs",
+		cpu_nodes);
+}
+
+/**
+ * @brief Number of NUMA nodes with CPUs
+ */
+
+uint32_t cpu_topology_nodes(void)
+{
+	return cpu_nodes;
+}
+
+/**
+ * @brief The NUMA node of a CPU
+ *
+ * @param[in] cpu  The CPU
+ *
+ * @return Its node, numbered densely from 0.
+ */
+
+uint32_t cpu_topology_node_of(int cpu)
+{
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return 0;
+	return cpu_node[cpu];
+}
+
+/**
+ * @brief The CPUs of a NUMA node
+ *
+ * @param[in]  node  The node
+ * @param[out] set   Its CPUs
+ */
+
+void cpu_topology_node_cpus(uint32_t node, cpu_set_t *set)
+{
+	*set = node_cpus[node % cpu_nodes];
+}
+
+/**
+ * @brief Bind the calling thread to a set of CPUs
+ *
+ * Memory the thread touches first is then allocated on the node(s)
+ * of those CPUs.
+ *
+ * @param[in] set  The CPUs
+ *
+ * @return 0 or an errno.
+ */
+
+int cpu_affinity_set_self(const cpu_set_t *set)
+{
+	int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+					set);
+
+	if (rc != 0)
+		LogWarn(COMPONENT_THREAD,
+			"Could not set CPU affinity: %s", strerror(rc));
+	return rc;
+}
+
+/** @} */
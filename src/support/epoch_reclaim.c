@@ -0,0 +1,290 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup epoch
+ * @{
+ */
+
+/**
+ * @file epoch_reclaim.c
+ * @brief Implementation of the epoch-based reclamation package
+ *
+ * The global epoch only ever advances.  A reader publishes the epoch
+ * it observed on entry in its per-thread record.  Each deferred
+ * object is tagged with the global epoch current when it was retired
+ * (after which the epoch is advanced), and may be released as soon as
+ * no record still publishes an epoch less than or equal to its tag.
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <sched.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "common_utils.h"
+#include "log.h"
+#include "epoch_reclaim.h"
+
+/**
+ * @brief A retired object awaiting a grace period
+ */
+
+struct epoch_deferred {
+	struct glist_head link;	/*< Link in the deferred list */
+	uint64_t epoch;		/*< Epoch at retirement */
+	void (*func)(void *);	/*< Release function */
+	void *arg;		/*< Release argument */
+};
+
+/**
+ * Number of pending objects that triggers an inline reclaim pass.
+ */
+#define EPOCH_RECLAIM_THRESHOLD 1024
+
+uint64_t epoch_global = 1;
+__thread struct epoch_record *epoch_self;
+
+/** All thread records, live or recycled */
+static struct glist_head epoch_records = GLIST_HEAD_INIT(epoch_records);
+/** Protects the record list */
+static pthread_mutex_t epoch_records_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** Retired objects, oldest first */
+static struct glist_head epoch_pending = GLIST_HEAD_INIT(epoch_pending);
+/** Protects the deferred list */
+static pthread_mutex_t epoch_pending_mtx = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t epoch_npending;
+
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Return a thread's record to the free pool on thread exit
+ */
+
+static void epoch_thread_exit(void *arg)
+{
+	struct epoch_record *rec = arg;
+
+	atomic_store_uint64_t(&rec->epoch, 0);
+	rec->nesting = 0;
+	PTHREAD_MUTEX_lock(&epoch_records_mtx);
+	rec->in_use = false;
+	PTHREAD_MUTEX_unlock(&epoch_records_mtx);
+}
+
+static void epoch_make_key(void)
+{
+	(void)pthread_key_create(&epoch_key, epoch_thread_exit);
+}
+
+/**
+ * @brief Attach an epoch record to the calling thread
+ *
+ * Called lazily from epoch_enter() the first time a thread enters a
+ * critical section.
+ *
+ * @return The calling thread's record.
+ */
+
+struct epoch_record *epoch_register(void)
+{
+	struct epoch_record *rec = NULL;
+	struct glist_head *glist;
+
+	(void)pthread_once(&epoch_key_once, epoch_make_key);
+
+	PTHREAD_MUTEX_lock(&epoch_records_mtx);
+	glist_for_each(glist, &epoch_records) {
+		rec = glist_entry(glist, struct epoch_record, rec_link);
+		if (!rec->in_use)
+			break;
+		rec = NULL;
+	}
+
+	if (rec == NULL) {
+		rec = gsh_malloc_aligned(GSH_CACHE_LINE_SIZE, sizeof(*rec));
+		if (rec == NULL) {
+			LogFatal(COMPONENT_INIT,
+				 "Unable to allocate epoch record");
+		}
+		memset(rec, 0, sizeof(*rec));
+		glist_add_tail(&epoch_records, &rec->rec_link);
+	}
+
+	rec->in_use = true;
+	rec->nesting = 0;
+	rec->epoch = 0;
+	if (rec->reserve == NULL)
+		rec->reserve = gsh_malloc(sizeof(struct epoch_deferred));
+	PTHREAD_MUTEX_unlock(&epoch_records_mtx);
+
+	(void)pthread_setspecific(epoch_key, rec);
+	epoch_self = rec;
+
+	return rec;
+}
+
+/**
+ * @brief Find the oldest epoch still published by a reader
+ *
+ * @return The minimum active epoch, or UINT64_MAX if all readers are
+ *         quiescent.
+ */
+
+static uint64_t epoch_min_active(void)
+{
+	struct glist_head *glist;
+	uint64_t min = UINT64_MAX;
+
+	PTHREAD_MUTEX_lock(&epoch_records_mtx);
+	glist_for_each(glist, &epoch_records) {
+		struct epoch_record *rec =
+			glist_entry(glist, struct epoch_record, rec_link);
+		uint64_t e = atomic_fetch_uint64_t(&rec->epoch);
+
+		if (e != 0 && e < min)
+			min = e;
+	}
+	PTHREAD_MUTEX_unlock(&epoch_records_mtx);
+
+	return min;
+}
+
+/**
+ * @brief Release every retired object whose grace period has elapsed
+ *
+ * Safe to call from any thread that is not itself inside a read-side
+ * critical section.
+ */
+
+void epoch_reclaim(void)
+{
+	struct glist_head ready;
+	struct glist_head *glist, *glistn;
+	uint64_t min = epoch_min_active();
+
+	glist_init(&ready);
+
+	PTHREAD_MUTEX_lock(&epoch_pending_mtx);
+	glist_for_each_safe(glist, glistn, &epoch_pending) {
+		struct epoch_deferred *def =
+			glist_entry(glist, struct epoch_deferred, link);
+
+		/* the list is in retirement order */
+		if (def->epoch >= min)
+			break;
+		glist_del(&def->link);
+		glist_add_tail(&ready, &def->link);
+		--epoch_npending;
+	}
+	PTHREAD_MUTEX_unlock(&epoch_pending_mtx);
+
+	glist_for_each_safe(glist, glistn, &ready) {
+		struct epoch_deferred *def =
+			glist_entry(glist, struct epoch_deferred, link);
+
+		glist_del(&def->link);
+		def->func(def->arg);
+		gsh_free(def);
+	}
+}
+
+/**
+ * @brief Wait for all pre-existing readers to leave
+ *
+ * On return, no reader that entered a critical section before the
+ * call can still be inside it.  Read-side sections are short, so this
+ * simply yields until they drain.  MUST NOT be called from within a
+ * read-side critical section.
+ */
+
+void epoch_synchronize(void)
+{
+	uint64_t target = atomic_inc_uint64_t(&epoch_global);
+
+	while (epoch_min_active() < target)
+		sched_yield();
+}
+
+/**
+ * @brief Release an object after a grace period
+ *
+ * The caller must already have made the object unreachable to new
+ * readers.
+ *
+ * @param[in] func Function to release the object
+ * @param[in] arg  Argument to func
+ */
+
+void epoch_defer(void (*func)(void *), void *arg)
+{
+	struct epoch_record *rec = epoch_self;
+	struct epoch_deferred *def = gsh_malloc(sizeof(*def));
+	bool reclaim;
+
+	if (unlikely(def == NULL)) {
+		if (rec == NULL || rec->nesting == 0) {
+			/* no memory to queue it, so pay for the grace
+			 * period now */
+			epoch_synchronize();
+			func(arg);
+			return;
+		}
+		/* Inside a read-side section a grace period would wait
+		 * on ourselves.  Use the thread's spare, or wait for
+		 * memory. */
+		def = rec->reserve;
+		rec->reserve = NULL;
+		while (def == NULL) {
+			sched_yield();
+			def = gsh_malloc(sizeof(*def));
+		}
+	} else if (unlikely(rec != NULL && rec->reserve == NULL)) {
+		/* the spare was used; replace it now memory is back */
+		rec->reserve = gsh_malloc(sizeof(*def));
+	}
+
+	def->func = func;
+	def->arg = arg;
+
+	PTHREAD_MUTEX_lock(&epoch_pending_mtx);
+	def->epoch = atomic_postinc_uint64_t(&epoch_global);
+	glist_add_tail(&epoch_pending, &def->link);
+	reclaim = (++epoch_npending >= EPOCH_RECLAIM_THRESHOLD);
+	PTHREAD_MUTEX_unlock(&epoch_pending_mtx);
+
+	if (reclaim && (epoch_self == NULL || epoch_self->nesting == 0))
+		epoch_reclaim();
+}
+
+/**
+ * @brief Drain all retired objects at shutdown
+ */
+
+void epoch_pkgshutdown(void)
+{
+	epoch_synchronize();
+	epoch_reclaim();
+}
+
+/** @} */
@@ -1495,6 +1495,54 @@ static bool show_cache_inode_stats(DBusMessageIter *args,
 	return true;
 }
 
+static bool show_cache_inode_mem(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	cache_inode_dbus_show_mem(&iter);
+
+	return true;
+}
+
+static bool show_admission(DBusMessageIter *args,
+			   DBusMessage *reply,
+			   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	admission_dbus_show(&iter);
+
+	return true;
+}
+
+static bool show_drc(DBusMessageIter *args,
+		     DBusMessage *reply,
+		     DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	dupreq_dbus_show(&iter);
+
+	return true;
+}
+
 static struct gsh_dbus_method export_show_v41_layouts = {
 	.name = "GetNFSv41Layouts",
 	.method = get_nfsv41_export_layouts,
@@ -1637,6 +1685,33 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method cache_inode_mem_show = {
+	.name = "ShowCacheInodeMemory",
+	.method = show_cache_inode_mem,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 CACHE_MEM_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method admission_show = {
+	.name = "ShowAdmission",
+	.method = show_admission,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 TOTAL_OPS_REPLY,
+		 END_ARG_LIST}
+};
+
+static struct gsh_dbus_method drc_show = {
+	.name = "ShowDRC",
+	.method = show_drc,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 DRC_REPLY,
+		 END_ARG_LIST}
+};
+
 /**
  * @brief Report all IO stats of all exports in one call
  *
@@ -1704,6 +1779,9 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&cache_inode_mem_show,
+	&admission_show,
+	&drc_show,
 	&export_show_all_io,
 	NULL
 };
@@ -1680,7 +1680,7 @@ int init_export_root(struct gsh_export *export)
 
 	export->exp_root_cache_inode = entry;
 
-	glist_add_tail(&entry->object.dir.export_roots,
+	glist_add_tail(&entry->object.dir->export_roots,
 		       &export->exp_root_list);
 
 	/* Protect this entry from removal (unlink) */
@@ -1819,7 +1819,7 @@ void kill_export_root_entry(cache_entry_t *entry)
 	while (true) {
 		PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 
-		export = glist_first_entry(&entry->object.dir.export_roots,
+		export = glist_first_entry(&entry->object.dir->export_roots,
 					   struct gsh_export,
 					   exp_root_list);
 
@@ -1858,7 +1858,7 @@ void kill_export_junction_entry(cache_entry_t *entry)
 
 	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
 
-	export = entry->object.dir.junction_export;
+	export = entry->object.dir->junction_export;
 
 	if (export == NULL) {
 		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
@@ -1866,7 +1866,7 @@ void kill_export_junction_entry(cache_entry_t *entry)
 	}
 
 	/* Detach the export from the inode */
-	entry->object.dir.junction_export = NULL;
+	entry->object.dir->junction_export = NULL;
 
 	get_gsh_export_ref(export);
 
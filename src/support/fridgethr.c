@@ -103,6 +103,7 @@ int fridgethr_init(struct fridgethr **frout, const char *s,
 
 	frobj->s = NULL;
 	frobj->nthreads = 0;
+	frobj->nexiting = 0;
 	frobj->nidle = 0;
 	frobj->flags = fridgethr_flag_none;
 
@@ -340,6 +341,35 @@ static bool fridgethr_getwork(struct fridgethr *fr, struct fridgethr_entry *fe)
 	}
 }
 
+/**
+ * @brief Claim an exit token after the maximum was lowered
+ *
+ * Each thread above the maximum may claim one token; the thread that
+ * holds it leaves, and the others keep running.
+ *
+ * @note The fridge mutex must be held.
+ *
+ * @param[in] fr  The fridge
+ * @param[in] fe  The calling thread
+ *
+ * @return true if the thread should exit.
+ */
+
+static bool fridgethr_claim_exit(struct fridgethr *fr,
+				 struct fridgethr_entry *fe)
+{
+	if (fe->exiting)
+		return true;
+
+	if ((fr->p.thr_max == 0)
+	    || (fr->nthreads - fr->nexiting <= fr->p.thr_max))
+		return false;
+
+	fe->exiting = true;
+	++(fr->nexiting);
+	return true;
+}
+
 /**
  * @brief Wait for more work
  *
@@ -378,10 +408,13 @@ static bool fridgethr_freeze(struct fridgethr *fr,
 
 	/* rc would have been set in the while loop below */
 	if (((rc == ETIMEDOUT) && (fr->nthreads > fr->p.thr_min))
+	    || fridgethr_claim_exit(fr, fe)
 	    || (fr->command == fridgethr_comm_stop)) {
 		/* We do this here since we already have the fridge
 		   lock. */
 		--(fr->nthreads);
+		if (fe->exiting)
+			--(fr->nexiting);
 		glist_del(&fe->thread_link);
 		if ((fr->nthreads == 0) && (fr->command == fridgethr_comm_stop)
 		    && (fr->transitioning) && !fridgethr_deferredwork(fr)) {
@@ -1351,8 +1384,10 @@ int fridgethr_sync_command(struct fridgethr *fr, fridgethr_comm_t command,
 /**
  * @brief Return true if a looper function should return
  *
- * For the moment, this checks if we're in the middle of a state
- * transition.
+ * This checks if we're in the middle of a state transition, or if
+ * the fridge has more threads than its (lowered) maximum.  In the
+ * latter case only as many threads as are surplus are told to break,
+ * each claiming an exit token, and they exit on return.
  *
  * @param[in] ctx The thread context
  *
@@ -1366,9 +1401,21 @@ bool fridgethr_you_should_break(struct fridgethr_context *ctx)
 	struct fridgethr_entry *fe = container_of(ctx, struct fridgethr_entry,
 						  ctx);
 	struct fridgethr *fr = fe->fr;
+	bool rc;
 
 	/* No locking is needed as it is only read */
-	return fr->transitioning;
+	if (fr->transitioning || fe->exiting)
+		return true;
+
+	if ((fr->p.thr_max == 0)
+	    || (fr->nthreads - fr->nexiting <= fr->p.thr_max))
+		return false;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	rc = fridgethr_claim_exit(fr, fe);
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+
+	return rc;
 }
 
 /**
@@ -1491,6 +1538,28 @@ time_t fridgethr_getwait(struct fridgethr_context *ctx)
 	return thread_delay;
 }
 
+/**
+ * @brief Change the thread limits of a running fridge
+ *
+ * Raising the maximum lets fridgethr_submit start more threads.
+ * Lowering it below the number of running threads makes the surplus,
+ * and only the surplus, exit as they next freeze, which for loopers
+ * is when their function returns after fridgethr_you_should_break.
+ *
+ * @param[in] fr      The fridge
+ * @param[in] thr_min New low watermark
+ * @param[in] thr_max New maximum, not 0
+ */
+
+void fridgethr_set_limits(struct fridgethr *fr, uint32_t thr_min,
+			  uint32_t thr_max)
+{
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	fr->p.thr_min = thr_min;
+	fr->p.thr_max = thr_max;
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+}
+
 /**
  * @brief Cancel all of the threads in the fridge
  *
@@ -0,0 +1,184 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup cksum
+ * @{
+ */
+
+/**
+ * @file gsh_cksum.c
+ * @brief Implementation of request checksums
+ */
+
+#include "config.h"
+#include <string.h>
+#include "city.h"
+#include "xxhash.h"
+#include "gsh_cksum.h"
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+/** Reflected CRC32C (Castagnoli) polynomial */
+#define CRC32C_POLY 0x82F63B78
+
+static uint32_t crc32c_table[256];
+
+/**
+ * @brief CRC32C a byte at a time from a table
+ */
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--)
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/**
+ * @brief CRC32C with the SSE4.2 instruction, eight bytes at a time
+ */
+
+static uint32_t __attribute__ ((target("sse4.2")))
+crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t crc64 = crc;
+	uint64_t v;
+
+	for (; len >= sizeof(v); p += sizeof(v), len -= sizeof(v)) {
+		memcpy(&v, p, sizeof(v));
+		crc64 = __builtin_ia32_crc32di(crc64, v);
+	}
+	crc = crc64;
+	while (len--)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+
+	return crc;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+/**
+ * @brief CRC32C with the ARMv8 CRC instructions, eight bytes at a time
+ */
+
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len >= sizeof(v); p += sizeof(v), len -= sizeof(v)) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+#endif
+
+static uint32_t (*crc32c_impl)(uint32_t, const uint8_t *, size_t) =
+	crc32c_sw;
+
+/**
+ * @brief Build the CRC32C table and pick the hardware path if present
+ */
+
+void gsh_cksum_pkginit(void)
+{
+	uint32_t i, j, crc;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+		crc32c_table[i] = crc;
+	}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+		crc32c_impl = crc32c_hw;
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+	crc32c_impl = crc32c_hw;
+#endif
+}
+
+/**
+ * @brief Whether CRC32C is computed by a CPU instruction
+ */
+
+bool gsh_cksum_hw(void)
+{
+	return crc32c_impl != crc32c_sw;
+}
+
+/**
+ * @brief Extend a CRC32C over a buffer
+ *
+ * @param[in] crc  CRC so far, 0 to start
+ * @param[in] buf  Data
+ * @param[in] len  Its length
+ *
+ * @return The CRC.
+ */
+
+uint32_t gsh_crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	return ~crc32c_impl(~crc, buf, len);
+}
+
+/**
+ * @brief Digest a bounded prefix of a buffer and its length
+ *
+ * @param[in] type  Hash to use; GSH_CKSUM_TIRPC hashes nothing
+ * @param[in] buf   Data
+ * @param[in] len   Its full length
+ * @param[in] max   Bytes of it to hash at most
+ * @param[in] seed  Digest to extend
+ *
+ * @return The digest.
+ */
+
+uint64_t gsh_cksum(enum gsh_cksum_type type, const void *buf, size_t len,
+		   size_t max, uint64_t seed)
+{
+	size_t n = len < max ? len : max;
+
+	switch (type) {
+	case GSH_CKSUM_CRC32C:
+		/* the CRC in the high half, the length in the low */
+		return seed ^ (((uint64_t)gsh_crc32c((uint32_t)seed, buf, n)
+				<< 32) | (uint32_t)len);
+	case GSH_CKSUM_XXHASH:
+		return XXH64(buf, n, seed ^ len);
+	case GSH_CKSUM_CITY:
+		return CityHash64WithSeed(buf, n, seed ^ len);
+	case GSH_CKSUM_TIRPC:
+		break;
+	}
+
+	return seed;
+}
+
+/** @} */
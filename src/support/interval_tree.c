@@ -0,0 +1,258 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup interval_tree
+ * @{
+ */
+
+/**
+ * @file interval_tree.c
+ * @brief Implementation of interval trees
+ */
+
+#include "config.h"
+#include "interval_tree.h"
+
+/**
+ * @brief Order a key (start, node address) against a node
+ */
+
+static inline int interval_cmp(uint64_t start, const void *addr,
+			       const struct interval_node *node)
+{
+	if (start != node->start)
+		return start < node->start ? -1 : 1;
+	if ((uintptr_t)addr != (uintptr_t)node)
+		return (uintptr_t)addr < (uintptr_t)node ? -1 : 1;
+	return 0;
+}
+
+static inline int interval_height(const struct interval_node *node)
+{
+	return node != NULL ? node->height : 0;
+}
+
+/**
+ * @brief Recompute a node's height and max_last from its children
+ */
+
+static void interval_update(struct interval_node *node)
+{
+	int hl = interval_height(node->left);
+	int hr = interval_height(node->right);
+
+	node->height = (hl > hr ? hl : hr) + 1;
+	node->max_last = node->last;
+	if (node->left != NULL && node->left->max_last > node->max_last)
+		node->max_last = node->left->max_last;
+	if (node->right != NULL && node->right->max_last > node->max_last)
+		node->max_last = node->right->max_last;
+}
+
+static struct interval_node *interval_rotate_right(struct interval_node *node)
+{
+	struct interval_node *left = node->left;
+
+	node->left = left->right;
+	left->right = node;
+	interval_update(node);
+	interval_update(left);
+	return left;
+}
+
+static struct interval_node *interval_rotate_left(struct interval_node *node)
+{
+	struct interval_node *right = node->right;
+
+	node->right = right->left;
+	right->left = node;
+	interval_update(node);
+	interval_update(right);
+	return right;
+}
+
+/**
+ * @brief Restore the AVL property at a node whose subtrees changed
+ *
+ * @return The new root of the subtree.
+ */
+
+static struct interval_node *interval_balance(struct interval_node *node)
+{
+	int bf = interval_height(node->left) - interval_height(node->right);
+
+	if (bf > 1) {
+		if (interval_height(node->left->left) <
+		    interval_height(node->left->right))
+			node->left = interval_rotate_left(node->left);
+		return interval_rotate_right(node);
+	}
+	if (bf < -1) {
+		if (interval_height(node->right->right) <
+		    interval_height(node->right->left))
+			node->right = interval_rotate_right(node->right);
+		return interval_rotate_left(node);
+	}
+
+	interval_update(node);
+	return node;
+}
+
+static struct interval_node *interval_insert(struct interval_node *root,
+					     struct interval_node *node)
+{
+	if (root == NULL)
+		return node;
+
+	if (interval_cmp(node->start, node, root) < 0)
+		root->left = interval_insert(root->left, node);
+	else
+		root->right = interval_insert(root->right, node);
+
+	return interval_balance(root);
+}
+
+static struct interval_node *interval_remove_min(struct interval_node *root,
+						 struct interval_node **min)
+{
+	if (root->left == NULL) {
+		*min = root;
+		return root->right;
+	}
+
+	root->left = interval_remove_min(root->left, min);
+	return interval_balance(root);
+}
+
+static struct interval_node *interval_remove(struct interval_node *root,
+					     struct interval_node *node)
+{
+	struct interval_node *min;
+	int cmp;
+
+	if (root == NULL)
+		return NULL;
+
+	cmp = interval_cmp(node->start, node, root);
+	if (cmp < 0) {
+		root->left = interval_remove(root->left, node);
+	} else if (cmp > 0) {
+		root->right = interval_remove(root->right, node);
+	} else {
+		if (root->left == NULL)
+			return root->right;
+		if (root->right == NULL)
+			return root->left;
+		min = NULL;
+		root->right = interval_remove_min(root->right, &min);
+		min->left = root->left;
+		min->right = root->right;
+		root = min;
+	}
+
+	return interval_balance(root);
+}
+
+/**
+ * @brief Add a node to a tree
+ *
+ * @param[in] tree  The tree
+ * @param[in] node  Node with start and last set, not in any tree
+ */
+
+void interval_tree_insert(struct interval_tree *tree,
+			  struct interval_node *node)
+{
+	node->left = NULL;
+	node->right = NULL;
+	node->height = 1;
+	node->max_last = node->last;
+	tree->root = interval_insert(tree->root, node);
+	tree->count++;
+}
+
+/**
+ * @brief Take a node out of its tree
+ *
+ * @param[in] tree  The tree
+ * @param[in] node  Node in the tree, with start as when inserted
+ */
+
+void interval_tree_remove(struct interval_tree *tree,
+			  struct interval_node *node)
+{
+	tree->root = interval_remove(tree->root, node);
+	node->left = NULL;
+	node->right = NULL;
+	node->height = 0;
+	tree->count--;
+}
+
+static struct interval_node *interval_next(struct interval_node *node,
+					   const struct interval_node *after,
+					   uint64_t lo, uint64_t hi)
+{
+	struct interval_node *found;
+
+	while (node != NULL && node->max_last >= lo) {
+		if (after == NULL ||
+		    interval_cmp(after->start, after, node) < 0) {
+			/* node is past the cursor, so may its left be */
+			found = interval_next(node->left, after, lo, hi);
+			if (found != NULL)
+				return found;
+			if (node->start > hi)
+				return NULL;
+			if (node->last >= lo)
+				return node;
+		} else if (node->start > hi) {
+			return NULL;
+		}
+		node = node->right;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Find the next interval overlapping [lo, hi]
+ *
+ * Only the key of after is looked at, so it may since have been
+ * removed from the tree, but its start must not have changed.
+ *
+ * @param[in] tree   The tree
+ * @param[in] after  Node to continue from, NULL for the first
+ * @param[in] lo     First point of the range
+ * @param[in] hi     Last point of the range, inclusive
+ *
+ * @return The overlapping interval with the lowest key above after's,
+ *         or NULL.
+ */
+
+struct interval_node *interval_tree_next(struct interval_tree *tree,
+					 const struct interval_node *after,
+					 uint64_t lo, uint64_t hi)
+{
+	return interval_next(tree->root, after, lo, hi);
+}
+
+/** @} */
@@ -0,0 +1,219 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+
+/**
+ * @addtogroup io_buffer
+ * @{
+ */
+
+/**
+ * @file io_buffer.c
+ * @brief Implementation of aligned I/O buffers
+ *
+ * Buffers come in power-of-two sizes from a page up to the largest
+ * I/O we decode.  A free buffer's first bytes link it into the free
+ * list of its size; the lists together hold at most
+ * IO_Buffer_Cache_MB, beyond which buffers go back to the system.
+ */
+
+#include "config.h"
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "log.h"
+#include "nfs_core.h"
+#include "io_buffer.h"
+
+/** Smallest buffer, as a shift */
+#define IO_BUF_MIN_SHIFT 12
+/** Number of buffer sizes, up to XDR_BYTES_MAXLEN_IO */
+#define IO_BUF_CLASSES 15
+
+struct io_buf_free {
+	struct io_buf_free *next;
+};
+
+static struct io_buf_class {
+	pthread_spinlock_t sp;
+	struct io_buf_free *free;	/*< Cached buffers */
+	uint32_t count;			/*< Number of them */
+} io_buf_classes[IO_BUF_CLASSES];
+
+static size_t io_buf_align = 1 << IO_BUF_MIN_SHIFT;
+static uint64_t io_buf_cached;	/*< Bytes on the free lists */
+
+/**
+ * @brief Set up the buffer free lists
+ */
+
+void io_buf_pkginit(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	int ix;
+
+	if (page > 0)
+		io_buf_align = page;
+
+	for (ix = 0; ix < IO_BUF_CLASSES; ix++) {
+		pthread_spin_init(&io_buf_classes[ix].sp,
+				  PTHREAD_PROCESS_PRIVATE);
+		io_buf_classes[ix].free = NULL;
+		io_buf_classes[ix].count = 0;
+	}
+}
+
+/**
+ * @brief Size class of a length
+ *
+ * @param[in] len The length, at most XDR_BYTES_MAXLEN_IO
+ *
+ * @return The class; its buffers are 1 << (class + IO_BUF_MIN_SHIFT).
+ */
+
+static inline int io_buf_class(size_t len)
+{
+	int ix = 0;
+
+	while (ix < IO_BUF_CLASSES - 1
+	       && ((size_t)1 << (ix + IO_BUF_MIN_SHIFT)) < len)
+		ix++;
+
+	return ix;
+}
+
+/**
+ * @brief Get an aligned buffer
+ *
+ * @param[in] len Bytes needed, at most XDR_BYTES_MAXLEN_IO
+ *
+ * @return The buffer, to be returned with io_buf_put and the same len.
+ */
+
+void *io_buf_get(size_t len)
+{
+	int ix = io_buf_class(len);
+	struct io_buf_class *cls = &io_buf_classes[ix];
+	size_t size = (size_t)1 << (ix + IO_BUF_MIN_SHIFT);
+	struct io_buf_free *buf;
+
+	pthread_spin_lock(&cls->sp);
+	buf = cls->free;
+	if (buf != NULL) {
+		cls->free = buf->next;
+		cls->count--;
+	}
+	pthread_spin_unlock(&cls->sp);
+
+	if (buf != NULL) {
+		atomic_sub_uint64_t(&io_buf_cached, size);
+		return buf;
+	}
+
+	buf = gsh_malloc_aligned(io_buf_align, size);
+	if (buf == NULL) {
+		LogMajor(COMPONENT_DISPATCH,
+			 "Unable to allocate %zu byte I/O buffer", size);
+	}
+	return buf;
+}
+
+/**
+ * @brief Return a buffer from io_buf_get
+ *
+ * @param[in] buf  The buffer
+ * @param[in] len  The length it was got for
+ */
+
+void io_buf_put(void *buf, size_t len)
+{
+	int ix = io_buf_class(len);
+	struct io_buf_class *cls = &io_buf_classes[ix];
+	size_t size = (size_t)1 << (ix + IO_BUF_MIN_SHIFT);
+	uint64_t limit =
+		(uint64_t)nfs_param.core_param.io_buffer_cache_mb << 20;
+	struct io_buf_free *fb = buf;
+
+	if (atomic_add_uint64_t(&io_buf_cached, size) > limit) {
+		atomic_sub_uint64_t(&io_buf_cached, size);
+		gsh_free(buf);
+		return;
+	}
+
+	pthread_spin_lock(&cls->sp);
+	fb->next = cls->free;
+	cls->free = fb;
+	cls->count++;
+	pthread_spin_unlock(&cls->sp);
+}
+
+/**
+ * @brief XDR variable-length opaque data, decoded into an I/O buffer
+ *
+ * Like xdr_bytes, except that on decode the data is landed in an
+ * aligned buffer from io_buf_get, and on free that buffer is given
+ * back.  Encoding is unchanged.
+ *
+ * @param[in]     xdrs    The XDR stream
+ * @param[in,out] data    The data
+ * @param[in,out] len     Its length
+ * @param[in]     maxlen  Largest length accepted
+ *
+ * @return true on success.
+ */
+
+bool xdr_io_data(XDR *xdrs, char **data, u_int *len, u_int maxlen)
+{
+	switch (xdrs->x_op) {
+	case XDR_DECODE:
+		if (!xdr_u_int(xdrs, len))
+			return false;
+		if (*len > maxlen || *len > XDR_BYTES_MAXLEN_IO)
+			return false;
+		if (*len == 0)
+			return true;
+		if (*data != NULL)
+			return xdr_opaque(xdrs, *data, *len);
+		*data = io_buf_get(*len);
+		if (*data == NULL)
+			return false;
+		if (!xdr_opaque(xdrs, *data, *len)) {
+			io_buf_put(*data, *len);
+			*data = NULL;
+			return false;
+		}
+		return true;
+
+	case XDR_FREE:
+		if (*data != NULL) {
+			io_buf_put(*data, *len);
+			*data = NULL;
+		}
+		return true;
+
+	default:
+		return xdr_bytes(xdrs, data, len, maxlen);
+	}
+}
+
+/** @} */
@@ -52,6 +52,7 @@
 #include "nfs_exports.h"
 #include "nfs_proto_functions.h"
 #include "nfs_dupreq.h"
+#include "gsh_cksum.h"
 #include "config_parsing.h"
 
 /**
@@ -71,6 +72,20 @@ static struct config_item_list protocols[] = {
 	CONFIG_LIST_EOL
 };
 
+static struct config_item_list cksum_types[] = {
+	CONFIG_LIST_TOK("tirpc", GSH_CKSUM_TIRPC),
+	CONFIG_LIST_TOK("crc32c", GSH_CKSUM_CRC32C),
+	CONFIG_LIST_TOK("xxhash", GSH_CKSUM_XXHASH),
+	CONFIG_LIST_TOK("city", GSH_CKSUM_CITY),
+	CONFIG_LIST_EOL
+};
+
+static struct config_item_list recovery_backends[] = {
+	CONFIG_LIST_TOK("fs", RECOVERY_BACKEND_FS),
+	CONFIG_LIST_TOK("log", RECOVERY_BACKEND_LOG),
+	CONFIG_LIST_EOL
+};
+
 static struct config_item core_params[] = {
 	CONF_ITEM_UI16("NFS_Port", 0, UINT16_MAX, NFS_PORT,
 		       nfs_core_param, port[P_NFS]),
@@ -92,6 +107,12 @@ static struct config_item core_params[] = {
 		       nfs_core_param, program[P_RQUOTA]),
 	CONF_ITEM_UI32("Nb_Worker", 1, 1024*128, NB_WORKER_THREAD_DEFAULT,
 		       nfs_core_param, nb_worker),
+	CONF_ITEM_UI32("Nb_Worker_Min", 0, 1024*128, 0,
+		       nfs_core_param, nb_worker_min),
+	CONF_ITEM_UI32("Nb_Worker_Max", 0, 1024*128, 0,
+		       nfs_core_param, nb_worker_max),
+	CONF_ITEM_UI32("Worker_Wait_Target_Msec", 1, 60000, 10,
+		       nfs_core_param, worker_wait_target_ms),
 	CONF_ITEM_BOOL("Drop_IO_Errors", false,
 		       nfs_core_param, drop_io_errors),
 	CONF_ITEM_BOOL("Drop_Inval_Errors", false,
@@ -102,8 +123,38 @@ static struct config_item core_params[] = {
 		       nfs_core_param, dispatch_max_reqs),
 	CONF_ITEM_UI32("Dispatch_Max_Reqs_Xprt", 1, 2048, 512,
 		       nfs_core_param, dispatch_max_reqs_xprt),
+	CONF_ITEM_UI32("Dispatch_Lanes", 0, 1024, 0,
+		       nfs_core_param, dispatch_lanes),
+	CONF_ITEM_UI32("Dispatch_Quantum", 1, 65536, 64,
+		       nfs_core_param, dispatch_quantum),
+	CONF_ITEM_UI32("Dispatch_Batch", 1, 64, 4,
+		       nfs_core_param, dispatch_batch),
+	CONF_ITEM_UI32("Dispatch_Spin_Usec", 0, 10000, 20,
+		       nfs_core_param, dispatch_spin_usec),
+	CONF_ITEM_BOOL("Admission_Control", true,
+		       nfs_core_param, admission_control),
+	CONF_ITEM_UI32("Admission_Target_Msec", 1, 10000, 20,
+		       nfs_core_param, admission_target_ms),
+	CONF_ITEM_UI32("Admission_Interval_Msec", 10, 10000, 100,
+		       nfs_core_param, admission_interval_ms),
+	CONF_ITEM_UI32("IO_Buffer_Cache_MB", 0, 65536, 64,
+		       nfs_core_param, io_buffer_cache_mb),
+	CONF_ITEM_BOOL("Dispatch_NUMA", false,
+		       nfs_core_param, dispatch_numa),
+	CONF_ITEM_STR("Decoder_CPUs", 1, 1024, NULL,
+		      nfs_core_param, decoder_cpus),
+	CONF_ITEM_STR("Worker_CPUs", 1, 1024, NULL,
+		      nfs_core_param, worker_cpus),
 	CONF_ITEM_BOOL("DRC_Disabled", false,
 		       nfs_core_param, drc.disabled),
+	CONF_ITEM_UI32("DRC_Budget_MB", 1, 65536, DRC_BUDGET_MB,
+		       nfs_core_param, drc.budget_mb),
+	CONF_ITEM_BOOL("DRC_Cache_Idempotent", false,
+		       nfs_core_param, drc.cache_idempotent),
+	CONF_ITEM_TOKEN("DRC_Checksum_Type", GSH_CKSUM_CRC32C, cksum_types,
+			nfs_core_param, drc.cksum_type),
+	CONF_ITEM_UI32("DRC_Checksum_Len", 0, 1048576, DRC_CKSUM_LEN,
+		       nfs_core_param, drc.cksum_len),
 	CONF_ITEM_UI32("DRC_TCP_Npart", 1, 20, DRC_TCP_NPART,
 		       nfs_core_param, drc.tcp.npart),
 	CONF_ITEM_UI32("DRC_TCP_Size", 1, 32767, DRC_TCP_SIZE,
@@ -241,6 +292,18 @@ static struct config_item version4_params[] = {
 	CONF_ITEM_UI32("Deleg_Recall_Retry_Delay", 0, 10,
 			DELEG_RECALL_RETRY_DELAY_DEFAULT,
 			nfs_version4_parameter, deleg_recall_retry_delay),
+	CONF_ITEM_UI32("Session_Initial_Slots", 1, 16384,
+		       SESSION_INITIAL_SLOTS_DEFAULT,
+		       nfs_version4_parameter, session_initial_slots),
+	CONF_ITEM_UI32("Session_Max_Slots", 1, 16384,
+		       SESSION_MAX_SLOTS_DEFAULT,
+		       nfs_version4_parameter, session_max_slots),
+	CONF_ITEM_UI32("Session_Slot_Budget", 1, UINT32_MAX,
+		       SESSION_SLOT_BUDGET_DEFAULT,
+		       nfs_version4_parameter, session_slot_budget),
+	CONF_ITEM_TOKEN("Recovery_Backend", RECOVERY_BACKEND_FS,
+			recovery_backends,
+			nfs_version4_parameter, recovery_backend),
 	CONF_ITEM_BOOL("PNFS_MDS", true,
 		       nfs_version4_parameter, pnfs_mds),
 	CONF_ITEM_BOOL("PNFS_DS", true,
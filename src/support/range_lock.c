@@ -0,0 +1,200 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup range_lock
+ * @{
+ */
+
+/**
+ * @file range_lock.c
+ * @brief Implementation of byte-range reader/writer locks
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include "common_utils.h"
+#include "log.h"
+#include "range_lock.h"
+
+/**
+ * @brief Initialize a range lock
+ *
+ * @param[in] rl  The lock
+ */
+
+void range_lock_init(struct range_lock *rl)
+{
+	PTHREAD_MUTEX_init(&rl->mtx, NULL);
+	glist_init(&rl->held);
+	glist_init(&rl->waiting);
+}
+
+/**
+ * @brief Destroy a range lock
+ *
+ * No range may be held or awaited.
+ *
+ * @param[in] rl  The lock
+ */
+
+void range_lock_destroy(struct range_lock *rl)
+{
+	PTHREAD_MUTEX_destroy(&rl->mtx);
+}
+
+/**
+ * @brief Find out whether two ranges conflict
+ *
+ * @param[in] a  One range
+ * @param[in] b  The other
+ *
+ * @return true if they overlap and either is exclusive.
+ */
+
+static inline bool range_lock_conflict(const struct range_lock_entry *a,
+				       const struct range_lock_entry *b)
+{
+	if (!a->exclusive && !b->exclusive)
+		return false;
+
+	return a->start < b->end && b->start < a->end;
+}
+
+/**
+ * @brief Find out whether a range may be granted now
+ *
+ * A range is grantable if it conflicts with no granted range and with
+ * no waiting range queued before @a stop.
+ *
+ * @param[in] rl    The lock, mutex held
+ * @param[in] re    The requested range
+ * @param[in] stop  Where to stop scanning the waiters, the list head
+ *                  to scan them all
+ *
+ * @return true if the range may be granted.
+ */
+
+static bool range_lock_grantable(struct range_lock *rl,
+				 struct range_lock_entry *re,
+				 struct glist_head *stop)
+{
+	struct glist_head *glist;
+
+	glist_for_each(glist, &rl->held) {
+		if (range_lock_conflict(re, glist_entry(glist,
+							struct range_lock_entry,
+							link)))
+			return false;
+	}
+
+	for (glist = rl->waiting.next; glist != stop; glist = glist->next) {
+		if (range_lock_conflict(re, glist_entry(glist,
+							struct range_lock_entry,
+							link)))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Lock a byte range, waiting for conflicting holders
+ *
+ * A zero length describes an empty range, which conflicts with
+ * nothing and is granted at once without being recorded.
+ *
+ * @param[in]  rl         The lock
+ * @param[out] re         Caller storage describing the granted range,
+ *                        which must stay valid until released
+ * @param[in]  offset     First byte
+ * @param[in]  length     Length in bytes
+ * @param[in]  exclusive  Lock for writing
+ */
+
+void range_lock_acquire(struct range_lock *rl, struct range_lock_entry *re,
+			uint64_t offset, uint64_t length, bool exclusive)
+{
+	re->start = offset;
+	if (offset + length < offset)
+		re->end = UINT64_MAX;
+	else
+		re->end = offset + length;
+	re->exclusive = exclusive;
+	re->granted = true;
+
+	if (re->start == re->end)
+		return;
+
+	PTHREAD_MUTEX_lock(&rl->mtx);
+	if (range_lock_grantable(rl, re, &rl->waiting)) {
+		glist_add_tail(&rl->held, &re->link);
+		PTHREAD_MUTEX_unlock(&rl->mtx);
+		return;
+	}
+
+	re->granted = false;
+	PTHREAD_COND_init(&re->cv, NULL);
+	glist_add_tail(&rl->waiting, &re->link);
+	while (!re->granted)
+		pthread_cond_wait(&re->cv, &rl->mtx);
+	PTHREAD_MUTEX_unlock(&rl->mtx);
+
+	PTHREAD_COND_destroy(&re->cv);
+}
+
+/**
+ * @brief Release a byte range
+ *
+ * Waiters that no longer conflict with a holder, or with a waiter
+ * queued before them, are granted in queue order.
+ *
+ * @param[in] rl  The lock
+ * @param[in] re  The range returned by range_lock_acquire
+ */
+
+void range_lock_release(struct range_lock *rl, struct range_lock_entry *re)
+{
+	struct glist_head *glist, *glistn;
+
+	if (re->start == re->end)
+		return;
+
+	PTHREAD_MUTEX_lock(&rl->mtx);
+	glist_del(&re->link);
+
+	glist_for_each_safe(glist, glistn, &rl->waiting) {
+		struct range_lock_entry *w =
+			glist_entry(glist, struct range_lock_entry, link);
+
+		if (!range_lock_conflict(re, w) ||
+		    !range_lock_grantable(rl, w, glist))
+			continue;
+
+		glist_del(&w->link);
+		glist_add_tail(&rl->held, &w->link);
+		w->granted = true;
+		pthread_cond_signal(&w->cv);
+	}
+	PTHREAD_MUTEX_unlock(&rl->mtx);
+}
+
+/** @} */
@@ -48,6 +48,7 @@
 #include <assert.h>
 #include <arpa/inet.h>
 #include "fsal.h"
+#include "fsal_convert.h"
 #include "nfs_core.h"
 #include "log.h"
 #include "avltree.h"
@@ -60,6 +61,7 @@
 #include "server_stats.h"
 #include <abstract_atomic.h>
 #include "nfs_proto_functions.h"
+#include "nfs_dupreq.h"
 
 #define NFS_V3_NB_COMMAND (NFSPROC3_COMMIT + 1)
 #define NFS_V4_NB_COMMAND 2
@@ -422,6 +424,8 @@ struct deleg_stats {
 				       recall */
 	uint32_t failed_recalls;    /* times client failed to process recall */
 	uint32_t num_revokes;	    /* Num revokes for the client */
+	uint32_t declined[DELEG_DECLINE_COUNT]; /* delegations not granted,
+						   by reason */
 };
 
 static struct global_stats global_st;
@@ -1238,7 +1242,7 @@ void dec_grants(struct gsh_client *client)
 
 		server_st = container_of(client, struct server_stats, client);
 		check_deleg_struct(&server_st->st, &client->lock);
-		server_st->st.deleg->curr_deleg_grants++;
+		server_st->st.deleg->curr_deleg_grants--;
 	}
 }
 void inc_revokes(struct gsh_client *client)
@@ -1271,6 +1275,16 @@ void inc_failed_recalls(struct gsh_client *client)
 		server_st->st.deleg->failed_recalls++;
 	}
 }
+void inc_deleg_declined(struct gsh_client *client, enum deleg_decline why)
+{
+	if (client != NULL) {
+		struct server_stats *server_st;
+
+		server_st = container_of(client, struct server_stats, client);
+		check_deleg_struct(&server_st->st, &client->lock);
+		server_st->st.deleg->declined[why]++;
+	}
+}
 
 #ifdef USE_DBUS
 
@@ -1766,6 +1780,204 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+/**
+ * @brief Report cache_inode memory use by object type
+ *
+ * Emits one (type, entries, bytes) record for every type that has
+ * entries in the cache.
+ *
+ * @param[in] iter  Reply iterator
+ */
+
+void cache_inode_dbus_show_mem(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter, struct_iter;
+	object_file_type_t type;
+	const char *name;
+	uint64_t entries, bytes;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(stt)",
+					 &array_iter);
+	for (type = REGULAR_FILE; type <= EXTENDED_ATTR; type++) {
+		entries = atomic_fetch_uint64_t(&cache_mem_st.entries[type]);
+		bytes = atomic_fetch_uint64_t(&cache_mem_st.bytes[type]);
+		if (entries == 0)
+			continue;
+		name = object_file_type_to_str(type);
+		dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT,
+						 NULL, &struct_iter);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+					       &name);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &entries);
+		dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					       &bytes);
+		dbus_message_iter_close_container(&array_iter, &struct_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report admission control (load shedding) counters
+ *
+ * @param[in] iter  Reply iterator
+ */
+
+void admission_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	uint64_t val;
+	char *type;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "lanes_overloaded";
+	val = atomic_fetch_uint32_t(&admission_st.overloaded);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "overloads";
+	val = atomic_fetch_uint64_t(&admission_st.overloads);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "xprt_stalls";
+	val = atomic_fetch_uint64_t(&admission_st.xprt_stalls);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "slot_cuts";
+	val = atomic_fetch_uint64_t(&admission_st.slot_cuts);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "sessions";
+	val = atomic_fetch_uint64_t(&nfs41_slot_st.sessions);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "slot_targets";
+	val = atomic_fetch_uint64_t(&nfs41_slot_st.target);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "slots_allocated";
+	val = atomic_fetch_uint64_t(&nfs41_slot_st.allocated);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "slot_table_grows";
+	val = atomic_fetch_uint64_t(&nfs41_slot_st.grows);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "slot_table_shrinks";
+	val = atomic_fetch_uint64_t(&nfs41_slot_st.shrinks);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+/**
+ * @brief Emit one DRC's occupancy and hit counters
+ *
+ * @param[in] drc    The DRC, mutex held
+ * @param[in] state  Array iterator
+ */
+
+static void drc_to_dbus(drc_t *drc, void *state)
+{
+	DBusMessageIter *array_iter = state;
+	DBusMessageIter struct_iter;
+	char addr[SOCK_NAME_MAX];
+	const char *addrp = addr;
+	const char *type;
+	uint64_t entries = drc->size;
+
+	switch (drc->type) {
+	case DRC_TCP_V4:
+		type = "TCP_V4";
+		sprint_sockaddr(&drc->d_u.tcp.addr, addr, sizeof(addr));
+		break;
+	case DRC_TCP_V3:
+		type = "TCP_V3";
+		sprint_sockaddr(&drc->d_u.tcp.addr, addr, sizeof(addr));
+		break;
+	default:
+		type = "UDP";
+		addrp = "*";
+		break;
+	}
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &addrp);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &entries);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &drc->bytes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &drc->hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &drc->misses);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report duplicate request cache occupancy and hits
+ *
+ * Emits the totals against the byte budget, then one
+ * (address, type, entries, bytes, hits, misses) record per DRC.
+ *
+ * @param[in] iter  Reply iterator
+ */
+
+void dupreq_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter, array_iter;
+	struct drc_totals tot;
+	char *type;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dupreq2_totals(&tot);
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "budget";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.budget);
+	type = "entries";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.entries);
+	type = "bytes";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.bytes);
+	type = "hits";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.hits);
+	type = "misses";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.misses);
+	type = "evictions";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &tot.evictions);
+	dbus_message_iter_close_container(iter, &struct_iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(sstttt)",
+					 &array_iter);
+	dupreq2_foreach_drc(drc_to_dbus, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
 #ifdef _USE_9P
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 {
@@ -1875,6 +2087,12 @@ void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter)
 				       &ds->failed_recalls);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
 				       &ds->num_revokes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &ds->declined[DELEG_DECLINE_FILE]);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &ds->declined[DELEG_DECLINE_CLIENT]);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &ds->declined[DELEG_DECLINE_SHARED]);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
@@ -0,0 +1,201 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @addtogroup timer_wheel
+ * @{
+ */
+
+/**
+ * @file timer_wheel.c
+ * @brief Implementation of timer wheels
+ */
+
+#include "config.h"
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * @brief Initialize a wheel
+ *
+ * @param[in] tw   The wheel
+ * @param[in] now  Current time
+ */
+
+void timer_wheel_init(struct timer_wheel *tw, time_t now)
+{
+	int level, slot;
+
+	tw->now = now;
+	tw->armed = 0;
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+		for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+			glist_init(&tw->slots[level][slot]);
+}
+
+/**
+ * @brief Put an entry in the slot for its deadline
+ */
+
+static void timer_wheel_place(struct timer_wheel *tw,
+			      struct timer_wheel_entry *te)
+{
+	uint64_t delta;
+	time_t when = te->expires;
+	int level;
+
+	if (when < tw->now)
+		when = tw->now;
+
+	delta = when - tw->now;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++)
+		if (delta < (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+			break;
+
+	/* Beyond the last level, wait in its farthest slot */
+	if (level == TIMER_WHEEL_LEVELS - 1 &&
+	    delta >= (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+		when = tw->now +
+			(1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+	glist_add_tail(&tw->slots[level][(when >> (TIMER_WHEEL_BITS * level))
+					 & TIMER_WHEEL_MASK],
+		       &te->link);
+}
+
+/**
+ * @brief Arm an entry, or move it if already armed
+ *
+ * @param[in] tw       The wheel
+ * @param[in] te       The entry
+ * @param[in] expires  Deadline
+ */
+
+void timer_wheel_arm(struct timer_wheel *tw, struct timer_wheel_entry *te,
+		     time_t expires)
+{
+	if (te->armed)
+		glist_del(&te->link);
+	else
+		tw->armed++;
+
+	te->expires = expires;
+	te->armed = true;
+	timer_wheel_place(tw, te);
+}
+
+/**
+ * @brief Take an entry off the wheel
+ *
+ * @param[in] tw  The wheel
+ * @param[in] te  The entry
+ *
+ * @return true if it was armed.
+ */
+
+bool timer_wheel_disarm(struct timer_wheel *tw, struct timer_wheel_entry *te)
+{
+	if (!te->armed)
+		return false;
+
+	glist_del(&te->link);
+	te->armed = false;
+	tw->armed--;
+	return true;
+}
+
+/**
+ * @brief Spread a slot of a higher level over the levels below
+ */
+
+static void timer_wheel_cascade(struct timer_wheel *tw, int level)
+{
+	struct glist_head *slot;
+	struct glist_head *glist, *glistn;
+	struct glist_head moving;
+
+	slot = &tw->slots[level][(tw->now >> (TIMER_WHEEL_BITS * level))
+				 & TIMER_WHEEL_MASK];
+
+	glist_init(&moving);
+	glist_splice_tail(&moving, slot);
+
+	glist_for_each_safe(glist, glistn, &moving) {
+		glist_del(glist);
+		timer_wheel_place(tw, glist_entry(glist,
+						  struct timer_wheel_entry,
+						  link));
+	}
+}
+
+/**
+ * @brief Turn the wheel up to a time, collecting what fell due
+ *
+ * @param[in]  tw       The wheel
+ * @param[in]  now      Current time
+ * @param[out] expired  List the expired entries are added to, by
+ *                      their link; they are no longer armed
+ *
+ * @return The number of entries expired.
+ */
+
+uint32_t timer_wheel_advance(struct timer_wheel *tw, time_t now,
+			     struct glist_head *expired)
+{
+	struct glist_head *slot;
+	struct glist_head *glist, *glistn;
+	uint32_t count = 0;
+	int level;
+
+	while (tw->now <= now) {
+		/* Where a level wraps, bring down the next slot above */
+		for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+			if ((tw->now >> (TIMER_WHEEL_BITS * (level - 1)))
+			    & TIMER_WHEEL_MASK)
+				break;
+			timer_wheel_cascade(tw, level);
+		}
+
+		slot = &tw->slots[0][tw->now & TIMER_WHEEL_MASK];
+		glist_for_each_safe(glist, glistn, slot) {
+			struct timer_wheel_entry *te =
+			    glist_entry(glist, struct timer_wheel_entry, link);
+
+			glist_del(&te->link);
+			te->armed = false;
+			tw->armed--;
+			glist_add_tail(expired, &te->link);
+			count++;
+		}
+
+		tw->now++;
+
+		/* Nothing left to find, skip ahead */
+		if (tw->armed == 0 && tw->now <= now)
+			tw->now = now + 1;
+	}
+
+	return count;
+}
+
+/** @} */
@@ -0,0 +1,250 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "CUnit/Basic.h"
+
+#include "epoch_reclaim.h"
+
+static uint32_t er_unit_freed;
+
+static void er_unit_free(void *arg)
+{
+	atomic_inc_uint32_t(&er_unit_freed);
+}
+
+/* A reader thread, held inside a critical section until told to go */
+struct er_unit_reader {
+	pthread_t thread;
+	uint32_t inside;
+	uint32_t leave;
+	struct epoch_record *rec;
+};
+
+static void *er_unit_read(void *arg)
+{
+	struct er_unit_reader *r = arg;
+
+	epoch_enter();
+	r->rec = epoch_self;
+	atomic_store_uint32_t(&r->inside, 1);
+	while (!atomic_fetch_uint32_t(&r->leave))
+		usleep(1000);
+	epoch_exit();
+
+	return NULL;
+}
+
+static void er_unit_reader_start(struct er_unit_reader *r)
+{
+	memset(r, 0, sizeof(*r));
+	pthread_create(&r->thread, NULL, er_unit_read, r);
+	while (!atomic_fetch_uint32_t(&r->inside))
+		usleep(1000);
+}
+
+static void er_unit_reader_stop(struct er_unit_reader *r)
+{
+	atomic_store_uint32_t(&r->leave, 1);
+	pthread_join(r->thread, NULL);
+}
+
+int init_suite(void)
+{
+	return 0;
+}
+
+int clean_suite(void)
+{
+	epoch_pkgshutdown();
+	return 0;
+}
+
+void no_readers(void)
+{
+	er_unit_freed = 0;
+	epoch_defer(er_unit_free, NULL);
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 1);
+}
+
+void reader_holds_back(void)
+{
+	struct er_unit_reader r;
+
+	er_unit_freed = 0;
+	er_unit_reader_start(&r);
+
+	epoch_defer(er_unit_free, NULL);
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 0);
+
+	er_unit_reader_stop(&r);
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 1);
+}
+
+void later_reader_ignored(void)
+{
+	struct er_unit_reader r;
+
+	er_unit_freed = 0;
+	epoch_defer(er_unit_free, NULL);
+
+	/* it can't have seen what was retired before it entered */
+	er_unit_reader_start(&r);
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 1);
+
+	er_unit_reader_stop(&r);
+}
+
+void nested_sections(void)
+{
+	struct er_unit_reader r;
+
+	er_unit_freed = 0;
+	er_unit_reader_start(&r);
+
+	/* this thread's own sections nest */
+	epoch_enter();
+	epoch_enter();
+	epoch_defer(er_unit_free, NULL);
+	epoch_exit();
+	CU_ASSERT_EQUAL(epoch_self->nesting, 1);
+	CU_ASSERT_NOT_EQUAL(epoch_self->epoch, 0);
+	epoch_exit();
+	CU_ASSERT_EQUAL(epoch_self->epoch, 0);
+
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 0);
+	er_unit_reader_stop(&r);
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 1);
+}
+
+static void *er_unit_synchronize(void *arg)
+{
+	uint32_t *done = arg;
+
+	epoch_synchronize();
+	atomic_store_uint32_t(done, 1);
+
+	return NULL;
+}
+
+void synchronize_waits(void)
+{
+	struct er_unit_reader r;
+	pthread_t thread;
+	uint32_t done = 0;
+
+	er_unit_reader_start(&r);
+	pthread_create(&thread, NULL, er_unit_synchronize, &done);
+
+	usleep(50000);
+	CU_ASSERT_EQUAL(atomic_fetch_uint32_t(&done), 0);
+
+	er_unit_reader_stop(&r);
+	pthread_join(thread, NULL);
+	CU_ASSERT_EQUAL(done, 1);
+}
+
+void record_recycled(void)
+{
+	struct er_unit_reader r1, r2;
+
+	er_unit_reader_start(&r1);
+	er_unit_reader_stop(&r1);
+
+	/* a thread that exited leaves its record to the next one */
+	er_unit_reader_start(&r2);
+	CU_ASSERT_PTR_EQUAL(r1.rec, r2.rec);
+	er_unit_reader_stop(&r2);
+}
+
+void reclaim_inline(void)
+{
+	int i;
+
+	/* whatever earlier tests left is gone */
+	epoch_reclaim();
+	er_unit_freed = 0;
+
+	/* enough pending objects reclaim without being asked */
+	for (i = 0; i < 2000; i++)
+		epoch_defer(er_unit_free, NULL);
+	CU_ASSERT(er_unit_freed >= 1000);
+
+	epoch_reclaim();
+	CU_ASSERT_EQUAL(er_unit_freed, 2000);
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo epoch_unit_arr[] = {
+		{"Freed with no readers.", no_readers}
+		,
+		{"Reader holds back free.", reader_holds_back}
+		,
+		{"Later reader doesn't.", later_reader_ignored}
+		,
+		{"Sections nest.", nested_sections}
+		,
+		{"Synchronize waits for reader.", synchronize_waits}
+		,
+		{"Thread record recycled.", record_recycled}
+		,
+		{"Pending objects reclaimed inline.", reclaim_inline}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Epoch reclamation", init_suite, clean_suite,
+		 epoch_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
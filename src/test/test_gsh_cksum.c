@@ -0,0 +1,185 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CUnit/Basic.h"
+
+#include "gsh_cksum.h"
+
+static enum gsh_cksum_type cksum_unit_types[] = {
+	GSH_CKSUM_CRC32C, GSH_CKSUM_XXHASH, GSH_CKSUM_CITY
+};
+
+#define CKSUM_UNIT_NTYPES \
+	(sizeof(cksum_unit_types) / sizeof(cksum_unit_types[0]))
+
+int init_suite(void)
+{
+	gsh_cksum_pkginit();
+	printf("\nCRC32C in %s\n", gsh_cksum_hw() ? "hardware" : "software");
+	return 0;
+}
+
+int clean_suite(void)
+{
+	return 0;
+}
+
+/* Known answers from RFC 3720, B.4 */
+void crc32c_vectors(void)
+{
+	uint8_t buf[32];
+	int i;
+
+	CU_ASSERT_EQUAL(gsh_crc32c(0, "123456789", 9), 0xE3069283);
+	CU_ASSERT_EQUAL(gsh_crc32c(0, buf, 0), 0);
+
+	memset(buf, 0, sizeof(buf));
+	CU_ASSERT_EQUAL(gsh_crc32c(0, buf, sizeof(buf)), 0x8A9136AA);
+
+	memset(buf, 0xff, sizeof(buf));
+	CU_ASSERT_EQUAL(gsh_crc32c(0, buf, sizeof(buf)), 0x62A8AB43);
+
+	for (i = 0; i < 32; i++)
+		buf[i] = i;
+	CU_ASSERT_EQUAL(gsh_crc32c(0, buf, sizeof(buf)), 0x46DD794E);
+
+	for (i = 0; i < 32; i++)
+		buf[i] = 31 - i;
+	CU_ASSERT_EQUAL(gsh_crc32c(0, buf, sizeof(buf)), 0x113FDB5C);
+}
+
+/* Any split, at any alignment, gives the CRC of the whole */
+void crc32c_incremental(void)
+{
+	uint8_t buf[256];
+	uint32_t whole, crc;
+	size_t off, split, len;
+
+	for (off = 0; off < sizeof(buf); off++)
+		buf[off] = off * 7 + 3;
+
+	for (off = 0; off < 8; off++) {
+		len = sizeof(buf) - off;
+		whole = gsh_crc32c(0, buf + off, len);
+		for (split = 0; split <= len; split += 3) {
+			crc = gsh_crc32c(0, buf + off, split);
+			crc = gsh_crc32c(crc, buf + off + split, len - split);
+			CU_ASSERT_EQUAL(crc, whole);
+		}
+	}
+}
+
+/* Only the first max bytes are hashed... */
+void prefix_bounded(void)
+{
+	char a[128], b[128];
+	size_t ix;
+
+	memset(a, 'a', sizeof(a));
+	memcpy(b, a, sizeof(b));
+	b[100] = 'b';
+
+	for (ix = 0; ix < CKSUM_UNIT_NTYPES; ix++) {
+		CU_ASSERT_EQUAL(
+			gsh_cksum(cksum_unit_types[ix], a, sizeof(a), 64, 0),
+			gsh_cksum(cksum_unit_types[ix], b, sizeof(b), 64, 0));
+		CU_ASSERT_NOT_EQUAL(
+			gsh_cksum(cksum_unit_types[ix], a, sizeof(a), 128, 0),
+			gsh_cksum(cksum_unit_types[ix], b, sizeof(b), 128, 0));
+	}
+}
+
+/* ...but the full length always counts */
+void length_folded(void)
+{
+	char a[128];
+	size_t ix;
+
+	memset(a, 'a', sizeof(a));
+
+	for (ix = 0; ix < CKSUM_UNIT_NTYPES; ix++)
+		CU_ASSERT_NOT_EQUAL(
+			gsh_cksum(cksum_unit_types[ix], a, 100, 64, 0),
+			gsh_cksum(cksum_unit_types[ix], a, 128, 64, 0));
+}
+
+void seed_extended(void)
+{
+	char a[64];
+	size_t ix;
+
+	memset(a, 'a', sizeof(a));
+
+	for (ix = 0; ix < CKSUM_UNIT_NTYPES; ix++)
+		CU_ASSERT_NOT_EQUAL(
+			gsh_cksum(cksum_unit_types[ix], a, sizeof(a), 64, 1),
+			gsh_cksum(cksum_unit_types[ix], a, sizeof(a), 64, 2));
+
+	/* TI-RPC's own checksum is all there is */
+	CU_ASSERT_EQUAL(gsh_cksum(GSH_CKSUM_TIRPC, a, sizeof(a), 64, 42), 42);
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo cksum_unit_arr[] = {
+		{"CRC32C known answers.", crc32c_vectors}
+		,
+		{"CRC32C extends across splits.", crc32c_incremental}
+		,
+		{"Digest bounded to prefix.", prefix_bounded}
+		,
+		{"Digest folds in length.", length_folded}
+		,
+		{"Digest extends seed.", seed_extended}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Checksums", init_suite, clean_suite,
+		 cksum_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
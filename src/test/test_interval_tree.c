@@ -0,0 +1,326 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CUnit/Basic.h"
+
+#include "interval_tree.h"
+
+#define IT_UNIT_RANDOM 1000
+
+struct interval_tree it;
+
+static struct interval_node it_unit_nodes[IT_UNIT_RANDOM];
+
+static void it_unit_set(struct interval_node *node, uint64_t start,
+			uint64_t last)
+{
+	memset(node, 0, sizeof(*node));
+	node->start = start;
+	node->last = last;
+}
+
+/* Check order, balance and max_last of a subtree, return its height */
+static int it_unit_check(struct interval_node *node, uint64_t *max_last)
+{
+	uint64_t max_l = 0, max_r = 0;
+	int hl, hr;
+
+	if (node == NULL) {
+		*max_last = 0;
+		return 0;
+	}
+
+	hl = it_unit_check(node->left, &max_l);
+	hr = it_unit_check(node->right, &max_r);
+
+	if (node->left != NULL)
+		CU_ASSERT(node->left->start <= node->start);
+	if (node->right != NULL)
+		CU_ASSERT(node->right->start >= node->start);
+	CU_ASSERT(hl - hr <= 1 && hr - hl <= 1);
+	CU_ASSERT_EQUAL(node->height, 1 + (hl > hr ? hl : hr));
+
+	*max_last = node->last;
+	if (max_l > *max_last)
+		*max_last = max_l;
+	if (max_r > *max_last)
+		*max_last = max_r;
+	CU_ASSERT_EQUAL(node->max_last, *max_last);
+
+	return node->height;
+}
+
+static void it_unit_check_tree(void)
+{
+	uint64_t max_last;
+
+	(void)it_unit_check(it.root, &max_last);
+}
+
+/* Count the nodes overlapping [lo, hi], checking they come in order */
+static int it_unit_count(uint64_t lo, uint64_t hi)
+{
+	struct interval_node *node;
+	uint64_t prev = 0;
+	int n = 0;
+
+	interval_tree_for_each(node, &it, lo, hi) {
+		CU_ASSERT(node->start <= hi && node->last >= lo);
+		CU_ASSERT(node->start >= prev);
+		prev = node->start;
+		n++;
+	}
+
+	return n;
+}
+
+int init_suite(void)
+{
+	interval_tree_init(&it);
+	return 0;
+}
+
+int clean_suite(void)
+{
+	CU_ASSERT_PTR_NULL(it.root);
+	CU_ASSERT_EQUAL(it.count, 0);
+	return 0;
+}
+
+void empty_tree(void)
+{
+	CU_ASSERT_PTR_NULL(interval_tree_first(&it, 0, UINT64_MAX));
+}
+
+void touching_not_overlapping(void)
+{
+	struct interval_node a, b;
+
+	it_unit_set(&a, 0, 9);
+	it_unit_set(&b, 10, 19);
+	interval_tree_insert(&it, &a);
+	interval_tree_insert(&it, &b);
+	CU_ASSERT(interval_node_linked(&a));
+
+	/* last is inclusive */
+	CU_ASSERT_PTR_EQUAL(interval_tree_first(&it, 9, 9), &a);
+	CU_ASSERT_EQUAL(it_unit_count(9, 9), 1);
+	CU_ASSERT_PTR_EQUAL(interval_tree_first(&it, 10, 10), &b);
+	CU_ASSERT_EQUAL(it_unit_count(10, 10), 1);
+	CU_ASSERT_EQUAL(it_unit_count(9, 10), 2);
+	CU_ASSERT_EQUAL(it_unit_count(20, UINT64_MAX), 0);
+
+	interval_tree_remove(&it, &a);
+	interval_tree_remove(&it, &b);
+	CU_ASSERT(!interval_node_linked(&a));
+}
+
+void long_interval_found(void)
+{
+	struct interval_node n[10], eof;
+	int i;
+
+	/* a long interval starting early, hidden among short ones */
+	for (i = 0; i < 10; i++) {
+		it_unit_set(&n[i], i * 100, i * 100 + 9);
+		interval_tree_insert(&it, &n[i]);
+	}
+	it_unit_set(&eof, 50, UINT64_MAX);
+	interval_tree_insert(&it, &eof);
+	it_unit_check_tree();
+
+	CU_ASSERT_PTR_EQUAL(interval_tree_first(&it, 5000, 5000), &eof);
+	CU_ASSERT_EQUAL(it_unit_count(450, 455), 1);
+	CU_ASSERT_EQUAL(it_unit_count(400, 505), 3);
+
+	interval_tree_remove(&it, &eof);
+	it_unit_check_tree();
+	CU_ASSERT_EQUAL(it_unit_count(450, 455), 0);
+
+	for (i = 0; i < 10; i++)
+		interval_tree_remove(&it, &n[i]);
+}
+
+void equal_starts(void)
+{
+	struct interval_node n[5];
+	struct interval_node *node;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		it_unit_set(&n[i], 100, 100 + i * 10);
+		interval_tree_insert(&it, &n[i]);
+	}
+	it_unit_check_tree();
+	CU_ASSERT_EQUAL(it.count, 5);
+	CU_ASSERT_EQUAL(it_unit_count(125, 200), 2);
+
+	/* removing one leaves the others with the same start */
+	interval_tree_remove(&it, &n[3]);
+	it_unit_check_tree();
+	CU_ASSERT_EQUAL(it_unit_count(125, 200), 1);
+	interval_tree_for_each(node, &it, 0, UINT64_MAX)
+		CU_ASSERT_PTR_NOT_EQUAL(node, &n[3]);
+
+	for (i = 0; i < 5; i++)
+		if (i != 3)
+			interval_tree_remove(&it, &n[i]);
+}
+
+/* Unlocking the middle of a lock splits it in two, as state_lock does */
+void split_interval(void)
+{
+	struct interval_node whole, right;
+	struct interval_node *node;
+
+	it_unit_set(&whole, 0, 99);
+	interval_tree_insert(&it, &whole);
+
+	interval_tree_remove(&it, &whole);
+	whole.last = 39;
+	interval_tree_insert(&it, &whole);
+	it_unit_set(&right, 60, 99);
+	interval_tree_insert(&it, &right);
+	it_unit_check_tree();
+
+	CU_ASSERT_EQUAL(it_unit_count(40, 59), 0);
+	CU_ASSERT_EQUAL(it_unit_count(39, 39), 1);
+	CU_ASSERT_EQUAL(it_unit_count(60, 60), 1);
+
+	node = interval_tree_first(&it, 30, 70);
+	CU_ASSERT_PTR_EQUAL(node, &whole);
+	node = interval_tree_next(&it, node, 30, 70);
+	CU_ASSERT_PTR_EQUAL(node, &right);
+	CU_ASSERT_PTR_NULL(interval_tree_next(&it, node, 30, 70));
+
+	interval_tree_remove(&it, &whole);
+	interval_tree_remove(&it, &right);
+}
+
+void remove_while_walking(void)
+{
+	struct interval_node n[20];
+	struct interval_node *node, *next;
+	int i;
+
+	for (i = 0; i < 20; i++) {
+		it_unit_set(&n[i], i * 10, i * 10 + 14);
+		interval_tree_insert(&it, &n[i]);
+	}
+
+	interval_tree_for_each_safe(node, next, &it, 50, 120)
+		interval_tree_remove(&it, node);
+	it_unit_check_tree();
+
+	/* [40,54] through [120,134] are gone */
+	CU_ASSERT_EQUAL(it.count, 11);
+	CU_ASSERT_EQUAL(it_unit_count(50, 120), 0);
+	CU_ASSERT_EQUAL(it_unit_count(0, UINT64_MAX), 11);
+
+	interval_tree_for_each_safe(node, next, &it, 0, UINT64_MAX)
+		interval_tree_remove(&it, node);
+}
+
+/* Random inserts and removes, checked against a brute force search */
+void random_against_scan(void)
+{
+	uint64_t lo, hi;
+	int i, j, expect;
+
+	srandom(42);
+
+	for (i = 0; i < IT_UNIT_RANDOM; i++) {
+		lo = random() % 10000;
+		it_unit_set(&it_unit_nodes[i], lo, lo + random() % 200);
+		interval_tree_insert(&it, &it_unit_nodes[i]);
+	}
+	it_unit_check_tree();
+
+	for (i = 0; i < IT_UNIT_RANDOM; i += 2)
+		interval_tree_remove(&it, &it_unit_nodes[i]);
+	it_unit_check_tree();
+	CU_ASSERT_EQUAL(it.count, IT_UNIT_RANDOM / 2);
+
+	for (i = 0; i < 200; i++) {
+		lo = random() % 10300;
+		hi = lo + random() % 300;
+		expect = 0;
+		for (j = 1; j < IT_UNIT_RANDOM; j += 2)
+			if (it_unit_nodes[j].start <= hi
+			    && it_unit_nodes[j].last >= lo)
+				expect++;
+		CU_ASSERT_EQUAL(it_unit_count(lo, hi), expect);
+	}
+
+	for (i = 1; i < IT_UNIT_RANDOM; i += 2)
+		interval_tree_remove(&it, &it_unit_nodes[i]);
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo interval_tree_unit_arr[] = {
+		{"Empty tree.", empty_tree}
+		,
+		{"Touching intervals don't overlap.", touching_not_overlapping}
+		,
+		{"Long interval found.", long_interval_found}
+		,
+		{"Equal starts.", equal_starts}
+		,
+		{"Split interval.", split_interval}
+		,
+		{"Remove while walking.", remove_while_walking}
+		,
+		{"Random against scan.", random_against_scan}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Interval tree", init_suite, clean_suite,
+		 interval_tree_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
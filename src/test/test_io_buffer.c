@@ -0,0 +1,180 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CUnit/Basic.h"
+
+#include "nfs_core.h"
+#include "io_buffer.h"
+
+/* io_buffer.c reads the cache limit from here */
+nfs_parameter_t nfs_param;
+
+int init_suite(void)
+{
+	nfs_param.core_param.io_buffer_cache_mb = 2;
+	io_buf_pkginit();
+	return 0;
+}
+
+int clean_suite(void)
+{
+	return 0;
+}
+
+void page_aligned(void)
+{
+	size_t lens[] = {1, 4096, 4097, 65536, 1048576};
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	char *buf;
+	size_t ix;
+
+	for (ix = 0; ix < sizeof(lens) / sizeof(lens[0]); ix++) {
+		buf = io_buf_get(lens[ix]);
+		CU_ASSERT_PTR_NOT_NULL(buf);
+		if (buf == NULL)
+			continue;
+		CU_ASSERT_EQUAL((uintptr_t)buf % page, 0);
+		/* the whole length is usable */
+		memset(buf, 0xa5, lens[ix]);
+		io_buf_put(buf, lens[ix]);
+	}
+}
+
+void reuse_same_size(void)
+{
+	void *a, *b;
+
+	a = io_buf_get(8192);
+	io_buf_put(a, 8192);
+	b = io_buf_get(8192);
+	CU_ASSERT_PTR_EQUAL(a, b);
+	io_buf_put(b, 8192);
+}
+
+void reuse_same_class(void)
+{
+	void *a, *b;
+
+	/* 5000 bytes rounds up to the 8k class */
+	a = io_buf_get(5000);
+	io_buf_put(a, 5000);
+	b = io_buf_get(8192);
+	CU_ASSERT_PTR_EQUAL(a, b);
+	io_buf_put(b, 8192);
+}
+
+void reuse_lifo(void)
+{
+	void *a, *b;
+
+	a = io_buf_get(4096);
+	b = io_buf_get(4096);
+	CU_ASSERT_PTR_NOT_EQUAL(a, b);
+	io_buf_put(a, 4096);
+	io_buf_put(b, 4096);
+
+	/* the most recently freed, so most likely cache hot, comes first */
+	CU_ASSERT_PTR_EQUAL(io_buf_get(4096), b);
+	CU_ASSERT_PTR_EQUAL(io_buf_get(4096), a);
+	io_buf_put(a, 4096);
+	io_buf_put(b, 4096);
+}
+
+void classes_apart(void)
+{
+	void *a, *b;
+
+	a = io_buf_get(4096);
+	io_buf_put(a, 4096);
+
+	/* a is cached for 4k requests only */
+	b = io_buf_get(16384);
+	CU_ASSERT_PTR_NOT_EQUAL(a, b);
+	io_buf_put(b, 16384);
+	CU_ASSERT_PTR_EQUAL(io_buf_get(4096), a);
+	io_buf_put(a, 4096);
+}
+
+void cache_up_to_limit(void)
+{
+	void *a, *b;
+
+	/* with 2MB to cache, one 1MB buffer is kept, beside the small
+	 * ones the earlier tests left, and the second goes back */
+	a = io_buf_get(1048576);
+	b = io_buf_get(1048576);
+	io_buf_put(a, 1048576);
+	io_buf_put(b, 1048576);
+
+	b = io_buf_get(1048576);
+	CU_ASSERT_PTR_EQUAL(a, b);
+	io_buf_put(b, 1048576);
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo io_buffer_unit_arr[] = {
+		{"Buffers page aligned.", page_aligned}
+		,
+		{"Freed buffer reused.", reuse_same_size}
+		,
+		{"Buffer reused within its class.", reuse_same_class}
+		,
+		{"Last freed reused first.", reuse_lifo}
+		,
+		{"Classes kept apart.", classes_apart}
+		,
+		{"Buffers cached up to the limit.", cache_up_to_limit}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"I/O buffers", init_suite, clean_suite,
+		 io_buffer_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
@@ -0,0 +1,268 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "CUnit/Basic.h"
+
+#include "range_lock.h"
+
+struct range_lock rl;
+
+/* A thread acquiring one range and recording the order of grants */
+struct rl_unit_req {
+	pthread_t thread;
+	struct range_lock_entry re;
+	uint64_t offset;
+	uint64_t length;
+	bool exclusive;
+	int granted;		/* grant order, 0 while waiting */
+};
+
+static int rl_unit_grants;
+
+static void *rl_unit_acquire(void *arg)
+{
+	struct rl_unit_req *req = arg;
+
+	range_lock_acquire(&rl, &req->re, req->offset, req->length,
+			   req->exclusive);
+	req->granted = __sync_add_and_fetch(&rl_unit_grants, 1);
+
+	return NULL;
+}
+
+static int rl_unit_count(struct glist_head *head)
+{
+	struct glist_head *glist;
+	int n = 0;
+
+	pthread_mutex_lock(&rl.mtx);
+	glist_for_each(glist, head)
+		n++;
+	pthread_mutex_unlock(&rl.mtx);
+
+	return n;
+}
+
+/* Start a request and wait until it is granted or queued */
+static void rl_unit_start(struct rl_unit_req *req, uint64_t offset,
+			  uint64_t length, bool exclusive)
+{
+	int waiting = rl_unit_count(&rl.waiting);
+	int grants = rl_unit_grants;
+
+	memset(req, 0, sizeof(*req));
+	req->offset = offset;
+	req->length = length;
+	req->exclusive = exclusive;
+	pthread_create(&req->thread, NULL, rl_unit_acquire, req);
+
+	while (rl_unit_count(&rl.waiting) == waiting &&
+	       __sync_fetch_and_add(&rl_unit_grants, 0) == grants)
+		usleep(1000);
+}
+
+static void rl_unit_finish(struct rl_unit_req *req)
+{
+	pthread_join(req->thread, NULL);
+	range_lock_release(&rl, &req->re);
+}
+
+int init_suite(void)
+{
+	range_lock_init(&rl);
+	rl_unit_grants = 0;
+	return 0;
+}
+
+int clean_suite(void)
+{
+	CU_ASSERT(glist_empty(&rl.held));
+	CU_ASSERT(glist_empty(&rl.waiting));
+	range_lock_destroy(&rl);
+	return 0;
+}
+
+void shared_overlap(void)
+{
+	struct range_lock_entry a, b;
+
+	range_lock_acquire(&rl, &a, 0, 100, false);
+	range_lock_acquire(&rl, &b, 50, 100, false);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.held), 2);
+	range_lock_release(&rl, &b);
+	range_lock_release(&rl, &a);
+}
+
+void exclusive_disjoint(void)
+{
+	struct range_lock_entry a, b, c;
+
+	range_lock_acquire(&rl, &a, 0, 4096, true);
+	range_lock_acquire(&rl, &b, 4096, 4096, true);
+	range_lock_acquire(&rl, &c, 8192, 4096, false);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.held), 3);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.waiting), 0);
+	range_lock_release(&rl, &c);
+	range_lock_release(&rl, &a);
+	range_lock_release(&rl, &b);
+}
+
+void zero_length(void)
+{
+	struct range_lock_entry a, b;
+
+	range_lock_acquire(&rl, &a, 0, 100, true);
+	/* an empty range inside the held one neither waits nor is held */
+	range_lock_acquire(&rl, &b, 10, 0, true);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.held), 1);
+	range_lock_release(&rl, &b);
+	range_lock_release(&rl, &a);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.held), 0);
+}
+
+void overflow_to_eof(void)
+{
+	struct range_lock_entry a;
+
+	range_lock_acquire(&rl, &a, UINT64_MAX - 10, 100, true);
+	CU_ASSERT_EQUAL(a.end, UINT64_MAX);
+	range_lock_release(&rl, &a);
+}
+
+void writer_not_starved(void)
+{
+	struct range_lock_entry r1;
+	struct rl_unit_req w, r2;
+
+	rl_unit_grants = 0;
+	range_lock_acquire(&rl, &r1, 0, 100, false);
+
+	/* a writer queues behind the reader ... */
+	rl_unit_start(&w, 0, 100, true);
+	CU_ASSERT_EQUAL(w.granted, 0);
+
+	/* ... and a later reader queues behind the writer */
+	rl_unit_start(&r2, 50, 10, false);
+	CU_ASSERT_EQUAL(r2.granted, 0);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.waiting), 2);
+
+	range_lock_release(&rl, &r1);
+	pthread_join(w.thread, NULL);
+	CU_ASSERT_EQUAL(w.granted, 1);
+	CU_ASSERT_EQUAL(r2.granted, 0);
+
+	range_lock_release(&rl, &w.re);
+	rl_unit_finish(&r2);
+	CU_ASSERT_EQUAL(r2.granted, 2);
+}
+
+void disjoint_waiter_bypasses(void)
+{
+	struct range_lock_entry h;
+	struct rl_unit_req w, d;
+
+	rl_unit_grants = 0;
+	range_lock_acquire(&rl, &h, 0, 100, true);
+	rl_unit_start(&w, 0, 100, true);
+
+	/* conflicts with neither the holder nor the waiter */
+	rl_unit_start(&d, 200, 100, true);
+	pthread_join(d.thread, NULL);
+	CU_ASSERT_EQUAL(d.granted, 1);
+	CU_ASSERT_EQUAL(w.granted, 0);
+
+	range_lock_release(&rl, &d.re);
+	range_lock_release(&rl, &h);
+	rl_unit_finish(&w);
+	CU_ASSERT_EQUAL(w.granted, 2);
+}
+
+void fifo_grant(void)
+{
+	struct range_lock_entry h;
+	struct rl_unit_req req[4];
+	int ix;
+
+	rl_unit_grants = 0;
+	range_lock_acquire(&rl, &h, 0, 4096, true);
+
+	for (ix = 0; ix < 4; ix++)
+		rl_unit_start(&req[ix], ix * 10, 1000, true);
+	CU_ASSERT_EQUAL(rl_unit_count(&rl.waiting), 4);
+
+	range_lock_release(&rl, &h);
+	for (ix = 0; ix < 4; ix++) {
+		rl_unit_finish(&req[ix]);
+		CU_ASSERT_EQUAL(req[ix].granted, ix + 1);
+	}
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo range_lock_unit_arr[] = {
+		{"Shared ranges overlap.", shared_overlap}
+		,
+		{"Exclusive ranges disjoint.", exclusive_disjoint}
+		,
+		{"Zero length takes no lock.", zero_length}
+		,
+		{"Overflow locks to EOF.", overflow_to_eof}
+		,
+		{"Writer not starved by readers.", writer_not_starved}
+		,
+		{"Disjoint waiter bypasses queue.", disjoint_waiter_bypasses}
+		,
+		{"Conflicting waiters granted FIFO.", fifo_grant}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Range lock", init_suite, clean_suite,
+		 range_lock_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
@@ -0,0 +1,256 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "CUnit/Basic.h"
+
+#include "abstract_atomic.h"
+#include "slab_pool.h"
+
+#define SP_UNIT_THREADS 8
+#define SP_UNIT_OBJECTS 64
+#define SP_UNIT_ROUNDS 1000
+
+struct sp_unit_obj {
+	void *link;		/* the pool's while free */
+	uint64_t owner;
+	char data[48];
+};
+
+static uint32_t sp_unit_constructed;
+
+static void sp_unit_construct(void *object, void *param)
+{
+	sp_unit_constructed++;
+}
+
+/* Objects go back to the free list of the CPU freeing them, so keep
+ * to one CPU to see them handed out again */
+int init_suite(void)
+{
+	cpu_set_t cpus;
+	int cpu = sched_getcpu();
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu < 0 ? 0 : cpu, &cpus);
+	(void)sched_setaffinity(0, sizeof(cpus), &cpus);
+	return 0;
+}
+
+int clean_suite(void)
+{
+	return 0;
+}
+
+void reuse_zeroed(void)
+{
+	pool_t *pool;
+	struct sp_unit_obj *a, *b;
+	size_t i;
+
+	pool = pool_init("reuse", sizeof(*a), pool_slab_substrate,
+			 NULL, NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+
+	a = pool_alloc(pool, NULL);
+	memset(a, 0x5a, sizeof(*a));
+	pool_free(pool, a);
+
+	/* handed out again, and cleared like a fresh one */
+	b = pool_alloc(pool, NULL);
+	CU_ASSERT_PTR_EQUAL(a, b);
+	CU_ASSERT_PTR_NULL(b->link);
+	for (i = 0; i < sizeof(b->data); i++)
+		CU_ASSERT_EQUAL(b->data[i], 0);
+
+	pool_free(pool, b);
+	pool_destroy(pool);
+}
+
+void reuse_lifo(void)
+{
+	pool_t *pool;
+	struct sp_unit_obj *a, *b;
+
+	pool = pool_init("lifo", sizeof(*a), pool_slab_substrate,
+			 NULL, NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+
+	a = pool_alloc(pool, NULL);
+	b = pool_alloc(pool, NULL);
+	pool_free(pool, a);
+	pool_free(pool, b);
+
+	CU_ASSERT_PTR_EQUAL(pool_alloc(pool, NULL), b);
+	CU_ASSERT_PTR_EQUAL(pool_alloc(pool, NULL), a);
+
+	pool_free(pool, a);
+	pool_free(pool, b);
+	pool_destroy(pool);
+}
+
+void constructed_not_cleared(void)
+{
+	pool_t *pool;
+	struct sp_unit_obj *a;
+
+	pool = pool_init("constructed", sizeof(*a), pool_slab_substrate,
+			 NULL, sp_unit_construct, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+
+	sp_unit_constructed = 0;
+	a = pool_alloc(pool, NULL);
+	a->owner = 42;
+	pool_free(pool, a);
+
+	/* the constructor runs on every allocation, and owns clearing */
+	a = pool_alloc(pool, NULL);
+	CU_ASSERT_EQUAL(sp_unit_constructed, 2);
+	CU_ASSERT_EQUAL(a->owner, 42);
+
+	pool_free(pool, a);
+	pool_destroy(pool);
+}
+
+void free_list_capped(void)
+{
+	struct pool_slab_params params = { .max_free = 2 };
+	struct sp_unit_obj *objs[4];
+	pool_t *pool;
+	int i;
+
+	pool = pool_init("capped", sizeof(*objs[0]), pool_slab_substrate,
+			 &params, NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+
+	for (i = 0; i < 4; i++)
+		objs[i] = pool_alloc(pool, NULL);
+	for (i = 0; i < 4; i++)
+		pool_free(pool, objs[i]);
+
+	/* only two are kept, the rest went back to the allocator */
+	CU_ASSERT_EQUAL(pool_slab_shard(pool)->nfree, 2);
+	CU_ASSERT_PTR_EQUAL(pool_alloc(pool, NULL), objs[1]);
+	CU_ASSERT_PTR_EQUAL(pool_alloc(pool, NULL), objs[0]);
+	CU_ASSERT_EQUAL(pool_slab_shard(pool)->nfree, 0);
+
+	pool_free(pool, objs[0]);
+	pool_free(pool, objs[1]);
+	pool_destroy(pool);
+}
+
+static pool_t *sp_unit_pool;
+static uint32_t sp_unit_shared;
+
+static void *sp_unit_churn(void *arg)
+{
+	uint64_t me = (uintptr_t)arg;
+	struct sp_unit_obj *objs[SP_UNIT_OBJECTS];
+	int round, i;
+
+	for (round = 0; round < SP_UNIT_ROUNDS; round++) {
+		for (i = 0; i < SP_UNIT_OBJECTS; i++) {
+			objs[i] = pool_alloc(sp_unit_pool, NULL);
+			if (objs[i]->owner != 0)
+				atomic_inc_uint32_t(&sp_unit_shared);
+			objs[i]->owner = me;
+		}
+		sched_yield();
+		for (i = 0; i < SP_UNIT_OBJECTS; i++) {
+			/* no one else was handed it meanwhile */
+			if (objs[i]->owner != me)
+				atomic_inc_uint32_t(&sp_unit_shared);
+			pool_free(sp_unit_pool, objs[i]);
+		}
+	}
+
+	return NULL;
+}
+
+void threads_churn(void)
+{
+	pthread_t threads[SP_UNIT_THREADS];
+	uintptr_t i;
+
+	sp_unit_pool = pool_init("churn", sizeof(struct sp_unit_obj),
+				 pool_slab_substrate, NULL, NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sp_unit_pool);
+
+	sp_unit_shared = 0;
+	for (i = 0; i < SP_UNIT_THREADS; i++)
+		pthread_create(&threads[i], NULL, sp_unit_churn,
+			       (void *)(i + 1));
+	for (i = 0; i < SP_UNIT_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	CU_ASSERT_EQUAL(sp_unit_shared, 0);
+
+	/* destroying frees what the free lists kept */
+	pool_destroy(sp_unit_pool);
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo slab_pool_unit_arr[] = {
+		{"Freed object reused, zeroed.", reuse_zeroed}
+		,
+		{"Last freed reused first.", reuse_lifo}
+		,
+		{"Constructed object not cleared.", constructed_not_cleared}
+		,
+		{"Free list capped.", free_list_capped}
+		,
+		{"Threads never share an object.", threads_churn}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Slab pool", init_suite, clean_suite,
+		 slab_pool_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}
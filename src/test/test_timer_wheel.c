@@ -0,0 +1,255 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CUnit/Basic.h"
+
+#include "timer_wheel.h"
+
+/* Not aligned to any level of the wheel */
+#define TW_UNIT_START 1000003
+
+/* Seconds covered by the wheel */
+#define TW_UNIT_SPAN (1LL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+#define TW_UNIT_RANDOM 500
+
+struct timer_wheel tw;
+
+struct tw_unit_timer {
+	struct timer_wheel_entry te;
+	time_t fired;			/* second it expired, 0 if not */
+};
+
+static struct tw_unit_timer tw_unit_timers[TW_UNIT_RANDOM];
+
+/* Advance to now, noting when each expired timer fired */
+static void tw_unit_advance(time_t now)
+{
+	struct glist_head expired;
+	struct glist_head *glist, *glistn;
+	struct tw_unit_timer *t;
+	uint32_t count;
+
+	glist_init(&expired);
+	count = timer_wheel_advance(&tw, now, &expired);
+
+	glist_for_each_safe(glist, glistn, &expired) {
+		t = glist_entry(glist, struct tw_unit_timer, te.link);
+		glist_del(glist);
+		CU_ASSERT(!t->te.armed);
+		t->fired = now;
+		count--;
+	}
+	CU_ASSERT_EQUAL(count, 0);
+}
+
+static void tw_unit_arm(struct tw_unit_timer *t, time_t expires)
+{
+	memset(t, 0, sizeof(*t));
+	timer_wheel_arm(&tw, &t->te, expires);
+}
+
+int init_suite(void)
+{
+	timer_wheel_init(&tw, TW_UNIT_START);
+	return 0;
+}
+
+int clean_suite(void)
+{
+	CU_ASSERT_EQUAL(tw.armed, 0);
+	return 0;
+}
+
+void expires_on_time(void)
+{
+	struct tw_unit_timer t;
+	time_t now = tw.now;
+
+	tw_unit_arm(&t, now + 5);
+	CU_ASSERT(t.te.armed);
+	CU_ASSERT_EQUAL(tw.armed, 1);
+
+	tw_unit_advance(now + 4);
+	CU_ASSERT_EQUAL(t.fired, 0);
+	tw_unit_advance(now + 5);
+	CU_ASSERT_EQUAL(t.fired, now + 5);
+	CU_ASSERT_EQUAL(tw.armed, 0);
+}
+
+void past_deadline(void)
+{
+	struct tw_unit_timer t;
+	time_t now = tw.now;
+
+	tw_unit_arm(&t, now - 100);
+	tw_unit_advance(now);
+	CU_ASSERT_EQUAL(t.fired, now);
+}
+
+void disarm_and_rearm(void)
+{
+	struct tw_unit_timer a, b;
+	time_t now = tw.now;
+
+	tw_unit_arm(&a, now + 10);
+	tw_unit_arm(&b, now + 10);
+	CU_ASSERT(timer_wheel_disarm(&tw, &a.te));
+	CU_ASSERT(!timer_wheel_disarm(&tw, &a.te));
+
+	/* moving b, from level 0 to level 1 */
+	timer_wheel_arm(&tw, &b.te, now + 1000);
+	CU_ASSERT_EQUAL(tw.armed, 1);
+
+	tw_unit_advance(now + 999);
+	CU_ASSERT_EQUAL(a.fired, 0);
+	CU_ASSERT_EQUAL(b.fired, 0);
+	tw_unit_advance(now + 1000);
+	CU_ASSERT_EQUAL(b.fired, now + 1000);
+}
+
+/* One timer on each level, brought down as the wheel turns */
+void cascade(void)
+{
+	struct tw_unit_timer t[4];
+	time_t now = tw.now;
+	time_t when[4] = {now + 63, now + 64 * 64 - 1,
+			  now + 64 * 64 * 64 + 17, now + 5000000};
+	time_t sec;
+	int i;
+
+	for (i = 0; i < 4; i++)
+		tw_unit_arm(&t[i], when[i]);
+
+	/* a second at a time, so each cascade happens on its own */
+	for (sec = now; sec <= when[2]; sec++)
+		tw_unit_advance(sec);
+
+	for (i = 0; i < 3; i++)
+		CU_ASSERT_EQUAL(t[i].fired, when[i]);
+	CU_ASSERT_EQUAL(t[3].fired, 0);
+
+	/* and in one go */
+	tw_unit_advance(when[3] - 1);
+	CU_ASSERT_EQUAL(t[3].fired, 0);
+	tw_unit_advance(when[3]);
+	CU_ASSERT_EQUAL(t[3].fired, when[3]);
+}
+
+/* A deadline the wheel can't reach yet is held back, not lost */
+void beyond_span(void)
+{
+	struct tw_unit_timer t;
+	time_t now = tw.now;
+
+	tw_unit_arm(&t, now + TW_UNIT_SPAN + 1000);
+
+	tw_unit_advance(now + TW_UNIT_SPAN + 999);
+	CU_ASSERT_EQUAL(t.fired, 0);
+	CU_ASSERT(t.te.armed);
+	tw_unit_advance(now + TW_UNIT_SPAN + 1000);
+	CU_ASSERT_EQUAL(t.fired, now + TW_UNIT_SPAN + 1000);
+}
+
+/* Random deadlines, each fired by the first advance to reach it */
+void random_deadlines(void)
+{
+	time_t now = tw.now;
+	time_t sec, last = now;
+	int i;
+
+	srandom(42);
+
+	for (i = 0; i < TW_UNIT_RANDOM; i++) {
+		sec = now + random() % 300000;
+		tw_unit_arm(&tw_unit_timers[i], sec);
+		if (sec > last)
+			last = sec;
+	}
+
+	/* some are cancelled */
+	for (i = 0; i < TW_UNIT_RANDOM; i += 10)
+		CU_ASSERT(timer_wheel_disarm(&tw, &tw_unit_timers[i].te));
+
+	for (sec = now; sec <= last; sec += 1 + random() % 3)
+		tw_unit_advance(sec);
+	tw_unit_advance(last);
+
+	for (i = 0; i < TW_UNIT_RANDOM; i++) {
+		if (i % 10 == 0) {
+			CU_ASSERT_EQUAL(tw_unit_timers[i].fired, 0);
+			continue;
+		}
+		/* fired at the first advance at or past its deadline */
+		CU_ASSERT(tw_unit_timers[i].fired
+			  >= tw_unit_timers[i].te.expires);
+		CU_ASSERT(tw_unit_timers[i].fired
+			  <= tw_unit_timers[i].te.expires + 2);
+	}
+}
+
+/* The main() function for setting up and running the tests.
+ * Returns a CUE_SUCCESS on successful running, another
+ * CUnit error code on failure.
+ */
+int main(int argc, char *argv[])
+{
+	/* initialize the CUnit test registry...  get this party started */
+	if (CUE_SUCCESS != CU_initialize_registry())
+		return CU_get_error();
+
+	CU_TestInfo timer_wheel_unit_arr[] = {
+		{"Expires on time.", expires_on_time}
+		,
+		{"Past deadline expires at once.", past_deadline}
+		,
+		{"Disarm and rearm.", disarm_and_rearm}
+		,
+		{"Cascade through levels.", cascade}
+		,
+		{"Deadline beyond the wheel.", beyond_span}
+		,
+		{"Random deadlines.", random_deadlines}
+		,
+		CU_TEST_INFO_NULL,
+	};
+
+	CU_SuiteInfo suites[] = {
+		{"Timer wheel", init_suite, clean_suite,
+		 timer_wheel_unit_arr}
+		,
+		CU_SUITE_INFO_NULL,
+	};
+
+	if (CUE_SUCCESS != CU_register_suites(suites)) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	/* Run all tests using the CUnit Basic interface */
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	CU_cleanup_registry();
+
+	return CU_get_error();
+}